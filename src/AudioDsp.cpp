@@ -0,0 +1,255 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+
+#include "AudioDsp.h"
+
+static inline float toFloat(short s) { return s * (1.0f / 32768.0f); }
+static inline float toFloat(float s) { return s; }
+
+static inline void fromFloat(float v, short &s)
+{
+    v *= 32768.0f;
+    if(v >= 32767.0f) s = 32767;
+    else if(v <= -32768.0f) s = -32768;
+    else s = (short)(v < 0.0f ? v - 0.5f : v + 0.5f);
+}
+static inline void fromFloat(float v, float &s) { s = v; }
+
+AudioDsp::AudioDsp(int rate, int channels, bool isFloat):
+    rate(rate),
+    channels(channels),
+    isFloat(isFloat),
+    gain(1.0f),
+    targetGain(1.0f),
+    gainStep(0.0f),
+    gainLeft(0),
+    bassDb(0.0),
+    trebleDb(0.0),
+    targetBass(0.0),
+    targetTreble(0.0),
+    bassStep(0.0),
+    trebleStep(0.0),
+    shelfLeft(0),
+    filtering(false),
+    fadeFrames(0),
+    fadePos(0)
+{
+    rampFrames = DSP_RAMP_MS * rate / 1000;
+    if(rampFrames < 1) rampFrames = 1;
+    shelfRampFrames = DSP_SHELF_RAMP_MS * rate / 1000;
+    state.resize(channels * 4, 0.0f);
+    design();
+}
+
+/**
+ * Set the volume gain
+ *
+ * @param gain linear gain
+ * @param ramp false to jump to the new gain, e.g. before the first buffer
+ */
+void AudioDsp::setGain(double gain, bool ramp)
+{
+    targetGain = (float)gain;
+    if(!ramp) {
+        this->gain = targetGain;
+        gainLeft = 0;
+        return;
+    }
+    gainLeft = rampFrames;
+    gainStep = (targetGain - this->gain) / rampFrames;
+}
+
+/**
+ * Set the bass and treble shelves
+ *
+ * @param bassDb gain below DSP_BASS_HZ
+ * @param trebleDb gain above DSP_TREBLE_HZ
+ * @param ramp false to jump to the new response
+ */
+void AudioDsp::setShelves(double bassDb, double trebleDb, bool ramp)
+{
+    targetBass = bassDb;
+    targetTreble = trebleDb;
+    int blocks = ramp ? (shelfRampFrames + DSP_BLOCK_FRAMES - 1) / DSP_BLOCK_FRAMES : 0;
+    if(blocks == 0) {
+        this->bassDb = bassDb;
+        this->trebleDb = trebleDb;
+        shelfLeft = 0;
+        bool wasFiltering = filtering;
+        design();
+        if(filtering && !wasFiltering)
+            for(size_t i = 0; i < state.size(); i++) state[i] = 0.0f;
+        return;
+    }
+    shelfLeft = blocks;
+    bassStep = (targetBass - this->bassDb) / blocks;
+    trebleStep = (targetTreble - this->trebleDb) / blocks;
+}
+
+/**
+ * Ramp up from silence, e.g. after a seek
+ *
+ * @param ms length of the fade
+ */
+void AudioDsp::fadeIn(int ms)
+{
+    fadeFrames = (int)((long long)ms * rate / 1000);
+    fadePos = 0;
+}
+
+/**
+ * Forget the filter history, for a new segment. Gain and shelves are kept
+ * and pending ramps are completed at once.
+ */
+void AudioDsp::reset()
+{
+    for(size_t i = 0; i < state.size(); i++) state[i] = 0.0f;
+    if(gainLeft > 0) setGain(targetGain, false);
+    if(shelfLeft > 0) setShelves(targetBass, targetTreble, false);
+}
+
+/**
+ * @return true if process() would leave the samples unchanged
+ */
+bool AudioDsp::isNeutral()
+{
+    return !filtering && shelfLeft == 0 && gainLeft == 0 && gain == 1.0f && fadePos >= fadeFrames;
+}
+
+AudioDsp::biquad AudioDsp::shelf(bool high, double hz, double dB, int rate)
+{
+    double A = pow(10.0, dB / 40.0);
+    double w0 = 2.0 * M_PI * hz / rate;
+    double c = cos(w0);
+    double alpha = sin(w0) / 2.0 * sqrt(2.0);
+    double beta = 2.0 * sqrt(A) * alpha;
+    double sign = high ? -1.0 : 1.0;
+
+    double b0 = A * ((A + 1) - sign * (A - 1) * c + beta);
+    double b1 = sign * 2.0 * A * ((A - 1) - sign * (A + 1) * c);
+    double b2 = A * ((A + 1) - sign * (A - 1) * c - beta);
+    double a0 = (A + 1) + sign * (A - 1) * c + beta;
+    double a1 = -sign * 2.0 * ((A - 1) + sign * (A + 1) * c);
+    double a2 = (A + 1) + sign * (A - 1) * c - beta;
+
+    biquad q = { (float)(b0 / a0), (float)(b1 / a0), (float)(b2 / a0), (float)(a1 / a0), (float)(a2 / a0) };
+    return q;
+}
+
+/**
+ * Calculate the shelf coefficients for the current bassDb and trebleDb
+ */
+void AudioDsp::design()
+{
+    filtering = fabs(bassDb) > DSP_FLAT_DB || fabs(trebleDb) > DSP_FLAT_DB;
+
+    bass = shelf(false, DSP_BASS_HZ, bassDb, rate);
+    treble = shelf(true, DSP_TREBLE_HZ < rate * 0.45 ? DSP_TREBLE_HZ : rate * 0.45, trebleDb, rate);
+}
+
+/**
+ * The pass over the samples. CH is the channel count when known at
+ * compile time, 0 otherwise. With CH 2 the filter state stays in
+ * registers and both channels go through the same instructions side by
+ * side, which the compiler can turn into vector operations.
+ */
+template <typename T, int CH>
+void AudioDsp::run(T *data, int frames)
+{
+    const int nch = CH > 0 ? CH : channels;
+    float *z = &state[0];
+    float zl[CH > 0 ? CH * 4 : 1];
+    if(CH > 0) {
+        for(int k = 0; k < CH * 4; k++) zl[k] = z[k];
+        z = zl;
+    }
+
+    for(int start = 0; start < frames; start += DSP_BLOCK_FRAMES) {
+        int n = frames - start < DSP_BLOCK_FRAMES ? frames - start : DSP_BLOCK_FRAMES;
+        T *block = data + start * nch;
+
+        if(shelfLeft > 0) {
+            shelfLeft--;
+            bassDb = shelfLeft > 0 ? bassDb + bassStep : targetBass;
+            trebleDb = shelfLeft > 0 ? trebleDb + trebleStep : targetTreble;
+            bool wasFiltering = filtering;
+            design();
+            // Start the filters from rest, not from where they were last used
+            if(filtering && !wasFiltering)
+                for(int k = 0; k < nch * 4; k++) z[k] = 0.0f;
+        }
+
+        const biquad lo = bass, hi = treble;
+        const bool filter = filtering;
+        const float fadeStep = fadeFrames > 0 ? 1.0f / fadeFrames : 0.0f;
+
+        for(int i = 0; i < n; i++) {
+            float g = gain;
+            if(gainLeft > 0) {
+                gain = --gainLeft > 0 ? gain + gainStep : targetGain;
+            }
+            if(fadePos < fadeFrames) g *= fadePos++ * fadeStep;
+
+            T *frame = block + i * nch;
+            if(filter) {
+                for(int c = 0; c < nch; c++) {
+                    float *zc = z + c * 4;
+                    float x = toFloat(frame[c]);
+                    float y = lo.b0 * x + zc[0];
+                    zc[0] = lo.b1 * x - lo.a1 * y + zc[1];
+                    zc[1] = lo.b2 * x - lo.a2 * y;
+                    x = y;
+                    y = hi.b0 * x + zc[2];
+                    zc[2] = hi.b1 * x - hi.a1 * y + zc[3];
+                    zc[3] = hi.b2 * x - hi.a2 * y;
+                    fromFloat(y * g, frame[c]);
+                }
+            } else {
+                for(int c = 0; c < nch; c++)
+                    fromFloat(toFloat(frame[c]) * g, frame[c]);
+            }
+        }
+    }
+
+    if(CH > 0)
+        for(int k = 0; k < CH * 4; k++) state[k] = zl[k];
+}
+
+/**
+ * Process a block of audio in place
+ *
+ * @param data interleaved samples
+ * @param frames number of frames
+ */
+void AudioDsp::process(void *data, int frames)
+{
+    if(isNeutral()) return;
+    if(isFloat) {
+        if(channels == 2) run<float, 2>((float *)data, frames);
+        else if(channels == 1) run<float, 1>((float *)data, frames);
+        else run<float, 0>((float *)data, frames);
+    } else {
+        if(channels == 2) run<short, 2>((short *)data, frames);
+        else if(channels == 1) run<short, 1>((short *)data, frames);
+        else run<short, 0>((short *)data, frames);
+    }
+}
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef AUDIODSP_H
+#define AUDIODSP_H
+
+#include <vector>
+
+#define DSP_BASS_HZ 250.0       // Corner of the bass shelf
+#define DSP_TREBLE_HZ 3000.0    // Corner of the treble shelf
+#define DSP_RAMP_MS 20          // Gain changes are spread over this time
+#define DSP_SHELF_RAMP_MS 100   // Shelf changes are spread over this time
+#define DSP_BLOCK_FRAMES 32     // Shelf coefficients are recalculated this often while ramping
+#define DSP_FLAT_DB 0.01        // Shelves closer to 0 dB than this are left out
+
+/**
+ * Bass and treble shelves, volume gain and fade-in in one pass.
+ *
+ * Each frame goes through both shelf filters and gets the gain and fade
+ * applied while it is in registers, so the buffer is only read and
+ * written once. The shelves are second order filters (RBJ cookbook, slope
+ * 1) in transposed direct form II, one state per channel.
+ *
+ * Gain changes ramp linearly sample by sample over DSP_RAMP_MS. Shelf
+ * changes ramp in dB over DSP_SHELF_RAMP_MS, the coefficients are
+ * recalculated every DSP_BLOCK_FRAMES frames on the way. Sweeping the bass
+ * shelf faster than a few periods of its corner frequency makes it ring. A flat response skips the
+ * filters and unity gain with no fade skips the buffer altogether.
+ *
+ * Samples are interleaved 16 bit integers or 32 bit floats and processed
+ * in place, counts are in frames.
+ */
+class AudioDsp
+{
+    public:
+        AudioDsp(int rate, int channels, bool isFloat);
+
+        void setGain(double gain, bool ramp = true);
+        void setShelves(double bassDb, double trebleDb, bool ramp = true);
+        void fadeIn(int ms);
+        void reset();
+
+        void process(void *data, int frames);
+        bool isNeutral();
+
+    private:
+        struct biquad {
+            float b0, b1, b2, a1, a2;
+        };
+
+        template <typename T, int CH> void run(T *data, int frames);
+        void design();
+        static biquad shelf(bool high, double hz, double dB, int rate);
+
+        int rate;
+        int channels;
+        bool isFloat;
+        int rampFrames;
+        int shelfRampFrames;
+
+        float gain;
+        float targetGain;
+        float gainStep;
+        int gainLeft;           // Frames until gain reaches targetGain
+
+        double bassDb, trebleDb;
+        double targetBass, targetTreble;
+        double bassStep, trebleStep;
+        int shelfLeft;          // Blocks until the shelves reach their targets
+        bool filtering;         // Shelves are not flat
+        biquad bass, treble;
+
+        int fadeFrames;
+        int fadePos;            // Frames into the fade, fadeFrames when done
+
+        std::vector<float> state; // Per channel: bass z1, z2, treble z1, z2
+};
+
+#endif
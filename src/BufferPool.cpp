@@ -0,0 +1,199 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdlib>
+
+#include "BufferPool.h"
+
+#define POOL_PAD_KEY "kolibre-buffer-pool"
+
+// Headers are padded so the data after them is suitably aligned for samples
+#define HEADER_SIZE ((sizeof(BufferPool::header) + 15) & ~(size_t)15)
+
+BufferPool::BufferPool():
+    maxBytes(POOL_MAX_BYTES),
+    arenaFree(NULL),
+    arenaLeft(0)
+{
+    pthread_mutex_init(&poolMutex, NULL);
+    counters.requests = 0;
+    counters.reuses = 0;
+    counters.fallbacks = 0;
+    counters.arenaBytes = 0;
+    counters.inUseBytes = 0;
+}
+
+/**
+ * Frees the arenas, all buffers from the pool must be gone
+ */
+BufferPool::~BufferPool()
+{
+    for(size_t i = 0; i < arenas.size(); i++) free(arenas[i]);
+    pthread_mutex_destroy(&poolMutex);
+}
+
+/**
+ * Limit the memory held in arenas. Arenas already allocated are kept.
+ *
+ * @param bytes arena memory after which blocks come from the heap
+ */
+void BufferPool::setMaxBytes(size_t bytes)
+{
+    pthread_mutex_lock(&poolMutex);
+    maxBytes = bytes;
+    pthread_mutex_unlock(&poolMutex);
+}
+
+/**
+ * Get a block of memory
+ *
+ * @param size bytes needed
+ * @return the block, to be freed with release()
+ */
+void *BufferPool::acquire(size_t size)
+{
+    int sizeClass = 0;
+    size_t classSize = POOL_MIN_BLOCK;
+    while(classSize < size && sizeClass < POOL_CLASSES) {
+        classSize *= 2;
+        sizeClass++;
+    }
+
+    pthread_mutex_lock(&poolMutex);
+    counters.requests++;
+
+    header *block = NULL;
+    if(sizeClass < POOL_CLASSES) {
+        if(!freeLists[sizeClass].empty()) {
+            block = freeLists[sizeClass].back();
+            freeLists[sizeClass].pop_back();
+            counters.reuses++;
+        } else {
+            size_t needed = HEADER_SIZE + classSize;
+            if(arenaLeft < needed && counters.arenaBytes + POOL_ARENA_BYTES <= maxBytes) {
+                char *arena = (char *)malloc(POOL_ARENA_BYTES);
+                if(arena != NULL) {
+                    arenas.push_back(arena);
+                    arenaFree = arena;
+                    arenaLeft = POOL_ARENA_BYTES;
+                    counters.arenaBytes += POOL_ARENA_BYTES;
+                }
+            }
+            if(arenaLeft >= needed) {
+                block = (header *)arenaFree;
+                block->pool = this;
+                block->sizeClass = sizeClass;
+                block->size = classSize;
+                arenaFree += needed;
+                arenaLeft -= needed;
+            }
+        }
+    }
+
+    if(block == NULL) {
+        block = (header *)malloc(HEADER_SIZE + size);
+        if(block == NULL) {
+            pthread_mutex_unlock(&poolMutex);
+            return NULL;
+        }
+        block->pool = this;
+        block->sizeClass = -1;
+        block->size = size;
+        counters.fallbacks++;
+    }
+
+    counters.inUseBytes += block->size;
+    pthread_mutex_unlock(&poolMutex);
+
+    return (char *)block + HEADER_SIZE;
+}
+
+/**
+ * Give a block back to the pool it came from. Usable as a GFreeFunc.
+ *
+ * @param data block from acquire()
+ */
+void BufferPool::release(void *data)
+{
+    if(data == NULL) return;
+    header *block = (header *)((char *)data - HEADER_SIZE);
+    block->pool->put(block);
+}
+
+void BufferPool::put(header *block)
+{
+    pthread_mutex_lock(&poolMutex);
+    counters.inUseBytes -= block->size;
+    if(block->sizeClass < 0) free(block);
+    else freeLists[block->sizeClass].push_back(block);
+    pthread_mutex_unlock(&poolMutex);
+}
+
+/**
+ * Create a buffer with memory from the pool
+ *
+ * @param size bytes of data
+ * @return the buffer, or NULL if out of memory
+ */
+GstBuffer *BufferPool::newBuffer(guint size)
+{
+    void *data = acquire(size);
+    if(data == NULL) return NULL;
+
+    GstBuffer *buffer = gst_buffer_new();
+    GST_BUFFER_MALLOCDATA(buffer) = (guint8 *)data;
+    GST_BUFFER_FREE_FUNC(buffer) = BufferPool::release;
+    GST_BUFFER_DATA(buffer) = (guint8 *)data;
+    GST_BUFFER_SIZE(buffer) = size;
+    return buffer;
+}
+
+GstFlowReturn BufferPool::padAlloc(GstPad *pad, guint64 offset, guint size, GstCaps *caps, GstBuffer **buffer)
+{
+    BufferPool *pool = (BufferPool *)g_object_get_data(G_OBJECT(pad), POOL_PAD_KEY);
+
+    *buffer = pool->newBuffer(size);
+    if(*buffer == NULL) return GST_FLOW_ERROR;
+    GST_BUFFER_OFFSET(*buffer) = offset;
+    gst_buffer_set_caps(*buffer, caps);
+    return GST_FLOW_OK;
+}
+
+/**
+ * Serve the buffer allocations arriving at a sink pad from this pool
+ *
+ * @param pad sink pad, usually that of the audio sink
+ */
+void BufferPool::attach(GstPad *pad)
+{
+    g_object_set_data(G_OBJECT(pad), POOL_PAD_KEY, this);
+    gst_pad_set_bufferalloc_function(pad, BufferPool::padAlloc);
+}
+
+/**
+ * @return the allocation counters
+ */
+BufferPool::stats BufferPool::getStats()
+{
+    pthread_mutex_lock(&poolMutex);
+    stats s = counters;
+    pthread_mutex_unlock(&poolMutex);
+    return s;
+}
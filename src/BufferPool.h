@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <vector>
+#include <stddef.h>
+#include <pthread.h>
+#include <gst/gst.h>
+
+#define POOL_MIN_BLOCK 512                  // Smallest size class
+#define POOL_CLASSES 9                      // Size classes, doubling from POOL_MIN_BLOCK to 128 kB
+#define POOL_ARENA_BYTES (256 * 1024)       // Blocks are carved from arenas of this size
+#define POOL_MAX_BYTES (8 * 1024 * 1024)    // Arena memory before falling back to the heap
+#define POOL_LOWMEM_MAX_BYTES (1024 * 1024) // Arena memory in the low-memory profile
+
+/**
+ * Preallocated memory for audio buffers in the postprocessing chain.
+ *
+ * Blocks come in power of two size classes and are carved from large
+ * arenas that are never returned to the heap. Freed blocks go on a free
+ * list of their class and are handed out again, so irregular buffer
+ * sizes, e.g. from time-stretching, don't fragment the heap over long
+ * sessions. Requests larger than the biggest class, or made when the
+ * arenas have reached the maximum size, are served from the heap.
+ *
+ * attach() installs the pool as the buffer allocator of a pad. Elements
+ * upstream that allocate with gst_pad_alloc_buffer then get pool memory.
+ */
+class BufferPool
+{
+    public:
+        BufferPool();
+        ~BufferPool();
+
+        void setMaxBytes(size_t bytes);
+
+        void *acquire(size_t size);
+        static void release(void *data);
+
+        GstBuffer *newBuffer(guint size);
+        void attach(GstPad *pad);
+
+        struct stats {
+            unsigned long long requests;    // Blocks acquired
+            unsigned long long reuses;      // Served from a free list
+            unsigned long long fallbacks;   // Served from the heap
+            size_t arenaBytes;              // Memory held in arenas
+            size_t inUseBytes;              // Memory of blocks not yet released
+        };
+        stats getStats();
+
+    private:
+        /**
+         * Placed in front of every block, tells release() where it belongs
+         */
+        struct header {
+            BufferPool *pool;
+            int sizeClass;                  // -1 for heap blocks
+            size_t size;                    // Usable size of the block
+        };
+
+        static GstFlowReturn padAlloc(GstPad *pad, guint64 offset, guint size, GstCaps *caps, GstBuffer **buffer);
+        void put(header *block);
+
+        pthread_mutex_t poolMutex;
+        size_t maxBytes;
+        std::vector<char *> arenas;
+        char *arenaFree;                    // Unused part of the newest arena
+        size_t arenaLeft;
+        std::vector<header *> freeLists[POOL_CLASSES];
+        stats counters;
+};
+
+#endif
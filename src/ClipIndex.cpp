@@ -0,0 +1,228 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "ClipIndex.h"
+#include "SmilTime.h"
+
+using namespace std;
+
+// Orders clip numbers by file and begin, ties in book order
+struct ClipOrder
+{
+    const vector<unsigned int> &files;
+    const vector<unsigned int> &begins;
+
+    ClipOrder(const vector<unsigned int> &f, const vector<unsigned int> &b): files(f), begins(b) {}
+
+    bool operator()(unsigned int a, unsigned int b) const
+    {
+        if(files[a] != files[b]) return files[a] < files[b];
+        if(begins[a] != begins[b]) return begins[a] < begins[b];
+        return a < b;
+    }
+};
+
+// Convert a clip attribute, missing gives fallback
+static bool clipTime(const char *str, unsigned int fallback, unsigned int &ms)
+{
+    ms = fallback;
+    if(str == NULL || *str == '\0') return true;
+
+    unsigned long value;
+    if(!SmilTimeCode::parse(str, value)) return false;
+    ms = value < CLIP_TO_END ? (unsigned int)value : CLIP_TO_END - 1;
+    return true;
+}
+
+ClipIndex::ClipIndex():
+    fileFirst(1, 0)
+{
+    pthread_mutex_init(&clipMutex, NULL);
+}
+
+ClipIndex::~ClipIndex()
+{
+    pthread_mutex_destroy(&clipMutex);
+}
+
+/**
+ * Replace the clips. Missing begins are 0 and missing ends CLIP_TO_END,
+ * values that are not clock values are taken as missing.
+ *
+ * @param urls file of each clip, as passed to open
+ * @param clipBegins SMIL clock value where each clip begins, entries may be NULL
+ * @param clipEnds SMIL clock value where each clip ends, entries may be NULL
+ * @param count number of clips
+ * @return the number of clips with valid times
+ */
+size_t ClipIndex::set(const char *const *urls, const char *const *clipBegins,
+        const char *const *clipEnds, size_t count)
+{
+    vector<string> newFiles;
+    map<string, unsigned int> newFileNumbers;
+    vector<unsigned int> newClipFiles(count), clipBegin(count), clipEnd(count);
+    size_t valid = 0;
+
+    // Books list many clips of a file in a row, look the name up once for them
+    const char *lastUrl = NULL;
+    unsigned int lastFile = 0;
+    for(size_t i = 0; i < count; i++) {
+        const char *url = urls[i] != NULL ? urls[i] : "";
+        if(lastUrl == NULL || strcmp(url, lastUrl) != 0) {
+            map<string, unsigned int>::iterator it = newFileNumbers.find(url);
+            if(it == newFileNumbers.end()) {
+                it = newFileNumbers.insert(make_pair(string(url), (unsigned int)newFiles.size())).first;
+                newFiles.push_back(url);
+            }
+            lastUrl = url;
+            lastFile = it->second;
+        }
+        newClipFiles[i] = lastFile;
+
+        bool ok = clipTime(clipBegins[i], 0, clipBegin[i]);
+        if(!clipTime(clipEnds[i], CLIP_TO_END, clipEnd[i])) ok = false;
+        if(ok) valid++;
+    }
+
+    vector<unsigned int> order(count);
+    for(size_t i = 0; i < count; i++) order[i] = i;
+    sort(order.begin(), order.end(), ClipOrder(newClipFiles, clipBegin));
+
+    vector<unsigned int> newFileFirst(newFiles.size() + 1, 0);
+    vector<unsigned int> newBegins(count), newEnds(count), newClipSlots(count);
+    for(size_t slot = 0; slot < count; slot++) {
+        unsigned int clip = order[slot];
+        newBegins[slot] = clipBegin[clip];
+        newEnds[slot] = clipEnd[clip];
+        newClipSlots[clip] = slot;
+        newFileFirst[newClipFiles[clip] + 1] = slot + 1;
+    }
+    // Every file has a clip, so each entry has been set
+
+    pthread_mutex_lock(&clipMutex);
+    files.swap(newFiles);
+    fileNumbers.swap(newFileNumbers);
+    fileFirst.swap(newFileFirst);
+    begins.swap(newBegins);
+    ends.swap(newEnds);
+    clips.swap(order);
+    clipFiles.swap(newClipFiles);
+    clipSlots.swap(newClipSlots);
+    pthread_mutex_unlock(&clipMutex);
+
+    return valid;
+}
+
+/**
+ * Remove all clips
+ */
+void ClipIndex::reset()
+{
+    set(NULL, NULL, NULL, 0);
+}
+
+/**
+ * @return number of clips
+ */
+size_t ClipIndex::size()
+{
+    pthread_mutex_lock(&clipMutex);
+    size_t n = clipFiles.size();
+    pthread_mutex_unlock(&clipMutex);
+    return n;
+}
+
+/**
+ * Find the clip playing at a position. Clips of a file should not overlap,
+ * if they do only the one that begins last before the position is looked
+ * at.
+ *
+ * @param url file, as passed to open
+ * @param ms position in the file (ms)
+ * @return the clip number, -1 if no clip of the file contains ms
+ */
+long ClipIndex::find(const string &url, long long ms)
+{
+    if(ms < 0 || ms >= CLIP_TO_END) return -1;
+
+    long clip = -1;
+    pthread_mutex_lock(&clipMutex);
+    map<string, unsigned int>::const_iterator it = fileNumbers.find(url);
+    if(it != fileNumbers.end()) {
+        vector<unsigned int>::const_iterator first = begins.begin() + fileFirst[it->second];
+        vector<unsigned int>::const_iterator last = begins.begin() + fileFirst[it->second + 1];
+        vector<unsigned int>::const_iterator after = upper_bound(first, last, (unsigned int)ms);
+        if(after != first) {
+            size_t slot = (after - begins.begin()) - 1;
+            if(ms < ends[slot]) clip = clips[slot];
+        }
+    }
+    pthread_mutex_unlock(&clipMutex);
+    return clip;
+}
+
+/**
+ * @param clip a clip number
+ * @return the clip after it in the book, -1 at the last
+ */
+long ClipIndex::next(long clip)
+{
+    pthread_mutex_lock(&clipMutex);
+    long n = clipFiles.size();
+    pthread_mutex_unlock(&clipMutex);
+    return clip >= 0 && clip + 1 < n ? clip + 1 : -1;
+}
+
+/**
+ * @param clip a clip number
+ * @return the clip before it in the book, -1 at the first
+ */
+long ClipIndex::previous(long clip)
+{
+    pthread_mutex_lock(&clipMutex);
+    long n = clipFiles.size();
+    pthread_mutex_unlock(&clipMutex);
+    return clip > 0 && clip < n ? clip - 1 : -1;
+}
+
+/**
+ * Get a clip
+ *
+ * @param clip clip number
+ * @param url receives the file
+ * @param beginms receives the begin (ms)
+ * @param endms receives the end (ms), CLIP_TO_END if it runs to the end of the file
+ * @return false if there is no such clip
+ */
+bool ClipIndex::get(long clip, string &url, long long &beginms, long long &endms)
+{
+    pthread_mutex_lock(&clipMutex);
+    bool found = clip >= 0 && clip < (long)clipFiles.size();
+    if(found) {
+        size_t slot = clipSlots[clip];
+        url = files[clipFiles[clip]];
+        beginms = begins[slot];
+        endms = ends[slot];
+    }
+    pthread_mutex_unlock(&clipMutex);
+    return found;
+}
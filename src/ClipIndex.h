@@ -0,0 +1,72 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLIPINDEX_H
+#define CLIPINDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#define CLIP_TO_END 0xffffffffU     // Clip end when it runs to the end of the file, as UINT_MAX in open
+
+/**
+ * The audio clips of a book, e.g. from the clipBegin and clipEnd attributes
+ * of its SMIL files, numbered in book order.
+ *
+ * The clips are kept as arrays of begin, end and clip number sorted by
+ * file and begin, so that the clip playing at a position is found with a
+ * binary search in the range of its file. Each file name is stored once.
+ * Times are ms in 32 bits, enough for 49 days per file.
+ */
+class ClipIndex
+{
+    public:
+        ClipIndex();
+        ~ClipIndex();
+
+        size_t set(const char *const *urls, const char *const *clipBegins,
+                const char *const *clipEnds, size_t count);
+        void reset();
+        size_t size();
+
+        long find(const std::string &url, long long ms);
+        long next(long clip);
+        long previous(long clip);
+        bool get(long clip, std::string &url, long long &beginms, long long &endms);
+
+    private:
+        pthread_mutex_t clipMutex;
+
+        std::vector<std::string> files;
+        std::map<std::string, unsigned int> fileNumbers;
+        std::vector<unsigned int> fileFirst;    // First slot of each file, and the number of clips last
+
+        // Sorted by file and begin
+        std::vector<unsigned int> begins;
+        std::vector<unsigned int> ends;
+        std::vector<unsigned int> clips;
+
+        // In book order
+        std::vector<unsigned int> clipFiles;
+        std::vector<unsigned int> clipSlots;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "CueList.h"
+
+using namespace std;
+
+CueList::CueList():
+    cursor(0),
+    synced(false)
+{
+    pthread_mutex_init(&cueMutex, NULL);
+}
+
+CueList::~CueList()
+{
+    pthread_mutex_destroy(&cueMutex);
+}
+
+/**
+ * Replace the cues
+ *
+ * @param ms media positions in milliseconds, in any order
+ */
+void CueList::set(const vector<long long> &ms)
+{
+    pthread_mutex_lock(&cueMutex);
+    cues = ms;
+    sort(cues.begin(), cues.end());
+    cues.erase(unique(cues.begin(), cues.end()), cues.end());
+    cursor = 0;
+    synced = false;
+    pthread_mutex_unlock(&cueMutex);
+}
+
+/**
+ * Find the cursor from the next position, when a new file is opened
+ */
+void CueList::reset()
+{
+    pthread_mutex_lock(&cueMutex);
+    synced = false;
+    pthread_mutex_unlock(&cueMutex);
+}
+
+/**
+ * @return number of cues
+ */
+size_t CueList::size()
+{
+    pthread_mutex_lock(&cueMutex);
+    size_t n = cues.size();
+    pthread_mutex_unlock(&cueMutex);
+    return n;
+}
+
+/**
+ * Get the next cue to send, moving the cursor if the position has jumped
+ *
+ * @param ms audible position (ms)
+ * @return the cue (ms), -1 when there are no more
+ */
+long long CueList::pending(long long ms)
+{
+    pthread_mutex_lock(&cueMutex);
+    if(!synced ||
+            (cursor > 0 && ms < cues[cursor - 1] - CUE_SEEK_MS) ||
+            (cursor < cues.size() && ms > cues[cursor] + CUE_SEEK_MS)) {
+        cursor = lower_bound(cues.begin(), cues.end(), ms) - cues.begin();
+        synced = true;
+    }
+    long long cue = cursor < cues.size() ? cues[cursor] : -1;
+    pthread_mutex_unlock(&cueMutex);
+
+    return cue;
+}
+
+/**
+ * Take the cues that have become audible
+ *
+ * @param ms audible position (ms)
+ * @param taken the cues at or before ms that were not sent are appended
+ */
+void CueList::take(long long ms, vector<long long> &taken)
+{
+    pthread_mutex_lock(&cueMutex);
+    if(synced)
+        for(; cursor < cues.size() && cues[cursor] <= ms; cursor++)
+            taken.push_back(cues[cursor]);
+    pthread_mutex_unlock(&cueMutex);
+}
@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CUELIST_H
+#define CUELIST_H
+
+#include <vector>
+#include <pthread.h>
+
+#define CUE_SEEK_MS 250             // Position jump that is taken for a seek
+
+/**
+ * Cue points of the playing file, e.g. the clip starts of a SMIL file that
+ * text is highlighted at.
+ *
+ * The cues are kept sorted in one array with a cursor at the first cue not
+ * yet sent. The player thread asks for the pending cue to schedule it on
+ * the pipeline clock, and the cues up to the audible position are taken
+ * when the clock reaches it. When the position jumps further than
+ * CUE_SEEK_MS away from the cursor it is moved there, cues skipped by a
+ * seek are not sent and cues before a seek backwards are sent again.
+ */
+class CueList
+{
+    public:
+        CueList();
+        ~CueList();
+
+        void set(const std::vector<long long> &ms);
+        void reset();
+        size_t size();
+
+        long long pending(long long ms);
+        void take(long long ms, std::vector<long long> &taken);
+
+    private:
+        pthread_mutex_t cueMutex;
+        std::vector<long long> cues;        // Sorted
+        size_t cursor;                      // First cue not sent
+        bool synced;                        // cursor follows the position
+};
+
+#endif
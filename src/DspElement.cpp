@@ -0,0 +1,287 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <log4cxx/logger.h>
+
+#include "DspElement.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr dspElementLog(log4cxx::Logger::getLogger("kolibre.player.dspelement"));
+
+enum {
+    PROP_0,
+    PROP_AMPLIFICATION,
+    PROP_BASS,
+    PROP_TREBLE,
+    PROP_FADE_IN
+};
+
+#define DSP_CAPS \
+    "audio/x-raw-int, " \
+    "width = (int) 16, " \
+    "depth = (int) 16, " \
+    "signed = (boolean) true, " \
+    "endianness = (int) BYTE_ORDER, " \
+    "rate = (int) [ 8000, 96000 ], " \
+    "channels = (int) [ 1, 2 ]; " \
+    "audio/x-raw-float, " \
+    "width = (int) 32, " \
+    "endianness = (int) BYTE_ORDER, " \
+    "rate = (int) [ 8000, 96000 ], " \
+    "channels = (int) [ 1, 2 ]"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+        GST_PAD_SINK,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS (DSP_CAPS));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+        GST_PAD_SRC,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS (DSP_CAPS));
+
+GST_BOILERPLATE (GstKolibreDsp, gst_kolibre_dsp, GstBaseTransform, GST_TYPE_BASE_TRANSFORM);
+
+static void gst_kolibre_dsp_finalize (GObject *object);
+static void gst_kolibre_dsp_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_kolibre_dsp_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static gboolean gst_kolibre_dsp_set_caps (GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps);
+static gboolean gst_kolibre_dsp_event (GstBaseTransform *trans, GstEvent *event);
+static GstFlowReturn gst_kolibre_dsp_transform_ip (GstBaseTransform *trans, GstBuffer *buffer);
+
+static void gst_kolibre_dsp_base_init (gpointer g_class)
+{
+    GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&src_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&sink_template));
+    gst_element_class_set_details_simple (element_class, "Tone, volume and fade",
+            "Filter/Effect/Audio", "Bass and treble shelves, gain and fade-in in one pass", "Kolibre");
+}
+
+static void gst_kolibre_dsp_class_init (GstKolibreDspClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+    GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
+
+    gobject_class->set_property = gst_kolibre_dsp_set_property;
+    gobject_class->get_property = gst_kolibre_dsp_get_property;
+    gobject_class->finalize = gst_kolibre_dsp_finalize;
+
+    g_object_class_install_property (gobject_class, PROP_AMPLIFICATION,
+            g_param_spec_float ("amplification", "Amplification", "Factor of amplification",
+                0.0, 100.0, 1.0, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_BASS,
+            g_param_spec_double ("bass", "Bass", "Gain in dB below the bass corner",
+                -24.0, 12.0, 0.0, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_TREBLE,
+            g_param_spec_double ("treble", "Treble", "Gain in dB above the treble corner",
+                -24.0, 12.0, 0.0, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_FADE_IN,
+            g_param_spec_uint ("fade-in", "Fade in", "Milliseconds to fade in from the next buffer, 0 for none",
+                0, 10000, 0, (GParamFlags) G_PARAM_READWRITE));
+
+    trans_class->set_caps = GST_DEBUG_FUNCPTR (gst_kolibre_dsp_set_caps);
+    trans_class->event = GST_DEBUG_FUNCPTR (gst_kolibre_dsp_event);
+    trans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_kolibre_dsp_transform_ip);
+}
+
+static void gst_kolibre_dsp_init (GstKolibreDsp *self, GstKolibreDspClass *klass)
+{
+    gst_base_transform_set_in_place (GST_BASE_TRANSFORM (self), TRUE);
+
+    self->dsp = NULL;
+    self->amplification = 1.0;
+    self->bass = 0.0;
+    self->treble = 0.0;
+    self->fadeIn = 0;
+    self->changed = TRUE;
+    self->fadePending = FALSE;
+    self->bytesPerFrame = 0;
+}
+
+static void gst_kolibre_dsp_finalize (GObject *object)
+{
+    GstKolibreDsp *self = GST_KOLIBRE_DSP (object);
+
+    delete self->dsp;
+    self->dsp = NULL;
+
+    G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void gst_kolibre_dsp_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    GstKolibreDsp *self = GST_KOLIBRE_DSP (object);
+
+    GST_OBJECT_LOCK (self);
+    switch (prop_id) {
+        case PROP_AMPLIFICATION:
+            self->amplification = g_value_get_float (value);
+            break;
+        case PROP_BASS:
+            self->bass = g_value_get_double (value);
+            break;
+        case PROP_TREBLE:
+            self->treble = g_value_get_double (value);
+            break;
+        case PROP_FADE_IN:
+            self->fadeIn = g_value_get_uint (value);
+            self->fadePending = self->fadeIn > 0;
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    self->changed = TRUE;
+    GST_OBJECT_UNLOCK (self);
+
+    gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (self), FALSE);
+}
+
+static void gst_kolibre_dsp_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    GstKolibreDsp *self = GST_KOLIBRE_DSP (object);
+
+    GST_OBJECT_LOCK (self);
+    switch (prop_id) {
+        case PROP_AMPLIFICATION:
+            g_value_set_float (value, self->amplification);
+            break;
+        case PROP_BASS:
+            g_value_set_double (value, self->bass);
+            break;
+        case PROP_TREBLE:
+            g_value_set_double (value, self->treble);
+            break;
+        case PROP_FADE_IN:
+            g_value_set_uint (value, self->fadeIn);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * Start a new segment, forgetting the filter state of the old one
+ */
+static void gst_kolibre_dsp_reset (GstKolibreDsp *self)
+{
+    GST_OBJECT_LOCK (self);
+    if (self->dsp) self->dsp->reset ();
+    GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean gst_kolibre_dsp_set_caps (GstBaseTransform *trans, GstCaps *incaps, GstCaps *outcaps)
+{
+    GstKolibreDsp *self = GST_KOLIBRE_DSP (trans);
+    GstStructure *structure = gst_caps_get_structure (incaps, 0);
+    gboolean isFloat = gst_structure_has_name (structure, "audio/x-raw-float");
+    gint rate, channels;
+
+    if (!gst_structure_get_int (structure, "rate", &rate) ||
+            !gst_structure_get_int (structure, "channels", &channels))
+        return FALSE;
+
+    // Start out at the current settings, ramps are for changes while playing
+    GST_OBJECT_LOCK (self);
+    delete self->dsp;
+    self->dsp = new AudioDsp (rate, channels, isFloat);
+    self->dsp->setGain (self->amplification, false);
+    self->dsp->setShelves (self->bass, self->treble, false);
+    self->bytesPerFrame = channels * (isFloat ? sizeof(float) : sizeof(short));
+    self->changed = FALSE;
+    gboolean neutral = self->dsp->isNeutral () && !self->fadePending;
+    GST_OBJECT_UNLOCK (self);
+
+    gst_base_transform_set_passthrough (trans, neutral);
+    return TRUE;
+}
+
+static gboolean gst_kolibre_dsp_event (GstBaseTransform *trans, GstEvent *event)
+{
+    GstKolibreDsp *self = GST_KOLIBRE_DSP (trans);
+
+    switch (GST_EVENT_TYPE (event)) {
+        case GST_EVENT_FLUSH_STOP:
+            gst_kolibre_dsp_reset (self);
+            break;
+        case GST_EVENT_NEWSEGMENT:
+            {
+                gboolean update;
+                gst_event_parse_new_segment (event, &update, NULL, NULL, NULL, NULL, NULL);
+                if (!update) gst_kolibre_dsp_reset (self);
+                break;
+            }
+        default:
+            break;
+    }
+
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->event (trans, event);
+}
+
+static GstFlowReturn gst_kolibre_dsp_transform_ip (GstBaseTransform *trans, GstBuffer *buffer)
+{
+    GstKolibreDsp *self = GST_KOLIBRE_DSP (trans);
+
+    // Nothing to do, the buffer is read-only
+    if (gst_base_transform_is_passthrough (trans)) return GST_FLOW_OK;
+
+    GST_OBJECT_LOCK (self);
+    if (self->dsp == NULL) {
+        GST_OBJECT_UNLOCK (self);
+        return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    if (self->changed) {
+        self->dsp->setGain (self->amplification);
+        self->dsp->setShelves (self->bass, self->treble);
+        self->changed = FALSE;
+    }
+    if (self->fadePending) {
+        self->dsp->fadeIn (self->fadeIn);
+        self->fadePending = FALSE;
+    }
+
+    self->dsp->process (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer) / self->bytesPerFrame);
+    gboolean neutral = self->dsp->isNeutral () && !self->changed && !self->fadePending;
+    GST_OBJECT_UNLOCK (self);
+
+    // Skip making buffers writable until something changes
+    if (neutral) gst_base_transform_set_passthrough (trans, TRUE);
+
+    return GST_FLOW_OK;
+}
+
+/**
+ * Make the kolibredsp element available to gst_element_factory_make
+ *
+ * @return true on success
+ */
+bool dsp_element_register()
+{
+    if (!gst_element_register (NULL, "kolibredsp", GST_RANK_NONE, GST_TYPE_KOLIBRE_DSP)) {
+        LOG4CXX_ERROR(dspElementLog, "Failed to register kolibredsp element");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DSPELEMENT_H
+#define DSPELEMENT_H
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+#include "AudioDsp.h"
+
+#define GST_TYPE_KOLIBRE_DSP (gst_kolibre_dsp_get_type())
+#define GST_KOLIBRE_DSP(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_KOLIBRE_DSP, GstKolibreDsp))
+
+/**
+ * The "kolibredsp" element applies bass and treble, volume and a fade-in
+ * in place, in one pass over each buffer. It takes the place of
+ * equalizer-10bands and audioamplify, the "amplification" property works
+ * like audioamplify's.
+ *
+ * Property changes are ramped, see AudioDsp. Setting "fade-in" fades in
+ * that many milliseconds from the next buffer. New segments do not fade by
+ * themselves: after a seek the player drops the seek margin downstream,
+ * so only it knows the first buffer that is heard.
+ */
+typedef struct {
+    GstBaseTransform element;
+
+    AudioDsp *dsp;              // Used in the streaming thread with the object lock held
+    gint bytesPerFrame;
+
+    // Properties, protected by the object lock
+    gfloat amplification;
+    gdouble bass;
+    gdouble treble;
+    guint fadeIn;
+    gboolean changed;
+    gboolean fadePending;       // Fade in from the next buffer
+} GstKolibreDsp;
+
+typedef struct {
+    GstBaseTransformClass parent_class;
+} GstKolibreDspClass;
+
+GType gst_kolibre_dsp_get_type(void);
+
+bool dsp_element_register();
+
+#endif
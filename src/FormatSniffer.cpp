@@ -0,0 +1,337 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <log4cxx/logger.h>
+
+#include "FormatSniffer.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr formatSnifferLog(log4cxx::Logger::getLogger("kolibre.player.formatsniffer"));
+
+using namespace std;
+
+#define SYNC_SCAN_BYTES 2048    // Bytes searched for an MPEG or ADTS frame sync
+
+// MPEG audio bitrates in kbit/s, [version 1 or 2/2.5][layer 1-3][index]
+static const int mpegBitrates[2][3][16] = {
+    {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 }
+    },
+    {
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 }
+    }
+};
+
+// MPEG audio sample rates, [version 2.5, reserved, 2, 1][index]
+static const int mpegRates[4][3] = {
+    { 11025, 12000, 8000 },
+    { 0, 0, 0 },
+    { 22050, 24000, 16000 },
+    { 44100, 48000, 32000 }
+};
+
+/**
+ * Length in bytes of the MPEG audio frame with the header at data
+ *
+ * @return frame length or 0 if data is not a valid frame header
+ */
+static size_t mpegFrameLength(const unsigned char *data)
+{
+    if(data[0] != 0xFF || (data[1] & 0xE0) != 0xE0) return 0;
+
+    int version = (data[1] >> 3) & 0x03;    // 0 = 2.5, 1 = reserved, 2 = 2, 3 = 1
+    int layer = 4 - ((data[1] >> 1) & 0x03);  // 4 = reserved
+    int bitrateIndex = data[2] >> 4;
+    int rateIndex = (data[2] >> 2) & 0x03;
+    int padding = (data[2] >> 1) & 0x01;
+
+    if(version == 1 || layer == 4 || rateIndex == 3) return 0;
+
+    int bitrate = mpegBitrates[version == 3 ? 0 : 1][layer - 1][bitrateIndex] * 1000;
+    int rate = mpegRates[version][rateIndex];
+    if(bitrate == 0) return 0;
+
+    if(layer == 1) return (12 * bitrate / rate + padding) * 4;
+    if(layer == 3 && version != 3) return 72 * bitrate / rate + padding;
+    return 144 * bitrate / rate + padding;
+}
+
+/**
+ * Check for an ADTS frame header at data
+ */
+static bool isAdtsHeader(const unsigned char *data, size_t size)
+{
+    if(size < 7) return false;
+    if(data[0] != 0xFF || (data[1] & 0xF6) != 0xF0) return false;
+    if(((data[2] >> 2) & 0x0F) > 12) return false;   // Sample rate index
+    size_t length = ((data[3] & 0x03) << 11) | (data[4] << 3) | (data[5] >> 5);
+    if(length < 7) return false;
+
+    // Confirm with the next frame when it is in the buffer
+    if(length + 2 <= size) return data[length] == 0xFF && (data[length + 1] & 0xF6) == 0xF0;
+    return true;
+}
+
+/**
+ * Search for a byte string in a buffer
+ */
+static bool contains(const unsigned char *data, size_t size, const char *needle, size_t length)
+{
+    if(size < length) return false;
+    for(size_t i = 0; i + length <= size; i++)
+        if(memcmp(data + i, needle, length) == 0) return true;
+    return false;
+}
+
+FormatSniffer::FormatSniffer()
+{
+    pthread_mutex_init(&cacheMutex, NULL);
+}
+
+FormatSniffer::~FormatSniffer()
+{
+    pthread_mutex_destroy(&cacheMutex);
+}
+
+/**
+ * Work out the format of a file, from the cache, its content or its name
+ *
+ * @param url file name or url as given to the player
+ * @return the format, FORMAT_UNKNOWN if it could not be told
+ */
+FormatSniffer::format FormatSniffer::detect(const string &url)
+{
+    pthread_mutex_lock(&cacheMutex);
+    map<string, format>::iterator it = cache.find(url);
+    if(it != cache.end()) {
+        format cached = it->second;
+        pthread_mutex_unlock(&cacheMutex);
+        LOG4CXX_DEBUG(formatSnifferLog, "Cached format " << name(cached) << " for '" << url << "'");
+        return cached;
+    }
+    pthread_mutex_unlock(&cacheMutex);
+
+    string lower = url;
+    std::transform(lower.begin(), lower.end(), lower.begin(), (int(*)(int))tolower);
+
+    // Remote files are not read ahead of the pipeline, it would cost a request
+    if(lower.substr(0, 7) == "http://" || lower.substr(0, 8) == "https://") {
+        format f = fromExtension(url);
+        LOG4CXX_DEBUG(formatSnifferLog, "Format " << name(f) << " from the name of '" << url << "'");
+        return f;
+    }
+
+    string path = url;
+    if(lower.substr(0, 7) == "file://") path = url.substr(7);
+
+    format f = FORMAT_UNKNOWN;
+    FILE *file = fopen(path.c_str(), "rb");
+    if(file != NULL) {
+        unsigned char data[SNIFF_BYTES];
+        size_t size = fread(data, 1, sizeof(data), file);
+        size_t skip = 0;
+        f = sniff(data, size, &skip);
+
+        // A large ID3 tag, look at what follows it
+        if(f == FORMAT_UNKNOWN && skip > 0 && fseek(file, skip, SEEK_SET) == 0) {
+            size = fread(data, 1, sizeof(data), file);
+            f = sniff(data, size, &skip);
+        }
+        fclose(file);
+    } else {
+        LOG4CXX_WARN(formatSnifferLog, "Could not open '" << path << "' for sniffing");
+    }
+
+    if(f == FORMAT_UNKNOWN) {
+        f = fromExtension(url);
+        LOG4CXX_DEBUG(formatSnifferLog, "Format " << name(f) << " from the name of '" << url << "'");
+        return f;
+    }
+
+    LOG4CXX_DEBUG(formatSnifferLog, "Sniffed format " << name(f) << " for '" << url << "'");
+    remember(url, f);
+    return f;
+}
+
+/**
+ * Store the format of a file, e.g. once decodebin has typefound it
+ *
+ * @param url file name or url as given to the player
+ * @param f the format
+ */
+void FormatSniffer::remember(const string &url, format f)
+{
+    if(f == FORMAT_UNKNOWN) return;
+
+    pthread_mutex_lock(&cacheMutex);
+    if(cache.size() >= SNIFF_CACHE_SIZE && cache.find(url) == cache.end()) cache.clear();
+    cache[url] = f;
+    pthread_mutex_unlock(&cacheMutex);
+}
+
+/**
+ * Drop the stored format of a file, e.g. when it failed to decode
+ *
+ * @param url file name or url as given to the player
+ */
+void FormatSniffer::forget(const string &url)
+{
+    pthread_mutex_lock(&cacheMutex);
+    cache.erase(url);
+    pthread_mutex_unlock(&cacheMutex);
+}
+
+/**
+ * Tell the format from the first bytes of a file
+ *
+ * @param data start of the file
+ * @param size number of bytes in data
+ * @param skip set to the offset to sniff again from when an ID3v2 tag
+ * covers the buffer, 0 otherwise
+ * @return the format or FORMAT_UNKNOWN
+ */
+FormatSniffer::format FormatSniffer::sniff(const unsigned char *data, size_t size, size_t *skip)
+{
+    size_t offset = 0;
+    if(skip != NULL) *skip = 0;
+
+    // ID3v2 tags come before MPEG audio, and sometimes before AAC or FLAC
+    if(size >= 10 && memcmp(data, "ID3", 3) == 0 &&
+            !((data[6] | data[7] | data[8] | data[9]) & 0x80)) {
+        offset = 10 + ((data[6] << 21) | (data[7] << 14) | (data[8] << 7) | data[9]);
+        if(data[5] & 0x10) offset += 10;    // Footer
+        if(offset + 4 > size) {
+            if(skip != NULL) *skip = offset;
+            return FORMAT_UNKNOWN;
+        }
+        data += offset;
+        size -= offset;
+    }
+
+    if(size < 4) return FORMAT_UNKNOWN;
+
+    if(memcmp(data, "OggS", 4) == 0) {
+        if(contains(data, size, "\001vorbis", 7)) return FORMAT_OGG_VORBIS;
+        if(contains(data, size, "OpusHead", 8)) return FORMAT_OGG_OPUS;
+        return FORMAT_OGG_OTHER;
+    }
+    if(size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0) return FORMAT_WAV;
+    if(memcmp(data, "fLaC", 4) == 0) return FORMAT_FLAC;
+    if(size >= 8 && memcmp(data + 4, "ftyp", 4) == 0) return FORMAT_MP4;
+    if(memcmp(data, "ADIF", 4) == 0) return FORMAT_AAC;
+
+    // Raw MPEG or ADTS frames, possibly after some junk
+    size_t limit = size < SYNC_SCAN_BYTES ? size : SYNC_SCAN_BYTES;
+    for(size_t i = 0; i + 4 <= limit; i++) {
+        if(data[i] != 0xFF || (data[i + 1] & 0xE0) != 0xE0) continue;
+
+        if(isAdtsHeader(data + i, size - i)) return FORMAT_AAC;
+
+        size_t length = mpegFrameLength(data + i);
+        if(length == 0) continue;
+
+        // Away from the start a lone sync is likely to be chance, require the next frame
+        if(i + length + 4 <= size) {
+            if(mpegFrameLength(data + i + length) != 0) return FORMAT_MP3;
+        } else if(i == 0 || offset > 0) {
+            return FORMAT_MP3;
+        }
+    }
+
+    return FORMAT_UNKNOWN;
+}
+
+/**
+ * Guess the format from the extension of a file name or url
+ *
+ * @param url file name or url, query and fragment are ignored
+ * @return the format or FORMAT_UNKNOWN
+ */
+FormatSniffer::format FormatSniffer::fromExtension(const string &url)
+{
+    string path = url.substr(0, url.find_first_of("?#"));
+    size_t dot = path.find_last_of('.');
+    if(dot == string::npos || path.find('/', dot) != string::npos) return FORMAT_UNKNOWN;
+
+    string ext = path.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), (int(*)(int))tolower);
+
+    if(ext == "ogg" || ext == "oga") return FORMAT_OGG_VORBIS;
+    if(ext == "opus") return FORMAT_OGG_OPUS;
+    if(ext == "mp3" || ext == "mpg" || ext == "mpeg" || ext == "mp2") return FORMAT_MP3;
+    if(ext == "aac") return FORMAT_AAC;
+    if(ext == "wav") return FORMAT_WAV;
+    if(ext == "flac") return FORMAT_FLAC;
+    if(ext == "mp4" || ext == "m4a" || ext == "m4b") return FORMAT_MP4;
+    return FORMAT_UNKNOWN;
+}
+
+/**
+ * Tell the format from caps found by typefind
+ *
+ * @param caps the container or stream caps
+ * @return the format or FORMAT_UNKNOWN
+ */
+FormatSniffer::format FormatSniffer::fromCaps(GstCaps *caps)
+{
+    if(caps == NULL || gst_caps_get_size(caps) == 0) return FORMAT_UNKNOWN;
+
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    string mime = gst_structure_get_name(structure);
+
+    if(mime == "audio/mpeg") {
+        gint version = 0;
+        gst_structure_get_int(structure, "mpegversion", &version);
+        if(version == 1) return FORMAT_MP3;
+        if(version == 2 || version == 4) return FORMAT_AAC;
+        return FORMAT_UNKNOWN;
+    }
+    if(mime == "audio/x-wav") return FORMAT_WAV;
+    if(mime == "audio/x-flac") return FORMAT_FLAC;
+    if(mime == "video/quicktime" || mime == "audio/x-m4a") return FORMAT_MP4;
+
+    // Ogg needs a look at the stream inside, leave it to the sniffer
+    return FORMAT_UNKNOWN;
+}
+
+/**
+ * @return printable name of a format
+ */
+const char *FormatSniffer::name(format f)
+{
+    switch(f) {
+        case FORMAT_MP3: return "mp3";
+        case FORMAT_AAC: return "aac";
+        case FORMAT_OGG_VORBIS: return "ogg/vorbis";
+        case FORMAT_OGG_OPUS: return "ogg/opus";
+        case FORMAT_OGG_OTHER: return "ogg";
+        case FORMAT_WAV: return "wav";
+        case FORMAT_FLAC: return "flac";
+        case FORMAT_MP4: return "mp4";
+        default: return "unknown";
+    }
+}
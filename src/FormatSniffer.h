@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FORMATSNIFFER_H
+#define FORMATSNIFFER_H
+
+#include <map>
+#include <string>
+#include <stddef.h>
+#include <pthread.h>
+#include <gst/gst.h>
+
+#define SNIFF_BYTES 4096        // Bytes read from the start of a file
+#define SNIFF_CACHE_SIZE 1024   // Urls remembered before the cache is cleared
+
+/**
+ * Works out the format of an audio file from its first bytes, so that the
+ * player can go straight to a dedicated decoder pipeline instead of
+ * trusting the extension or typefinding in decodebin.
+ *
+ * Local files are sniffed, remote files are judged by the extension of
+ * the url path until decodebin has typefound them once. Results are kept
+ * per url.
+ */
+class FormatSniffer
+{
+    public:
+        enum format {
+            FORMAT_UNKNOWN,
+            FORMAT_MP3,         // MPEG-1/2/2.5 audio
+            FORMAT_AAC,         // ADTS or ADIF
+            FORMAT_OGG_VORBIS,
+            FORMAT_OGG_OPUS,
+            FORMAT_OGG_OTHER,
+            FORMAT_WAV,
+            FORMAT_FLAC,        // Native flac, flac in ogg is FORMAT_OGG_OTHER
+            FORMAT_MP4          // MP4/M4A/M4B container
+        };
+
+        FormatSniffer();
+        ~FormatSniffer();
+
+        format detect(const std::string &url);
+        void remember(const std::string &url, format f);
+        void forget(const std::string &url);
+
+        static format sniff(const unsigned char *data, size_t size, size_t *skip);
+        static format fromExtension(const std::string &url);
+        static format fromCaps(GstCaps *caps);
+        static const char *name(format f);
+
+    private:
+        pthread_mutex_t cacheMutex;
+        std::map<std::string, format> cache;
+};
+
+#endif
@@ -0,0 +1,449 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <log4cxx/logger.h>
+
+#include "MmapSrcElement.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr mmapSrcElementLog(log4cxx::Logger::getLogger("kolibre.player.mmapsrcelement"));
+
+enum {
+    PROP_0,
+    PROP_LOCATION,
+    PROP_READAHEAD,
+    PROP_KEEP_BEHIND
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+        GST_PAD_SRC,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS_ANY);
+
+GST_BOILERPLATE (GstKolibreMmapSrc, gst_kolibre_mmapsrc, GstBaseSrc, GST_TYPE_BASE_SRC);
+
+static void gst_kolibre_mmapsrc_finalize (GObject *object);
+static void gst_kolibre_mmapsrc_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_kolibre_mmapsrc_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static gboolean gst_kolibre_mmapsrc_start (GstBaseSrc *src);
+static gboolean gst_kolibre_mmapsrc_stop (GstBaseSrc *src);
+static gboolean gst_kolibre_mmapsrc_get_size (GstBaseSrc *src, guint64 *size);
+static gboolean gst_kolibre_mmapsrc_is_seekable (GstBaseSrc *src);
+static gboolean gst_kolibre_mmapsrc_check_get_range (GstBaseSrc *src);
+static GstFlowReturn gst_kolibre_mmapsrc_create (GstBaseSrc *src, guint64 offset, guint length, GstBuffer **buffer);
+
+static void gst_kolibre_mmapsrc_base_init (gpointer g_class)
+{
+    GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&src_template));
+    gst_element_class_set_details_simple (element_class, "Memory mapped file source",
+            "Source/File", "Reads a file through a memory mapping without copying", "Kolibre");
+}
+
+static void gst_kolibre_mmapsrc_class_init (GstKolibreMmapSrcClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+    GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+
+    gobject_class->set_property = gst_kolibre_mmapsrc_set_property;
+    gobject_class->get_property = gst_kolibre_mmapsrc_get_property;
+    gobject_class->finalize = gst_kolibre_mmapsrc_finalize;
+
+    g_object_class_install_property (gobject_class, PROP_LOCATION,
+            g_param_spec_string ("location", "File location", "Location of the file to read",
+                NULL, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_READAHEAD,
+            g_param_spec_uint ("readahead", "Readahead", "Bytes to page in ahead of the read position",
+                0, G_MAXUINT, MMAPSRC_READAHEAD, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_KEEP_BEHIND,
+            g_param_spec_uint ("keep-behind", "Keep behind", "Bytes to keep behind the read position, 0 to keep everything",
+                0, G_MAXUINT, MMAPSRC_KEEP_BEHIND, (GParamFlags) G_PARAM_READWRITE));
+
+    basesrc_class->start = GST_DEBUG_FUNCPTR (gst_kolibre_mmapsrc_start);
+    basesrc_class->stop = GST_DEBUG_FUNCPTR (gst_kolibre_mmapsrc_stop);
+    basesrc_class->get_size = GST_DEBUG_FUNCPTR (gst_kolibre_mmapsrc_get_size);
+    basesrc_class->is_seekable = GST_DEBUG_FUNCPTR (gst_kolibre_mmapsrc_is_seekable);
+    basesrc_class->check_get_range = GST_DEBUG_FUNCPTR (gst_kolibre_mmapsrc_check_get_range);
+    basesrc_class->create = GST_DEBUG_FUNCPTR (gst_kolibre_mmapsrc_create);
+}
+
+static void gst_kolibre_mmapsrc_init (GstKolibreMmapSrc *self, GstKolibreMmapSrcClass *klass)
+{
+    self->location = NULL;
+    self->readahead = MMAPSRC_READAHEAD;
+    self->keepBehind = MMAPSRC_KEEP_BEHIND;
+    self->fd = -1;
+    self->size = 0;
+    self->window = NULL;
+    self->windowOffset = 0;
+    self->pageSize = sysconf(_SC_PAGESIZE);
+    self->nextOffset = 0;
+    self->advisedEnd = 0;
+    self->droppedEnd = 0;
+}
+
+static void gst_kolibre_mmapsrc_finalize (GObject *object)
+{
+    GstKolibreMmapSrc *self = GST_KOLIBRE_MMAPSRC (object);
+
+    g_free (self->location);
+    self->location = NULL;
+
+    G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void gst_kolibre_mmapsrc_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    GstKolibreMmapSrc *self = GST_KOLIBRE_MMAPSRC (object);
+
+    GST_OBJECT_LOCK (self);
+    switch (prop_id) {
+        case PROP_LOCATION:
+            if (self->fd >= 0) {
+                LOG4CXX_WARN(mmapSrcElementLog, "Can not change location of an open file");
+                break;
+            }
+            g_free (self->location);
+            self->location = g_value_dup_string (value);
+            break;
+        case PROP_READAHEAD:
+            self->readahead = g_value_get_uint (value);
+            break;
+        case PROP_KEEP_BEHIND:
+            self->keepBehind = g_value_get_uint (value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    GST_OBJECT_UNLOCK (self);
+}
+
+static void gst_kolibre_mmapsrc_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    GstKolibreMmapSrc *self = GST_KOLIBRE_MMAPSRC (object);
+
+    GST_OBJECT_LOCK (self);
+    switch (prop_id) {
+        case PROP_LOCATION:
+            g_value_set_string (value, self->location);
+            break;
+        case PROP_READAHEAD:
+            g_value_set_uint (value, self->readahead);
+            break;
+        case PROP_KEEP_BEHIND:
+            g_value_set_uint (value, self->keepBehind);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    GST_OBJECT_UNLOCK (self);
+}
+
+typedef struct {
+    void *data;
+    size_t size;
+} mapping_t;
+
+/**
+ * Free function of a window, called when the last buffer made from it is
+ * gone
+ */
+static void unmap_window (gpointer data)
+{
+    mapping_t *mapping = (mapping_t *) data;
+    munmap (mapping->data, mapping->size);
+    g_free (mapping);
+}
+
+static gboolean gst_kolibre_mmapsrc_start (GstBaseSrc *src)
+{
+    GstKolibreMmapSrc *self = GST_KOLIBRE_MMAPSRC (src);
+    struct stat st;
+
+    GST_OBJECT_LOCK (self);
+    gchar *location = g_strdup (self->location);
+    GST_OBJECT_UNLOCK (self);
+
+    if (location == NULL) {
+        GST_ELEMENT_ERROR (self, RESOURCE, NOT_FOUND, ("No file name specified"), (NULL));
+        return FALSE;
+    }
+
+    int fd = open (location, O_RDONLY);
+    if (fd < 0 || fstat (fd, &st) != 0 || !S_ISREG (st.st_mode)) {
+        LOG4CXX_ERROR(mmapSrcElementLog, "Could not open '" << location << "': " << strerror(errno));
+        GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, ("Could not open file \"%s\" for reading", location), (NULL));
+        if (fd >= 0) close (fd);
+        g_free (location);
+        return FALSE;
+    }
+
+    GST_OBJECT_LOCK (self);
+    self->fd = fd;
+    GST_OBJECT_UNLOCK (self);
+    self->size = st.st_size;
+    self->window = NULL;
+    self->windowOffset = 0;
+    self->nextOffset = G_MAXUINT64;
+    self->advisedEnd = 0;
+    self->droppedEnd = 0;
+
+    LOG4CXX_DEBUG(mmapSrcElementLog, "Opened " << self->size << " bytes of '" << location << "'");
+    g_free (location);
+    return TRUE;
+}
+
+static gboolean gst_kolibre_mmapsrc_stop (GstBaseSrc *src)
+{
+    GstKolibreMmapSrc *self = GST_KOLIBRE_MMAPSRC (src);
+
+    // Buffers still downstream keep their window mapped
+    if (self->window != NULL) gst_buffer_unref (self->window);
+    self->window = NULL;
+
+    GST_OBJECT_LOCK (self);
+    if (self->fd >= 0) close (self->fd);
+    self->fd = -1;
+    GST_OBJECT_UNLOCK (self);
+    self->size = 0;
+
+    return TRUE;
+}
+
+static gboolean gst_kolibre_mmapsrc_get_size (GstBaseSrc *src, guint64 *size)
+{
+    GstKolibreMmapSrc *self = GST_KOLIBRE_MMAPSRC (src);
+
+    if (self->fd < 0) return FALSE;
+    *size = self->size;
+    return TRUE;
+}
+
+static gboolean gst_kolibre_mmapsrc_is_seekable (GstBaseSrc *src)
+{
+    return TRUE;
+}
+
+static gboolean gst_kolibre_mmapsrc_check_get_range (GstBaseSrc *src)
+{
+    return TRUE;
+}
+
+/**
+ * Replace the window with one that holds the range at offset
+ *
+ * @return true if the range is mapped
+ */
+static bool gst_kolibre_mmapsrc_map_window (GstKolibreMmapSrc *self, guint64 offset, guint length)
+{
+    if (self->window != NULL) gst_buffer_unref (self->window);
+    self->window = NULL;
+
+    guint64 start = offset / self->pageSize * self->pageSize;
+    guint64 size = MMAPSRC_WINDOW;
+    if (size < offset - start + length) size = offset - start + length;
+    if (size > self->size - start) size = self->size - start;
+
+    // Private and writable, so an element that writes in place gets a copy of the page
+    void *data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, self->fd, start);
+    if (data == MAP_FAILED) {
+        LOG4CXX_WARN(mmapSrcElementLog, "Could not map " << size << " bytes at " << start << ": " << strerror(errno));
+        return false;
+    }
+
+    mapping_t *mapping = g_new (mapping_t, 1);
+    mapping->data = data;
+    mapping->size = size;
+    self->window = gst_buffer_new ();
+    GST_BUFFER_DATA (self->window) = (guint8 *) data;
+    GST_BUFFER_SIZE (self->window) = size;
+    GST_BUFFER_MALLOCDATA (self->window) = (guint8 *) mapping;
+    GST_BUFFER_FREE_FUNC (self->window) = unmap_window;
+    GST_BUFFER_FLAG_SET (self->window, GST_BUFFER_FLAG_READONLY);
+    self->windowOffset = start;
+
+    // Nothing of the new window has been paged in or dropped yet
+    self->advisedEnd = start;
+    self->droppedEnd = start;
+    return true;
+}
+
+/**
+ * Page in the range ahead of offset and drop the range far behind it,
+ * within the window
+ */
+static void gst_kolibre_mmapsrc_advise (GstKolibreMmapSrc *self, guint64 offset, guint length)
+{
+    GST_OBJECT_LOCK (self);
+    guint64 readahead = self->readahead;
+    guint64 keepBehind = self->keepBehind;
+    GST_OBJECT_UNLOCK (self);
+
+    guint64 page = self->pageSize;
+    guint64 start = offset / page * page;
+    guint8 *data = GST_BUFFER_DATA (self->window);
+    guint64 windowEnd = self->windowOffset + GST_BUFFER_SIZE (self->window);
+
+    // After a jump, e.g. a seek to the next segment, restart the readahead from there
+    if (offset != self->nextOffset) {
+        LOG4CXX_DEBUG(mmapSrcElementLog, "Read jumped to " << offset);
+        self->advisedEnd = start;
+        if (self->droppedEnd > start) self->droppedEnd = start;
+    }
+    self->nextOffset = offset + length;
+
+    // Renew the readahead once half of it has been used
+    guint64 wanted = offset + length + readahead;
+    if (wanted > windowEnd) wanted = windowEnd;
+    if (self->advisedEnd < wanted && wanted - self->advisedEnd > readahead / 2) {
+        guint64 from = self->advisedEnd > start ? self->advisedEnd : start;
+        madvise (data + (from - self->windowOffset), wanted - from, MADV_WILLNEED);
+        self->advisedEnd = wanted;
+    }
+
+    // Drop whole pages far behind, in steps of at least a readahead
+    if (keepBehind > 0 && offset > keepBehind) {
+        guint64 end = (offset - keepBehind) / page * page;
+        if (end > self->droppedEnd && end - self->droppedEnd >= readahead) {
+            madvise (data + (self->droppedEnd - self->windowOffset), end - self->droppedEnd, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+            posix_fadvise (self->fd, self->droppedEnd, end - self->droppedEnd, POSIX_FADV_DONTNEED);
+#endif
+            self->droppedEnd = end;
+        }
+    }
+}
+
+/**
+ * Read the range into a new buffer, when it can not be mapped
+ */
+static GstFlowReturn gst_kolibre_mmapsrc_read (GstKolibreMmapSrc *self, guint64 offset, guint length, GstBuffer **buffer)
+{
+    GstBuffer *buf = gst_buffer_new_and_alloc (length);
+    guint done = 0;
+    while (done < length) {
+        ssize_t ret = pread (self->fd, GST_BUFFER_DATA (buf) + done, length - done, offset + done);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret < 0) {
+            GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL), ("Could not read at %" G_GUINT64_FORMAT ": %s", offset + done, strerror (errno)));
+            gst_buffer_unref (buf);
+            return GST_FLOW_ERROR;
+        }
+        if (ret == 0) break;
+        done += ret;
+    }
+    if (done == 0) {
+        gst_buffer_unref (buf);
+        return GST_FLOW_UNEXPECTED;
+    }
+
+    GST_BUFFER_SIZE (buf) = done;
+    GST_BUFFER_OFFSET (buf) = offset;
+    GST_BUFFER_OFFSET_END (buf) = offset + done;
+    *buffer = buf;
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn gst_kolibre_mmapsrc_create (GstBaseSrc *src, guint64 offset, guint length, GstBuffer **buffer)
+{
+    GstKolibreMmapSrc *self = GST_KOLIBRE_MMAPSRC (src);
+    struct stat st;
+
+    // Touching a mapped page past the end of a file that shrank raises SIGBUS,
+    // so follow the size and never hand out pages past it
+    if (fstat (self->fd, &st) == 0 && (guint64) st.st_size != self->size) {
+        LOG4CXX_WARN(mmapSrcElementLog, "File size changed from " << self->size << " to " << st.st_size);
+        self->size = st.st_size;
+        if (self->window != NULL && self->windowOffset + GST_BUFFER_SIZE (self->window) > self->size) {
+            gst_buffer_unref (self->window);
+            self->window = NULL;
+        }
+    }
+
+    if (offset >= self->size) return GST_FLOW_UNEXPECTED;
+    if (offset + length > self->size) length = self->size - offset;
+
+    if (self->window == NULL || offset < self->windowOffset ||
+            offset + length > self->windowOffset + GST_BUFFER_SIZE (self->window)) {
+        if (!gst_kolibre_mmapsrc_map_window (self, offset, length))
+            return gst_kolibre_mmapsrc_read (self, offset, length, buffer);
+    }
+
+    gst_kolibre_mmapsrc_advise (self, offset, length);
+
+    *buffer = gst_buffer_create_sub (self->window, offset - self->windowOffset, length);
+    if (*buffer == NULL) return GST_FLOW_ERROR;
+    GST_BUFFER_FLAG_SET (*buffer, GST_BUFFER_FLAG_READONLY);
+    GST_BUFFER_OFFSET (*buffer) = offset;
+    GST_BUFFER_OFFSET_END (*buffer) = offset + length;
+
+    return GST_FLOW_OK;
+}
+
+/**
+ * Make the kolibremmapsrc element available to gst_element_factory_make
+ *
+ * @return true on success
+ */
+bool mmapsrc_element_register()
+{
+    if (!gst_element_register (NULL, "kolibremmapsrc", GST_RANK_NONE, GST_TYPE_KOLIBRE_MMAPSRC)) {
+        LOG4CXX_ERROR(mmapSrcElementLog, "Failed to register kolibremmapsrc element");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Check that a file can be read through the kolibremmapsrc element, i.e.
+ * it is a non-empty regular file and its first window can be mapped
+ *
+ * @param location path of the file
+ * @return true if the file can be mapped, false to read it with filesrc
+ */
+bool mmapsrc_can_map(const char *location)
+{
+    struct stat st;
+    int fd = open (location, O_RDONLY);
+    if (fd < 0) return false;
+
+    bool ok = false;
+    if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode) && st.st_size > 0) {
+        size_t size = (guint64) st.st_size < MMAPSRC_WINDOW ? st.st_size : MMAPSRC_WINDOW;
+        void *data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            munmap (data, size);
+            ok = true;
+        }
+    }
+    close (fd);
+
+    if (!ok) LOG4CXX_DEBUG(mmapSrcElementLog, "Can not map '" << location << "'");
+    return ok;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef MMAPSRCELEMENT_H
+#define MMAPSRCELEMENT_H
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+
+#define GST_TYPE_KOLIBRE_MMAPSRC (gst_kolibre_mmapsrc_get_type())
+#define GST_KOLIBRE_MMAPSRC(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_KOLIBRE_MMAPSRC, GstKolibreMmapSrc))
+
+#define MMAPSRC_READAHEAD (1024 * 1024)       // Bytes paged in ahead of the read position
+#define MMAPSRC_KEEP_BEHIND (4 * 1024 * 1024) // Bytes kept behind the read position
+#define MMAPSRC_WINDOW (8 * 1024 * 1024)      // Bytes of the file mapped at a time
+
+/**
+ * The "kolibremmapsrc" element reads a local file through private mappings
+ * of a window of the file at a time, so large files fit a 32-bit address
+ * space. Buffers are sub-buffers of a window, so the data is never copied
+ * and the pages are shared with the page cache. A window stays mapped
+ * until the last buffer made from it is gone. If a window can not be
+ * mapped the data is read into a new buffer instead.
+ *
+ * The kernel is asked to page in readahead bytes after every jump and as
+ * reading goes on. Pages more than keep-behind bytes behind the read
+ * position are dropped from the mapping and from the cache, so a long
+ * book never builds up resident memory.
+ *
+ * The size of the file is checked before every read, so a file that
+ * shrinks ends the stream instead of faulting. Truncating the file while
+ * buffers already handed downstream are being read still raises SIGBUS,
+ * so files still being written, e.g. downloads, must be written under
+ * another name and renamed into place, or read through filesrc.
+ */
+typedef struct {
+    GstBaseSrc element;
+
+    // Properties, protected by the object lock
+    gchar *location;
+    guint readahead;
+    guint keepBehind;
+
+    int fd;                 // Open between start and stop, protected by the object lock
+    guint64 size;           // Size of the file at the last read
+    GstBuffer *window;      // Parent of the buffers in the window, unmaps when the last one is gone
+    guint64 windowOffset;   // File offset of the window
+    long pageSize;
+
+    guint64 nextOffset;     // Where a sequential read continues
+    guint64 advisedEnd;     // End of the range paged in so far
+    guint64 droppedEnd;     // End of the range dropped so far
+} GstKolibreMmapSrc;
+
+typedef struct {
+    GstBaseSrcClass parent_class;
+} GstKolibreMmapSrcClass;
+
+GType gst_kolibre_mmapsrc_get_type(void);
+
+bool mmapsrc_element_register();
+
+bool mmapsrc_can_map(const char *location);
+
+#endif
@@ -0,0 +1,438 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <log4cxx/logger.h>
+
+#include "PauseIndex.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr pauseIndexLog(log4cxx::Logger::getLogger("kolibre.player.pauseindex"));
+
+using namespace std;
+
+#define CACHE_MAGIC "KPIX"
+#define CACHE_VERSION 1
+
+PauseIndex::PauseIndex():
+    stopping(false)
+{
+    pthread_mutex_init(&indexMutex, NULL);
+    pthread_cond_init(&jobCond, NULL);
+
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if(xdg != NULL && *xdg != '\0') cacheDir = string(xdg) + "/kolibre-player";
+    else if(home != NULL && *home != '\0') cacheDir = string(home) + "/.cache/kolibre-player";
+}
+
+PauseIndex::~PauseIndex()
+{
+    pthread_cond_destroy(&jobCond);
+    pthread_mutex_destroy(&indexMutex);
+}
+
+/**
+ * Set where indexes are stored on disk
+ *
+ * @param dir cache directory, empty to keep indexes in memory only
+ */
+void PauseIndex::setCacheDir(string dir)
+{
+    pthread_mutex_lock(&indexMutex);
+    cacheDir = dir;
+    pthread_mutex_unlock(&indexMutex);
+}
+
+/**
+ * Get the pauses of a file, the file is queued for indexing when it
+ * hasn't been indexed yet
+ *
+ * @param url file as passed to Player::open
+ * @param pauses receives the pauses in ms
+ * @return true if the index was available
+ */
+bool PauseIndex::getPauses(string url, vector<Player::pauseData> &pauses)
+{
+    entry e;
+    if(!lookup(url, e)) {
+        request(url);
+        return false;
+    }
+    if(!e.valid) return false;
+
+    pauses = e.pauses;
+    return true;
+}
+
+/**
+ * Move a seek target to the end of a nearby pause, so that playback starts
+ * at the beginning of a phrase
+ *
+ * @param url file as passed to Player::open
+ * @param ms seek target
+ * @param maxDistance how far the target may move (ms)
+ * @return new seek target, ms if there is no index or no pause close enough
+ */
+long PauseIndex::snap(string url, long ms, long maxDistance)
+{
+    entry e;
+    if(!lookup(url, e) || !e.valid) return ms;
+
+    long best = ms;
+    long bestDistance = maxDistance + 1;
+    for(size_t i = 0; i < e.pauses.size(); i++) {
+        long target = e.pauses[i].stop - PAUSEINDEX_SNAP_LEAD_MS;
+        if(target < e.pauses[i].start) target = e.pauses[i].start;
+
+        long distance = labs(target - ms);
+        if(distance < bestDistance) {
+            best = target;
+            bestDistance = distance;
+        }
+        if(e.pauses[i].start > ms + maxDistance) break;
+    }
+
+    return best;
+}
+
+/**
+ * Queue a file for indexing unless it is known or queued already
+ *
+ * @param url file as passed to Player::open
+ */
+void PauseIndex::request(string url)
+{
+    pthread_mutex_lock(&indexMutex);
+    bool known = entries.find(url) != entries.end() || running == url;
+    for(list<string>::iterator it = jobs.begin(); !known && it != jobs.end(); ++it)
+        known = *it == url;
+
+    if(!known) {
+        LOG4CXX_DEBUG(pauseIndexLog, "Queueing '" << url << "' for indexing");
+        jobs.push_back(url);
+        pthread_cond_signal(&jobCond);
+    }
+    pthread_mutex_unlock(&indexMutex);
+}
+
+/**
+ * Wait for a file that needs to be decoded, files found in the disk cache
+ * are loaded without returning
+ *
+ * @param url receives the file to index
+ * @return false when shutting down
+ */
+bool PauseIndex::waitJob(string &url)
+{
+    for(;;) {
+        pthread_mutex_lock(&indexMutex);
+        while(jobs.empty() && !stopping)
+            pthread_cond_wait(&jobCond, &indexMutex);
+        if(stopping) {
+            pthread_mutex_unlock(&indexMutex);
+            return false;
+        }
+        url = running = jobs.front();
+        jobs.pop_front();
+        pthread_mutex_unlock(&indexMutex);
+
+        vector<unsigned char> energy;
+        if(!readCache(url, energy)) return true;
+
+        entry e;
+        e.valid = true;
+        e.pauses = findPauses(energy);
+        remember(url, e);
+    }
+}
+
+/**
+ * Make waitJob return false and ongoing indexing stop
+ */
+void PauseIndex::shutdown()
+{
+    pthread_mutex_lock(&indexMutex);
+    stopping = true;
+    pthread_cond_broadcast(&jobCond);
+    pthread_mutex_unlock(&indexMutex);
+}
+
+/**
+ * @return true after shutdown
+ */
+bool PauseIndex::isStopping()
+{
+    pthread_mutex_lock(&indexMutex);
+    bool result = stopping;
+    pthread_mutex_unlock(&indexMutex);
+    return result;
+}
+
+/**
+ * Store the energy of a decoded file
+ *
+ * @param url file as passed to Player::open
+ * @param energy energy windows from Builder
+ */
+void PauseIndex::store(string url, const vector<unsigned char> &energy)
+{
+    writeCache(url, energy);
+
+    entry e;
+    e.valid = true;
+    e.pauses = findPauses(energy);
+    remember(url, e);
+    LOG4CXX_INFO(pauseIndexLog, "Indexed '" << url << "', " << e.pauses.size() << " pauses");
+}
+
+/**
+ * Remember that a file could not be decoded, so it isn't retried
+ *
+ * @param url file as passed to Player::open
+ */
+void PauseIndex::failed(string url)
+{
+    entry e;
+    e.valid = false;
+    remember(url, e);
+    LOG4CXX_WARN(pauseIndexLog, "Failed to index '" << url << "'");
+}
+
+/**
+ * Find an index in memory or in the disk cache
+ */
+bool PauseIndex::lookup(const string &url, entry &result)
+{
+    pthread_mutex_lock(&indexMutex);
+    map<string, entry>::iterator it = entries.find(url);
+    if(it != entries.end()) {
+        result = it->second;
+        recent.remove(url);
+        recent.push_front(url);
+        pthread_mutex_unlock(&indexMutex);
+        return true;
+    }
+    pthread_mutex_unlock(&indexMutex);
+
+    vector<unsigned char> energy;
+    if(!readCache(url, energy)) return false;
+
+    result.valid = true;
+    result.pauses = findPauses(energy);
+    remember(url, result);
+    return true;
+}
+
+/**
+ * Keep an index in memory, dropping the least recently used
+ */
+void PauseIndex::remember(const string &url, const entry &e)
+{
+    pthread_mutex_lock(&indexMutex);
+    entries[url] = e;
+    recent.remove(url);
+    recent.push_front(url);
+    if(recent.size() > PAUSEINDEX_FILES) {
+        entries.erase(recent.back());
+        recent.pop_back();
+    }
+    if(running == url) running = "";
+    pthread_mutex_unlock(&indexMutex);
+}
+
+/**
+ * Name of the cache file of a url. Local files are keyed on their size
+ * and modification time as well, so edited files are indexed again.
+ *
+ * @return path, empty if there is no cache directory
+ */
+string PauseIndex::cacheFile(const string &url)
+{
+    pthread_mutex_lock(&indexMutex);
+    string dir = cacheDir;
+    pthread_mutex_unlock(&indexMutex);
+    if(dir.empty()) return "";
+
+    char key[64];
+    struct stat st;
+    string id = url;
+    if(stat(url.c_str(), &st) == 0) {
+        snprintf(key, sizeof(key), "|%lld|%lld", (long long)st.st_size, (long long)st.st_mtime);
+        id += key;
+    }
+
+    // FNV-1a
+    unsigned long long hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < id.size(); i++) {
+        hash ^= (unsigned char)id[i];
+        hash *= 1099511628211ULL;
+    }
+    snprintf(key, sizeof(key), "/%016llx.idx", hash);
+    return dir + key;
+}
+
+bool PauseIndex::readCache(const string &url, vector<unsigned char> &energy)
+{
+    string filename = cacheFile(url);
+    if(filename.empty()) return false;
+
+    FILE *file = fopen(filename.c_str(), "rb");
+    if(file == NULL) return false;
+
+    char magic[4];
+    unsigned char header[2];
+    unsigned int count;
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, CACHE_MAGIC, 4) == 0 &&
+        fread(header, 1, 2, file) == 2 && header[0] == CACHE_VERSION && header[1] == PAUSEINDEX_WINDOW_MS &&
+        fread(&count, sizeof(count), 1, file) == 1;
+    if(ok) {
+        energy.resize(count);
+        ok = count == 0 || fread(&energy[0], 1, count, file) == count;
+    }
+    fclose(file);
+
+    if(!ok) LOG4CXX_WARN(pauseIndexLog, "Ignoring broken cache file " << filename);
+    return ok;
+}
+
+void PauseIndex::writeCache(const string &url, const vector<unsigned char> &energy)
+{
+    string filename = cacheFile(url);
+    if(filename.empty()) return;
+
+    // Create the cache directory and its parents
+    for(size_t pos = 1; pos != string::npos; ) {
+        pos = filename.find('/', pos + 1);
+        if(pos != string::npos) mkdir(filename.substr(0, pos).c_str(), 0755);
+    }
+
+    string tmpname = filename + ".tmp";
+    FILE *file = fopen(tmpname.c_str(), "wb");
+    if(file == NULL) {
+        LOG4CXX_WARN(pauseIndexLog, "Could not write cache file " << tmpname);
+        return;
+    }
+
+    unsigned char header[2] = { CACHE_VERSION, PAUSEINDEX_WINDOW_MS };
+    unsigned int count = energy.size();
+    bool ok = fwrite(CACHE_MAGIC, 1, 4, file) == 4 &&
+        fwrite(header, 1, 2, file) == 2 &&
+        fwrite(&count, sizeof(count), 1, file) == 1 &&
+        (count == 0 || fwrite(&energy[0], 1, count, file) == count);
+    ok = fclose(file) == 0 && ok;
+
+    if(!ok || rename(tmpname.c_str(), filename.c_str()) != 0) {
+        LOG4CXX_WARN(pauseIndexLog, "Could not write cache file " << filename);
+        remove(tmpname.c_str());
+    }
+}
+
+/**
+ * Work out the pauses from the energy windows
+ *
+ * @param energy energy windows
+ * @return pauses in ms
+ */
+vector<Player::pauseData> PauseIndex::findPauses(const vector<unsigned char> &energy)
+{
+    vector<Player::pauseData> pauses;
+    if(energy.empty()) return pauses;
+
+    // Typical speech level, the 90th percentile
+    unsigned int histogram[256] = { 0 };
+    for(size_t i = 0; i < energy.size(); i++) histogram[energy[i]]++;
+    int speech = 255;
+    for(size_t below = energy.size(); speech > 0; speech--) {
+        below -= histogram[speech];
+        if(below <= energy.size() * 9 / 10) break;
+    }
+
+    int threshold = speech - PAUSEINDEX_SPEECH_RANGE * 2;
+    if(threshold <= 0) return pauses;
+
+    size_t minWindows = PAUSEINDEX_MIN_PAUSE_MS / PAUSEINDEX_WINDOW_MS;
+    size_t start = 0;
+    bool quiet = false;
+    for(size_t i = 0; i <= energy.size(); i++) {
+        bool below = i < energy.size() && energy[i] < threshold;
+        if(below && !quiet) {
+            start = i;
+            quiet = true;
+        } else if(!below && quiet) {
+            quiet = false;
+            if(i - start >= minWindows) {
+                Player::pauseData pause;
+                pause.start = start * PAUSEINDEX_WINDOW_MS;
+                pause.stop = i * PAUSEINDEX_WINDOW_MS;
+                pauses.push_back(pause);
+            }
+        }
+    }
+
+    return pauses;
+}
+
+/**
+ * @param rate sample rate of the mono 16 bit samples that will be added
+ */
+PauseIndex::Builder::Builder(int rate):
+    windowSamples(rate * PAUSEINDEX_WINDOW_MS / 1000),
+    samples(0),
+    sum(0.0)
+{
+}
+
+/**
+ * Add decoded mono 16 bit samples
+ */
+void PauseIndex::Builder::addSamples(const short *data, int count)
+{
+    for(int i = 0; i < count; i++) {
+        sum += (double)data[i] * data[i];
+        if(++samples < windowSamples) continue;
+
+        double level = 10.0 * log10(sum / samples / (32768.0 * 32768.0) + 1e-20);
+        int value = (int)((level + 127.5) * 2.0);
+        energy.push_back(value < 0 ? 0 : value > 255 ? 255 : value);
+        samples = 0;
+        sum = 0.0;
+    }
+}
+
+/**
+ * @return energy windows of all added samples
+ */
+vector<unsigned char> PauseIndex::Builder::finish()
+{
+    // Keep a last partial window if it is at least half full
+    if(samples * 2 >= windowSamples) {
+        double level = 10.0 * log10(sum / samples / (32768.0 * 32768.0) + 1e-20);
+        int value = (int)((level + 127.5) * 2.0);
+        energy.push_back(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+    samples = 0;
+    sum = 0.0;
+    return energy;
+}
@@ -0,0 +1,108 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PAUSEINDEX_H
+#define PAUSEINDEX_H
+
+#include <map>
+#include <list>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include "Player.h"
+
+#define PAUSEINDEX_WINDOW_MS 20     // Energy is stored per window of this length
+#define PAUSEINDEX_MIN_PAUSE_MS 250 // Shorter silences are not pauses
+#define PAUSEINDEX_SPEECH_RANGE 30  // Pause threshold in dB below the speech level
+#define PAUSEINDEX_FILES 16         // Indexes kept in memory
+#define PAUSEINDEX_SNAP_LEAD_MS 100 // Snapped seeks land this long before the end of a pause
+
+/**
+ * Energy and pause index of audio files.
+ *
+ * A file is scanned once by the player's index thread. Its energy is stored
+ * as one byte per PAUSEINDEX_WINDOW_MS (0.5 dB steps, 0 is -127.5 dB and
+ * below) in memory and in the cache directory, and the pauses are worked
+ * out from it. The threshold adapts to the recording: pauses are runs of
+ * at least PAUSEINDEX_MIN_PAUSE_MS more than PAUSEINDEX_SPEECH_RANGE below
+ * the typical speech level of the file.
+ */
+class PauseIndex
+{
+    public:
+        PauseIndex();
+        ~PauseIndex();
+
+        void setCacheDir(std::string dir);
+
+        bool getPauses(std::string url, std::vector<Player::pauseData> &pauses);
+        long snap(std::string url, long ms, long maxDistance);
+
+        // Jobs for the index thread
+        void request(std::string url);
+        bool waitJob(std::string &url);
+        void shutdown();
+        bool isStopping();
+
+        /**
+         * Turns decoded audio into energy windows
+         */
+        class Builder
+        {
+            public:
+                Builder(int rate);
+                void addSamples(const short *samples, int count);
+                std::vector<unsigned char> finish();
+
+            private:
+                int windowSamples;
+                int samples;
+                double sum;
+                std::vector<unsigned char> energy;
+        };
+
+        void store(std::string url, const std::vector<unsigned char> &energy);
+        void failed(std::string url);
+
+        static std::vector<Player::pauseData> findPauses(const std::vector<unsigned char> &energy);
+
+    private:
+        struct entry {
+            bool valid;     // False if the file could not be decoded
+            std::vector<Player::pauseData> pauses;
+        };
+
+        bool lookup(const std::string &url, entry &result);
+        void remember(const std::string &url, const entry &e);
+        std::string cacheFile(const std::string &url);
+        bool readCache(const std::string &url, std::vector<unsigned char> &energy);
+        void writeCache(const std::string &url, const std::vector<unsigned char> &energy);
+
+        pthread_mutex_t indexMutex;
+        pthread_cond_t jobCond;
+        std::string cacheDir;
+        std::map<std::string, entry> entries;
+        std::list<std::string> recent;      // Most recently used first
+        std::list<std::string> jobs;
+        std::string running;                // Job the index thread is working on
+        bool stopping;
+};
+
+#endif
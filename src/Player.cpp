@@ -34,6 +34,7 @@ using namespace std;
 
 #include "Player.h"
 #include "PlayerImpl.h"
+#include "SmilTime.h"
 
 Player * Player::pinstance = 0;
 
@@ -154,6 +155,18 @@ boost::signals2::connection Player::doOnPlayerTime(OnPlayerTime::slot_type slot)
     return p_impl->doOnPlayerTime(slot);
 }
 
+/**
+ * Set the a signal slot for when a cue point set with setCues is heard
+ *
+ * @param slot function pointer to the slot, called with the cue (ms)
+ *
+ * @return connection object for the cue signal-slot connection
+ */
+boost::signals2::connection Player::doOnPlayerCue(OnPlayerCue::slot_type slot)
+{
+    return p_impl->doOnPlayerCue(slot);
+}
+
 /**
  * Open a file and go to paused state
  *
@@ -265,6 +278,18 @@ long long int Player::getPos()
     return p_impl->getPos();
 }
 
+/**
+ * Get the position being heard right now. Unlike getPos it moves smoothly
+ * between buffers and leaves out audio queued in the sink, and it never
+ * blocks, so it can be polled for highlighting at display rate.
+ *
+ * @return audible file position (ms), 0 when stopped
+ */
+long long int Player::getAudiblePos()
+{
+    return p_impl->getAudiblePos();
+}
+
 /**
  * Get the current playing file
  *
@@ -367,7 +392,8 @@ double Player::getTempo()
 }
 
 /**
- * Set the playback tempo
+ * Set the playback tempo. While playing the new tempo is faded in over a
+ * few milliseconds, without a pause or a gap.
  *
  * @param value tempo (between PLAYER_MAX_TEMPO and PLAYER_MIN_TEMPO)
  */
@@ -397,7 +423,8 @@ double Player::getPitch()
 }
 
 /**
- * Set the playback pitch
+ * Set the playback pitch. While playing the new pitch is faded in over a
+ * few milliseconds, without a pause or a gap.
  *
  * @param value pitch (between PLAYER_MAX_PITCH and PLAYER_MIN_PITCH)
  */
@@ -506,21 +533,343 @@ void Player::setDebugmode(bool setting)
     p_impl->setDebugmode(setting);
 }
 
-#ifdef ENABLE_EQUALIZER
 /**
- * Sets up the 10 band equalizer based on the bass and treble gain values
+ * Get a snapshot of the runtime metrics
+ *
+ * @return counters and latency histograms collected since start or last reset
+ */
+Player::metricsData Player::getMetrics()
+{
+    return p_impl->getMetrics();
+}
+
+/**
+ * Clear all runtime metrics
+ *
+ */
+void Player::resetMetrics()
+{
+    p_impl->resetMetrics();
+}
+
+/**
+ * Periodically write the runtime metrics to the log
+ *
+ * @param seconds interval between dumps, 0 to disable
+ */
+void Player::setMetricsInterval(int seconds)
+{
+    p_impl->setMetricsInterval(seconds);
+}
+
+/**
+ * Record a timeline of API calls, seeks, state changes and buffer
+ * handling that can be written with dumpTrace
+ *
+ * @param enable true to start recording, false to stop
+ */
+void Player::setTracing(bool enable)
+{
+    p_impl->setTracing(enable);
+}
+
+/**
+ * Write the recorded timeline as a Chrome trace (JSON), it can be
+ * opened in chrome://tracing or ui.perfetto.dev
+ *
+ * @param filename file to write
+ * @return true on success
+ */
+bool Player::dumpTrace(std::string filename)
+{
+    return p_impl->dumpTrace(filename);
+}
+
+/**
+ * Get the current processing quality. The player lowers the quality when
+ * the audio sink reports that buffers keep arriving late, and restores it
+ * when playback has had headroom for a while.
+ *
+ * @return current quality tier
+ */
+Player::qualityTier Player::getQualityTier()
+{
+    return p_impl->getQualityTier();
+}
+
+/**
+ * Shorten long pauses in the narration. Pauses are cut down to a few
+ * hundred milliseconds, positions reported by the player are still in
+ * the original time of the file.
+ *
+ * @param enable true to shorten pauses
+ */
+void Player::setSilenceCompression(bool enable)
+{
+    p_impl->setSilenceCompression(enable);
+}
+
+/**
+ * @return true if pauses are shortened
+ */
+bool Player::getSilenceCompression()
+{
+    return p_impl->getSilenceCompression();
+}
+
+/**
+ * Get the listening time saved by shortening pauses since the player was
+ * created
+ *
+ * @return saved time in milliseconds
+ */
+long Player::getSilenceSaved()
+{
+    return p_impl->getSilenceSaved();
+}
+
+/**
+ * Get the pauses in a file, for phrase navigation without SMIL. Files are
+ * scanned once in the background and the result is cached on disk. The
+ * first call for a file starts the scan and returns false, call again
+ * later.
+ *
+ * @param url file as passed to open
+ * @param pauses receives the pauses, start and stop in ms
+ * @return true if the pauses are known
+ */
+bool Player::getPauses(std::string url, std::vector<pauseData> &pauses)
+{
+    return p_impl->getPauses(url, pauses);
+}
+
+/**
+ * Let seekPos land at the start of a phrase instead of mid-word. Opened
+ * files are indexed in the background, and once a file is indexed seek
+ * targets close to a pause are moved to its end.
+ *
+ * @param maxms how far a seek target may move (ms), 0 to disable
+ */
+void Player::setSeekSnap(long maxms)
+{
+    p_impl->setSeekSnap(maxms);
+}
+
+/**
+ * Set how often OnPlayerTime is sent while playing. A notification is
+ * sent each time playback enters a new interval of media time, and always
+ * when it passes a threshold, jumps backwards or a new segment starts.
+ * The default is TIME_INTERVAL_MS.
+ *
+ * @param ms interval (ms), 0 to notify at thresholds and segment changes only
+ */
+void Player::setTimeInterval(long ms)
+{
+    p_impl->setTimeInterval(ms);
+}
+
+/**
+ * Set positions that OnPlayerTime is always sent for when playback
+ * passes them, e.g. the clip boundaries of the current SMIL file. The
+ * previous thresholds are replaced.
+ *
+ * @param ms media positions (ms)
+ */
+void Player::setTimeThresholds(std::vector<long long> ms)
+{
+    p_impl->setTimeThresholds(ms);
+}
+
+/**
+ * Set cue points of the current file, e.g. the clip starts of a SMIL file
+ * to highlight text at. OnPlayerCue is sent for each cue when it is heard,
+ * taking the sink latency and the tempo into account, so the position
+ * need not be polled. Cues jumped over by a seek are not sent, cues before
+ * a seek backwards are sent again. The previous cues are replaced, an
+ * empty vector removes them.
+ *
+ * @param ms media positions (ms), in any order
+ */
+void Player::setCues(std::vector<long long> ms)
+{
+    p_impl->setCues(ms);
+}
+
+/**
+ * Choose where OnPlayerMessage(PLAYER_CONTINUE) is called. By default it
+ * runs on a dispatch thread of the player, never on the thread that
+ * streams the audio. With a context set it runs from that context, e.g.
+ * the application's main loop, which must then be iterated.
+ *
+ * @param context GMainContext to run callbacks from, NULL for the dispatch thread
+ */
+void Player::setDispatchContext(GMainContext *context)
+{
+    p_impl->setDispatchContext(context);
+}
+
+/**
+ * Set what happens at the stop of a segment while the application is
+ * still answering PLAYER_CONTINUE. The default CONTINUE_PLAY suits books
+ * where the next clip continues where this one stops. The stop is taken
+ * when it is heard, not when it is decoded.
+ *
+ * @param policy CONTINUE_PLAY, CONTINUE_MUTE or CONTINUE_PAUSE
+ */
+void Player::setContinuePolicy(continuePolicy policy)
+{
+    p_impl->setContinuePolicy(policy);
+}
+
+/**
+ * Stage the segment that follows the current one. At the stop of the
+ * current segment playback continues with it without waiting for the
+ * application, as if open had been called. PLAYER_CONTINUE is still sent
+ * so the next one can be staged, its answer is then ignored. Calling
+ * open drops a staged segment.
  *
- * @param element gstreamer element
- * @param bass bass value
- * @param treble treble value
+ * @param filename URL of the file
+ * @param startms start of the segment
+ * @param stopms stop of the segment
+ */
+void Player::setNextSegment(std::string filename, long long startms, long long stopms)
+{
+    p_impl->setNextSegment(filename, startms, stopms);
+}
+
+/**
+ * Send OnPlayerMessage(PLAYER_SEGMENT_ENDING) this long before the stop of
+ * the current segment, or the end of the file if that comes first, is
+ * heard. The time is scheduled on the pipeline clock and the message is
+ * sent like PLAYER_CONTINUE, see setDispatchContext. It gives the
+ * application time to prepare the next clip and stage it with
+ * setNextSegment, the file of a staged segment is then sniffed ahead.
+ *
+ * @param ms lead time (ms), 0 to disable (the default)
+ */
+void Player::setSegmentEndingLead(long ms)
+{
+    p_impl->setSegmentEndingLead(ms);
+}
+
+/**
+ * Load the audio clips of a book, numbered in the order given, e.g. the
+ * src, clipBegin and clipEnd attributes of the audio elements of its SMIL
+ * files. The clip playing at a position is then found without a scan, and
+ * the player can continue through the clips itself, see setClipAdvance.
+ * Missing or invalid clipBegins are taken as 0 and clipEnds as the end of
+ * the file.
+ *
+ * @param urls file of each clip, as it will be passed to open
+ * @param clipBegins SMIL clock value where each clip begins, entries may be NULL
+ * @param clipEnds SMIL clock value where each clip ends, entries may be NULL
+ * @param count number of clips, 0 to remove them
+ * @return the number of clips with valid clock values
+ */
+size_t Player::setClips(const char *const *urls, const char *const *clipBegins,
+        const char *const *clipEnds, size_t count)
+{
+    return p_impl->setClips(urls, clipBegins, clipEnds, count);
+}
+
+/**
+ * Find the clip playing at a position, e.g. after a seek
+ *
+ * @param url file, as passed to open
+ * @param ms position in the file (ms)
+ * @return the clip number, -1 if no clip contains the position
+ */
+long Player::findClip(std::string url, long long ms)
+{
+    return p_impl->findClip(url, ms);
+}
+
+/**
+ * Get the clip of the segment opened or continued with last. The clip of
+ * an opened segment is looked up from its file and start.
+ *
+ * @return the clip number, -1 if unknown
+ */
+long Player::getClip()
+{
+    return p_impl->getClip();
+}
+
+/**
+ * Open a clip loaded with setClips, like open
+ *
+ * @param clip clip number
+ * @return false if there is no such clip
+ */
+bool Player::openClip(long clip)
+{
+    return p_impl->openClip(clip);
+}
+
+/**
+ * Continue with the next clip at the stop of each clip, and at the end of
+ * the file when no OnPlayerMessage slot is connected to handle
+ * PLAYER_ATEOS. The next
+ * clip is staged as with setNextSegment, a segment staged by the
+ * application takes precedence. PLAYER_CONTINUE is still sent, getClip
+ * tells where playback went.
+ *
+ * @param enable true to continue through the clips, false by default
+ */
+void Player::setClipAdvance(bool enable)
+{
+    p_impl->setClipAdvance(enable);
+}
+
+/**
+ * Keep the memory used for playback small, for devices with little RAM.
+ * Queues, the sink buffer and the file readahead are bounded tightly and
+ * files are not indexed in the background. Takes effect from the next
+ * opened file.
+ *
+ * @param enable true for the low-memory profile
+ */
+void Player::setLowMemory(bool enable)
+{
+    p_impl->setLowMemory(enable);
+}
+
+/**
+ * @return true if the low-memory profile is selected
+ */
+bool Player::getLowMemory()
+{
+    return p_impl->getLowMemory();
+}
+
+/**
+ * Get the audio formats of the current pipeline, for diagnostics. The
+ * postprocessing chain runs in the decoder's format when it can, so that
+ * samples are converted at most once, to the sink format at the end.
+ *
+ * @return the negotiated formats
+ */
+Player::formatData Player::getFormats()
+{
+    return p_impl->getFormats();
+}
+
+/**
+ * Convert SMIL clock values, e.g. the clipBegin and clipEnd attributes of
+ * a book, to milliseconds up front. Full and partial clock values and
+ * timecount values are accepted, with or without an "npt=" prefix. The
+ * decimal point is '.' whatever the locale.
  *
- * @return null
+ * @param values clock values, entries may be NULL
+ * @param count number of values
+ * @param ms receives count times in ms, -1 for values that are missing,
+ * empty or not valid
+ * @return the number of valid values
  */
-void Player::setEqualizer(GstElement *element, double bass, double treble)
+size_t Player::parseClockValues(const char *const *values, size_t count, long long *ms)
 {
-    p_impl->setEqualizer(element, bass, treble);
+    return SmilTimeCode::parse(values, count, ms);
 }
-#endif
 
 /**
  * Set user agent string that is used when fetching online resources
@@ -29,8 +29,9 @@ along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
 
 #include "PlayerState.h"
 
+typedef struct _GMainContext GMainContext;
+
 // Features
-//#define ENABLE_EQUALIZER
 #define ENABLE_FADEIN
 
 // Limits
@@ -45,6 +46,9 @@ along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
 #define PLAYER_MIN_TREBLE -0.5
 #define PLAYER_MAX_TREBLE 0.5
 
+// Metrics
+#define PLAYER_HISTOGRAM_BUCKETS 24
+
 struct PlayerImpl;
 
 class Player
@@ -68,6 +72,7 @@ class Player
         std::string getFilename();
 
         long long int getPos();
+        long long int getAudiblePos();
         void seekPos(long long int seektime);
         long long int getStartms();
         long long int getStopms();
@@ -106,7 +111,7 @@ class Player
         void setDebugmode(bool);
         void setUseragent(std::string);
 
-        enum playerMessage { PLAYER_CONTINUE, PLAYER_ATEOS, PLAYER_BUFFERING, PLAYER_ERROR };
+        enum playerMessage { PLAYER_CONTINUE, PLAYER_ATEOS, PLAYER_BUFFERING, PLAYER_ERROR, PLAYER_SEGMENT_ENDING };
 
         /**
          * Holds data about an audio segment. The data is sent with the OnPlayerTime signal.
@@ -118,13 +123,124 @@ class Player
             long segmentstop;
         } timeData;
 
+        /**
+         * A pause in the narration, found by the pause index
+         */
+        typedef struct {
+            long start;     // ms
+            long stop;      // ms
+        } pauseData;
+
+        /**
+         * Distribution of a duration in microseconds. Bucket n counts the samples
+         * below 2^n us, the last bucket also counts everything above that.
+         */
+        typedef struct {
+            unsigned long count;
+            unsigned long long total;
+            unsigned long long max;
+            unsigned long buckets[PLAYER_HISTOGRAM_BUCKETS];
+        } histogramData;
+
+        /**
+         * Snapshot of the runtime counters and histograms. Returned by getMetrics.
+         */
+        typedef struct {
+            unsigned long buffersProcessed;
+            unsigned long buffersSkipped;
+            unsigned long reopenRetries;
+            unsigned long agcAdjustments;
+            unsigned long qosEvents;
+            unsigned long timeNotifications;
+            histogramData seekLatency;
+            histogramData stateChangeLatency;
+            histogramData dataMutexWait;
+            histogramData dataMutexHold;
+            histogramData stateMutexWait;
+            histogramData stateMutexHold;
+            histogramData probeTime;
+            histogramData dispatchDelay;
+            histogramData cueJitter;
+        } metricsData;
+
+        metricsData getMetrics();
+        void resetMetrics();
+        void setMetricsInterval(int seconds);
+
+        void setTracing(bool enable);
+        bool dumpTrace(std::string filename);
+
+        /**
+         * Processing quality, lowered when the device can't keep up with playback
+         */
+        enum qualityTier {
+            QUALITY_FULL,     // All processing stages enabled
+            QUALITY_REDUCED,  // Level analysis (AGC) and equalizer disabled
+            QUALITY_MINIMAL   // As reduced, and a larger sink buffer from the next file on
+        };
+
+        qualityTier getQualityTier();
+
+        void setSilenceCompression(bool enable);
+        bool getSilenceCompression();
+        long getSilenceSaved();
+
+        bool getPauses(std::string url, std::vector<pauseData> &pauses);
+        void setSeekSnap(long maxms);
+
+        void setTimeInterval(long ms);
+        void setTimeThresholds(std::vector<long long> ms);
+        void setCues(std::vector<long long> ms);
+
+        /**
+         * What playback does at the stop of a segment while the application
+         * answers PLAYER_CONTINUE
+         */
+        enum continuePolicy {
+            CONTINUE_PLAY,  // Keep playing past the stop, for clips that run on
+            CONTINUE_MUTE,  // Stay silent until the answer
+            CONTINUE_PAUSE  // Pause until the answer
+        };
+
+        void setDispatchContext(GMainContext *context);
+        void setContinuePolicy(continuePolicy policy);
+        void setNextSegment(std::string filename, long long startms, long long stopms);
+        void setSegmentEndingLead(long ms);
+
+        size_t setClips(const char *const *urls, const char *const *clipBegins,
+                const char *const *clipEnds, size_t count);
+        long findClip(std::string url, long long ms);
+        long getClip();
+        bool openClip(long clip);
+        void setClipAdvance(bool enable);
+
+        void setLowMemory(bool enable);
+        bool getLowMemory();
+
+        /**
+         * Audio formats negotiated in the current pipeline, as caps strings.
+         * Empty until data has flowed. Returned by getFormats.
+         */
+        typedef struct {
+            std::string decoder;      // Decoder output
+            std::string processing;   // Tempo, equalizer, silence compression and level
+            std::string sink;         // Audio sink input
+            int conversions;          // Sample format conversions on the way, 0 to 2
+        } formatData;
+
+        formatData getFormats();
+
+        static size_t parseClockValues(const char *const *values, size_t count, long long *ms);
+
         typedef boost::signals2::signal<bool (playerMessage)> OnPlayerMessage;
         typedef boost::signals2::signal<bool (playerState)> OnPlayerState;
         typedef boost::signals2::signal<bool (timeData)> OnPlayerTime;
+        typedef boost::signals2::signal<bool (long long)> OnPlayerCue;
 
         boost::signals2::connection doOnPlayerMessage(OnPlayerMessage::slot_type slot);
         boost::signals2::connection doOnPlayerState(OnPlayerState::slot_type slot);
         boost::signals2::connection doOnPlayerTime(OnPlayerTime::slot_type slot);
+        boost::signals2::connection doOnPlayerCue(OnPlayerCue::slot_type slot);
         bool isPlaying();
 
         Player();
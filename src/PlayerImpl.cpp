@@ -19,6 +19,8 @@ along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <string>
+#include <cstring>
+#include <sstream>
 #include <iostream>
 #include <cstdarg>
 #include <cstdio>
@@ -27,17 +29,39 @@ along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
 #include <cmath>
 #include <ctime>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
 #include <log4cxx/logger.h>
+#include <boost/bind.hpp>
 
 #include "config.h"
 #include "SmilTime.h"
 #include "PlayerImpl.h"
+#include "SilenceElement.h"
+#ifdef ENABLE_WSOLA
+#include "WsolaElement.h"
+#endif
+#ifdef ENABLE_MMAPSRC
+#include "MmapSrcElement.h"
+#endif
+#if defined(ENABLE_DSP) && !defined(ENABLE_AMPLIFY)
+#undef ENABLE_DSP   // kolibredsp takes the place of audioamplify
+#endif
+#include "DspElement.h"
 
 //#define DEBUG 1
 //#define DEBUG2 1
 
 // Tweakable values
 #define FADEIN_MS 50
+#define PITCH_RELINK_TIMEOUT_MS 500
+
+// States of a pitch element relink
+#define PITCH_RELINK_NONE 0         // No relink asked for
+#define PITCH_RELINK_PENDING 1      // Pad block asked for, may still be cancelled
+#define PITCH_RELINK_CLAIMED 2      // cb_pitch_blocked is relinking
+#define PITCH_RELINK_DONE 3         // Relinked, waiting for the seek
 #define SEEKMARGIN_MS 300
 #define NEWPOSFLEX_MS 300
 #define REOPEN_AFTER_PAUSING_SEC 240
@@ -48,6 +72,30 @@ along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
 #define levelPeakttl 1000 * GST_MSECOND
 #define levelPeakfalloff 0.5
 
+#define EQUALIZER_MAX_DB 9.0                // Shelf gain at the bass and treble limits
+
+#define ENDING_RESCHEDULE_MS 20             // Estimate drift before a segment clock id is rescheduled
+
+#define QOS_LATE_EVENTS 3                   // Late buffers per second before lowering quality
+#define QOS_RESTORE_SEC 30                  // Seconds without lateness before raising quality
+#define QOS_SINK_BUFFER_TIME 1000000        // Sink buffer-time in QUALITY_MINIMAL (us)
+
+#define STREAM_QUEUE_BYTES 10485760         // queue2 size for http sources
+#define CDA_QUEUE_BYTES 262144              // Queue size after cdparanoiasrc
+#define CDA_QUEUE_THRESHOLD 65536
+
+#define LOWMEM_STREAM_QUEUE_BYTES 524288    // queue2 size in the low-memory profile
+#define LOWMEM_CDA_QUEUE_BYTES 65536
+#define LOWMEM_CDA_QUEUE_THRESHOLD 16384
+#define LOWMEM_SINK_BUFFER_TIME 200000      // Sink buffer-time in the low-memory profile (us)
+#define LOWMEM_READAHEAD 262144             // kolibremmapsrc readahead in the low-memory profile
+#define LOWMEM_KEEP_BEHIND 524288           // kolibremmapsrc keep-behind in the low-memory profile
+
+// Sample formats for the postprocessing chain, all its elements handle both
+#define FORMAT_INT16 "audio/x-raw-int, width = (int) 16, depth = (int) 16, signed = (boolean) true"
+#define FORMAT_FLOAT32 "audio/x-raw-float, width = (int) 32"
+#define FORMAT_ANY FORMAT_INT16 "; " FORMAT_FLOAT32
+
 // helper function to build a clock string from a GstClockTime object
 std::string gst_time_string(GstClockTime gstClockTime)
 {
@@ -104,6 +152,7 @@ log4cxx::LoggerPtr playerImplLog(log4cxx::Logger::getLogger("kolibre.player.play
 char spinner[] = { '-', '\\', '|', '/' };
 
 void *player_thread(void *player);
+void *pause_index_thread(void *player);
 bool handle_bus_message(GstMessage *message, PlayerImpl *p);
 
 #define bError true
@@ -128,6 +177,43 @@ PlayerImpl::PlayerImpl():
     dataMutex = (pthread_mutex_t *) malloc (sizeof (pthread_mutex_t));
     pthread_mutex_init (dataMutex, NULL);
 
+    stateMutexLocked = dataMutexLocked = GST_CLOCK_TIME_NONE;
+    memset(&mStateMutexWait, 0, sizeof(mStateMutexWait));
+    memset(&mStateMutexHold, 0, sizeof(mStateMutexHold));
+    memset(&mDataMutexWait, 0, sizeof(mDataMutexWait));
+    memset(&mDataMutexHold, 0, sizeof(mDataMutexHold));
+    mMetricsInterval = 0;
+
+    mQualityTier = Player::QUALITY_FULL;
+    mSilenceCompression = false;
+    mSilenceSavedms = 0;
+    mSilenceLivems = 0;
+    bIndexThread = false;
+    mSeekSnapms = 0;
+    mLowMemory = false;
+    mFormats.conversions = 0;
+    mQosLateEvents = 0;
+    mQosLateness = mQosPrevLateness = 0;
+    mQosEvaluated = mQosLastLate = 0;
+    gst_segment_init(&mSinkSegment, GST_FORMAT_TIME);
+    mContinuePolicy = Player::CONTINUE_PLAY;
+    bNextStaged = false;
+    mNextStartms = mNextStopms = 0;
+    bClipAdvance = false;
+    mClip = mNextClip = -1;
+    bClipStaged = false;
+    mEndingLeadms = 0;
+    pClock = NULL;
+    mStopId = NULL;
+    mStopAt = GST_CLOCK_TIME_NONE;
+    mEndingId = NULL;
+    mEndingAt = GST_CLOCK_TIME_NONE;
+    mCueId = NULL;
+    mCueAt = GST_CLOCK_TIME_NONE;
+    mCuems = -1;
+    mEndingTargetms = -1;
+    bEndingSent = false;
+
     // Set the state to inactive
     curState = INACTIVE;
     realState = INACTIVE;
@@ -170,14 +256,25 @@ PlayerImpl::PlayerImpl():
 
     pWavparse = NULL;
 
+    pFlacdec = NULL;
+
+    pOpusdec = NULL;
+
+    pQtdemux = NULL;
+
     pDecodebin = NULL;
 
     pQueue = NULL;
     pLevel = NULL;
     pAmplify = NULL;
     pAudioconvert1 = NULL;
+    pCapsfilter = NULL;
     pPitch = NULL;
+    bPitchBypassed = false;
+    mPitchRelink = PITCH_RELINK_NONE;
+    mPitchBlockedAt = GST_CLOCK_TIME_NONE;
     pEqualizer = NULL;
+    pSilence = NULL;
     pAudioconvert2 = NULL;
     pAudiosink = NULL;
     pQueue2 = NULL;
@@ -194,6 +291,14 @@ PlayerImpl::~PlayerImpl()
 {
     LOG4CXX_TRACE(playerImplLog, "Destructor");
 
+    // No more callbacks to the application
+    dispatcher.shutdown();
+
+    // Stop indexing before gstreamer goes away
+    pauseIndex.shutdown();
+    if(bIndexThread)
+        pthread_join (indexThread, NULL);
+
     // Tell the playbackThread to exit
     if(realState!=INACTIVE){
         setState(EXITING);
@@ -433,6 +538,16 @@ boost::signals2::connection PlayerImpl::doOnPlayerTime(Player::OnPlayerTime::slo
     return onPlayerTime.connect(slot);
 }
 
+/**
+ * Set the a signal slot for when a cue point is heard
+ *
+ * @param slot function pointer
+ */
+boost::signals2::connection PlayerImpl::doOnPlayerCue(Player::OnPlayerCue::slot_type slot)
+{
+    return onPlayerCue.connect(slot);
+}
+
 /**
  * Send the audio-finished-playing signal
  *
@@ -440,12 +555,6 @@ boost::signals2::connection PlayerImpl::doOnPlayerTime(Player::OnPlayerTime::slo
  */
 bool PlayerImpl::sendCONTSignal()
 {
-    //Set mPlayWaiting before knowing the result of onPlayerMessage since a race condition might occur
-    //and setting it to true after might be to late
-    lockMutex(dataMutex);
-    mPlayingWaiting = true;
-    unlockMutex(dataMutex);
-
     LOG4CXX_DEBUG(playerImplLog, "Sending 'Continue?' signal");
     bool result;
     boost::optional<bool> resultval = onPlayerMessage( Player::PLAYER_CONTINUE );
@@ -487,6 +596,468 @@ bool PlayerImpl::sendEOSSignal()
     }
 }
 
+/**
+ * Send the Continue signal for a segment stop reached in segmentStop,
+ * run by the dispatcher
+ *
+ * @param posted when the stop posted the job
+ * @param stopms stop of the segment the question is about
+ * @param staged playback already continued with a staged segment
+ */
+void PlayerImpl::dispatchContinue(GstClockTime posted, long long stopms, bool staged)
+{
+    metrics.record(PlayerMetrics::DISPATCH_DELAY, gst_util_get_timestamp() - posted);
+    PlayerTraceSpan span(trace, "dispatch", "continue callback");
+
+    lockMutex(dataMutex);
+    bool hold = !staged && mContinuePolicy == Player::CONTINUE_PAUSE;
+    unlockMutex(dataMutex);
+
+    // Hold playback at the stop while the application answers
+    if(hold) pause();
+
+    bool result = sendCONTSignal();
+
+    // Unless the application stopped meanwhile, play on. When there is
+    // nothing more the muted stream runs to the end of the file.
+    if(hold && getState() == PAUSING) resume();
+
+    lockMutex(dataMutex);
+    if(staged || mPlayingStopms != stopms) {
+        // Playback has already moved on, the answer only matters to the application
+        LOG4CXX_DEBUG(playerImplLog, "Continue answered after playback moved on");
+    } else if(result) {
+        LOG4CXX_INFO(playerImplLog, "Continuing playback at: " << mPlayingms);
+        // Without a new position to wait for, there is nothing to stay silent for
+        if(!bOpenSignal) bMutePlayback = false;
+    } else {
+        LOG4CXX_INFO(playerImplLog, "Starting to mute buffers");
+        trace.instant("dispatch", "mute", mPlayingms);
+        mPlayingWaiting = false;
+        bMutePlayback = true;
+    }
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Run application callbacks from a GMainContext instead of the player's
+ * dispatch thread
+ *
+ * @param context the context, NULL for the dispatch thread
+ */
+void PlayerImpl::setDispatchContext(GMainContext *context)
+{
+    dispatcher.setContext(context);
+}
+
+/**
+ * Set what playback does at the stop of a segment while the Continue
+ * signal is being answered
+ *
+ * @param policy play on, mute or pause
+ */
+void PlayerImpl::setContinuePolicy(Player::continuePolicy policy)
+{
+    lockMutex(dataMutex);
+    mContinuePolicy = policy;
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Stage the segment to continue with at the stop of the current one
+ *
+ * @param filename URL of the file
+ * @param startms start of the segment
+ * @param stopms stop of the segment
+ */
+void PlayerImpl::setNextSegment(string filename, long long startms, long long stopms)
+{
+    lockMutex(dataMutex);
+    mNextFilename = filename;
+    mNextStartms = startms;
+    mNextStopms = stopms;
+    bNextStaged = true;
+    mNextClip = clipIndex.find(filename, startms);
+    bClipStaged = false;
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Load the clips of a book, see Player::setClips
+ *
+ * @param urls file of each clip
+ * @param clipBegins where each clip begins, entries may be NULL
+ * @param clipEnds where each clip ends, entries may be NULL
+ * @param count number of clips
+ * @return the number of clips with valid times
+ */
+size_t PlayerImpl::setClips(const char *const *urls, const char *const *clipBegins,
+        const char *const *clipEnds, size_t count)
+{
+    size_t valid = clipIndex.set(urls, clipBegins, clipEnds, count);
+    if(valid < count)
+        LOG4CXX_WARN(playerImplLog, count - valid << " of " << count << " clips have invalid clock values");
+
+    lockMutex(dataMutex);
+    mClip = clipIndex.find(mFilename, mStartms);
+    if(bClipStaged) {
+        bNextStaged = false;
+        bClipStaged = false;
+    }
+    stageNextClip();
+    unlockMutex(dataMutex);
+    return valid;
+}
+
+/**
+ * @param url file, as passed to open
+ * @param ms position in the file
+ * @return the clip containing the position, -1 if none
+ */
+long PlayerImpl::findClip(string url, long long ms)
+{
+    return clipIndex.find(url, ms);
+}
+
+/**
+ * @return the clip opened or continued with last, -1 if unknown
+ */
+long PlayerImpl::getClip()
+{
+    lockMutex(dataMutex);
+    long clip = mClip;
+    unlockMutex(dataMutex);
+    return clip;
+}
+
+/**
+ * Open a clip loaded with setClips
+ *
+ * @param clip clip number
+ * @return false if there is no such clip
+ */
+bool PlayerImpl::openClip(long clip)
+{
+    string url;
+    long long beginms, endms;
+    if(!clipIndex.get(clip, url, beginms, endms)) return false;
+
+    openSegment(url, beginms, endms, clip);
+    return true;
+}
+
+/**
+ * Continue with the next clip at the stop of each clip, unless the
+ * application stages a segment
+ *
+ * @param enable true to continue through the clips
+ */
+void PlayerImpl::setClipAdvance(bool enable)
+{
+    lockMutex(dataMutex);
+    bClipAdvance = enable;
+    if(enable) stageNextClip();
+    else if(bClipStaged) {
+        bNextStaged = false;
+        bClipStaged = false;
+    }
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Stage the clip after mClip, if clip advance is on and the application
+ * has not staged a segment. Called with dataMutex held.
+ */
+void PlayerImpl::stageNextClip()
+{
+    if(!bClipAdvance || (bNextStaged && !bClipStaged)) return;
+
+    string url;
+    long long beginms, endms;
+    long next = clipIndex.next(mClip);
+    if(next < 0 || !clipIndex.get(next, url, beginms, endms)) {
+        if(bClipStaged) bNextStaged = false;
+        bClipStaged = false;
+        return;
+    }
+
+    mNextFilename = url;
+    mNextStartms = beginms;
+    mNextStopms = endms;
+    mNextClip = next;
+    bNextStaged = true;
+    bClipStaged = true;
+}
+
+/**
+ * Act on the stop of the playing segment: continue with a staged segment
+ * or apply the continue policy, and ask the application on the dispatcher.
+ * Called with dataMutex held from stop_time_callback or cb_data_probe, so
+ * it must never wait.
+ */
+void PlayerImpl::segmentStop()
+{
+    //Sometimes there is a delayed input making the cases below send us extra next commands. These will then make the reader leave out
+    //beginning of sentences. Workaround is to check the goal state (p-getState()) and make sure we want it to be playing and sending
+    //these commands. However, this needs robust testing.
+    if(getState() != PLAYING) return;
+
+    if((position + 760 * GST_MSECOND) > duration) // Check that we aren't almost the very end of the current file
+    {
+        LOG4CXX_INFO(playerImplLog, "not calling continue callback at end of file " << position/GST_MSECOND << "/" << duration/GST_MSECOND);
+        return;
+    }
+
+    mPlayingWaiting = true;
+    bool staged = bNextStaged;
+    if(staged) {
+        LOG4CXX_INFO(playerImplLog, "Continuing with staged segment " << TIME_STR_MS(mNextStartms) << " -> " << TIME_STR_MS(mNextStopms));
+        trace.instant("streaming", "staged segment", mNextStartms);
+        mFilename = mNextFilename;
+        mStartms = mNextStartms;
+        mStopms = mNextStopms;
+        mUnderrunms = 0;
+        mOpenRetries = 5;
+        bOpenSignal = true;
+        bNextStaged = false;
+        bClipStaged = false;
+        mClip = mNextClip;
+        stageNextClip();
+    } else if(mContinuePolicy != Player::CONTINUE_PLAY) {
+        trace.instant("streaming", "mute", mPlayingms);
+        bMutePlayback = true;
+    }
+    dispatcher.post(boost::bind(&PlayerImpl::dispatchContinue, this,
+                gst_util_get_timestamp(), mPlayingStopms, staged));
+}
+
+/**
+ * Gstreamer callback for the clock reaching the stop of the playing
+ * segment, called from the clock thread
+ */
+gboolean stop_time_callback (GstClock *clock, GstClockTime time, GstClockID id, gpointer player_object)
+{
+    PlayerImpl *p = (PlayerImpl *)player_object;
+    p->lockMutex(p->dataMutex);
+    if(time == p->mStopAt && !p->mPlayingWaiting && !p->bMutePlayback) {
+        p->trace.instant("clock", "segment stop", p->mPlayingStopms);
+        p->segmentStop();
+    }
+    p->unlockMutex(p->dataMutex);
+    return TRUE;
+}
+
+/**
+ * Set how long before the end of a segment PLAYER_SEGMENT_ENDING is sent
+ *
+ * @param ms lead time, 0 to disable
+ */
+void PlayerImpl::setSegmentEndingLead(long ms)
+{
+    lockMutex(dataMutex);
+    mEndingLeadms = ms > 0 ? ms : 0;
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Gstreamer callback for the clock reaching a PLAYER_SEGMENT_ENDING time,
+ * called from the clock thread
+ */
+static gboolean cb_segment_ending (GstClock *clock, GstClockTime time, GstClockID id, gpointer player_object)
+{
+    PlayerImpl *p = (PlayerImpl *)player_object;
+    p->dispatcher.post(boost::bind(&PlayerImpl::dispatchSegmentEnding, p, time));
+    return TRUE;
+}
+
+/**
+ * Gstreamer callback for the clock reaching a cue, called from the clock
+ * thread
+ */
+static gboolean cb_cue (GstClock *clock, GstClockTime time, GstClockID id, gpointer player_object)
+{
+    PlayerImpl *p = (PlayerImpl *)player_object;
+    GstClockTime late = gst_clock_get_time(clock) - time;
+    p->lockMutex(p->dataMutex);
+    if(time == p->mCueAt) {
+        // Fired, the player thread schedules the next cue
+        p->mCueAt = GST_CLOCK_TIME_NONE;
+        p->dispatcher.post(boost::bind(&PlayerImpl::dispatchCue, p, late, gst_util_get_timestamp(), p->mCuems));
+    }
+    p->unlockMutex(p->dataMutex);
+    return TRUE;
+}
+
+/**
+ * Send onPlayerCue for the cues that have become audible, run by the
+ * dispatcher
+ *
+ * @param late how late the clock thread woke up for the cue
+ * @param posted when the clock thread posted the job
+ * @param cuems the cue the clock id was for
+ */
+void PlayerImpl::dispatchCue(GstClockTime late, GstClockTime posted, long long cuems)
+{
+    metrics.record(PlayerMetrics::CUE_JITTER, gst_util_get_timestamp() - posted + late);
+
+    // Cues closer than the player loop are taken together
+    long long audiblems = positionClock.position() / GST_MSECOND;
+    std::vector<long long> cues;
+    cueList.take(audiblems > cuems ? audiblems : cuems, cues);
+
+    PlayerTraceSpan span(trace, "dispatch", "cue callback");
+    for(size_t i = 0; i < cues.size(); i++) {
+        LOG4CXX_TRACE(playerImplLog, "Sending cue " << cues[i]);
+        onPlayerCue(cues[i]);
+    }
+}
+
+/**
+ * Keep a single-shot clock id at a clock time. The id is left alone while
+ * the new time is within ENDING_RESCHEDULE_MS of it, otherwise it is
+ * replaced. Called by the player thread.
+ *
+ * @param id the id, NULL when nothing is scheduled
+ * @param scheduled clock time of the id, written under dataMutex. A
+ * callback sets it to none to have the id replaced
+ * @param at wanted clock time, GST_CLOCK_TIME_NONE to cancel
+ * @param callback called from the clock thread when the time is reached
+ */
+void PlayerImpl::armClockId(GstClockID *id, GstClockTime *scheduled, GstClockTime at, GstClockCallback callback)
+{
+    if(*id != NULL && GST_CLOCK_TIME_IS_VALID(*scheduled) && GST_CLOCK_TIME_IS_VALID(at)) {
+        GstClockTimeDiff drift = GST_CLOCK_DIFF(*scheduled, at);
+        if(drift < ENDING_RESCHEDULE_MS * GST_MSECOND && drift > -ENDING_RESCHEDULE_MS * GST_MSECOND) return;
+    }
+
+    if(*id != NULL) {
+        gst_clock_id_unschedule(*id);
+        gst_clock_id_unref(*id);
+        lockMutex(dataMutex);
+        *id = NULL;
+        *scheduled = GST_CLOCK_TIME_NONE;
+        unlockMutex(dataMutex);
+    }
+    if(!GST_CLOCK_TIME_IS_VALID(at)) return;
+
+    // The ids are made on the clock the position is estimated from
+    if(pClock == NULL) pClock = gst_pipeline_get_clock(GST_PIPELINE(pPipeline));
+    if(pClock == NULL) return;
+
+    GstClockID newId = gst_clock_new_single_shot_id(pClock, at);
+    lockMutex(dataMutex);
+    *id = newId;
+    *scheduled = at;
+    unlockMutex(dataMutex);
+
+    // A time already passed fires right away
+    if(gst_clock_id_wait_async(newId, callback, this) != GST_CLOCK_OK)
+        LOG4CXX_WARN(playerImplLog, "Failed to schedule clock id at " << TIME_STR(at));
+}
+
+/**
+ * Keep the segment stop, PLAYER_SEGMENT_ENDING and the next cue scheduled
+ * on the pipeline clock, called by the player thread while playing. The clock
+ * times are estimated from the newest buffer at the sink and rescheduled
+ * when the estimate moves, e.g. after a tempo change or a seek.
+ *
+ * @param stopms stop of the playing segment (ms)
+ * @param endms stop of the segment or end of the file, whichever is first (ms)
+ */
+void PlayerImpl::scheduleSegmentClock(long long stopms, long long endms)
+{
+    lockMutex(dataMutex);
+    if(endms != mEndingTargetms) {
+        mEndingTargetms = endms;
+        bEndingSent = false;
+    }
+    long lead = mEndingLeadms;
+    bool endingDone = bEndingSent;
+    bool stopDone = mPlayingWaiting || bMutePlayback;
+    unlockMutex(dataMutex);
+
+    // Only stops inside the file, the end of the file is handled at EOS
+    GstClockTime stopAt = GST_CLOCK_TIME_NONE;
+    if(!stopDone && stopms < endms + 1)
+        stopAt = positionClock.clockTimeAt(stopms * GST_MSECOND);
+    armClockId(&mStopId, &mStopAt, stopAt, stop_time_callback);
+
+    GstClockTime endingAt = GST_CLOCK_TIME_NONE;
+    if(lead > 0 && !endingDone)
+        endingAt = positionClock.clockTimeAt((endms - lead) * GST_MSECOND);
+    armClockId(&mEndingId, &mEndingAt, endingAt, cb_segment_ending);
+
+    // The next cue, each is scheduled once the one before has fired
+    long long cue = cueList.pending(positionClock.position() / GST_MSECOND);
+    GstClockTime cueAt = GST_CLOCK_TIME_NONE;
+    if(cue >= 0) {
+        cueAt = positionClock.clockTimeAt(cue * GST_MSECOND);
+        lockMutex(dataMutex);
+        mCuems = cue;
+        unlockMutex(dataMutex);
+    }
+    armClockId(&mCueId, &mCueAt, cueAt, cb_cue);
+}
+
+/**
+ * Drop the scheduled segment stop, PLAYER_SEGMENT_ENDING and cue, when
+ * not playing or tearing down
+ */
+void PlayerImpl::cancelSegmentClock()
+{
+    armClockId(&mStopId, &mStopAt, GST_CLOCK_TIME_NONE, stop_time_callback);
+    armClockId(&mEndingId, &mEndingAt, GST_CLOCK_TIME_NONE, cb_segment_ending);
+    armClockId(&mCueId, &mCueAt, GST_CLOCK_TIME_NONE, cb_cue);
+    if(pClock != NULL) {
+        gst_object_unref(pClock);
+        pClock = NULL;
+    }
+}
+
+/**
+ * Send PLAYER_SEGMENT_ENDING unless it went stale meanwhile, run by the
+ * dispatcher. Afterwards the file of a staged segment is sniffed so that
+ * its pipeline can be set up without waiting for the disk.
+ *
+ * @param at clock time the notification was scheduled for
+ */
+void PlayerImpl::dispatchSegmentEnding(GstClockTime at)
+{
+    lockMutex(dataMutex);
+    bool send = at == mEndingAt && !bEndingSent;
+    if(send) bEndingSent = true;
+    unlockMutex(dataMutex);
+    if(!send) return;
+
+    PlayerTraceSpan span(trace, "dispatch", "segment ending callback");
+    sendENDINGSignal();
+
+    lockMutex(dataMutex);
+    string next = bNextStaged && mNextFilename != mPlayingFilename ? mNextFilename : "";
+    unlockMutex(dataMutex);
+    if(next != "") {
+        FormatSniffer::format format = formatSniffer.detect(next);
+        LOG4CXX_DEBUG(playerImplLog, "Staged file '" << next << "' is " << FormatSniffer::name(format));
+    }
+}
+
+/**
+ * Send the Segment ending signal
+ *
+ * @return the slot's answer, false when no slot is connected
+ */
+bool PlayerImpl::sendENDINGSignal()
+{
+    LOG4CXX_DEBUG(playerImplLog, "Sending 'Segment ending' signal");
+    boost::optional<bool> result = onPlayerMessage( Player::PLAYER_SEGMENT_ENDING );
+    if (result!=NULL)
+        return *result;
+    else {
+        LOG4CXX_WARN(playerImplLog, "No slots connected, defaulting returnvalue to false");
+        return false;
+    }
+}
+
 /**
  * Send the Buffering signal
  *
@@ -547,6 +1118,8 @@ bool PlayerImpl::setupThread()
 void PlayerImpl::open(const char *filename, const char *startms, const char *stopms)
 {
     SmilTimeCode startStop(startms, stopms);
+    if(!startStop.isValid())
+        LOG4CXX_WARN(playerImplLog, "Invalid clock value in '" << startms << "', '" << stopms << "', using 0");
 
     // This is just a conversion function
     open(filename, startStop.getStart(), startStop.getEnd());
@@ -562,12 +1135,28 @@ void PlayerImpl::open(const char *filename, const char *startms, const char *sto
  */
 void PlayerImpl::open(string filename, long long startms, long long stopms)
 {
+    openSegment(filename, startms, stopms, -1);
+}
+
+/**
+ * Open a segment and go to paused state
+ *
+ * @param filename URL of file to open
+ * @param startms startms
+ * @param stopms stopms
+ * @param clip clip of the segment, -1 to look it up
+ */
+void PlayerImpl::openSegment(string filename, long long startms, long long stopms, long clip)
+{
+    bool snap;
+
     switch(getState())
     {
         case BUFFERING:
         case PAUSING:
         case PLAYING:
         case STOPPED:
+            trace.instant("api", "open", startms);
             LOG4CXX_INFO(playerImplLog, "Opening '" << filename << "'");
             if(startms != 0 && stopms != UINT_MAX)
                 LOG4CXX_INFO(playerImplLog, "from time " << TIME_STR_MS(startms) << " -> " << TIME_STR_MS(stopms));
@@ -575,15 +1164,16 @@ void PlayerImpl::open(string filename, long long startms, long long stopms)
             if(getState() != PLAYING) setState(PAUSING);
 
             lockMutex(dataMutex);
-            mFilename = filename;
-            mStartms = startms;
-            mStopms = stopms;
-            mUnderrunms = 0;
-            mOpenRetries = 5;
-
-            bOpenSignal = true;
+            setOpenPosition(filename, startms, stopms, clip);
+            snap = mSeekSnapms > 0 && !mLowMemory;
 
             unlockMutex(dataMutex);
+
+            // Index the file in the background so that seeks can snap to pauses
+            if(snap) {
+                startIndexThread();
+                pauseIndex.request(filename);
+            }
             usleep(100000);
 
             break;
@@ -597,6 +1187,30 @@ void PlayerImpl::open(string filename, long long startms, long long stopms)
     }
 }
 
+/**
+ * Hand a new segment to the player thread, which opens it on its next
+ * loop. Called with dataMutex held.
+ *
+ * @param filename URL of file to open
+ * @param startms startms
+ * @param stopms stopms
+ * @param clip clip of the segment, -1 to look it up
+ */
+void PlayerImpl::setOpenPosition(string filename, long long startms, long long stopms, long clip)
+{
+    mFilename = filename;
+    mStartms = startms;
+    mStopms = stopms;
+    mUnderrunms = 0;
+    mOpenRetries = 5;
+    bNextStaged = false;
+    bClipStaged = false;
+    mClip = clip >= 0 ? clip : clipIndex.find(filename, startms);
+    stageNextClip();
+
+    bOpenSignal = true;
+}
+
 /**
  * Open a file and go to paused state
  *
@@ -631,14 +1245,26 @@ void PlayerImpl::seekPos(long long int seektime)
             {
                 if(seektime < 0) seektime = 0;
                 lockMutex(dataMutex);
-                double tempo = mPlayingTempo;
                 string filename = mFilename;
+                long snapms = mSeekSnapms;
                 bFadeIn = true;
                 unlockMutex(dataMutex);
 
-                gint64 c_seektime = (gint64) ((double)seektime / tempo) * GST_MSECOND;
-
-                LOG4CXX_INFO(playerImplLog, "Seeking to " << seektime << " ms (" << c_seektime << ")");
+                if(snapms > 0) {
+                    long snapped = pauseIndex.snap(filename, seektime, snapms);
+                    if(snapped != seektime) {
+                        LOG4CXX_DEBUG(playerImplLog, "Seek target " << seektime << " ms snapped to pause at " << snapped << " ms");
+                        seektime = snapped;
+                    }
+                }
+
+                lockMutex(dataMutex);
+                gint64 c_seektime = toSeekTime(seektime);
+                unlockMutex(dataMutex);
+
+                LOG4CXX_INFO(playerImplLog, "Seeking to " << seektime << " ms (" << c_seektime << ")");
+                PlayerTraceSpan span(trace, "api", "seekPos");
+                metrics.start(PlayerMetrics::SEEK_LATENCY);
 
                 if (!gst_element_seek_simple (pPipeline, GST_FORMAT_TIME, (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), c_seektime))
                 {
@@ -674,6 +1300,7 @@ void PlayerImpl::seekPos(long long int seektime)
  */
 void PlayerImpl::stop()
 {
+    trace.instant("api", "stop");
     pausePosition = PlayerPosition(*this);
     lockMutex(dataMutex);
     mFilename = mPlayingFilename = "";
@@ -703,6 +1330,7 @@ void PlayerImpl::reopen()
  */
 void PlayerImpl::pause()
 {
+    PlayerTraceSpan span(trace, "api", "pause");
     playerState state = getState();
 
     switch(state)
@@ -731,6 +1359,7 @@ void PlayerImpl::pause()
 void PlayerImpl::resume()
 {
     LOG4CXX_INFO(playerImplLog, "resuming playback...");
+    trace.instant("api", "resume");
     playerState state = getState();
 
     switch(state)
@@ -785,6 +1414,18 @@ long long int PlayerImpl::getPos()
     }
 }
 
+/**
+ * Get the position being heard right now. Interpolated from the pipeline
+ * clock between buffers and compensated for what is queued in the sink,
+ * callable from any thread without taking a lock.
+ *
+ * @return audible file position (ms)
+ */
+long long int PlayerImpl::getAudiblePos()
+{
+    return positionClock.position() / GST_MSECOND;
+}
+
 /**
  * Get the current playing file
  *
@@ -1016,7 +1657,7 @@ double PlayerImpl::getTempo()
 }
 
 /**
- * Set the playback tempo
+ * Set the playback tempo, applied right away while playing
  *
  * @param value tempo (between PLAYER_MAX_TEMPO and PLAYER_MIN_TEMPO)
  */
@@ -1077,7 +1718,7 @@ double PlayerImpl::getPitch()
 }
 
 /**
- * Set the playback pitch
+ * Set the playback pitch, applied right away while playing
  *
  * @param value pitch (between PLAYER_MAX_PITCH and PLAYER_MIN_PITCH)
  */
@@ -1087,13 +1728,20 @@ void PlayerImpl::setPitch(double value)
     if(value >= PLAYER_MAX_PITCH) value = PLAYER_MAX_PITCH;
     lockMutex(dataMutex);
     mPitch = value;
+    mPlayingPitch = value;
     unlockMutex(dataMutex);
 
     switch(getState())
     {
         case PAUSING:
         case PLAYING:
-            LOG4CXX_INFO(playerImplLog, "setting pitch to: " << value);
+            if(pPitch != NULL)
+            {
+                LOG4CXX_INFO(playerImplLog, "setting pitch to: " << value);
+#ifdef ENABLE_PITCH
+                g_object_set(pPitch, "pitch", value, NULL);
+#endif
+            }
             break;
         default:
             break;
@@ -1297,7 +1945,390 @@ string PlayerImpl::getUseragent()
 }
 
 /**
- * lockMutex function for debugging
+ * Get a snapshot of the runtime metrics
+ *
+ * @return counters and latency histograms
+ */
+Player::metricsData PlayerImpl::getMetrics()
+{
+    Player::metricsData data = metrics.snapshot();
+
+    // The mutex histograms are kept by lockMutex and unlockMutex, copied without recording
+    pthread_mutex_lock(stateMutex);
+    data.stateMutexWait = mStateMutexWait;
+    data.stateMutexHold = mStateMutexHold;
+    pthread_mutex_unlock(stateMutex);
+
+    pthread_mutex_lock(dataMutex);
+    data.dataMutexWait = mDataMutexWait;
+    data.dataMutexHold = mDataMutexHold;
+    pthread_mutex_unlock(dataMutex);
+
+    return data;
+}
+
+/**
+ * Clear all runtime metrics
+ */
+void PlayerImpl::resetMetrics()
+{
+    metrics.reset();
+
+    pthread_mutex_lock(stateMutex);
+    memset(&mStateMutexWait, 0, sizeof(mStateMutexWait));
+    memset(&mStateMutexHold, 0, sizeof(mStateMutexHold));
+    pthread_mutex_unlock(stateMutex);
+
+    pthread_mutex_lock(dataMutex);
+    memset(&mDataMutexWait, 0, sizeof(mDataMutexWait));
+    memset(&mDataMutexHold, 0, sizeof(mDataMutexHold));
+    pthread_mutex_unlock(dataMutex);
+}
+
+/**
+ * Set how often the player thread writes the metrics to the log
+ *
+ * @param seconds interval between dumps, 0 to disable
+ */
+void PlayerImpl::setMetricsInterval(int seconds)
+{
+    if(seconds < 0) seconds = 0;
+    lockMutex(dataMutex);
+    mMetricsInterval = seconds;
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Turn timeline tracing on or off
+ *
+ * @param enable true to start recording
+ */
+void PlayerImpl::setTracing(bool enable)
+{
+    LOG4CXX_INFO(playerImplLog, "Tracing " << (enable ? "enabled" : "disabled"));
+    trace.setEnabled(enable);
+}
+
+/**
+ * Write the recorded timeline to a file
+ *
+ * @param filename file to write
+ * @return true on success
+ */
+bool PlayerImpl::dumpTrace(std::string filename)
+{
+    return trace.dump(filename);
+}
+
+/**
+ * Get the current processing quality
+ *
+ * @return quality tier
+ */
+Player::qualityTier PlayerImpl::getQualityTier()
+{
+    lockMutex(dataMutex);
+    Player::qualityTier tier = mQualityTier;
+    unlockMutex(dataMutex);
+    return tier;
+}
+
+/**
+ * Turn pause compression on or off, takes effect immediately
+ *
+ * @param enable true to shorten long pauses
+ */
+void PlayerImpl::setSilenceCompression(bool enable)
+{
+    lockMutex(dataMutex);
+    mSilenceCompression = enable;
+    unlockMutex(dataMutex);
+
+    LOG4CXX_INFO(playerImplLog, "Pause compression " << (enable ? "on" : "off"));
+    if(pSilence != NULL)
+        g_object_set(pSilence, "enabled", enable, NULL);
+}
+
+/**
+ * @return true if pause compression is on
+ */
+bool PlayerImpl::getSilenceCompression()
+{
+    lockMutex(dataMutex);
+    bool enable = mSilenceCompression;
+    unlockMutex(dataMutex);
+    return enable;
+}
+
+/**
+ * Get the playback time saved by pause compression since the player was
+ * created
+ *
+ * @return saved time in milliseconds
+ */
+long PlayerImpl::getSilenceSaved()
+{
+    // The pipeline belongs to the player thread, it keeps mSilenceLivems
+    lockMutex(dataMutex);
+    long savedms = mSilenceSavedms + mSilenceLivems;
+    unlockMutex(dataMutex);
+    return savedms;
+}
+
+/**
+ * Get the pauses in a file. Files are indexed in the background, the
+ * first call for a file queues it and returns false.
+ *
+ * @param url file as passed to open
+ * @param pauses receives the pauses
+ * @return true if the file has been indexed
+ */
+bool PlayerImpl::getPauses(string url, vector<Player::pauseData> &pauses)
+{
+    startIndexThread();
+    return pauseIndex.getPauses(url, pauses);
+}
+
+/**
+ * Let seekPos move its target to the end of a nearby pause
+ *
+ * @param maxms how far the target may move, 0 to disable
+ */
+void PlayerImpl::setSeekSnap(long maxms)
+{
+    lockMutex(dataMutex);
+    mSeekSnapms = maxms > 0 ? maxms : 0;
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Set how much media time passes between onPlayerTime notifications
+ *
+ * @param ms interval, 0 to notify at thresholds and segment changes only
+ */
+void PlayerImpl::setTimeInterval(long ms)
+{
+    timeNotifier.setInterval(ms);
+}
+
+/**
+ * Set positions that are always notified through onPlayerTime
+ *
+ * @param ms media positions (ms)
+ */
+void PlayerImpl::setTimeThresholds(std::vector<long long> ms)
+{
+    timeNotifier.setThresholds(ms);
+}
+
+/**
+ * Set the cue points sent through onPlayerCue
+ *
+ * @param ms media positions (ms)
+ */
+void PlayerImpl::setCues(std::vector<long long> ms)
+{
+    cueList.set(ms);
+    LOG4CXX_DEBUG(playerImplLog, "Set " << cueList.size() << " cues");
+}
+
+/**
+ * Select the low-memory profile, used when the next pipeline is set up
+ *
+ * @param enable true for tight buffer limits
+ */
+void PlayerImpl::setLowMemory(bool enable)
+{
+    lockMutex(dataMutex);
+    mLowMemory = enable;
+    unlockMutex(dataMutex);
+
+    LOG4CXX_INFO(playerImplLog, "Low-memory profile " << (enable ? "on" : "off"));
+}
+
+/**
+ * @return true if the low-memory profile is selected
+ */
+bool PlayerImpl::getLowMemory()
+{
+    lockMutex(dataMutex);
+    bool enable = mLowMemory;
+    unlockMutex(dataMutex);
+    return enable;
+}
+
+/**
+ * @return the formats negotiated in the current pipeline
+ */
+Player::formatData PlayerImpl::getFormats()
+{
+    lockMutex(dataMutex);
+    Player::formatData formats = mFormats;
+    unlockMutex(dataMutex);
+    return formats;
+}
+
+/**
+ * Describe the negotiated caps of a pad
+ *
+ * @param element element of the pad
+ * @param name pad name
+ * @param sample receives the sample type, e.g. audio/x-raw-int 16 2
+ * @return the caps as a string, empty if not negotiated
+ */
+static string negotiatedFormat(GstElement *element, const char *name, string &sample)
+{
+    sample = "";
+    if(element == NULL) return "";
+
+    GstPad *pad = gst_element_get_static_pad(element, name);
+    GstCaps *caps = gst_pad_get_negotiated_caps(pad);
+    gst_object_unref(pad);
+    if(caps == NULL) return "";
+
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    gint width = 0, channels = 0;
+    gst_structure_get_int(structure, "width", &width);
+    gst_structure_get_int(structure, "channels", &channels);
+    std::ostringstream oss;
+    oss << gst_structure_get_name(structure) << " " << width << " " << channels;
+    sample = oss.str();
+
+    gchar *str = gst_caps_to_string(caps);
+    string format = str;
+    g_free(str);
+    gst_caps_unref(caps);
+    return format;
+}
+
+/**
+ * Read the formats of the postprocessing chain after a caps change, from
+ * the streaming thread
+ */
+void PlayerImpl::updateFormats()
+{
+    string decoderSample, processingSample, sinkSample;
+    Player::formatData formats;
+    formats.decoder = negotiatedFormat(pAudioconvert1, "sink", decoderSample);
+    formats.processing = negotiatedFormat(pCapsfilter, "src", processingSample);
+    formats.sink = negotiatedFormat(pAudioconvert2, "src", sinkSample);
+    formats.conversions = 0;
+    if(decoderSample != processingSample) formats.conversions++;
+    if(processingSample != sinkSample) formats.conversions++;
+
+    lockMutex(dataMutex);
+    bool changed = formats.decoder != mFormats.decoder || formats.processing != mFormats.processing || formats.sink != mFormats.sink;
+    mFormats = formats;
+    unlockMutex(dataMutex);
+
+    if(changed && formats.sink != "") {
+        LOG4CXX_INFO(playerImplLog, "Negotiated " << formats.decoder << " -> " << formats.processing << " -> " << formats.sink
+                << ", " << formats.conversions << " conversion(s)");
+    }
+}
+
+/**
+ * Start the pause index thread unless it is running
+ */
+void PlayerImpl::startIndexThread()
+{
+    lockMutex(dataMutex);
+    if(!bIndexThread) {
+        LOG4CXX_DEBUG(playerImplLog, "Setting up pause index thread");
+        bIndexThread = pthread_create(&indexThread, NULL, pause_index_thread, this) == 0;
+    }
+    unlockMutex(dataMutex);
+}
+
+/**
+ * Map a timestamp at the audio sink to the timestamp it had before pause
+ * compression. Tempo scaling by the pitch element is undone by timeMap.
+ *
+ * @param time timestamp at the sink
+ * @return timestamp before pause compression
+ */
+GstClockTime PlayerImpl::toSourceTime(GstClockTime time)
+{
+    if(pSilence == NULL) return time;
+    return gst_kolibre_silence_to_source(pSilence, time);
+}
+
+/**
+ * Convert a file position to the time to seek the pipeline to. The
+ * stretcher converts seeks with the tempo in use and starts a new segment
+ * from there, so earlier tempo changes don't matter. Called with
+ * dataMutex held.
+ *
+ * @param ms file position (ms)
+ * @return seek time (ns)
+ */
+gint64 PlayerImpl::toSeekTime(long long ms)
+{
+    return (gint64) ((double)ms / mPlayingTempo) * GST_MSECOND;
+}
+
+/**
+ * Evaluate the QOS events gathered by cb_event_probe, called from the
+ * player thread. Quality is lowered one tier when buffers are late and the
+ * lateness keeps increasing, and raised one tier after QOS_RESTORE_SEC
+ * seconds without late buffers.
+ */
+void PlayerImpl::updateQualityTier()
+{
+    time_t now = time(NULL);
+    if(now == mQosEvaluated) return;
+    mQosEvaluated = now;
+
+    lockMutex(dataMutex);
+    int late = mQosLateEvents;
+    gint64 lateness = mQosLateness;
+    Player::qualityTier tier = mQualityTier;
+    mQosLateEvents = 0;
+    mQosLateness = 0;
+    unlockMutex(dataMutex);
+
+    if(late >= QOS_LATE_EVENTS && lateness > mQosPrevLateness && tier != Player::QUALITY_MINIMAL) {
+        LOG4CXX_WARN(playerImplLog, late << " late buffers, lateness " << lateness / GST_MSECOND << " ms, lowering quality");
+        applyQualityTier((Player::qualityTier)(tier + 1));
+        mQosLastLate = now;
+    } else if(late > 0) {
+        mQosLastLate = now;
+    } else if(tier != Player::QUALITY_FULL && now - mQosLastLate >= QOS_RESTORE_SEC) {
+        LOG4CXX_INFO(playerImplLog, "No late buffers in " << QOS_RESTORE_SEC << " seconds, raising quality");
+        applyQualityTier((Player::qualityTier)(tier - 1));
+        mQosLastLate = now;
+    }
+
+    mQosPrevLateness = lateness;
+}
+
+/**
+ * Switch the processing stages of the running pipeline to a quality tier,
+ * the sink buffer-time is picked up when the next pipeline is set up
+ *
+ * @param tier tier to switch to
+ */
+void PlayerImpl::applyQualityTier(Player::qualityTier tier)
+{
+    lockMutex(dataMutex);
+    LOG4CXX_INFO(playerImplLog, "Quality tier " << mQualityTier << " -> " << tier);
+    mQualityTier = tier;
+    unlockMutex(dataMutex);
+    trace.instant("control", "quality tier", tier);
+
+#ifdef ENABLE_AMPLIFY
+    if(pLevel != NULL)
+        g_object_set(pLevel, "message", tier == Player::QUALITY_FULL, NULL);
+#endif
+#ifdef ENABLE_EQUALIZER
+    if(pEqualizer != NULL)
+        setEqualizer(pEqualizer, mPlayingBass, mPlayingTreble);
+#endif
+}
+
+/**
+ * lockMutex function for debugging, records the wait time while the
+ * mutex is held, so the metrics take no lock of their own
  *
  * @param theMutex mutex to change
  */
@@ -1310,11 +2341,22 @@ void PlayerImpl::lockMutex(pthread_mutex_t *theMutex)
         LOG4CXX_WARN(playerImplLog, "Locking dataMutex");
 #endif
 
+    GstClockTime requested = gst_util_get_timestamp();
     pthread_mutex_lock(theMutex);
+    GstClockTime acquired = gst_util_get_timestamp();
+
+    if(theMutex == stateMutex) {
+        stateMutexLocked = acquired;
+        PlayerMetrics::addSample(mStateMutexWait, acquired - requested);
+    } else if (theMutex == dataMutex) {
+        dataMutexLocked = acquired;
+        PlayerMetrics::addSample(mDataMutexWait, acquired - requested);
+    }
 }
 
 /**
- * unlockMutex function for debugging
+ * unlockMutex function for debugging, records the hold time before the
+ * mutex is released
  *
  * @param theMutex mutex to change
  */
@@ -1327,6 +2369,12 @@ void PlayerImpl::unlockMutex(pthread_mutex_t *theMutex)
         LOG4CXX_WARN(playerImplLog, "unLocking dataMutex");
 #endif
 
+    GstClockTime released = gst_util_get_timestamp();
+    if(theMutex == stateMutex)
+        PlayerMetrics::addSample(mStateMutexHold, released - stateMutexLocked);
+    else if (theMutex == dataMutex)
+        PlayerMetrics::addSample(mDataMutexHold, released - dataMutexLocked);
+
     pthread_mutex_unlock(theMutex);
 }
 
@@ -1346,6 +2394,14 @@ bool PlayerImpl::initGstreamer()
 
     if(gst_init_check(var_argc, var_argv, &error) == true) {
         gstreamer_initialized = true;
+        silence_element_register();
+#ifdef ENABLE_WSOLA
+        wsola_element_register();
+#endif
+#ifdef ENABLE_MMAPSRC
+        mmapsrc_element_register();
+#endif
+        dsp_element_register();
         return bOk;
     }
 
@@ -1359,46 +2415,69 @@ bool PlayerImpl::initGstreamer()
 gboolean cb_data_probe (GstPad *pad, GstBuffer *buffer, gpointer player_object)
 {
     PlayerImpl *p = (PlayerImpl *)player_object;
+    PlayerMetricsTimer timer(p->metrics, PlayerMetrics::PROBE_TIME);
     static int fadeinms = 0;
     static gint64 skippedlength = 0;
 
+    GstClockTime outputtime = p->toSourceTime(buffer->timestamp);
     p->lockMutex(p->dataMutex);
-    gint64 timestamp = (gint64) ((double)buffer->timestamp * p->mPlayingTempo);
+
+    // A tempo change takes effect in the stretcher about when its output
+    // gets here, from then on the file position moves at the new tempo
+    if(p->mPlayingTempo != p->timeMap.tempo())
+        p->timeMap.setTempo(outputtime, p->mPlayingTempo);
+    gint64 timestamp = p->timeMap.toSource(outputtime);
     p->mPlayingms = ( (timestamp % GST_SECOND) / GST_MSECOND ) + ( (timestamp) / GST_SECOND * 1000);
 
     if(p->mPlayingms < p->mPlayingStartms-FADEIN_MS && p->mPlayingms + 5000 > p->mPlayingStartms) {
         p->unlockMutex(p->dataMutex);
         LOG4CXX_DEBUG(playerImplLog, "Skipping buffer " << TIME_STR(buffer->timestamp) <<  " -> " << TIME_STR(buffer->timestamp+buffer->duration));
         skippedlength += buffer->duration;
+        p->metrics.count(PlayerMetrics::BUFFERS_SKIPPED);
+        p->trace.instant("streaming", "skip buffer", buffer->timestamp / GST_MSECOND);
         return FALSE;
     } else if(skippedlength > 0) {
         LOG4CXX_DEBUG(playerImplLog, "Skipped seek margin " << TIME_STR(skippedlength));
         skippedlength = 0;
     }
 
+    p->metrics.count(PlayerMetrics::BUFFERS_PROCESSED);
+    p->metrics.stop(PlayerMetrics::SEEK_LATENCY);
+
+    // Remember when the sink will play this buffer, for getAudiblePos
+    GstClockTime running = gst_segment_to_running_time(&p->mSinkSegment, GST_FORMAT_TIME, buffer->timestamp);
+    if(GST_CLOCK_TIME_IS_VALID(running))
+        p->positionClock.add(running, buffer->duration, timestamp, p->mPlayingTempo);
+    p->trace.counter("streaming", "position", p->mPlayingms);
+
 
 #ifdef ENABLE_FADEIN
     if(p->bFadeIn) {
         p->bFadeIn = false;
         fadeinms = FADEIN_MS; // Milliseconds to apply fade to
+        p->trace.instant("streaming", "fade in", p->mPlayingms);
     }
 
     // Fade in the first few buffers
     if(fadeinms > 0) {
         //int size =  GST_BUFFER_SIZE(buffer);
 
-        int samples = GST_BUFFER_SIZE(buffer) / sizeof(short);
+        // The sink may take float when the postprocessing chain runs in it
+        GstCaps *caps = GST_BUFFER_CAPS(buffer);
+        bool isFloat = caps != NULL && gst_structure_has_name(gst_caps_get_structure(caps, 0), "audio/x-raw-float");
+
+        int samples = GST_BUFFER_SIZE(buffer) / (isFloat ? sizeof(float) : sizeof(short));
         gint64 lengthms = (gint64) ((double)buffer->duration * p->mPlayingTempo);
         lengthms = ( (lengthms % GST_SECOND) / GST_MSECOND ) + ( (lengthms) / GST_SECOND * 1000);
 
-        gint64 startms = (gint64) ((double)buffer->timestamp * p->mPlayingTempo);
-        startms = ( (startms % GST_SECOND) / GST_MSECOND ) + ( (startms) / GST_SECOND * 1000);
+        gint64 startms = timestamp / GST_MSECOND;
 
         float mspersample = (float) lengthms / (float) samples;
 
         //LOG4CXX_WARN(playerImpleLog, "Fading  " << fadeinms << " ms samples " << samples << ", pos " << startms << " duration " << lengthms << " ms/sample " << mspersample << " start at " << p->mPlayingStartms);
 
         short *data = (short *)GST_BUFFER_DATA(buffer);
+        float *fdata = (float *)GST_BUFFER_DATA(buffer);
 
         int fadecounter = 0;
         for (int i = 0; i < samples && (i*mspersample) < fadeinms; i++) {
@@ -1408,10 +2487,13 @@ gboolean cb_data_probe (GstPad *pad, GstBuffer *buffer, gpointer player_object)
 
             if(startms + ((float) i * mspersample) + (FADEIN_MS/2) < p->mPlayingStartms) {
                 //if(i%10==0) LOG4CXX_WARN(playerImpleLog, "Nulling since " <<  (gint64) (startms + ((float) i * mspersample) + FADEIN_MS/2) << " < " << p->mPlayingStartms);
-                data[i] = 0;
+                if(isFloat) fdata[i] = 0.0f;
+                else data[i] = 0;
             } else {
                 //if(i%10 == 0) LOG4CXX_WARN(playerImpleLog, "Fading sample to " << ((float) (FADEIN_MS-(fadeinms - (float)fadecounter*mspersample)) / (float) FADEIN_MS) << " since " << (gint64) (startms + ((float) i * mspersample) + FADEIN_MS/2) << " > " << p->mPlayingStartms);
-                data[i] = (short)(data[i] * ((float) (FADEIN_MS-(fadeinms - (float)fadecounter*mspersample)) / (float) FADEIN_MS));
+                float gain = (float) (FADEIN_MS-(fadeinms - (float)fadecounter*mspersample)) / (float) FADEIN_MS;
+                if(isFloat) fdata[i] *= gain;
+                else data[i] = (short)(data[i] * gain);
                 fadecounter++;
             }
         }
@@ -1421,38 +2503,20 @@ gboolean cb_data_probe (GstPad *pad, GstBuffer *buffer, gpointer player_object)
     }
 #endif
 
-    if(p->mPlayingms > p->mPlayingStopms // If we have played past the current segment
+    // The stop is normally handled by stop_time_callback when it is heard,
+    // until that is scheduled (e.g. right after a seek) it is found here
+    bool pastStop = p->mPlayingms > p->mPlayingStopms // If we have played past the current segment
             && !p->mPlayingWaiting            // and we haven't yet called the continue callback
-            //&& p->mOpentime != time(NULL)     // and opentime isn't now
-            && !p->bMutePlayback              // and we arent't in mute mode
-      ) {
-        //Sometimes there is a delayed input making the cases below send us extra next commands. These will then make the reader leave out
-        //beginning of sentences. Workaround is to check the goal state (p-getState()) and make sure we want it to be playing and sending
-        //these commands. However, this needs robust testing.
-        if(p->getState() != PLAYING){
-            p->unlockMutex(p->dataMutex);
-            return true;
-        }
+            && !p->bMutePlayback;             // and we arent't in mute mode
+    if(pastStop && p->mStopId == NULL) p->segmentStop();
 
-        if((p->position + 760 * GST_MSECOND) > p->duration) // Check that we aren't almost the very end of the current file
-        {
-            LOG4CXX_INFO(playerImplLog, "not calling continue callback at end of file " << p->position/GST_MSECOND << "/" << p->duration/GST_MSECOND);
-            p->unlockMutex(p->dataMutex);
-        } else {
-
-            p->unlockMutex(p->dataMutex);
-            if(p->sendCONTSignal()) {
-                LOG4CXX_INFO(playerImplLog, "Continuing playback at: " << p->mPlayingms);
-                return TRUE;
-            } else {
-                LOG4CXX_INFO(playerImplLog, "Starting to mute buffers");
-                p->bMutePlayback = true;
-            }
-        }
-    }
+    // Audio after the stop stays silent until the application answers.
+    // A staged segment continues from here, usually without a seek when
+    // it follows on, so its start must not be silenced.
+    bool mute = p->bMutePlayback ||
+        (pastStop && !p->bNextStaged && p->mContinuePolicy != Player::CONTINUE_PLAY);
 
-
-    if(p->bMutePlayback) {
+    if(mute) {
         //int size =  GST_BUFFER_SIZE(buffer);
         LOG4CXX_INFO(playerImplLog, "Muting buffer");
 
@@ -1471,16 +2535,50 @@ gboolean cb_data_probe (GstPad *pad, GstBuffer *buffer, gpointer player_object)
 
 static gboolean cb_event_probe (GstPad *pad, GstEvent *event, gpointer player_object)
 {
-    //Player *p = (Player *)player_object;
+    PlayerImpl *p = (PlayerImpl *)player_object;
     if(GST_EVENT_TYPE(event) == GST_EVENT_QOS) {
         gdouble proportion;
         GstClockTimeDiff diff;
         GstClockTime timestamp;
         gst_event_parse_qos(event, &proportion, &diff, &timestamp);
+        p->metrics.count(PlayerMetrics::QOS_EVENTS);
+        p->trace.instant("streaming", "qos", diff / GST_MSECOND);
+
+        // A positive diff means the buffer arrived late at the sink
+        if(diff > 0) {
+            p->lockMutex(p->dataMutex);
+            p->mQosLateEvents++;
+            if(diff > p->mQosLateness) p->mQosLateness = diff;
+            p->unlockMutex(p->dataMutex);
+        }
 
         LOG4CXX_DEBUG(playerImplLog, "Got QOS event proportion: " << proportion << ", diff " << diff << ", timestamp " << timestamp);
 
 
+    } else if(GST_EVENT_TYPE(event) == GST_EVENT_NEWSEGMENT) {
+        // Follow the segment of the sink, buffers are played at its running time
+        gboolean update;
+        gdouble rate, appliedRate;
+        GstFormat format;
+        gint64 start, stop, position;
+        gst_event_parse_new_segment_full(event, &update, &rate, &appliedRate, &format, &start, &stop, &position);
+        if(format == GST_FORMAT_TIME)
+            gst_segment_set_newsegment_full(&p->mSinkSegment, update, rate, appliedRate, format, start, stop, position);
+
+        // The stretcher starts a new segment at file position / tempo
+        if(format == GST_FORMAT_TIME && !update) {
+            p->lockMutex(p->dataMutex);
+            double tempo = p->mPlayingTempo;
+            p->unlockMutex(p->dataMutex);
+            p->timeMap.reset(tempo);
+        }
+        LOG4CXX_DEBUG(playerImplLog, "Got event " << gst_event_type_get_name(GST_EVENT_TYPE(event)));
+
+    } else if(GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP) {
+        gst_segment_init(&p->mSinkSegment, GST_FORMAT_TIME);
+        p->positionClock.flush();
+        LOG4CXX_DEBUG(playerImplLog, "Got event " << gst_event_type_get_name(GST_EVENT_TYPE(event)));
+
     } else LOG4CXX_DEBUG(playerImplLog, "Got event " << gst_event_type_get_name(GST_EVENT_TYPE(event)));
 
 
@@ -1488,6 +2586,51 @@ static gboolean cb_event_probe (GstPad *pad, GstEvent *event, gpointer player_ob
     return TRUE;
 }
 
+/**
+ * Gstreamer callback for elements added to autoaudiosink, enables QOS
+ * on the real sink and applies the buffer-time of the quality tier
+ *
+ * @param bin autoaudiosink
+ * @param element the sink it created
+ * @param player_object PlayerImpl
+ */
+static void cb_sink_added (GstBin *bin, GstElement *element, gpointer player_object)
+{
+    PlayerImpl *p = (PlayerImpl *)player_object;
+    GObjectClass *klass = G_OBJECT_GET_CLASS(element);
+
+    if(g_object_class_find_property(klass, "qos"))
+        g_object_set(element, "qos", TRUE, NULL);
+
+    // Added when the pipeline is set up, the player thread doesn't hold dataMutex then
+    p->lockMutex(p->dataMutex);
+    Player::qualityTier tier = p->mQualityTier;
+    bool lowMemory = p->mLowMemory;
+    p->unlockMutex(p->dataMutex);
+
+    // A minimal quality tier means the device can't keep up, the larger buffer wins over the low-memory one
+    if(tier == Player::QUALITY_MINIMAL && g_object_class_find_property(klass, "buffer-time")) {
+        LOG4CXX_INFO(playerImplLog, "Using sink buffer-time " << QOS_SINK_BUFFER_TIME / 1000 << " ms");
+        g_object_set(element, "buffer-time", (gint64)QOS_SINK_BUFFER_TIME, NULL);
+    } else if(lowMemory && g_object_class_find_property(klass, "buffer-time")) {
+        LOG4CXX_INFO(playerImplLog, "Using sink buffer-time " << LOWMEM_SINK_BUFFER_TIME / 1000 << " ms");
+        g_object_set(element, "buffer-time", (gint64)LOWMEM_SINK_BUFFER_TIME, NULL);
+    }
+}
+
+/**
+ * Gstreamer callback for caps negotiated on the pads getFormats reports
+ *
+ * @param pad the pad
+ * @param pspec the caps property
+ * @param player_object PlayerImpl
+ */
+static void cb_caps_notify (GObject *pad, GParamSpec *pspec, gpointer player_object)
+{
+    PlayerImpl *p = (PlayerImpl *)player_object;
+    p->updateFormats();
+}
+
 /**
  * Gstreamer callback for linking two GstPads
  *
@@ -1502,17 +2645,47 @@ static void dynamic_link (GstPadTemplate * templ, GstPad * newpad, gpointer data
     gst_pad_link (newpad, target);
 }
 
+/**
+ * Gstreamer callback for linking the first audio pad of a demuxer.
+ * Containers like mp4 also carry cover art and chapter text streams,
+ * those pads are left unlinked.
+ *
+ * @param element The demuxer
+ * @param newpad The sourcepad
+ * @param data The targetpad
+ */
+static void dynamic_link_audio (GstElement *element, GstPad *newpad, gpointer data)
+{
+    GstPad *target = (GstPad *) data;
+    GstCaps *caps = gst_pad_get_caps(newpad);
+    string mime = "unknown";
+    if(caps != NULL && gst_caps_get_size(caps) > 0) mime = gst_structure_get_name(gst_caps_get_structure(caps, 0));
+    if(caps != NULL) gst_caps_unref(caps);
+
+    if(mime.substr(0, 6) != "audio/" || gst_pad_is_linked(target)) {
+        LOG4CXX_DEBUG(playerImplLog, "Ignoring '" << mime << "' pad of '" << gst_element_get_name(element) << "'");
+        return;
+    }
+
+    LOG4CXX_DEBUG(playerImplLog, "Linking '" << mime << "' pad of '" << gst_element_get_name(element) << "' and '" << gst_element_get_name(gst_pad_get_parent(target)) << "'");
+    gst_pad_link (newpad, target);
+}
+
 /**
  * Creates a source pipeline, for either http, https or file data source
  *
+ * @param bin bin to add the elements to
+ * @param location URL or path of the file
+ * @param source receives the source element
+ * @param queue receives the buffering queue, if any
  * @return last element to link against
  */
-GstElement *PlayerImpl::setupDatasource(GstBin *bin)
+GstElement *PlayerImpl::setupDatasource(GstBin *bin, string location, GstElement **source, GstElement **queue)
 {
     enum { http, https, file } sourcetype;
 
     // Get the filename
-    string filename = mPlayingFilename;
+    string filename = location;
 
     // Remove leading and trailing whitespaces
     static const char whitespace[] = " \n\t\v\r\f";
@@ -1535,65 +2708,79 @@ GstElement *PlayerImpl::setupDatasource(GstBin *bin)
     // Get the useragent string
     string useragent = getUseragent();
     bool debugmode = getDebugmode();
+    bool lowmemory = getLowMemory();
 
     // Setup the datasource depending on the sorucetype
     switch(sourcetype) {
         case http:
         case https:
-            pDatasource = gst_element_factory_make("souphttpsrc", "pDatasource");
-            if (pDatasource != NULL)
+            *source = gst_element_factory_make("souphttpsrc", "pDatasource");
+            if (*source != NULL)
             {
-                g_object_set(pDatasource, "location", mPlayingFilename.c_str(), NULL);
-                g_object_set(pDatasource, "timeout", 5, NULL);
-                g_object_set(pDatasource, "user-agent", useragent.c_str(), NULL);
-                if(debugmode) g_object_set(pDatasource, "soup-http-debug", 1, NULL);
+                g_object_set(*source, "location", location.c_str(), NULL);
+                g_object_set(*source, "timeout", 5, NULL);
+                g_object_set(*source, "user-agent", useragent.c_str(), NULL);
+                if(debugmode) g_object_set(*source, "soup-http-debug", 1, NULL);
             }
 
 #ifdef BUFFERED_STREAMING
-            pQueue2 = gst_element_factory_make("queue2", "pQueue2");
-            if (pQueue2 != NULL)
+            *queue = gst_element_factory_make("queue2", "pQueue2");
+            if (*queue != NULL)
             {
-                // setup queue2 element to keep 10MB data in memory
-                g_object_set(pQueue2, "max-size-buffers", 0, NULL); // disable buffers
-                g_object_set(pQueue2, "max-size-bytes", 10485760, NULL); // 10MB
-                g_object_set(pQueue2, "max-size-time", 0, NULL); // disable time buffer
+                // setup queue2 element to keep 10MB data in memory, 512kB in the low-memory profile
+                g_object_set(*queue, "max-size-buffers", 0, NULL); // disable buffers
+                g_object_set(*queue, "max-size-bytes", lowmemory ? LOWMEM_STREAM_QUEUE_BYTES : STREAM_QUEUE_BYTES, NULL);
+                g_object_set(*queue, "max-size-time", 0, NULL); // disable time buffer
             }
-            if(!pDatasource || !pQueue2) goto fail_http;
+            if(!*source || !*queue) goto fail_http;
 
-            gst_bin_add(bin, pDatasource);
-            gst_bin_add(bin, pQueue2);
-            gst_element_link(pDatasource, pQueue2);
+            gst_bin_add(bin, *source);
+            gst_bin_add(bin, *queue);
+            gst_element_link(*source, *queue);
 
-            return pQueue2;
+            return *queue;
 #else
-            if(!pDatasource) goto fail_http;
+            if(!*source) goto fail_http;
 
-            gst_bin_add(bin, pDatasource);
+            gst_bin_add(bin, *source);
 
-            return pDatasource;
+            return *source;
 #endif
 
         default:
-            pDatasource = gst_element_factory_make("filesrc", "pDatasource");
-            if (pDatasource != NULL)
+#ifdef ENABLE_MMAPSRC
+            // Zero-copy reads through mappings of the file, filesrc if unavailable
+            // or if the file is empty, not a regular file or can not be mapped
+            *source = NULL;
+            if (mmapsrc_can_map(location.c_str()))
+                *source = gst_element_factory_make("kolibremmapsrc", "pDatasource");
+            if (*source == NULL)
+#endif
+            *source = gst_element_factory_make("filesrc", "pDatasource");
+            if (*source != NULL)
             {
-                g_object_set(pDatasource, "location", mPlayingFilename.c_str(), NULL);
+                g_object_set(*source, "location", location.c_str(), NULL);
+#ifdef ENABLE_MMAPSRC
+                // Keep fewer pages of the file mapped
+                if(lowmemory && g_object_class_find_property(G_OBJECT_GET_CLASS(*source), "keep-behind"))
+                    g_object_set(*source, "readahead", LOWMEM_READAHEAD, "keep-behind", LOWMEM_KEEP_BEHIND, NULL);
+#endif
             }
-            if (!pDatasource) goto fail_file;
+            if (!*source) goto fail_file;
 
-            gst_bin_add(bin, pDatasource);
+            gst_bin_add(bin, *source);
 
-            return pDatasource;
+            return *source;
     }
 
 fail_file:
-    LOG4CXX_ERROR(playerImplLog, "filesrc:        " << (pDatasource ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "filesrc:        " << (*source ? "OK" : "failed"));
     return NULL;
 
 fail_http:
-    LOG4CXX_ERROR(playerImplLog, "souphttpsrc:    " << (pDatasource ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "souphttpsrc:    " << (*source ? "OK" : "failed"));
 #ifdef BUFFERED_STREAMING
-    LOG4CXX_ERROR(playerImplLog, "queue2:         " << (pQueue2 ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "queue2:         " << (*queue ? "OK" : "failed"));
 #endif
     return NULL;
 }
@@ -1601,7 +2788,7 @@ fail_http:
 
 #ifdef ENABLE_EQUALIZER
 /**
- * Sets up the 10 band equalizer based on the bass and treble gain values
+ * Sets the bass and treble shelves of a kolibredsp element
  *
  * @return null
  */
@@ -1610,54 +2797,84 @@ void PlayerImpl::setEqualizer(GstElement *element, double bass, double treble)
     if(element == NULL)
         LOG4CXX_ERROR(playerImplLog, "setEqualizer element was NULL");
 
+    // A flat response lets the filters be skipped
+    if(mQualityTier != Player::QUALITY_FULL) {
+        g_object_set(element, "bass", 0.0, "treble", 0.0, NULL);
+        return;
+    }
+
     g_object_set(element,
-            "band0",    bass * (4.0 * 0.25) + 0.3,
-            "band1",    bass * (3.0 * 0.25) + 0.3,
-            "band2",    bass * (2.0 * 0.25) + 0.3,
-            "band3",    bass * (1.0 * 0.25) + 0.3,
-            "band4",  treble * (1.0 * 0.166) + 0.3,
-            "band5",  treble * (2.0 * 0.166) + 0.3,
-            "band6",  treble * (3.0 * 0.166) + 0.3,
-            "band7",  treble * (4.0 * 0.166) + 0.3,
-            "band8",  treble * (5.0 * 0.166) + 0.3,
-            "band9",  treble * (6.0 * 0.166) + 0.3, NULL);
+            "bass",     bass / PLAYER_MAX_BASS * EQUALIZER_MAX_DB,
+            "treble", treble / PLAYER_MAX_TREBLE * EQUALIZER_MAX_DB, NULL);
 }
 #endif
 
 /**
  * Creates an audio processing pipeline, tempo, amplify, compressor and sink elements
  *
+ * The whole chain runs in one sample format, picked here from what the
+ * decoder outputs. pAudioconvert1 only converts when the decoder output
+ * differs from it, pAudioconvert2 at the end only when the sink doesn't
+ * accept it, so each buffer is converted at most once on the way.
+ *
+ * @param bin pipeline to add the elements to
+ * @param decoderFormat caps the decoder outputs, FORMAT_ANY if not known
  * @return first element to link against
  */
-GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
+GstElement *PlayerImpl::setupPostprocessing(GstBin *bin, const char *decoderFormat)
 {
     GstPad *pad;
+    GstCaps *caps;
 
     pAudioconvert1 = gst_element_factory_make("audioconvert", "pAudioconvert1");
+    pCapsfilter = gst_element_factory_make("capsfilter", "pCapsfilter");
 #ifdef ENABLE_PITCH
+#ifdef ENABLE_WSOLA
+    pPitch = gst_element_factory_make("kolibrewsola", "pPitch");
+#else
     pPitch = gst_element_factory_make("pitch", "pPitch");
+#endif
+    // Keep a reference of our own since linkPitch moves pPitch in and out of the bin
+    if(pPitch != NULL) {
+        gst_object_ref(pPitch);
+        gst_object_sink(pPitch);
+    }
 #endif
 #ifdef ENABLE_AMPLIFY
     pLevel = gst_element_factory_make("level", "pLevel");
+#ifdef ENABLE_DSP
+    // Volume, equalizer and fade-in in one element
+    pAmplify = gst_element_factory_make("kolibredsp", "pAmplify");
+#else
     pAmplify = gst_element_factory_make("audioamplify", "pAmplify");
 #endif
+#endif
 #ifdef ENABLE_EQUALIZER
-    pEqualizer = gst_element_factory_make("equalizer-10bands", "pEqualizer");
+#ifdef ENABLE_DSP
+    pEqualizer = pAmplify;
+#else
+    pEqualizer = gst_element_factory_make("kolibredsp", "pEqualizer");
 #endif
+#endif
+    pSilence = gst_element_factory_make("kolibresilence", "pSilence");
     pAudioconvert2 = gst_element_factory_make("audioconvert", "pAudioconvert2");
 
 
 #ifdef WIN32
     pAudiosink = gst_element_factory_make("directsoundsink", "pAudiosink");
     g_object_set (pAudiosink, "buffer-time", (gint64)500000, NULL);
+    cb_sink_added(NULL, pAudiosink, this);
     //g_object_set (pAudiosink, "slave-method", (gint64)1, NULL); // skew
     //g_object_set (pAudiosink, "preroll-queue-len", (gint64)50, NULL); // playback sometimes does not start
     //g_object_set (pAudiosink, "max-lateness", (gint64)10 * GST_MSECOND, NULL); // no effect?
 #else
     pAudiosink = gst_element_factory_make("autoaudiosink", "pAudiosink");
+    if(pAudiosink != NULL)
+        g_signal_connect(pAudiosink, "element-added", G_CALLBACK(cb_sink_added), this);
 #endif
     // Check that the elements got set up
     if (!pAudioconvert1 ||
+            !pCapsfilter    ||
 #ifdef ENABLE_PITCH
             !pPitch         ||
 #endif
@@ -1665,6 +2882,7 @@ GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
 #ifdef ENABLE_EQUALIZER
             !pEqualizer     ||
 #endif
+            !pSilence       ||
 #ifdef ENABLE_AMPLIFY
             !pLevel         ||
             !pAmplify       ||
@@ -1674,12 +2892,11 @@ GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
 
     // Add the elements to the bin
     gst_bin_add_many (bin, pAudioconvert1,
-#ifdef ENABLE_PITCH
-            pPitch,
-#endif
-#ifdef ENABLE_EQUALIZER
+            pCapsfilter,
+#if defined(ENABLE_EQUALIZER) && !defined(ENABLE_DSP)
             pEqualizer,
 #endif
+            pSilence,
             pAudioconvert2,
 #ifdef ENABLE_AMPLIFY
             pLevel,
@@ -1687,6 +2904,14 @@ GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
 #endif
             pAudiosink, NULL);
 
+#if defined(ENABLE_PITCH) && !defined(ENABLE_WSOLA)
+    // soundtouch only works in float, convert once before it instead of around it
+    decoderFormat = FORMAT_FLOAT32;
+#endif
+    caps = gst_caps_from_string(decoderFormat);
+    g_object_set(pCapsfilter, "caps", caps, NULL);
+    gst_caps_unref(caps);
+
 #ifdef ENABLE_PITCH
     mPlayingTempo = mTempo;
     g_object_set(pPitch, "tempo", mPlayingTempo, NULL);
@@ -1695,6 +2920,8 @@ GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
     g_object_set(pPitch, "pitch", mPlayingPitch, NULL);
 #endif
 
+    g_object_set(pSilence, "enabled", mSilenceCompression, NULL);
+
 #ifdef ENABLE_EQUALIZER
     mPlayingBass = mBass;
     mPlayingTreble = mTreble;
@@ -1705,6 +2932,7 @@ GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
     g_object_set(pLevel, "peak-ttl", levelPeakttl, NULL);
     g_object_set(pLevel, "interval", levelInterval, NULL);
     g_object_set(pLevel, "peak-falloff", levelPeakfalloff, NULL);
+    g_object_set(pLevel, "message", mQualityTier == Player::QUALITY_FULL, NULL);
 
     mPlayingVolumeGain = mVolumeGain;
     g_object_set(pAmplify, "amplification", mPlayingVolume*mPlayingVolumeGain, NULL);
@@ -1720,24 +2948,51 @@ GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
     //g_object_set(pAudiosink, "provide-clock", TRUE, NULL);
 
     // Link the elements
-    if(!gst_element_link_many (pAudioconvert1,
-#ifdef ENABLE_PITCH
-            pPitch,
+    if(!gst_element_link(pAudioconvert1, pCapsfilter)) goto fail;
+    if(!gst_element_link_many (
+#ifndef ENABLE_PITCH
+                pCapsfilter,
 #endif
-#ifdef ENABLE_EQUALIZER
+#if defined(ENABLE_EQUALIZER) && !defined(ENABLE_DSP)
                 pEqualizer,
 #endif
-                pAudioconvert2,
+                pSilence,
 #ifdef ENABLE_AMPLIFY
                 pLevel, pAmplify,
 #endif
+                pAudioconvert2,
                 pAudiosink, NULL)) goto fail;
 
+#ifdef ENABLE_PITCH
+#ifdef ENABLE_WSOLA
+    // The built-in stretcher copies the audio through at neutral settings,
+    // it stays in the chain so tempo and pitch can change while playing
+    if(!linkPitch(false)) goto fail;
+#else
+    // Leave out the pitch element when it wouldn't change anything
+    if(!linkPitch(mPlayingTempo == 1.0 && mPlayingPitch == 1.0)) goto fail;
+#endif
+#endif
+
+    // Keep track of the formats for getFormats
+    pad = gst_element_get_static_pad(pAudioconvert1, "sink");
+    g_signal_connect(pad, "notify::caps", G_CALLBACK(cb_caps_notify), this);
+    gst_object_unref(pad);
+    pad = gst_element_get_static_pad(pCapsfilter, "src");
+    g_signal_connect(pad, "notify::caps", G_CALLBACK(cb_caps_notify), this);
+    gst_object_unref(pad);
+    pad = gst_element_get_static_pad(pAudioconvert2, "src");
+    g_signal_connect(pad, "notify::caps", G_CALLBACK(cb_caps_notify), this);
+    gst_object_unref(pad);
 
     // Add a data probe
     pad = gst_element_get_pad (pAudiosink, "sink");
     gst_pad_add_buffer_probe (pad, G_CALLBACK (cb_data_probe), this);
     gst_pad_add_event_probe (pad, G_CALLBACK (cb_event_probe), this);
+
+    // Serve the buffers allocated by the postprocessing chain from the pool
+    bufferPool.setMaxBytes(getLowMemory() ? POOL_LOWMEM_MAX_BYTES : POOL_MAX_BYTES);
+    bufferPool.attach(pad);
     gst_object_unref (pad);
 
     // Return the first element in this chain
@@ -1745,12 +3000,14 @@ GstElement *PlayerImpl::setupPostprocessing(GstBin *bin)
 
 fail:
     LOG4CXX_ERROR(playerImplLog, "audioconvert1:  " << (pAudioconvert1 ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "capsfilter:     " << (pCapsfilter ? "OK" : "failed"));
 #ifdef ENABLE_PITCH
     LOG4CXX_ERROR(playerImplLog, "pitch:          " << (pPitch ? "OK" : "failed"));
 #endif
 #ifdef ENABLE_EQUALIZER
     LOG4CXX_ERROR(playerImplLog, "equalizer:      " << (pEqualizer ? "OK" : "failed"));
 #endif
+    LOG4CXX_ERROR(playerImplLog, "silence:        " << (pSilence ? "OK" : "failed"));
     LOG4CXX_ERROR(playerImplLog, "audioconvert2:  " << (pAudioconvert2 ? "OK" : "failed"));
 #ifdef ENABLE_AMPLIFY
     LOG4CXX_ERROR(playerImplLog, "level:          " << (pLevel ? "OK" : "failed"));
@@ -1761,13 +3018,299 @@ fail:
     return NULL;
 }
 
+#ifdef ENABLE_PITCH
+/**
+ * Link pCapsfilter to the rest of the postprocessing chain, through
+ * pPitch or past it. Used when setting up the chain and from
+ * cb_pitch_blocked while the pad is blocked.
+ *
+ * @param bypass true to leave pPitch out of the chain
+ * @return true if the elements were linked
+ */
+bool PlayerImpl::linkPitch(bool bypass)
+{
+#if defined(ENABLE_EQUALIZER) && !defined(ENABLE_DSP)
+    GstElement *next = pEqualizer;
+#else
+    GstElement *next = pSilence;
+#endif
+    GstBin *bin = GST_BIN(pPipeline);
+    bool linked;
+
+    // Take out the current links
+    if(GST_OBJECT_PARENT(pPitch) != NULL) {
+        gst_element_unlink_many(pCapsfilter, pPitch, next, NULL);
+        gst_element_set_state(pPitch, GST_STATE_NULL);
+        gst_bin_remove(bin, pPitch);
+    } else {
+        gst_element_unlink(pCapsfilter, next);
+    }
+
+    if(bypass) {
+        linked = gst_element_link(pCapsfilter, next);
+    } else {
+        gst_bin_add(bin, pPitch);
+        gst_element_sync_state_with_parent(pPitch);
+        linked = gst_element_link_many(pCapsfilter, pPitch, next, NULL);
+    }
+
+    LOG4CXX_DEBUG(playerImplLog, "Pitch element " << (bypass ? "bypassed" : "linked"));
+    g_atomic_int_set(&bPitchBypassed, bypass);
+    return linked;
+}
+
+/**
+ * Gstreamer callback for the blocked pCapsfilter src pad, switches the
+ * pitch element in or out while no data is flowing
+ *
+ * @param pad pCapsfilter src pad
+ * @param blocked true when the pad got blocked
+ * @param player_object PlayerImpl
+ */
+static void cb_pitch_blocked (GstPad *pad, gboolean blocked, gpointer player_object)
+{
+    PlayerImpl *p = (PlayerImpl *)player_object;
+    if(!blocked) return;
+
+    // Claim the relink before touching the links, unless the player thread cancelled it
+    if(g_atomic_int_compare_and_exchange(&p->mPitchRelink, PITCH_RELINK_PENDING, PITCH_RELINK_CLAIMED)) {
+        p->trace.begin("streaming", "pitch relink");
+        if(!p->linkPitch(!g_atomic_int_get(&p->bPitchBypassed)))
+            LOG4CXX_ERROR(playerImplLog, "Failed to relink pitch element");
+        g_atomic_int_set(&p->mPitchRelink, PITCH_RELINK_DONE);
+        p->trace.end("streaming", "pitch relink");
+    }
+
+    gst_pad_set_blocked_async(pad, FALSE, cb_pitch_blocked, p);
+}
+
+/**
+ * Bypass the pitch element at neutral tempo and pitch and put it back
+ * when they change, called from the player thread on every loop while
+ * playing.
+ *
+ * The relink is asked for on one loop and done by cb_pitch_blocked in the
+ * streaming thread, a later loop picks up the result without the player
+ * thread waiting for it. If no data flows the request is cancelled after
+ * a timeout, but only before the callback has claimed it; a claimed relink
+ * is always waited for. The pitch element scales timestamps by the tempo,
+ * so after a relink a flushing seek gives the new chain a fresh segment.
+ * It goes to the audible position, the audio queued at the sink is played
+ * again rather than skipped.
+ */
+void PlayerImpl::updatePitchBypass()
+{
+    if(pPitch == NULL || pCapsfilter == NULL) return;
+
+    switch(g_atomic_int_get(&mPitchRelink))
+    {
+        case PITCH_RELINK_NONE:
+            {
+                // The tempo and pitch applied to pPitch, which toSeekTime scales by too
+                lockMutex(dataMutex);
+                bool bypass = (mPlayingTempo == 1.0 && mPlayingPitch == 1.0);
+                unlockMutex(dataMutex);
+                if(bypass == (g_atomic_int_get(&bPitchBypassed) != 0)) return;
+
+                LOG4CXX_INFO(playerImplLog, (bypass ? "Bypassing" : "Inserting") << " pitch element");
+                GstPad *pad = gst_element_get_static_pad(pCapsfilter, "src");
+                g_atomic_int_set(&mPitchRelink, PITCH_RELINK_PENDING);
+                mPitchBlockedAt = gst_util_get_timestamp();
+                gst_pad_set_blocked_async(pad, TRUE, cb_pitch_blocked, this);
+                gst_object_unref(pad);
+                return;
+            }
+
+        case PITCH_RELINK_PENDING:
+            // Don't leave the pad blocked, a flushing seek can't pass it
+            if(gst_util_get_timestamp() - mPitchBlockedAt > PITCH_RELINK_TIMEOUT_MS * GST_MSECOND &&
+                    g_atomic_int_compare_and_exchange(&mPitchRelink, PITCH_RELINK_PENDING, PITCH_RELINK_NONE)) {
+                LOG4CXX_WARN(playerImplLog, "No data flowing, pitch element not relinked");
+                GstPad *pad = gst_element_get_static_pad(pCapsfilter, "src");
+                gst_pad_set_blocked(pad, FALSE);
+                gst_object_unref(pad);
+            }
+            return;
+
+        case PITCH_RELINK_CLAIMED:
+            return;
+
+        default:
+            break;
+    }
+
+    // Relinked, seek whether or not the timeout had passed meanwhile
+    g_atomic_int_set(&mPitchRelink, PITCH_RELINK_NONE);
+
+    lockMutex(dataMutex);
+    gint64 audible = positionClock.position();
+    gint64 c_seektime = toSeekTime(audible > 0 ? audible / GST_MSECOND : mPlayingms);
+    bFadeIn = true;
+    unlockMutex(dataMutex);
+
+    metrics.start(PlayerMetrics::SEEK_LATENCY);
+    if (!gst_element_seek_simple (pPipeline, GST_FORMAT_TIME, (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE), c_seektime))
+        LOG4CXX_ERROR(playerImplLog, "Seek after pitch relink failed");
+
+    if ( GST_STATE_CHANGE_ASYNC == gst_element_get_state( pPipeline, NULL, NULL, 0 ) ){
+        lockMutex(dataMutex);
+        bWaitAsync = true;
+        unlockMutex(dataMutex);
+    }
+}
+#endif
+
 /**
  * Creates an aac pipeline
  *
  * @return bOk if ok
  */
-bool PlayerImpl::setupAACPipeline()
+bool PlayerImpl::setupAACPipeline()
+{
+    GstElement *datasource = NULL;
+    GstElement *postprocessing = NULL;
+
+    // Create the pipeline
+    pPipeline = gst_element_factory_make("pipeline", "pPipeline");
+    pBus = gst_element_get_bus (GST_ELEMENT (pPipeline));
+
+    if(!pPipeline) goto fail;
+
+    // Setup datasource
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
+
+    // Setup decoding
+    pFaaddec = gst_element_factory_make("faad", "pFaaddec");
+    gst_bin_add(GST_BIN(pPipeline), pFaaddec);
+
+    // Setup postprocessing
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_INT16);
+
+    if (!datasource ||
+            !pFaaddec ||
+            !postprocessing) goto fail;
+
+    // Add the elements to the pPipeline
+    gst_element_link_many(datasource, pFaaddec, postprocessing, NULL);
+
+    // We should now have the pipeline setup
+    return bOk;
+
+fail:
+    LOG4CXX_ERROR(playerImplLog, "faaddec:        " << (pFaaddec ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "pipeline:       " << (pPipeline ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "Internal error, please check your GStreamer installation.");
+
+    destroyPipeline();
+    return bError;
+}
+
+/**
+ * Creates an wav pipeline
+ *
+ * @return bOk if ok
+ */
+bool PlayerImpl::setupWAVPipeline()
+{
+    GstPad *pad;
+    GstElement *datasource = NULL;
+    GstElement *postprocessing = NULL;
+
+    // Create the pipeline
+    pPipeline = gst_element_factory_make("pipeline", "pPipeline");
+    pBus = gst_element_get_bus (GST_ELEMENT (pPipeline));
+
+    if(!pPipeline) goto fail;
+
+    // Setup datasource
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
+
+    // Setup decoding
+    pWavparse = gst_element_factory_make("wavparse", "pWavparse");
+    gst_bin_add(GST_BIN(pPipeline), pWavparse);
+
+    // Setup postprocessing
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_INT16);
+
+
+    if (!datasource ||
+            !pWavparse ||
+            !postprocessing) goto fail;
+
+    // Add the elements to the pPipeline
+    gst_element_link_many(datasource, pWavparse, NULL);
+
+    // Setup dynamic link
+    pad = gst_element_get_pad(postprocessing, "sink");
+    g_signal_connect(G_OBJECT(pWavparse), "pad-added", G_CALLBACK(dynamic_link), pad);
+    gst_object_unref(pad);
+
+    // We should now have the pipeline setup
+    return bOk;
+
+fail:
+    LOG4CXX_ERROR(playerImplLog, "wavparse:       " << (pWavparse ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "pipeline:       " << (pPipeline ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "Internal error, please check your GStreamer installation.");
+    destroyPipeline();
+
+    return bError;
+}
+
+/**
+ * Creates an mp3 pipeline
+ *
+ * @return bOk if ok
+ */
+bool PlayerImpl::setupMP3Pipeline()
+{
+    GstElement *datasource = NULL;
+    GstElement *postprocessing = NULL;
+
+    // Create the pipeline
+    pPipeline = gst_element_factory_make("pipeline", "pPipeline");
+    pBus = gst_element_get_bus (GST_ELEMENT (pPipeline));
+
+    if(!pPipeline) goto fail;
+
+    // Setup datasource
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
+
+    // Setup decoding
+    pFlump3dec = gst_element_factory_make("flump3dec", "pFlump3dec");
+    gst_bin_add(GST_BIN(pPipeline), pFlump3dec);
+
+    // Setup postprocessing
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_INT16);
+
+
+    if (!datasource ||
+            !pFlump3dec ||
+            !postprocessing) goto fail;
+
+    // Add the elements to the pPipeline
+    gst_element_link_many(datasource, pFlump3dec, postprocessing, NULL);
+
+    // We should now have the pipeline setup
+    return bOk;
+
+fail:
+    LOG4CXX_ERROR(playerImplLog, "flump3dec:      " << (pFlump3dec ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "pipeline:       " << (pPipeline ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "Internal error, please check your GStreamer installation.");
+    destroyPipeline();
+
+    return bError;
+}
+
+/**
+ * Creates an ogg/vorbis pipeline
+ *
+ * @return bOk if ok
+ */
+bool PlayerImpl::setupOGGPipeline()
 {
+    GstPad *pad;
     GstElement *datasource = NULL;
     GstElement *postprocessing = NULL;
 
@@ -1778,42 +3321,50 @@ bool PlayerImpl::setupAACPipeline()
     if(!pPipeline) goto fail;
 
     // Setup datasource
-    datasource = setupDatasource(GST_BIN(pPipeline));
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
 
     // Setup decoding
-    pFaaddec = gst_element_factory_make("faad", "pFaaddec");
-    gst_bin_add(GST_BIN(pPipeline), pFaaddec);
+    pOggdemux = gst_element_factory_make("oggdemux", "pOggdemux");
+    pVorbisdec = gst_element_factory_make("vorbisdec", "pVorbisdec");
+    gst_bin_add_many(GST_BIN(pPipeline), pOggdemux, pVorbisdec, NULL);
 
     // Setup postprocessing
-    postprocessing = setupPostprocessing(GST_BIN(pPipeline));
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_FLOAT32);
 
-    if (!datasource ||
-            !pFaaddec ||
+    if (!datasource     ||
+            !pOggdemux      ||
+            !pVorbisdec     ||
             !postprocessing) goto fail;
 
-    // Add the elements to the pPipeline
-    gst_element_link_many(datasource, pFaaddec, postprocessing, NULL);
+    // Link the elements
+    if(!gst_element_link_many (pDatasource, pOggdemux, NULL)) goto fail;
+
+    // Setup dynamic link
+    pad = gst_element_get_pad(pVorbisdec, "sink");
+    g_signal_connect(G_OBJECT(pOggdemux), "pad-added", G_CALLBACK(dynamic_link), pad);
+    gst_object_unref(pad);
+
+    // Link the other elements
+    if(!gst_element_link_many (pVorbisdec, postprocessing, NULL)) goto fail;
 
-    // We should now have the pipeline setup
     return bOk;
 
 fail:
-    LOG4CXX_ERROR(playerImplLog, "faaddec:        " << (pFaaddec ? "OK" : "failed"));
-    LOG4CXX_ERROR(playerImplLog, "pipeline:       " << (pPipeline ? "OK" : "failed"));
-    LOG4CXX_ERROR(playerImplLog, "Internal error, please check your GStreamer installation.");
-
+    LOG4CXX_ERROR(playerImplLog, "%oggdemux:       " << (pOggdemux ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "%vorbisdec:      " << (pVorbisdec ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "%Internal error, please check your GStreamer installation.");
     destroyPipeline();
+
     return bError;
 }
 
 /**
- * Creates an wav pipeline
+ * Creates a flac pipeline
  *
  * @return bOk if ok
  */
-bool PlayerImpl::setupWAVPipeline()
+bool PlayerImpl::setupFLACPipeline()
 {
-    GstPad *pad;
     GstElement *datasource = NULL;
     GstElement *postprocessing = NULL;
 
@@ -1824,33 +3375,27 @@ bool PlayerImpl::setupWAVPipeline()
     if(!pPipeline) goto fail;
 
     // Setup datasource
-    datasource = setupDatasource(GST_BIN(pPipeline));
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
 
     // Setup decoding
-    pWavparse = gst_element_factory_make("wavparse", "pWavparse");
-    gst_bin_add(GST_BIN(pPipeline), pWavparse);
+    pFlacdec = gst_element_factory_make("flacdec", "pFlacdec");
+    gst_bin_add(GST_BIN(pPipeline), pFlacdec);
 
     // Setup postprocessing
-    postprocessing = setupPostprocessing(GST_BIN(pPipeline));
-
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_INT16);
 
     if (!datasource ||
-            !pWavparse ||
+            !pFlacdec ||
             !postprocessing) goto fail;
 
     // Add the elements to the pPipeline
-    gst_element_link_many(datasource, pWavparse, NULL);
-
-    // Setup dynamic link
-    pad = gst_element_get_pad(postprocessing, "sink");
-    g_signal_connect(G_OBJECT(pWavparse), "pad-added", G_CALLBACK(dynamic_link), pad);
-    gst_object_unref(pad);
+    if(!gst_element_link_many(datasource, pFlacdec, postprocessing, NULL)) goto fail;
 
     // We should now have the pipeline setup
     return bOk;
 
 fail:
-    LOG4CXX_ERROR(playerImplLog, "wavparse:       " << (pWavparse ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "flacdec:        " << (pFlacdec ? "OK" : "failed"));
     LOG4CXX_ERROR(playerImplLog, "pipeline:       " << (pPipeline ? "OK" : "failed"));
     LOG4CXX_ERROR(playerImplLog, "Internal error, please check your GStreamer installation.");
     destroyPipeline();
@@ -1859,12 +3404,13 @@ fail:
 }
 
 /**
- * Creates an mp3 pipeline
+ * Creates an ogg/opus pipeline
  *
  * @return bOk if ok
  */
-bool PlayerImpl::setupMP3Pipeline()
+bool PlayerImpl::setupOpusPipeline()
 {
+    GstPad *pad;
     GstElement *datasource = NULL;
     GstElement *postprocessing = NULL;
 
@@ -1875,29 +3421,37 @@ bool PlayerImpl::setupMP3Pipeline()
     if(!pPipeline) goto fail;
 
     // Setup datasource
-    datasource = setupDatasource(GST_BIN(pPipeline));
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
 
     // Setup decoding
-    pFlump3dec = gst_element_factory_make("flump3dec", "pFlump3dec");
-    gst_bin_add(GST_BIN(pPipeline), pFlump3dec);
+    pOggdemux = gst_element_factory_make("oggdemux", "pOggdemux");
+    pOpusdec = gst_element_factory_make("opusdec", "pOpusdec");
+    gst_bin_add_many(GST_BIN(pPipeline), pOggdemux, pOpusdec, NULL);
 
     // Setup postprocessing
-    postprocessing = setupPostprocessing(GST_BIN(pPipeline));
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_INT16);
 
-
-    if (!datasource ||
-            !pFlump3dec ||
+    if (!datasource     ||
+            !pOggdemux      ||
+            !pOpusdec       ||
             !postprocessing) goto fail;
 
-    // Add the elements to the pPipeline
-    gst_element_link_many(datasource, pFlump3dec, postprocessing, NULL);
+    // Link the elements
+    if(!gst_element_link_many (datasource, pOggdemux, NULL)) goto fail;
+
+    // Setup dynamic link
+    pad = gst_element_get_pad(pOpusdec, "sink");
+    g_signal_connect(G_OBJECT(pOggdemux), "pad-added", G_CALLBACK(dynamic_link_audio), pad);
+    gst_object_unref(pad);
+
+    // Link the other elements
+    if(!gst_element_link_many (pOpusdec, postprocessing, NULL)) goto fail;
 
-    // We should now have the pipeline setup
     return bOk;
 
 fail:
-    LOG4CXX_ERROR(playerImplLog, "flump3dec:      " << (pFlump3dec ? "OK" : "failed"));
-    LOG4CXX_ERROR(playerImplLog, "pipeline:       " << (pPipeline ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "oggdemux:       " << (pOggdemux ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "opusdec:        " << (pOpusdec ? "OK" : "failed"));
     LOG4CXX_ERROR(playerImplLog, "Internal error, please check your GStreamer installation.");
     destroyPipeline();
 
@@ -1905,11 +3459,11 @@ fail:
 }
 
 /**
- * Creates an ogg/vorbis pipeline
+ * Creates an mp4/m4a/m4b pipeline for aac audio
  *
  * @return bOk if ok
  */
-bool PlayerImpl::setupOGGPipeline()
+bool PlayerImpl::setupMP4Pipeline()
 {
     GstPad *pad;
     GstElement *datasource = NULL;
@@ -1922,43 +3476,65 @@ bool PlayerImpl::setupOGGPipeline()
     if(!pPipeline) goto fail;
 
     // Setup datasource
-    datasource = setupDatasource(GST_BIN(pPipeline));
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
 
     // Setup decoding
-    pOggdemux = gst_element_factory_make("oggdemux", "pOggdemux");
-    pVorbisdec = gst_element_factory_make("vorbisdec", "pVorbisdec");
-    gst_bin_add_many(GST_BIN(pPipeline), pOggdemux, pVorbisdec, NULL);
+    pQtdemux = gst_element_factory_make("qtdemux", "pQtdemux");
+    pFaaddec = gst_element_factory_make("faad", "pFaaddec");
+    gst_bin_add_many(GST_BIN(pPipeline), pQtdemux, pFaaddec, NULL);
 
     // Setup postprocessing
-    postprocessing = setupPostprocessing(GST_BIN(pPipeline));
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_INT16);
 
     if (!datasource     ||
-            !pOggdemux      ||
-            !pVorbisdec     ||
+            !pQtdemux       ||
+            !pFaaddec       ||
             !postprocessing) goto fail;
 
     // Link the elements
-    if(!gst_element_link_many (pDatasource, pOggdemux, NULL)) goto fail;
+    if(!gst_element_link_many (datasource, pQtdemux, NULL)) goto fail;
 
-    // Setup dynamic link
-    pad = gst_element_get_pad(pVorbisdec, "sink");
-    g_signal_connect(G_OBJECT(pOggdemux), "pad-added", G_CALLBACK(dynamic_link), pad);
+    // Setup dynamic link, skipping cover art and chapter streams
+    pad = gst_element_get_pad(pFaaddec, "sink");
+    g_signal_connect(G_OBJECT(pQtdemux), "pad-added", G_CALLBACK(dynamic_link_audio), pad);
     gst_object_unref(pad);
 
     // Link the other elements
-    if(!gst_element_link_many (pVorbisdec, postprocessing, NULL)) goto fail;
+    if(!gst_element_link_many (pFaaddec, postprocessing, NULL)) goto fail;
 
     return bOk;
 
 fail:
-    LOG4CXX_ERROR(playerImplLog, "%oggdemux:       " << (pOggdemux ? "OK" : "failed"));
-    LOG4CXX_ERROR(playerImplLog, "%vorbisdec:      " << (pVorbisdec ? "OK" : "failed"));
-    LOG4CXX_ERROR(playerImplLog, "%Internal error, please check your GStreamer installation.");
+    LOG4CXX_ERROR(playerImplLog, "qtdemux:        " << (pQtdemux ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "faaddec:        " << (pFaaddec ? "OK" : "failed"));
+    LOG4CXX_ERROR(playerImplLog, "Internal error, please check your GStreamer installation.");
     destroyPipeline();
 
     return bError;
 }
 
+/**
+ * Gstreamer callback for the format found by typefind in decodebin
+ *
+ * @param typefind the typefind element
+ * @param probability how sure typefind is
+ * @param caps the format found
+ * @param player_object PlayerImpl
+ */
+void cb_have_type (GstElement *typefind, guint probability, GstCaps *caps, gpointer player_object)
+{
+    PlayerImpl *p = (PlayerImpl *)player_object;
+    FormatSniffer::format format = FormatSniffer::fromCaps(caps);
+    if(format == FormatSniffer::FORMAT_UNKNOWN) return;
+
+    p->lockMutex(p->dataMutex);
+    string filename = p->mPlayingFilename;
+    p->unlockMutex(p->dataMutex);
+
+    LOG4CXX_DEBUG(playerImplLog, "Typefind found " << FormatSniffer::name(format) << " (" << probability << "%) in '" << filename << "'");
+    p->formatSniffer.remember(filename, format);
+}
+
 /**
  * Creates a decodebin pipeline
  *
@@ -1967,6 +3543,7 @@ fail:
 bool PlayerImpl::setupUnknownPipeline()
 {
     GstPad *pad;
+    GstElement *typefind;
     GstElement *datasource = NULL;
     GstElement *postprocessing = NULL;
 
@@ -1977,14 +3554,14 @@ bool PlayerImpl::setupUnknownPipeline()
     if(!pPipeline) goto fail;
 
     // Setup datasource
-    datasource = setupDatasource(GST_BIN(pPipeline));
+    datasource = setupDatasource(GST_BIN(pPipeline), mPlayingFilename, &pDatasource, &pQueue2);
 
     // Setup decoding
     pDecodebin = gst_element_factory_make("decodebin", "pDecodebin");
     gst_bin_add_many(GST_BIN(pPipeline), pDecodebin, NULL);
 
     // Setup postprocessing
-    postprocessing = setupPostprocessing(GST_BIN(pPipeline));
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_ANY);
 
     if (!datasource  ||
             !pDecodebin  ||
@@ -1999,6 +3576,13 @@ bool PlayerImpl::setupUnknownPipeline()
     g_signal_connect(G_OBJECT(pDecodebin), "pad-added", G_CALLBACK(dynamic_link), pad);
     gst_object_unref (pad);
 
+    // Remember what decodebin finds, so the next open can skip typefinding
+    typefind = gst_bin_get_by_name(GST_BIN(pDecodebin), "typefind");
+    if(typefind != NULL) {
+        g_signal_connect(G_OBJECT(typefind), "have-type", G_CALLBACK(cb_have_type), this);
+        gst_object_unref(typefind);
+    }
+
     return bOk;
 
 fail:
@@ -2010,6 +3594,172 @@ fail:
     return bError;
 }
 
+/**
+ * Gstreamer callback for decoded audio in the pause index pipeline
+ *
+ * @param sink fakesink
+ * @param buffer mono 16 bit samples
+ * @param pad fakesink sink pad
+ * @param builder_object pointer to a PauseIndex::Builder pointer, created on the first buffer
+ */
+static void cb_index_handoff (GstElement *sink, GstBuffer *buffer, GstPad *pad, gpointer builder_object)
+{
+    PauseIndex::Builder **builder = (PauseIndex::Builder **)builder_object;
+
+    if(*builder == NULL) {
+        gint rate = 0;
+        if(GST_BUFFER_CAPS(buffer) == NULL ||
+                !gst_structure_get_int(gst_caps_get_structure(GST_BUFFER_CAPS(buffer), 0), "rate", &rate)) return;
+        *builder = new PauseIndex::Builder(rate);
+    }
+
+    (*builder)->addSamples((const short *)GST_BUFFER_DATA(buffer), GST_BUFFER_SIZE(buffer) / sizeof(short));
+}
+
+/**
+ * Gstreamer sync handler of the pause index pipeline. Its tasks are given
+ * a thread pool of their own, and the threads lower their priority when
+ * they start streaming, so that playback is not slowed down. Threads of
+ * the shared pool would carry the lower priority into the playback
+ * pipeline, and it can't be raised again without privileges.
+ *
+ * @param bus the bus
+ * @param message the message
+ * @param pool GstTaskPool for the tasks
+ * @return GST_BUS_DROP for stream status messages
+ */
+static GstBusSyncReply cb_index_sync_message (GstBus *bus, GstMessage *message, gpointer pool)
+{
+    if(GST_MESSAGE_TYPE(message) != GST_MESSAGE_STREAM_STATUS) return GST_BUS_PASS;
+
+    GstStreamStatusType type;
+    GstElement *owner;
+    gst_message_parse_stream_status(message, &type, &owner);
+
+    if(type == GST_STREAM_STATUS_TYPE_CREATE) {
+        const GValue *value = gst_message_get_stream_status_object(message);
+        if(value != NULL && G_VALUE_TYPE(value) == GST_TYPE_TASK)
+            gst_task_set_pool(GST_TASK(g_value_get_object(value)), (GstTaskPool *)pool);
+    } else if(type == GST_STREAM_STATUS_TYPE_ENTER) {
+#ifdef __linux__
+        // Posted from the streaming thread, on Linux this sets the calling thread only
+        setpriority(PRIO_PROCESS, 0, 10);
+#endif
+    }
+
+    return GST_BUS_DROP;
+}
+
+/**
+ * Decode a file as fast as possible and store its energy in the pause index.
+ * Runs in the pause index thread with a pipeline of its own.
+ *
+ * @param url file to index
+ * @return bOk if ok
+ */
+bool PlayerImpl::indexFile(string url)
+{
+    GstElement *source = NULL, *queue = NULL, *datasource = NULL;
+    GstElement *pipeline, *decodebin, *convert, *sink;
+    PauseIndex::Builder *builder = NULL;
+    GstCaps *caps;
+    GstPad *pad;
+    bool done = false, ok = false;
+    GstClockTime started = gst_util_get_timestamp();
+
+    pipeline = gst_element_factory_make("pipeline", "pIndexPipeline");
+    decodebin = gst_element_factory_make("decodebin", "pIndexDecodebin");
+    convert = gst_element_factory_make("audioconvert", "pIndexAudioconvert");
+    sink = gst_element_factory_make("fakesink", "pIndexSink");
+    if(pipeline) datasource = setupDatasource(GST_BIN(pipeline), url, &source, &queue);
+
+    if(!pipeline || !datasource || !decodebin || !convert || !sink) {
+        LOG4CXX_ERROR(playerImplLog, "Could not create pause index pipeline");
+        if(decodebin) gst_object_unref(decodebin);
+        if(convert) gst_object_unref(convert);
+        if(sink) gst_object_unref(sink);
+        if(pipeline) gst_object_unref(pipeline);
+        return bError;
+    }
+
+    // Mono 16 bit at the decoded rate, as fast as the decoder goes
+    g_object_set(sink, "sync", FALSE, "signal-handoffs", TRUE, NULL);
+    g_signal_connect(sink, "handoff", G_CALLBACK(cb_index_handoff), &builder);
+
+    gst_bin_add_many(GST_BIN(pipeline), decodebin, convert, sink, NULL);
+    caps = gst_caps_new_simple("audio/x-raw-int",
+            "width", G_TYPE_INT, 16,
+            "depth", G_TYPE_INT, 16,
+            "signed", G_TYPE_BOOLEAN, TRUE,
+            "endianness", G_TYPE_INT, G_BYTE_ORDER,
+            "channels", G_TYPE_INT, 1, NULL);
+    if(!gst_element_link(datasource, decodebin) || !gst_element_link_filtered(convert, sink, caps)) {
+        LOG4CXX_ERROR(playerImplLog, "Could not link pause index pipeline");
+        gst_caps_unref(caps);
+        gst_object_unref(pipeline);
+        return bError;
+    }
+    gst_caps_unref(caps);
+
+    pad = gst_element_get_pad(convert, "sink");
+    g_signal_connect(G_OBJECT(decodebin), "pad-added", G_CALLBACK(dynamic_link), pad);
+    gst_object_unref(pad);
+
+    GstTaskPool *pool = gst_task_pool_new();
+    gst_task_pool_prepare(pool, NULL);
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    gst_bus_set_sync_handler(bus, cb_index_sync_message, pool);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    while(!done && !pauseIndex.isStopping()) {
+        GstMessage *message = gst_bus_timed_pop_filtered(bus, 500 * GST_MSECOND,
+                (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+        if(message == NULL) continue;
+
+        done = true;
+        ok = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+        gst_message_unref(message);
+    }
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_bus_set_sync_handler(bus, NULL, NULL);
+    gst_object_unref(bus);
+    gst_object_unref(pipeline);
+    gst_task_pool_cleanup(pool);
+    gst_object_unref(pool);
+
+    if(builder == NULL) return bError;
+    vector<unsigned char> energy = builder->finish();
+    delete builder;
+    if(!ok) return bError;
+
+    GstClockTime elapsed = gst_util_get_timestamp() - started;
+    long audioms = energy.size() * PAUSEINDEX_WINDOW_MS;
+    LOG4CXX_INFO(playerImplLog, "Indexed " << TIME_STR_MS(audioms) << " of audio in " << TIME_STR(elapsed)
+            << " (" << (elapsed > 0 ? audioms * GST_MSECOND / elapsed : 0) << "x real time)");
+    pauseIndex.store(url, energy);
+
+    return bOk;
+}
+
+/**
+ * Pause index thread, indexes the files queued in pauseIndex one at a time
+ *
+ * @param player PlayerImpl
+ */
+void *pause_index_thread(void *player)
+{
+    PlayerImpl *p = (PlayerImpl *)player;
+    string url;
+
+    while(p->pauseIndex.waitJob(url)) {
+        if(p->indexFile(url) == bError && !p->pauseIndex.isStopping())
+            p->pauseIndex.failed(url);
+    }
+
+    LOG4CXX_DEBUG(playerImplLog, "Pause index thread exiting");
+    return NULL;
+}
+
 /**
  * Creates an AudioCD pipeline
  *
@@ -2033,7 +3783,7 @@ bool PlayerImpl::setupCDAPipeline()
     pQueue = gst_element_factory_make("queue", "pQueue");
 
     // Setup postprocessing
-    postprocessing = setupPostprocessing(GST_BIN(pPipeline));
+    postprocessing = setupPostprocessing(GST_BIN(pPipeline), FORMAT_INT16);
 
     if (!pCddasrc       ||
             !pQueue         ||
@@ -2043,8 +3793,13 @@ bool PlayerImpl::setupCDAPipeline()
     gst_bin_add_many (GST_BIN(pPipeline), pCddasrc, pQueue,
             postprocessing, NULL);
 
-    g_object_set(pQueue, "max-size-bytes", 262144, NULL);
-    g_object_set(pQueue, "min-threshold-bytes", 65536, NULL);
+    if(getLowMemory()) {
+        g_object_set(pQueue, "max-size-bytes", LOWMEM_CDA_QUEUE_BYTES, NULL);
+        g_object_set(pQueue, "min-threshold-bytes", LOWMEM_CDA_QUEUE_THRESHOLD, NULL);
+    } else {
+        g_object_set(pQueue, "max-size-bytes", CDA_QUEUE_BYTES, NULL);
+        g_object_set(pQueue, "min-threshold-bytes", CDA_QUEUE_THRESHOLD, NULL);
+    }
 
     g_object_set (pCddasrc, "read-speed", CDA_READSPEED, NULL);
 
@@ -2092,15 +3847,36 @@ bool PlayerImpl::destroyPipeline()
         if(pDatasource != NULL) {
             g_object_set(pDatasource, "location", NULL, NULL);
         }
+        cancelSegmentClock();
         LOG4CXX_DEBUG(playerImplLog, "Setting state to NULL");
         gst_element_set_state (GST_ELEMENT(pPipeline), GST_STATE_NULL);
         if(waitStateChange() == bError) usleep(3000000);
+        positionClock.stop();
+        timeNotifier.reset();
+        cueList.reset();
+
+        BufferPool::stats pool = bufferPool.getStats();
+        LOG4CXX_DEBUG(playerImplLog, "Buffer pool: " << pool.requests << " requests, " << pool.reuses << " reused, "
+                << pool.fallbacks << " from the heap, " << pool.arenaBytes << " bytes in arenas");
+
+        if(pSilence != NULL) {
+            guint64 saved = 0;
+            g_object_get(pSilence, "saved", &saved, NULL);
+            lockMutex(dataMutex);
+            mSilenceSavedms += saved / GST_MSECOND;
+            mSilenceLivems = 0;
+            if(saved > 0)
+                LOG4CXX_INFO(playerImplLog, "Pause compression saved " << saved / GST_MSECOND << " ms, " << mSilenceSavedms << " ms in total");
+            unlockMutex(dataMutex);
+        }
 
         if(pFlump3dec != NULL) parent = gst_element_get_parent(GST_OBJECT(pFlump3dec));
         if(pOggdemux != NULL) parent = gst_element_get_parent(GST_OBJECT(pOggdemux));
         if(pCddasrc != NULL) parent = gst_element_get_parent(GST_OBJECT(pCddasrc));
         if(pFaaddec != NULL) parent = gst_element_get_parent(GST_OBJECT(pFaaddec));
         if(pWavparse != NULL) parent = gst_element_get_parent(GST_OBJECT(pWavparse));
+        if(pFlacdec != NULL) parent = gst_element_get_parent(GST_OBJECT(pFlacdec));
+        if(pQtdemux != NULL) parent = gst_element_get_parent(GST_OBJECT(pQtdemux));
         if(pDecodebin != NULL) parent = gst_element_get_parent(GST_OBJECT(pDecodebin));
 
         if(parent == NULL) {
@@ -2110,15 +3886,20 @@ bool PlayerImpl::destroyPipeline()
             if(pFlump3dec != NULL) gst_object_unref(pFlump3dec);
             if(pFaaddec != NULL) gst_object_unref(pFaaddec);
             if(pWavparse != NULL) gst_object_unref(pWavparse);
+            if(pFlacdec != NULL) gst_object_unref(pFlacdec);
+            if(pOpusdec != NULL) gst_object_unref(pOpusdec);
+            if(pQtdemux != NULL) gst_object_unref(pQtdemux);
             if(pCddasrc != NULL) gst_object_unref(pCddasrc);
             if(pDecodebin != NULL) gst_object_unref(pDecodebin);
             if(pAudioconvert1 != NULL) gst_object_unref(pAudioconvert1);
+            if(pCapsfilter != NULL) gst_object_unref(pCapsfilter);
 #ifdef ENABLE_PITCH
             if(pPitch != NULL) gst_object_unref(pPitch);
 #endif
-#ifdef ENABLE_EQUALIZER
+#if defined(ENABLE_EQUALIZER) && !defined(ENABLE_DSP)
             if(pEqualizer != NULL) gst_object_unref(pEqualizer);
 #endif
+            if(pSilence != NULL) gst_object_unref(pSilence);
             if(pAudioconvert2 != NULL) gst_object_unref(pAudioconvert1);
             if(pQueue != NULL) gst_object_unref(pQueue);
 #ifdef ENABLE_AMPLIFY
@@ -2137,6 +3918,10 @@ bool PlayerImpl::destroyPipeline()
             LOG4CXX_DEBUG(playerImplLog, "Destroying pipeline with refcount: " << GST_OBJECT_REFCOUNT(pPipeline));
             if(parent != NULL) gst_object_unref (parent);
             if(pPipeline != NULL) gst_object_unref (pPipeline);
+#ifdef ENABLE_PITCH
+            // Our own reference, see setupPostprocessing
+            if(pPitch != NULL) gst_object_unref (pPitch);
+#endif
         }
 
         if(GST_OBJECT_REFCOUNT(pPipeline) == 0)
@@ -2175,18 +3960,36 @@ bool PlayerImpl::destroyPipeline()
     // Decoder for wav
     pWavparse = NULL;
 
+    // Decoder for flac
+    pFlacdec = NULL;
+
+    // Decoder for ogg/opus
+    pOpusdec = NULL;
+
+    // Demuxer for mp4
+    pQtdemux = NULL;
+
     // Decoder for other formats
     pDecodebin = NULL;
 
     // Postprocessing
     pAudioconvert1 = NULL;
+    pCapsfilter = NULL;
     pPitch = NULL;
+    g_atomic_int_set(&bPitchBypassed, FALSE);
+    g_atomic_int_set(&mPitchRelink, PITCH_RELINK_NONE);
+    mPitchBlockedAt = GST_CLOCK_TIME_NONE;
     pEqualizer = NULL;
+    pSilence = NULL;
     pAudioconvert2 = NULL;
     pLevel = NULL;
     pAmplify = NULL;
     pAudiosink = NULL;
 
+    lockMutex(dataMutex);
+    mFormats = Player::formatData();
+    unlockMutex(dataMutex);
+
     mNumTracks = 0;
     mCDADiscid = "";
 
@@ -2204,6 +4007,8 @@ bool PlayerImpl::waitStateChange()
     int count = 0;
     int spincnt = 0;
     GstStateChangeReturn stateret;
+    GstClockTime started = gst_util_get_timestamp();
+    PlayerTraceSpan span(trace, "control", "waitStateChange");
 
     usleep(10000);
     if(pPipeline == NULL) return bError;
@@ -2218,6 +4023,7 @@ bool PlayerImpl::waitStateChange()
 
             if(pendingState == GST_STATE_VOID_PENDING) {
                 LOG4CXX_DEBUG(playerImplLog, "State change OK");
+                metrics.record(PlayerMetrics::STATE_CHANGE_LATENCY, gst_util_get_timestamp() - started);
                 return bOk;
             }
 
@@ -2237,6 +4043,7 @@ bool PlayerImpl::waitStateChange()
             }
 
             LOG4CXX_ERROR(playerImplLog, "State change FAILED (" << tmpstr << ") while changing from " << gst_element_state_get_name(curState) << " to " << gst_element_state_get_name(pendingState));
+            metrics.record(PlayerMetrics::STATE_CHANGE_LATENCY, gst_util_get_timestamp() - started);
             return bError;
         }
 
@@ -2258,6 +4065,7 @@ bool PlayerImpl::waitStateChange()
     }
 
     LOG4CXX_ERROR(playerImplLog, "State change TIMEOUT (" << tmpstr << ") while changing from " << gst_element_state_get_name(curState) << " to " << gst_element_state_get_name(pendingState));
+    metrics.record(PlayerMetrics::STATE_CHANGE_LATENCY, gst_util_get_timestamp() - started);
     return bError;
 }
 
@@ -2269,9 +4077,9 @@ bool PlayerImpl::waitStateChange()
 bool PlayerImpl::setupPipeline()
 {
     LOG4CXX_DEBUG(playerImplLog, "Setting up correct pipeline type");
+    PlayerTraceSpan span(trace, "control", "setupPipeline");
 
-    // Check the file extension, decide what kind of codec to use
-    string file_ext = "unknown";
+    // Check the file content, decide what kind of codec to use
     string file_pre = "unknown";
     pipelineType newPipetype = NOPIPE;
 
@@ -2286,31 +4094,28 @@ bool PlayerImpl::setupPipeline()
                 file_pre.begin(), (int(*)(int))tolower);
     }
 
-    // Get the extension of a file
     if(file_pre == "audiocd:") {
         mTrack = filename.substr(8, filename.length());
         LOG4CXX_WARN(playerImplLog, "Got AudioCD '" << file_pre << "' track '" << mTrack<< "'");
-    }    else {
-        // Check extension if we don't have an audio CD
+        newPipetype = CDAPIPE;
+    } else {
+        // Look at the content of the file rather than trusting its name
         mTrack = "";
-        if(filename.length() > 4) {
-            file_ext = filename.substr(filename.length()-4, filename.length());
-            std::transform(file_ext.begin(), file_ext.end(),
-                    file_ext.begin(), (int(*)(int))tolower);
-            LOG4CXX_DEBUG(playerImplLog, "Got extension '" << file_ext << "'");
+        FormatSniffer::format format = formatSniffer.detect(filename);
+        LOG4CXX_DEBUG(playerImplLog, "Got format '" << FormatSniffer::name(format) << "'");
+
+        switch(format) {
+            case FormatSniffer::FORMAT_OGG_VORBIS: newPipetype = OGGPIPE; break;
+            case FormatSniffer::FORMAT_MP3: newPipetype = MP3PIPE; break;
+            case FormatSniffer::FORMAT_AAC: newPipetype = AACPIPE; break;
+            case FormatSniffer::FORMAT_WAV: newPipetype = WAVPIPE; break;
+            case FormatSniffer::FORMAT_FLAC: newPipetype = FLACPIPE; break;
+            case FormatSniffer::FORMAT_OGG_OPUS: newPipetype = OPUSPIPE; break;
+            case FormatSniffer::FORMAT_MP4: newPipetype = MP4PIPE; break;
+            default: newPipetype = ANYPIPE; break;
         }
     }
 
-    // Setup the correct type of pipeline depending on the extension
-    if(file_pre == "audiocd:") newPipetype = CDAPIPE;
-    else if(file_ext == ".ogg") newPipetype = OGGPIPE;
-    else if(file_ext == ".mp3") newPipetype = MP3PIPE;
-    else if(file_ext == ".mpg") newPipetype = MP3PIPE;
-    else if(file_ext == "mpeg") newPipetype = MP3PIPE;
-    else if(file_ext == ".wav") newPipetype = WAVPIPE;
-    else if(file_ext == ".aac") newPipetype = AACPIPE;
-    else newPipetype = ANYPIPE;
-
     if(pPipeline != NULL) {
         gst_element_set_state(GST_ELEMENT(pPipeline), GST_STATE_NULL);
         if(waitStateChange() == bError) usleep(1000000);
@@ -2337,6 +4142,21 @@ bool PlayerImpl::setupPipeline()
                 destroyPipeline();
                 break;
 
+            case FLACPIPE:
+                LOG4CXX_DEBUG(playerImplLog, "Destroying FLACPIPE");
+                destroyPipeline();
+                break;
+
+            case OPUSPIPE:
+                LOG4CXX_DEBUG(playerImplLog, "Destroying OPUSPIPE");
+                destroyPipeline();
+                break;
+
+            case MP4PIPE:
+                LOG4CXX_DEBUG(playerImplLog, "Destroying MP4PIPE");
+                destroyPipeline();
+                break;
+
             case CDAPIPE:
                 LOG4CXX_DEBUG(playerImplLog, "Destroying CDAPIPE");
                 destroyPipeline();
@@ -2401,6 +4221,36 @@ bool PlayerImpl::setupPipeline()
             }
             break;
 
+        case FLACPIPE:
+            LOG4CXX_INFO(playerImplLog, "Setting up FLACPIPE");
+            if(setupFLACPipeline() == bOk) {
+                pipeType = newPipetype;
+            } else {
+                LOG4CXX_ERROR(playerImplLog, "ERROR SETTING UPP FLACPIPE");
+                return bError;
+            }
+            break;
+
+        case OPUSPIPE:
+            LOG4CXX_INFO(playerImplLog, "Setting up OPUSPIPE");
+            if(setupOpusPipeline() == bOk) {
+                pipeType = newPipetype;
+            } else {
+                LOG4CXX_ERROR(playerImplLog, "ERROR SETTING UPP OPUSPIPE");
+                return bError;
+            }
+            break;
+
+        case MP4PIPE:
+            LOG4CXX_INFO(playerImplLog, "Setting up MP4PIPE");
+            if(setupMP4Pipeline() == bOk) {
+                pipeType = newPipetype;
+            } else {
+                LOG4CXX_ERROR(playerImplLog, "ERROR SETTING UPP MP4PIPE");
+                return bError;
+            }
+            break;
+
         case CDAPIPE:
             LOG4CXX_INFO(playerImplLog, "Setting up CDAPIPE");
             if(setupCDAPipeline() == bOk)
@@ -2558,8 +4408,6 @@ void *player_thread(void *player)
     p->bStartseek = false;
     p->bWaitAsync = false;
 
-    double currentTempo = p->mPlayingTempo;
-    double currentPitch;
     double currentVolumeGain;
     bool serverTimedOut = false;
 #ifdef ENABLE_EQUALIZER
@@ -2567,9 +4415,10 @@ void *player_thread(void *player)
     double currentTreble;
 #endif
 
-    long lastPosms = 0;
+    time_t lastMetricsDump = time(NULL);
     p->mGstState = GST_STATE_NULL;
     p->mGstPending = GST_STATE_VOID_PENDING;
+    p->trace.instant("control", "thread start");
 
     GstMessage *message;
 
@@ -2626,6 +4475,7 @@ void *player_thread(void *player)
             // Do not try to open an empty file
             if(p->mFilename != "")
                 openNewFile = true;
+            p->trace.instant("control", "new file", p->mStartms);
 
             p->mPlayingFilename = p->mFilename;
             p->mPlayingStartms = p->mStartms;
@@ -2642,12 +4492,16 @@ void *player_thread(void *player)
                 p->mStopms != p->mPlayingStopms ||
                 p->bOpenSignal == true)) {
             LOG4CXX_INFO(playerImplLog, "Got new Positions: '" << p->mFilename << "': " << TIME_STR_MS(p->mStartms) <<  "->'" << TIME_STR_MS(p->mStopms));
+            p->trace.instant("control", "new position", p->mStartms);
 
             // If this is a continuation clip,
-            // and the mPlayingms is already in this clip -> don't seek
+            // and the mPlayingms is already in this clip -> don't seek.
+            // Stops are taken when heard, by then a short clip may already
+            // be decoded past, so what is heard counts as well.
+            long long audiblems = p->positionClock.position() / GST_MSECOND;
             if(p->mPlayingStopms == p->mStartms &&
-                    p->mPlayingms >= p->mStartms &&
-                    p->mPlayingms <= p->mStopms) {
+                    ((p->mPlayingms >= p->mStartms && p->mPlayingms <= p->mStopms) ||
+                     (audiblems >= p->mStartms && audiblems <= p->mStopms))) {
                 openNewPosition = false;
                 // If eos has already been called for this file, call it again
                 // This happens in "Kovalla Kädellä - Higgs" when open is called on the last segments, after EOS was sent.
@@ -2756,7 +4610,7 @@ void *player_thread(void *player)
                                     p->mGstPending = GST_STATE_PLAYING;
                                 } else {
                                     p->lockMutex(p->dataMutex);
-                                    gint64 c_seektime = (gint64) ((double)p->mPlayingStartms / p->mPlayingTempo) * GST_MSECOND;
+                                    gint64 c_seektime = p->toSeekTime(p->mPlayingStartms);
 
                                     // If jumping backwards, go to a point a littlebit before the seekpoint
                                     //if(p->mPlayingms > p->mPlayingStartms)
@@ -2765,11 +4619,13 @@ void *player_thread(void *player)
                                     if(c_seektime < 0) c_seektime = 0;
 
                                     LOG4CXX_INFO(playerImplLog, "Startseeking1 from " << TIME_STR_MS(p->mPlayingms) << " to " << TIME_STR_MS(p->mPlayingStartms) << " (" << TIME_STR(c_seektime) << ")");
+                                    p->trace.instant("control", "startseek1", p->mPlayingStartms);
                                     // Fade in the first few buffers
                                     p->bFadeIn = true;
 
                                     p->unlockMutex(p->dataMutex);
 
+                                    p->metrics.start(PlayerMetrics::SEEK_LATENCY);
                                     if (!gst_element_seek_simple (p->pPipeline, GST_FORMAT_TIME, (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), c_seektime))
                                     {
                                         LOG4CXX_ERROR(playerImplLog, "Seek failed");
@@ -2796,7 +4652,7 @@ void *player_thread(void *player)
                                 // EXECUTE STARTSEEK
                                 if(p->bStartseek) {
                                     p->lockMutex(p->dataMutex);
-                                    gint64 c_seektime = (gint64) ((double)p->mPlayingStartms / p->mPlayingTempo) * GST_MSECOND;
+                                    gint64 c_seektime = p->toSeekTime(p->mPlayingStartms);
 
                                     // If jumping backwards, go to a point a littlebit before the seekpoint
                                     //if(p->mPlayingms > p->mPlayingStartms)
@@ -2805,10 +4661,12 @@ void *player_thread(void *player)
                                     if(c_seektime < 0) c_seektime = 0;
 
                                     LOG4CXX_INFO(playerImplLog, "Startseeking2 from " << TIME_STR_MS(p->mPlayingms) << " to " << TIME_STR_MS(p->mPlayingStartms) << " (" << TIME_STR(c_seektime) << ")");
+                                    p->trace.instant("control", "startseek2", p->mPlayingStartms);
                                     p->bFadeIn = true;
 
                                     p->unlockMutex(p->dataMutex);
 
+                                    p->metrics.start(PlayerMetrics::SEEK_LATENCY);
                                     if (!gst_element_seek_simple (p->pPipeline, GST_FORMAT_TIME, (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), c_seektime))
                                     {
                                         LOG4CXX_ERROR(playerImplLog, "Seek failed");
@@ -2828,30 +4686,6 @@ void *player_thread(void *player)
                                     p->unlockMutex(p->dataMutex);
                                 }
 
-                                // Check for speed change
-                                p->lockMutex(p->dataMutex);
-                                if(p->mTempo != p->mPlayingTempo || p->mPitch != p->mPlayingPitch) {
-
-                                    p->mPlayingStartms = -1;
-
-                                    currentTempo = p->mPlayingTempo = p->mTempo;
-                                    currentPitch = p->mPlayingPitch = p->mPitch;
-                                    p->unlockMutex(p->dataMutex);
-#ifdef ENABLE_PITCH
-                                    LOG4CXX_INFO(playerImplLog, "Setting tempo to: '" << currentTempo << "'");
-                                    g_object_set(p->pPitch, "tempo", currentTempo, NULL);
-
-                                    LOG4CXX_INFO(playerImplLog, "Setting pitch to: '" << currentPitch << "'");
-                                    g_object_set(p->pPitch, "pitch", currentPitch, NULL);
-#endif
-#ifdef ENABLE_AMPLIFY
-                                    g_object_set(G_OBJECT (p->pAmplify), "amplification", p->mPlayingVolume*p->mPlayingVolumeGain, NULL);
-#endif
-
-                                } else {
-                                    p->unlockMutex(p->dataMutex);
-                                }
-
 #ifdef ENABLE_EQUALIZER
                                 // Check for bass or treble change
                                 p->lockMutex(p->dataMutex);
@@ -2952,42 +4786,61 @@ void *player_thread(void *player)
             }
         }
 
+        // For getSilenceSaved, which can't touch the pipeline from other threads
+        if (GST_IS_ELEMENT(p->pPipeline) && p->pSilence != NULL) {
+            guint64 saved = 0;
+            g_object_get(p->pSilence, "saved", &saved, NULL);
+            p->lockMutex(p->dataMutex);
+            p->mSilenceLivems = saved / GST_MSECOND;
+            p->unlockMutex(p->dataMutex);
+        }
+
+#if defined(ENABLE_PITCH) && !defined(ENABLE_WSOLA)
+        if (GST_IS_ELEMENT(p->pPipeline) && state == PLAYING &&
+                p->mGstState == GST_STATE_PLAYING && !p->bWaitAsync)
+            p->updatePitchBypass();
+#endif
 
         if (GST_IS_ELEMENT(p->pPipeline) && state == PLAYING)
         {
-            p->lockMutex(p->dataMutex);
             bool updatePosition = true;
             GstFormat fmt = GST_FORMAT_TIME;
+            gint64 position = 0;
+            gint64 duration = p->duration; // Only changed by this thread
 
+            // The queries can take a while, dataMutex is not held meanwhile
             LOG4CXX_TRACE(playerImplLog, "Querying stream position");
-            if (!gst_element_query_position (p->pPipeline, &fmt, &p->position))
+            if (!gst_element_query_position (p->pPipeline, &fmt, &position))
             {
                 LOG4CXX_WARN(playerImplLog, "Position query failed");
                 updatePosition = false;
             }
+            else position = p->toSourceTime(position);
 
-            if (!GST_CLOCK_TIME_IS_VALID (p->duration)) {
+            if (!GST_CLOCK_TIME_IS_VALID (duration)) {
                 LOG4CXX_TRACE(playerImplLog, "Querying stream duration");
-                if (!gst_element_query_duration (p->pPipeline, &fmt, &p->duration))
+                if (!gst_element_query_duration (p->pPipeline, &fmt, &duration))
                 {
                     LOG4CXX_WARN(playerImplLog, "Duration query failed");
                     updatePosition = false;
                 }
             }
 
+            Player::timeData td;
+            bool notify = false;
+            p->lockMutex(p->dataMutex);
             if (updatePosition)
             {
-                if (lastPosms != p->position / 100)
-                {
-                    Player::timeData td;
-                    // Scale current position and duration according to currentTempo
-                    td.current = (double(p->position) * currentTempo) / GST_MSECOND;
-                    td.duration = (double(p->duration) * currentTempo) / GST_MSECOND;
-                    td.segmentstart = p->mPlayingStartms;
-                    td.segmentstop = p->mPlayingStopms;
-                    p->onPlayerTime(td);
-                    lastPosms = p->position / 100;
-                }
+                p->position = position;
+                p->duration = duration;
+
+                // Back to file time, the position across tempo changes and the
+                // duration, which the stretcher scaled with the tempo in use
+                td.current = p->timeMap.toSource(p->position) / GST_MSECOND;
+                td.duration = (double(p->duration) * p->mPlayingTempo) / GST_MSECOND;
+                td.segmentstart = p->mPlayingStartms;
+                td.segmentstop = p->mPlayingStopms;
+                notify = p->timeNotifier.due(td.current, td.segmentstart, td.segmentstop);
 
 #ifdef WIN32
                 /*
@@ -3005,28 +4858,58 @@ void *player_thread(void *player)
                         );
                 */
 #else
-                long long int remaining = 0;
-                if (p->mPlayingStopms == UINT_MAX) {
-                    remaining = p->duration - p->position;
-                } else {
-                    remaining = (p->mPlayingStopms - p->mPlayingms) * GST_MSECOND;
+                // Status line on the console only in debugmode
+                if (p->bDebugmode) {
+                    long long int remaining = 0;
+                    if (p->mPlayingStopms == UINT_MAX) {
+                        remaining = p->duration - p->position;
+                    } else {
+                        remaining = (p->mPlayingStopms - p->mPlayingms) * GST_MSECOND;
+                    }
+                    printf("%s(%s) %" TIME_FORMAT " (%" TIME_FORMAT") "
+                            "/ %" TIME_FORMAT" (-%" TIME_FORMAT ") (%s:%2.2f D:%2.2f)          \r",
+                            p->shortstrState(p->getRealState()).c_str(),
+                            p->shortstrState(state).c_str(),
+                            TIME_ARGS((gint64) (p->position)),
+                            TIME_ARGS((gint64) (p->mPlayingms * GST_MSECOND)),
+                            TIME_ARGS((gint64) (p->duration)),
+                            TIME_ARGS((gint64) (remaining)),
+                            (p->mAverageFactor > 0.01) ? "Vc" : "V",
+                            p->mPlayingVolume,
+                            p->mCurrentdB
+                            );
+                    fflush(stdout);
                 }
-                printf("%s(%s) %" TIME_FORMAT " (%" TIME_FORMAT") "
-                        "/ %" TIME_FORMAT" (-%" TIME_FORMAT ") (%s:%2.2f D:%2.2f)          \r",
-                        p->shortstrState(p->getRealState()).c_str(),
-                        p->shortstrState(state).c_str(),
-                        TIME_ARGS((gint64) (p->position)),
-                        TIME_ARGS((gint64) (p->mPlayingms * GST_MSECOND)),
-                        TIME_ARGS((gint64) (p->duration)),
-                        TIME_ARGS((gint64) (remaining)),
-                        (p->mAverageFactor > 0.01) ? "Vc" : "V",
-                        p->mPlayingVolume,
-                        p->mCurrentdB
-                        );
-                fflush(stdout);
 #endif
             }
             p->unlockMutex(p->dataMutex);
+
+            // Slots may call back into the player, so no lock is held
+            if (notify) {
+                p->onPlayerTime(td);
+                p->metrics.count(PlayerMetrics::TIME_NOTIFICATIONS);
+            }
+
+            // Schedule the segment stop, and the warning ahead of it or of
+            // the end of the file, whichever comes first
+            if (updatePosition) {
+                long long endms = td.segmentstop;
+                if (td.duration < endms) endms = td.duration;
+                p->scheduleSegmentClock(td.segmentstop, endms);
+            }
+        }
+        else if (GST_IS_ELEMENT(p->pPipeline)) p->cancelSegmentClock();
+
+        p->updateQualityTier();
+
+        // Periodic metrics dump
+        p->lockMutex(p->dataMutex);
+        int metricsInterval = p->mMetricsInterval;
+        p->unlockMutex(p->dataMutex);
+        if (metricsInterval > 0 && time(NULL) - lastMetricsDump >= metricsInterval)
+        {
+            p->metrics.dump(p->getMetrics());
+            lastMetricsDump = time(NULL);
         }
 
     }
@@ -3051,6 +4934,7 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
 
         switch (message->type) {
             case GST_MESSAGE_EOS:
+                p->trace.instant("control", "EOS", p->mPlayingms);
                 LOG4CXX_WARN(playerImplLog, "Recieved EOS at " << TIME_STR(p->position) << " (" << TIME_STR_MS(p->mPlayingms) << ") / " << TIME_STR(p->duration) << " (-" << TIME_STR_MS(p->mPlayingStopms - p->mPlayingms) << ")");
 
                 ret = false;
@@ -3077,7 +4961,20 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
                     p->bEOSCalledAlreadyForThisFile = true;
                     p->unlockMutex(p->dataMutex);
 
+                    // Without a slot to take care of it, go on with the next clip.
+                    // This is the player thread, the new position is picked
+                    // up on the next loop.
+                    bool answered = p->onPlayerMessage.num_slots() > 0;
                     p->sendEOSSignal();
+                    if(!answered) {
+                        p->lockMutex(p->dataMutex);
+                        if(p->bNextStaged && p->bClipStaged) {
+                            LOG4CXX_INFO(playerImplLog, "Continuing with clip " << p->mNextClip << " after EOS");
+                            p->trace.instant("control", "next clip", p->mNextStartms);
+                            p->setOpenPosition(p->mNextFilename, p->mNextStartms, p->mNextStopms, p->mNextClip);
+                        }
+                        p->unlockMutex(p->dataMutex);
+                    }
                 }
 
                 break;
@@ -3093,6 +4990,7 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
 
                     string type = "None";
 
+                    p->trace.instant("control", message->type == GST_MESSAGE_ERROR ? "error" : "warning");
                     if(message->type == GST_MESSAGE_ERROR) {
                         type = "Error";
                         gst_message_parse_error (message, &gerror, &debug);
@@ -3105,6 +5003,16 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
 
                     LOG4CXX_ERROR(playerImplLog, type << " from: " << gst_object_get_name(GST_MESSAGE_SRC(message)) << " '" << gerror->message << "'(" << gerror->code << ") '" << debug << "'");
 
+                    // A decoder failed, the stored format may be wrong
+                    if(message->type == GST_MESSAGE_ERROR &&
+                            GST_MESSAGE_SRC(message) != GST_OBJECT(p->pDatasource) &&
+                            GST_MESSAGE_SRC(message) != GST_OBJECT(p->pAudiosink)) {
+                        p->lockMutex(p->dataMutex);
+                        string filename = p->mPlayingFilename;
+                        p->unlockMutex(p->dataMutex);
+                        p->formatSniffer.forget(filename);
+                    }
+
                     // Workaround for bug..?
                     if(GST_MESSAGE_SRC(message) == GST_OBJECT(p->pAudiosink)) {
                         LOG4CXX_WARN(playerImplLog, "Audiosink error, setting state to PLAYING");
@@ -3150,6 +5058,7 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
                                 p->mStartms = lastplayedms;
                                 p->mOpenRetries--;
                                 p->unlockMutex(p->dataMutex);
+                                p->metrics.count(PlayerMetrics::REOPEN_RETRIES);
 
                                 // Check retrytime, wait if less than 10 seconds
                                 int spincnt = 0;
@@ -3181,6 +5090,7 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
                 }
             case GST_MESSAGE_ASYNC_DONE: {
                 	LOG4CXX_DEBUG(playerImplLog, "Async done!");
+                    p->trace.instant("control", "ASYNC_DONE");
                     p->lockMutex(p->dataMutex);
                     p->bWaitAsync = false;
                     p->unlockMutex(p->dataMutex);
@@ -3191,6 +5101,7 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
                     if(GST_MESSAGE_SRC(message) == (GstObject*)p->pPipeline) {
                         GstState oldstate;
                         gst_message_parse_state_changed (message, &oldstate, &p->mGstState, &p->mGstPending);
+                        p->trace.instant("control", gst_element_state_get_name(p->mGstState), p->mGstPending);
 
                         // Report state changes from PAUSED TO PLAYING AND PLAYING TO PAUSED
 
@@ -3209,6 +5120,28 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
                         }
 
 
+                        // Interpolate the audible position while playing, hold it otherwise
+                        if(p->mGstState == GST_STATE_PLAYING && p->mGstPending == GST_STATE_VOID_PENDING) {
+                            GstClock *clock = gst_pipeline_get_clock(GST_PIPELINE(p->pPipeline));
+                            if(clock != NULL) {
+                                GstClockTime latency = 0;
+                                GstQuery *query = gst_query_new_latency();
+                                gboolean live = FALSE;
+                                GstClockTime minLatency = 0, maxLatency = 0;
+                                // Sinks only wait for the latency in live pipelines
+                                if(gst_element_query(p->pPipeline, query)) {
+                                    gst_query_parse_latency(query, &live, &minLatency, &maxLatency);
+                                    if(live) latency = minLatency;
+                                }
+                                gst_query_unref(query);
+
+                                p->positionClock.start(clock, gst_element_get_base_time(p->pPipeline), latency);
+                                gst_object_unref(clock);
+                            }
+                        } else if(oldstate == GST_STATE_PLAYING) {
+                            p->positionClock.pause();
+                        }
+
                         // Store the actual pipeline state in the class variable
                         p->setRealState(p->mGstState, p->mGstPending);
 
@@ -3217,7 +5150,7 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
                                 // p->mGstState == GST_STATE_PAUSED &&
                                 p->mGstPending == GST_STATE_VOID_PENDING) {
                             p->lockMutex(p->dataMutex);
-                            gint64 c_seektime = (gint64) ((double)p->mPlayingStartms / p->mPlayingTempo) * GST_MSECOND;
+                            gint64 c_seektime = p->toSeekTime(p->mPlayingStartms);
 
                             // If jumping backwards, go to a point a littlebit before the seekpoint
                             //if(p->mPlayingms > p->mPlayingStartms)
@@ -3226,11 +5159,13 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
                             if(c_seektime < 0) c_seektime = 0;
 
                             LOG4CXX_INFO(playerImplLog, "Startseeking3 from " << TIME_STR_MS(p->mPlayingms) << " to " << TIME_STR_MS(p->mPlayingStartms) << " (" << TIME_STR(c_seektime) << ")");
+                            p->trace.instant("control", "startseek3", p->mPlayingStartms);
 
                             // Fade in the first few buffers
                             p->bFadeIn = true;
                             p->unlockMutex(p->dataMutex);
 
+                            p->metrics.start(PlayerMetrics::SEEK_LATENCY);
                             if (!gst_element_seek_simple (p->pPipeline, GST_FORMAT_TIME, (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), c_seektime))
                             {
                                 LOG4CXX_ERROR(playerImplLog, "Seek failed");
@@ -3334,6 +5269,7 @@ bool handle_bus_message(GstMessage *message, PlayerImpl *p){
 #ifdef ENABLE_AMPLIFY
                             g_object_set(G_OBJECT (p->pAmplify), "amplification", p->mPlayingVolume*p->mPlayingVolumeGain, NULL);
 #endif
+                            p->metrics.count(PlayerMetrics::AGC_ADJUSTMENTS);
 
                             if(p->mAverageFactor <= 0.1 && !p->mGotFinalVolume) {
                                 p->mGotFinalVolume = true;
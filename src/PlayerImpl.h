@@ -27,6 +27,17 @@ along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
 
 #include "Player.h"
 #include "PlayerPosition.h"
+#include "PlayerMetrics.h"
+#include "PlayerTrace.h"
+#include "PauseIndex.h"
+#include "FormatSniffer.h"
+#include "BufferPool.h"
+#include "PositionClock.h"
+#include "TimeMap.h"
+#include "TimeNotifier.h"
+#include "CueList.h"
+#include "ClipIndex.h"
+#include "SignalDispatcher.h"
 #include "PlayerState.h"
 
 struct PlayerImpl
@@ -48,6 +59,7 @@ struct PlayerImpl
     std::string getFilename();
 
     long long int getPos();
+    long long int getAudiblePos();
     void seekPos(long long int seektime);
     long long int getStartms();
     long long int getStopms();
@@ -86,11 +98,49 @@ struct PlayerImpl
     void setDebugmode(bool);
     void setUseragent(std::string);
 
+    Player::metricsData getMetrics();
+    void resetMetrics();
+    void setMetricsInterval(int seconds);
+
+    void setTracing(bool enable);
+    bool dumpTrace(std::string filename);
+
+    Player::qualityTier getQualityTier();
+
+    void setSilenceCompression(bool enable);
+    bool getSilenceCompression();
+    long getSilenceSaved();
+
+    bool getPauses(std::string url, std::vector<Player::pauseData> &pauses);
+    void setSeekSnap(long maxms);
+
+    void setTimeInterval(long ms);
+    void setTimeThresholds(std::vector<long long> ms);
+    void setCues(std::vector<long long> ms);
+
+    void setDispatchContext(GMainContext *context);
+    void setContinuePolicy(Player::continuePolicy policy);
+    void setNextSegment(std::string filename, long long startms, long long stopms);
+    void setSegmentEndingLead(long ms);
+
+    size_t setClips(const char *const *urls, const char *const *clipBegins,
+            const char *const *clipEnds, size_t count);
+    long findClip(std::string url, long long ms);
+    long getClip();
+    bool openClip(long clip);
+    void setClipAdvance(bool enable);
+
+    void setLowMemory(bool enable);
+    bool getLowMemory();
+
+    Player::formatData getFormats();
+
     bool isPlaying();
 
     boost::signals2::connection doOnPlayerMessage(Player::OnPlayerMessage::slot_type slot);
     boost::signals2::connection doOnPlayerState(Player::OnPlayerState::slot_type slot);
     boost::signals2::connection doOnPlayerTime(Player::OnPlayerTime::slot_type slot);
+    boost::signals2::connection doOnPlayerCue(Player::OnPlayerCue::slot_type slot);
 
 
     // PRIVATE
@@ -98,8 +148,13 @@ struct PlayerImpl
     Player::OnPlayerMessage onPlayerMessage;
     Player::OnPlayerState onPlayerState;
     Player::OnPlayerTime onPlayerTime;
+    Player::OnPlayerCue onPlayerCue;
 
     bool sendCONTSignal();
+    void dispatchContinue(GstClockTime posted, long long stopms, bool staged);
+    bool sendENDINGSignal();
+    void dispatchSegmentEnding(GstClockTime at);
+    void dispatchCue(GstClockTime late, GstClockTime posted, long long cuems);
     bool sendEOSSignal();
     bool sendBUFFERINGSignal();
     bool sendERRORSignal();
@@ -131,18 +186,29 @@ struct PlayerImpl
         // Decoder for wav
         *pWavparse,
 
+        // Decoder for flac
+        *pFlacdec,
+
+        // Decoder for ogg/opus, uses pOggdemux
+        *pOpusdec,
+
+        // Demuxer for mp4/m4a/m4b, uses pFaaddec
+        *pQtdemux,
+
         // Decoder for other formats
         *pDecodebin,
 
         // Post processing
         *pAudioconvert1,
+        *pCapsfilter,     // Sample format of the chain
         *pPitch,
         *pEqualizer,
+        *pSilence,  // Pause compression
         *pAudioconvert2,
         *pQueue,   // Queue
         *pAudiodynamic,   // Audio dynamics adjust
         *pLevel,   // Level indicator
-        *pAmplify,  // Level adjust
+        *pAmplify,  // Level adjust, with ENABLE_DSP also equalizer and fade-in
         *pAudiosink;
 
     GstClock *pClock;
@@ -150,13 +216,27 @@ struct PlayerImpl
     //GstController *pFadeController;
     //GValue mFadeControllerVolume;
 
-    GstElement *setupPostprocessing(GstBin *);
-    GstElement *setupDatasource(GstBin *);
+    GstElement *setupPostprocessing(GstBin *bin, const char *decoderFormat);
+
+    // Formats negotiated in the postprocessing chain
+    Player::formatData mFormats;
+    void updateFormats();
+
+    // Pitch element bypass at neutral tempo and pitch
+    bool linkPitch(bool bypass);
+    void updatePitchBypass();
+    gint bPitchBypassed;            // pPitch is out of the pipeline, atomic since cb_pitch_blocked sets it
+    gint mPitchRelink;              // PITCH_RELINK_* state, atomic between the player and streaming threads
+    GstClockTime mPitchBlockedAt;   // When the pending relink was asked for. Player thread only
+    GstElement *setupDatasource(GstBin *bin, std::string location, GstElement **source, GstElement **queue);
 
     bool setupOGGPipeline();
     bool setupMP3Pipeline();
     bool setupAACPipeline();
     bool setupWAVPipeline();
+    bool setupFLACPipeline();
+    bool setupOpusPipeline();
+    bool setupMP4Pipeline();
     bool setupCDAPipeline();
     bool setupUnknownPipeline();
 
@@ -165,6 +245,9 @@ struct PlayerImpl
         MP3PIPE,  // Mp3 special pipeline
         AACPIPE,  // AAC special pipeline
         WAVPIPE,  // Wav special pipeline
+        FLACPIPE, // Flac special pipeline
+        OPUSPIPE, // Ogg-Opus special pipeline
+        MP4PIPE,  // MP4/M4A/M4B with AAC special pipeline
         CDAPIPE,  // Audio CD pipeline
         ANYPIPE,  // Fallback pipeline
         NOPIPE      // Not yet initialized
@@ -177,10 +260,10 @@ struct PlayerImpl
     void unlockMutex(pthread_mutex_t *theMutex);
 
     friend void *player_thread(void *player);
-    friend gboolean start_time_callback (GstClock *clock, GstClockTime time, GstClockID id, gpointer player_object);
     friend gboolean stop_time_callback (GstClock *clock, GstClockTime time, GstClockID id, gpointer player_object);
     friend gboolean cb_data_probe (GstPad *pad, GstBuffer *buffer, gpointer player_object);
     friend void parse_tag (const GstTagList *list, const char *tag, gpointer player_object);
+    friend void cb_have_type (GstElement *typefind, guint probability, GstCaps *caps, gpointer player_object);
 
     // END OF GST DATA AND FUNCTIONS
 
@@ -241,6 +324,22 @@ struct PlayerImpl
 
     void setEqualizer(GstElement *equalizer, double bass, double treble);
 
+    // QoS driven quality degradation
+    void updateQualityTier();
+    void applyQualityTier(Player::qualityTier tier);
+    Player::qualityTier mQualityTier;
+    int mQosLateEvents;             // Late QOS events since last evaluation
+    gint64 mQosLateness;            // Largest lateness since last evaluation (ns)
+    gint64 mQosPrevLateness;        // Largest lateness in the previous evaluation (ns)
+    time_t mQosEvaluated;           // When the QOS events were last evaluated
+    time_t mQosLastLate;            // When playback was last late or the tier changed
+
+    // Pause compression
+    GstClockTime toSourceTime(GstClockTime time);
+    bool mSilenceCompression;
+    long mSilenceSavedms;           // Saved by pipelines already destroyed
+    long mSilenceLivems;            // Saved by the current pipeline, updated by the player thread
+
     void setRealState(GstState gstState, GstState gstPending);
     bool waitStateChange();
 
@@ -264,6 +363,85 @@ struct PlayerImpl
 
     pthread_mutex_t *stateMutex;    // Change of states
     pthread_mutex_t *dataMutex;     // Change mPlaying* data
+    GstClockTime stateMutexLocked;  // When stateMutex was last acquired
+    GstClockTime dataMutexLocked;   // When dataMutex was last acquired
+
+    // Wait and hold times of each mutex, guarded by that mutex so recording takes no other lock
+    Player::histogramData mStateMutexWait;
+    Player::histogramData mStateMutexHold;
+    Player::histogramData mDataMutexWait;
+    Player::histogramData mDataMutexHold;
+
+    // Runtime counters and histograms
+    PlayerMetrics metrics;
+    int mMetricsInterval;           // Seconds between metrics dumps, 0 to disable
+
+    // Playback timeline, recorded when tracing is enabled
+    PlayerTrace trace;
+
+    // Pause index, built in the background by indexThread
+    PauseIndex pauseIndex;
+    pthread_t indexThread;
+    bool bIndexThread;              // indexThread has been started
+    long mSeekSnapms;               // How far seekPos may move to a pause, 0 to disable
+    void startIndexThread();
+    bool indexFile(std::string url);
+
+    // Formats of opened files, picks the pipeline in setupPipeline
+    FormatSniffer formatSniffer;
+
+    // Low-memory profile, applied when a pipeline is set up
+    bool mLowMemory;
+
+    // Memory for the buffers allocated at the audio sink
+    BufferPool bufferPool;
+
+    // Audible position, written from the sink pad probes and the bus
+    PositionClock positionClock;
+    GstSegment mSinkSegment;        // Last segment seen at the sink, streaming thread only
+
+    // Output time of the stretcher to file position, across tempo changes
+    TimeMap timeMap;
+    gint64 toSeekTime(long long ms);
+
+    // Decides when onPlayerTime is sent
+    TimeNotifier timeNotifier;
+
+    // Cue points, sent when audible on a clock id kept by the player thread
+    CueList cueList;
+    GstClockID mCueId;              // Pending cue, player thread only
+    GstClockTime mCueAt;            // Clock time of mCueId, none once it has fired
+    long long mCuems;               // Cue mCueId is for
+
+    // Runs the Continue callback off the streaming thread
+    SignalDispatcher dispatcher;
+    Player::continuePolicy mContinuePolicy; // What the probe does until Continue is answered
+    bool bNextStaged;                       // A segment was staged with setNextSegment
+    std::string mNextFilename;
+    long long mNextStartms, mNextStopms;
+
+    // Clips of the book, for the player to continue through them itself
+    ClipIndex clipIndex;
+    bool bClipAdvance;              // Stage the next clip when nothing else is staged
+    long mClip;                     // Clip of the segment opened or continued with, -1 if unknown
+    long mNextClip;                 // Clip of the staged segment, -1 if unknown
+    bool bClipStaged;               // The staged segment was staged from clipIndex
+    void stageNextClip();
+    void openSegment(std::string filename, long long startms, long long stopms, long clip);
+    void setOpenPosition(std::string filename, long long startms, long long stopms, long clip);
+
+    // Segment stop and PLAYER_SEGMENT_ENDING, scheduled on the pipeline clock by the player thread
+    void segmentStop();
+    void armClockId(GstClockID *id, GstClockTime *scheduled, GstClockTime at, GstClockCallback callback);
+    void scheduleSegmentClock(long long stopms, long long endms);
+    void cancelSegmentClock();
+    GstClockID mStopId;             // Pending segment stop, player thread only
+    GstClockTime mStopAt;           // Clock time of mStopId
+    long mEndingLeadms;             // 0 to disable
+    GstClockID mEndingId;           // Pending notification, player thread only
+    GstClockTime mEndingAt;         // Clock time of mEndingId
+    long long mEndingTargetms;      // Segment end the notification is for
+    bool bEndingSent;               // Sent for mEndingTargetms
 
     PlayerPosition pausePosition;
     bool serverTimedOut;
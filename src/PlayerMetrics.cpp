@@ -0,0 +1,197 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstring>
+#include <log4cxx/logger.h>
+
+#include "PlayerMetrics.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr playerMetricsLog(log4cxx::Logger::getLogger("kolibre.player.playermetrics"));
+
+using namespace std;
+
+PlayerMetrics::PlayerMetrics()
+{
+    pthread_mutex_init(&metricsMutex, NULL);
+    reset();
+}
+
+PlayerMetrics::~PlayerMetrics()
+{
+    pthread_mutex_destroy(&metricsMutex);
+}
+
+/**
+ * Increment a counter
+ *
+ * @param c counter to increment
+ * @param n amount to add
+ */
+void PlayerMetrics::count(counter c, unsigned long n)
+{
+    pthread_mutex_lock(&metricsMutex);
+    counters[c] += n;
+    pthread_mutex_unlock(&metricsMutex);
+}
+
+/**
+ * Add a sample to a histogram
+ *
+ * @param h histogram to update
+ * @param elapsed sample value (ns)
+ */
+void PlayerMetrics::record(histogram h, GstClockTime elapsed)
+{
+    pthread_mutex_lock(&metricsMutex);
+    addSample(histograms[h], elapsed);
+    pthread_mutex_unlock(&metricsMutex);
+}
+
+/**
+ * Start timing an operation that completes on another code path,
+ * a running timer is restarted
+ *
+ * @param h histogram the operation is recorded in
+ */
+void PlayerMetrics::start(histogram h)
+{
+    GstClockTime now = gst_util_get_timestamp();
+    pthread_mutex_lock(&metricsMutex);
+    started[h] = now;
+    pthread_mutex_unlock(&metricsMutex);
+}
+
+/**
+ * Stop a timer started with start() and record the elapsed time,
+ * does nothing if the timer isn't running
+ *
+ * @param h histogram the operation is recorded in
+ */
+void PlayerMetrics::stop(histogram h)
+{
+    GstClockTime now = gst_util_get_timestamp();
+    pthread_mutex_lock(&metricsMutex);
+    if(GST_CLOCK_TIME_IS_VALID(started[h])) {
+        addSample(histograms[h], now - started[h]);
+        started[h] = GST_CLOCK_TIME_NONE;
+    }
+    pthread_mutex_unlock(&metricsMutex);
+}
+
+/**
+ * Get a copy of all counters and histograms
+ *
+ * @return metrics snapshot
+ */
+Player::metricsData PlayerMetrics::snapshot()
+{
+    Player::metricsData data;
+
+    pthread_mutex_lock(&metricsMutex);
+    data.buffersProcessed = counters[BUFFERS_PROCESSED];
+    data.buffersSkipped = counters[BUFFERS_SKIPPED];
+    data.reopenRetries = counters[REOPEN_RETRIES];
+    data.agcAdjustments = counters[AGC_ADJUSTMENTS];
+    data.qosEvents = counters[QOS_EVENTS];
+    data.timeNotifications = counters[TIME_NOTIFICATIONS];
+
+    data.seekLatency = histograms[SEEK_LATENCY];
+    data.stateChangeLatency = histograms[STATE_CHANGE_LATENCY];
+    data.dataMutexWait = histograms[DATAMUTEX_WAIT];
+    data.dataMutexHold = histograms[DATAMUTEX_HOLD];
+    data.stateMutexWait = histograms[STATEMUTEX_WAIT];
+    data.stateMutexHold = histograms[STATEMUTEX_HOLD];
+    data.probeTime = histograms[PROBE_TIME];
+    data.dispatchDelay = histograms[DISPATCH_DELAY];
+    data.cueJitter = histograms[CUE_JITTER];
+    pthread_mutex_unlock(&metricsMutex);
+
+    return data;
+}
+
+/**
+ * Clear all counters, histograms and running timers
+ */
+void PlayerMetrics::reset()
+{
+    pthread_mutex_lock(&metricsMutex);
+    memset(counters, 0, sizeof(counters));
+    memset(histograms, 0, sizeof(histograms));
+    for(int i = 0; i < NUM_HISTOGRAMS; i++)
+        started[i] = GST_CLOCK_TIME_NONE;
+    pthread_mutex_unlock(&metricsMutex);
+}
+
+/**
+ * Write a snapshot of the metrics to the log
+ */
+void PlayerMetrics::dump()
+{
+    dump(snapshot());
+}
+
+/**
+ * Write a metrics snapshot to the log
+ *
+ * @param data snapshot to write
+ */
+void PlayerMetrics::dump(const Player::metricsData &data)
+{
+    LOG4CXX_INFO(playerMetricsLog, "buffers processed: " << data.buffersProcessed
+            << ", skipped: " << data.buffersSkipped
+            << ", reopen retries: " << data.reopenRetries
+            << ", agc adjustments: " << data.agcAdjustments
+            << ", qos events: " << data.qosEvents
+            << ", time notifications: " << data.timeNotifications);
+
+    const char *names[NUM_HISTOGRAMS] = { "seek latency", "state change latency",
+        "dataMutex wait", "dataMutex hold", "stateMutex wait", "stateMutex hold", "probe time", "dispatch delay", "cue jitter" };
+    const Player::histogramData *hists[NUM_HISTOGRAMS] = { &data.seekLatency, &data.stateChangeLatency,
+        &data.dataMutexWait, &data.dataMutexHold, &data.stateMutexWait, &data.stateMutexHold,
+        &data.probeTime, &data.dispatchDelay, &data.cueJitter };
+
+    for(int i = 0; i < NUM_HISTOGRAMS; i++) {
+        if(hists[i]->count == 0) continue;
+        LOG4CXX_INFO(playerMetricsLog, names[i] << ": " << hists[i]->count << " samples, avg "
+                << hists[i]->total / hists[i]->count << " us, max " << hists[i]->max << " us");
+    }
+}
+
+/**
+ * Add a sample to a histogram, the caller must serialise access to it,
+ * e.g. with metricsMutex
+ *
+ * @param hist histogram to update
+ * @param elapsed sample value (ns)
+ */
+void PlayerMetrics::addSample(Player::histogramData &hist, GstClockTime elapsed)
+{
+    unsigned long long us = elapsed / GST_USECOND;
+
+    int bucket = 0;
+    while(bucket < PLAYER_HISTOGRAM_BUCKETS - 1 && (1ULL << bucket) <= us)
+        bucket++;
+
+    hist.count++;
+    hist.total += us;
+    if(us > hist.max) hist.max = us;
+    hist.buckets[bucket]++;
+}
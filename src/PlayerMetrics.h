@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PLAYERMETRICS_H
+#define PLAYERMETRICS_H
+
+#include <pthread.h>
+#include <gst/gst.h>
+
+#include "Player.h"
+
+class PlayerMetrics
+{
+    public:
+        enum counter {
+            BUFFERS_PROCESSED,  // Buffers let through cb_data_probe
+            BUFFERS_SKIPPED,    // Buffers dropped in the seek margin
+            REOPEN_RETRIES,     // Datasource errors that caused a reopen
+            AGC_ADJUSTMENTS,    // Amplification changes from the level element
+            QOS_EVENTS,         // QOS events seen at the sink
+            TIME_NOTIFICATIONS, // onPlayerTime signals sent
+            NUM_COUNTERS
+        };
+
+        enum histogram {
+            SEEK_LATENCY,         // Seek issued -> first buffer at the sink
+            STATE_CHANGE_LATENCY, // Time spent in waitStateChange
+            DATAMUTEX_WAIT,
+            DATAMUTEX_HOLD,
+            STATEMUTEX_WAIT,
+            STATEMUTEX_HOLD,
+            PROBE_TIME,           // Time spent in cb_data_probe on the streaming thread
+            DISPATCH_DELAY,       // Signal posted -> application callback called
+            CUE_JITTER,           // Cue audible -> OnPlayerCue called
+            NUM_HISTOGRAMS
+        };
+
+        PlayerMetrics();
+        ~PlayerMetrics();
+
+        void count(counter c, unsigned long n = 1);
+        void record(histogram h, GstClockTime elapsed);
+        void start(histogram h);
+        void stop(histogram h);
+
+        Player::metricsData snapshot();
+        void reset();
+        void dump();
+        void dump(const Player::metricsData &data);
+
+        static void addSample(Player::histogramData &hist, GstClockTime elapsed);
+
+    private:
+
+        pthread_mutex_t metricsMutex;
+        unsigned long counters[NUM_COUNTERS];
+        Player::histogramData histograms[NUM_HISTOGRAMS];
+        GstClockTime started[NUM_HISTOGRAMS];
+};
+
+/**
+ * Records the lifetime of the object in a histogram
+ */
+class PlayerMetricsTimer
+{
+    public:
+        PlayerMetricsTimer(PlayerMetrics &m, PlayerMetrics::histogram h): metrics(m), hist(h), start(gst_util_get_timestamp()) {}
+        ~PlayerMetricsTimer() { metrics.record(hist, gst_util_get_timestamp() - start); }
+    private:
+        PlayerMetrics &metrics;
+        PlayerMetrics::histogram hist;
+        GstClockTime start;
+};
+
+#endif
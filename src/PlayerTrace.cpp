@@ -0,0 +1,207 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include <vector>
+#include <log4cxx/logger.h>
+
+#include "PlayerTrace.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr playerTraceLog(log4cxx::Logger::getLogger("kolibre.player.playertrace"));
+
+using namespace std;
+
+PlayerTrace::PlayerTrace():
+    enabled(0),
+    nextTid(1)
+{
+    pthread_key_create(&ringKey, threadExit);
+    pthread_mutex_init(&ringsMutex, NULL);
+    for(int i = 0; i < TRACE_MAX_THREADS; i++)
+        rings[i] = NULL;
+    epoch = gst_util_get_timestamp();
+}
+
+PlayerTrace::~PlayerTrace()
+{
+    g_atomic_int_set(&enabled, 0);
+    pthread_key_delete(ringKey);
+    for(int i = 0; i < TRACE_MAX_THREADS; i++)
+        delete rings[i];
+    pthread_mutex_destroy(&ringsMutex);
+}
+
+/**
+ * Turn tracing on or off, recorded events are kept
+ *
+ * @param enable true to start recording
+ */
+void PlayerTrace::setEnabled(bool enable)
+{
+    g_atomic_int_set(&enabled, enable ? 1 : 0);
+}
+
+/**
+ * Append an event to the ring of the calling thread
+ *
+ * @param cat event category
+ * @param name event name
+ * @param phase Chrome trace phase ('B', 'E', 'i' or 'C')
+ * @param arg value stored with the event
+ */
+void PlayerTrace::add(const char *cat, const char *name, char phase, gint64 arg)
+{
+    ring *r = threadRing(cat);
+    if(r == NULL) return;
+
+    gint head = r->head;
+    event &e = r->events[head % TRACE_RING_SIZE];
+    e.ts = gst_util_get_timestamp();
+    e.cat = cat;
+    e.name = name;
+    e.arg = arg;
+    e.phase = phase;
+
+    // Publish the event, dump() never reads past head
+    g_atomic_int_set(&r->head, head + 1);
+}
+
+/**
+ * Get the ring of the calling thread, registering it on first use.
+ * The thread is named after the category of its first event.
+ *
+ * @param cat category of the event being recorded
+ * @return ring or NULL if all slots belong to running threads
+ */
+PlayerTrace::ring *PlayerTrace::threadRing(const char *cat)
+{
+    ring *r = (ring *)pthread_getspecific(ringKey);
+    if(r != NULL) return r;
+
+    pthread_mutex_lock(&ringsMutex);
+    int slot = -1;
+    for(int i = 0; i < TRACE_MAX_THREADS; i++) {
+        if(rings[i] == NULL) { slot = i; break; }
+        // Reuse the slot of an exited thread
+        if(slot == -1 && g_atomic_int_get(&rings[i]->alive) == 0) slot = i;
+    }
+
+    if(slot != -1) {
+        if(rings[slot] == NULL) rings[slot] = new ring;
+        r = rings[slot];
+        r->tid = nextTid++;
+        r->threadname = cat;
+        g_atomic_int_set(&r->head, 0);
+        g_atomic_int_set(&r->alive, 1);
+        pthread_setspecific(ringKey, r);
+    }
+    pthread_mutex_unlock(&ringsMutex);
+
+    if(r == NULL) LOG4CXX_WARN(playerTraceLog, "Too many threads, events not recorded");
+    return r;
+}
+
+/**
+ * Called when a traced thread exits, its events are kept until the
+ * slot is needed by another thread
+ */
+void PlayerTrace::threadExit(void *r)
+{
+    g_atomic_int_set(&((ring *)r)->alive, 0);
+}
+
+/**
+ * Forget all recorded events
+ */
+void PlayerTrace::clear()
+{
+    pthread_mutex_lock(&ringsMutex);
+    epoch = gst_util_get_timestamp();
+    pthread_mutex_unlock(&ringsMutex);
+}
+
+/**
+ * Write the recorded events in Chrome trace event format,
+ * the file can be opened in chrome://tracing or Perfetto
+ *
+ * @param filename file to write
+ * @return true on success
+ */
+bool PlayerTrace::dump(const string &filename)
+{
+    FILE *fp = fopen(filename.c_str(), "w");
+    if(fp == NULL) {
+        LOG4CXX_ERROR(playerTraceLog, "Failed to open '" << filename << "' for writing");
+        return false;
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"kolibre-player\"}}");
+
+    int written = 0;
+    vector<event> events;
+    events.reserve(TRACE_RING_SIZE);
+
+    pthread_mutex_lock(&ringsMutex);
+    for(int i = 0; i < TRACE_MAX_THREADS; i++) {
+        ring *r = rings[i];
+        if(r == NULL) continue;
+
+        gint head = g_atomic_int_get(&r->head);
+        gint first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        events.clear();
+        for(gint n = first; n < head; n++)
+            events.push_back(r->events[n % TRACE_RING_SIZE]);
+
+        // The writer may have lapped us while copying, drop what it overwrote
+        gint after = g_atomic_int_get(&r->head);
+        size_t skip = 0;
+        if(after - TRACE_RING_SIZE > first)
+            skip = after - TRACE_RING_SIZE - first;
+        if(skip > events.size()) skip = events.size();
+
+        fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                r->tid, r->threadname);
+
+        for(size_t n = skip; n < events.size(); n++) {
+            const event &e = events[n];
+            if(e.ts < epoch) continue;
+            double ts = (double)(e.ts - epoch) / GST_USECOND;
+
+            fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                    e.name, e.cat, e.phase, ts, r->tid);
+            if(e.phase == 'i')
+                fprintf(fp, ",\"s\":\"t\",\"args\":{\"value\":%lld}", (long long)e.arg);
+            else if(e.phase == 'C')
+                fprintf(fp, ",\"args\":{\"%s\":%lld}", e.name, (long long)e.arg);
+            fprintf(fp, "}");
+            written++;
+        }
+    }
+    pthread_mutex_unlock(&ringsMutex);
+
+    fprintf(fp, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    bool ok = (ferror(fp) == 0);
+    fclose(fp);
+
+    LOG4CXX_INFO(playerTraceLog, "Wrote " << written << " trace events to '" << filename << "'");
+    return ok;
+}
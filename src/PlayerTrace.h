@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PLAYERTRACE_H
+#define PLAYERTRACE_H
+
+#include <string>
+#include <pthread.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+// Events kept per thread, older events are overwritten
+#define TRACE_RING_SIZE 8192
+// Threads that can be traced at the same time
+#define TRACE_MAX_THREADS 16
+
+/**
+ * Records timestamped spans and events into one ring buffer per thread
+ * and writes them as a Chrome/Perfetto JSON trace.
+ *
+ * Writing an event never takes a lock, each ring has a single writer
+ * (its thread) and publishes its head with an atomic store. A lock is
+ * only taken the first time a thread records something and when dumping.
+ *
+ * The category and name of an event must be string literals, only the
+ * pointers are stored.
+ */
+class PlayerTrace
+{
+    public:
+        PlayerTrace();
+        ~PlayerTrace();
+
+        void setEnabled(bool enabled);
+        bool isEnabled() { return g_atomic_int_get(&enabled) != 0; }
+
+        void begin(const char *cat, const char *name) { if(isEnabled()) add(cat, name, 'B', 0); }
+        void end(const char *cat, const char *name) { if(isEnabled()) add(cat, name, 'E', 0); }
+        void instant(const char *cat, const char *name, gint64 arg = 0) { if(isEnabled()) add(cat, name, 'i', arg); }
+        void counter(const char *cat, const char *name, gint64 value) { if(isEnabled()) add(cat, name, 'C', value); }
+
+        bool dump(const std::string &filename);
+        void clear();
+
+    private:
+        struct event {
+            GstClockTime ts;
+            const char *cat;
+            const char *name;
+            gint64 arg;
+            char phase;
+        };
+
+        struct ring {
+            event events[TRACE_RING_SIZE];
+            gint head;      // Number of events written, only changed by the owner
+            gint alive;     // Owner thread is still running
+            int tid;        // Id shown in the trace
+            const char *threadname;
+        };
+
+        void add(const char *cat, const char *name, char phase, gint64 arg);
+        ring *threadRing(const char *cat);
+        static void threadExit(void *r);
+
+        gint enabled;
+        int nextTid;
+        pthread_key_t ringKey;
+        pthread_mutex_t ringsMutex;
+        ring *rings[TRACE_MAX_THREADS];
+        GstClockTime epoch;
+};
+
+/**
+ * Traces a span covering the lifetime of the object
+ */
+class PlayerTraceSpan
+{
+    public:
+        PlayerTraceSpan(PlayerTrace &t, const char *c, const char *n): trace(t), cat(c), name(n) { trace.begin(cat, name); }
+        ~PlayerTraceSpan() { trace.end(cat, name); }
+    private:
+        PlayerTrace &trace;
+        const char *cat;
+        const char *name;
+};
+
+#endif
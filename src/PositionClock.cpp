@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "PositionClock.h"
+
+PositionClock::PositionClock():
+    seq(0),
+    clock(NULL),
+    retired(NULL),
+    baseTime(0),
+    latency(0),
+    held(0),
+    head(0)
+{
+    pthread_mutex_init(&writeMutex, NULL);
+}
+
+PositionClock::~PositionClock()
+{
+    if(clock != NULL) gst_object_unref(clock);
+    if(retired != NULL) gst_object_unref(retired);
+    pthread_mutex_destroy(&writeMutex);
+}
+
+void PositionClock::beginWrite()
+{
+    pthread_mutex_lock(&writeMutex);
+    g_atomic_int_set(&seq, seq + 1);
+}
+
+void PositionClock::endWrite()
+{
+    g_atomic_int_set(&seq, seq + 1);
+    pthread_mutex_unlock(&writeMutex);
+}
+
+/**
+ * Start interpolating, when the pipeline has gone to PLAYING
+ *
+ * @param clock the pipeline clock, a reference is taken
+ * @param baseTime base time of the pipeline
+ * @param latency pipeline latency the sinks wait for
+ */
+void PositionClock::start(GstClock *clock, GstClockTime baseTime, GstClockTime latency)
+{
+    gst_object_ref(clock);
+
+    beginWrite();
+    // A reader may still be asking the previous clock for the time, it is
+    // released at the next change which is at least one state change away
+    if(retired != NULL) gst_object_unref(retired);
+    retired = this->clock;
+    this->clock = clock;
+    this->baseTime = baseTime;
+    this->latency = latency;
+    endWrite();
+}
+
+/**
+ * Hold the position heard right now, when the pipeline leaves PLAYING
+ */
+void PositionClock::pause()
+{
+    gint64 now = position();
+
+    beginWrite();
+    held = now;
+    if(retired != NULL) gst_object_unref(retired);
+    retired = clock;
+    clock = NULL;
+    endWrite();
+}
+
+/**
+ * Forget everything, when the pipeline is stopped
+ */
+void PositionClock::stop()
+{
+    beginWrite();
+    if(retired != NULL) gst_object_unref(retired);
+    retired = clock;
+    clock = NULL;
+    held = 0;
+    head = 0;
+    endWrite();
+}
+
+/**
+ * Drop the queued buffers, when the sink is flushed. The position stays
+ * where it was until a buffer after the flush arrives.
+ */
+void PositionClock::flush()
+{
+    gint64 now = position();
+
+    beginWrite();
+    held = now;
+    head = 0;
+    endWrite();
+}
+
+/**
+ * Record a buffer arriving at the sink
+ *
+ * @param runningTime running time of the buffer
+ * @param duration length of the buffer
+ * @param position file position of the first sample
+ * @param tempo file time played per running time
+ */
+void PositionClock::add(GstClockTime runningTime, GstClockTime duration, gint64 position, double tempo)
+{
+    beginWrite();
+    anchor &a = anchors[head % POSITION_ANCHORS];
+    a.runningTime = runningTime;
+    a.duration = GST_CLOCK_TIME_IS_VALID(duration) ? duration : 0;
+    a.position = position;
+    a.tempo = tempo;
+    // A seek while paused shows the new position right away
+    if(head == 0 && clock == NULL) held = position;
+    head++;
+    endWrite();
+}
+
+/**
+ * @return the file position audible right now (ns)
+ */
+gint64 PositionClock::position()
+{
+    GstClock *c = (GstClock *)g_atomic_pointer_get(&clock);
+    return positionAt(c != NULL ? gst_clock_get_time(c) : GST_CLOCK_TIME_NONE);
+}
+
+/**
+ * Find the file position audible at a clock time
+ *
+ * @param now time of the pipeline clock
+ * @return file position (ns)
+ */
+gint64 PositionClock::positionAt(GstClockTime now)
+{
+    for(;;) {
+        gint before = g_atomic_int_get(&seq);
+        if(before & 1) continue;
+
+        gint64 result = held;
+        gint n = head < POSITION_ANCHORS ? head : POSITION_ANCHORS;
+        if(clock != NULL && GST_CLOCK_TIME_IS_VALID(now) && n > 0) {
+            // Running time of what leaves the speaker now
+            GstClockTimeDiff audible = GST_CLOCK_DIFF(baseTime + latency, now);
+
+            const anchor *due = NULL;
+            for(gint i = 1; i <= n; i++) {
+                const anchor &a = anchors[(head - i) % POSITION_ANCHORS];
+                if((GstClockTimeDiff)a.runningTime <= audible) {
+                    due = &a;
+                    break;
+                }
+            }
+
+            if(due == NULL) {
+                // Nothing played since the flush, the oldest queued buffer is next
+                result = anchors[(head - n) % POSITION_ANCHORS].position;
+            } else {
+                GstClockTimeDiff into = audible - (GstClockTimeDiff)due->runningTime;
+                if(into > (GstClockTimeDiff)due->duration) into = due->duration;
+                result = due->position + (gint64)(into * due->tempo);
+            }
+        }
+
+        if(g_atomic_int_get(&seq) == before) return result;
+    }
+}
+
+/**
+ * Estimate when a file position will be heard
+ *
+ * @param position file position (ns)
+ * @return pipeline clock time, GST_CLOCK_TIME_NONE when not playing
+ */
+GstClockTime PositionClock::clockTimeAt(gint64 position)
+{
+    for(;;) {
+        gint before = g_atomic_int_get(&seq);
+        if(before & 1) continue;
+
+        GstClockTime result = GST_CLOCK_TIME_NONE;
+        if(clock != NULL && head > 0) {
+            const anchor &a = anchors[(head - 1) % POSITION_ANCHORS];
+            GstClockTimeDiff running = (GstClockTimeDiff)a.runningTime + (GstClockTimeDiff)((position - a.position) / a.tempo);
+            if(running < 0) running = 0;
+            result = baseTime + latency + running;
+        }
+
+        if(g_atomic_int_get(&seq) == before) return result;
+    }
+}
@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef POSITIONCLOCK_H
+#define POSITIONCLOCK_H
+
+#include <pthread.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+// Buffers remembered between the sink pad and the speaker, enough for
+// the largest sink buffer-time with 10 ms buffers
+#define POSITION_ANCHORS 128
+
+/**
+ * Tells what is audible right now, from any thread without a lock.
+ *
+ * Every buffer reaching the sink is recorded as an anchor: its running
+ * time, its length and the file position it starts at. The sink plays the
+ * buffer when the pipeline clock reaches base time + running time +
+ * latency, so the position at a clock time is found by taking the newest
+ * anchor already due and moving forward from it at the tempo, up to the
+ * end of the buffer. Buffers queued in the sink are not counted until they
+ * are heard, and positions move smoothly between buffers.
+ *
+ * Writers (the streaming thread and the bus thread) serialize on a mutex
+ * and bump a sequence number around every change. Readers copy what they
+ * need and retry if the sequence number was odd or changed meanwhile.
+ *
+ * The other way round, the clock time a later file position will be heard
+ * at is extrapolated from the newest buffer, assuming playback runs on at
+ * the same tempo.
+ *
+ * While paused or before the pipeline clock is known the position stays
+ * where it was last heard. Positions are in nanoseconds of the file.
+ */
+class PositionClock
+{
+    public:
+        PositionClock();
+        ~PositionClock();
+
+        void start(GstClock *clock, GstClockTime baseTime, GstClockTime latency);
+        void pause();
+        void stop();
+        void flush();
+        void add(GstClockTime runningTime, GstClockTime duration, gint64 position, double tempo);
+
+        gint64 position();
+        gint64 positionAt(GstClockTime now);
+        GstClockTime clockTimeAt(gint64 position);
+
+    private:
+        struct anchor {
+            GstClockTime runningTime;   // When the buffer starts playing
+            GstClockTime duration;      // Running time the buffer lasts
+            gint64 position;            // File position of the first sample
+            double tempo;               // File time per running time
+        };
+
+        void beginWrite();
+        void endWrite();
+
+        gint seq;                       // Odd while a writer is busy
+        pthread_mutex_t writeMutex;
+
+        GstClock *clock;                // Pipeline clock, NULL when not playing
+        GstClock *retired;              // Previous clock, kept for readers still using it
+        GstClockTime baseTime;
+        GstClockTime latency;
+        gint64 held;                    // Position while not playing
+
+        anchor anchors[POSITION_ANCHORS];
+        gint head;                      // Anchors added since the last flush
+};
+
+#endif
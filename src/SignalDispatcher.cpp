@@ -0,0 +1,203 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <log4cxx/logger.h>
+
+#include "SignalDispatcher.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr signalDispatcherLog(log4cxx::Logger::getLogger("kolibre.player.signaldispatcher"));
+
+using namespace std;
+
+SignalDispatcher::SignalDispatcher():
+    context(NULL),
+    started(false),
+    stopping(false)
+{
+    pthread_mutex_init(&dispatchMutex, NULL);
+    pthread_cond_init(&jobCond, NULL);
+
+    // A job may shut the dispatcher down
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    idleState = new IdleState;
+    pthread_mutex_init(&idleState->runMutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    idleState->alive = true;
+    idleState->refs = 1;
+}
+
+SignalDispatcher::~SignalDispatcher()
+{
+    shutdown();
+    release(idleState);
+    if(context != NULL) g_main_context_unref(context);
+    pthread_cond_destroy(&jobCond);
+    pthread_mutex_destroy(&dispatchMutex);
+}
+
+/**
+ * Run the following jobs from a GMainContext
+ *
+ * @param context context to attach jobs to, NULL for the dispatch thread
+ */
+void SignalDispatcher::setContext(GMainContext *context)
+{
+    if(context != NULL) g_main_context_ref(context);
+
+    pthread_mutex_lock(&dispatchMutex);
+    GMainContext *old = this->context;
+    this->context = context;
+    pthread_mutex_unlock(&dispatchMutex);
+
+    if(old != NULL) g_main_context_unref(old);
+}
+
+/**
+ * Queue a job, returns without waiting for it
+ *
+ * @param j the job
+ */
+void SignalDispatcher::post(const job &j)
+{
+    pthread_mutex_lock(&dispatchMutex);
+    if(stopping) {
+        pthread_mutex_unlock(&dispatchMutex);
+        return;
+    }
+
+    if(context != NULL) {
+        IdleJob *idle = new IdleJob;
+        idle->state = idleState;
+        idle->dispatcher = this;
+        idle->source = g_idle_source_new();
+        idle->j = j;
+        g_atomic_int_inc(&idleState->refs);
+
+        // The reference of g_idle_source_new is kept in sources until the job runs
+        sources.push_back(idle->source);
+        g_source_set_callback(idle->source, dispatch_idle, idle, free_job);
+        g_source_attach(idle->source, context);
+        pthread_mutex_unlock(&dispatchMutex);
+        return;
+    }
+
+    jobs.push_back(j);
+    if(!started) {
+        LOG4CXX_DEBUG(signalDispatcherLog, "Setting up dispatch thread");
+        started = pthread_create(&thread, NULL, dispatch_thread, this) == 0;
+        if(!started) LOG4CXX_ERROR(signalDispatcherLog, "Failed to start dispatch thread");
+    }
+    pthread_cond_signal(&jobCond);
+    pthread_mutex_unlock(&dispatchMutex);
+}
+
+/**
+ * Stop the dispatch thread, jobs not yet run are dropped. Waits for a job
+ * running from a context, unless it is the caller.
+ */
+void SignalDispatcher::shutdown()
+{
+    pthread_mutex_lock(&idleState->runMutex);
+    idleState->alive = false;
+    pthread_mutex_unlock(&idleState->runMutex);
+
+    pthread_mutex_lock(&dispatchMutex);
+    stopping = true;
+    jobs.clear();
+    list<GSource *> pending;
+    pending.swap(sources);
+    pthread_cond_signal(&jobCond);
+    bool join = started;
+    started = false;
+    pthread_mutex_unlock(&dispatchMutex);
+
+    for(list<GSource *>::iterator it = pending.begin(); it != pending.end(); ++it) {
+        g_source_destroy(*it);
+        g_source_unref(*it);
+    }
+
+    if(join) pthread_join(thread, NULL);
+}
+
+void *SignalDispatcher::dispatch_thread(void *dispatcher)
+{
+    ((SignalDispatcher *)dispatcher)->run();
+    return NULL;
+}
+
+/**
+ * Run jobs until shutdown
+ */
+void SignalDispatcher::run()
+{
+    for(;;) {
+        pthread_mutex_lock(&dispatchMutex);
+        while(jobs.empty() && !stopping)
+            pthread_cond_wait(&jobCond, &dispatchMutex);
+        if(stopping) {
+            pthread_mutex_unlock(&dispatchMutex);
+            return;
+        }
+        job j = jobs.front();
+        jobs.pop_front();
+        pthread_mutex_unlock(&dispatchMutex);
+
+        j();
+    }
+}
+
+gboolean SignalDispatcher::dispatch_idle(gpointer data)
+{
+    IdleJob *idle = (IdleJob *)data;
+
+    // While alive is set under runMutex the dispatcher exists
+    pthread_mutex_lock(&idle->state->runMutex);
+    if(idle->state->alive) {
+        SignalDispatcher *dispatcher = idle->dispatcher;
+        pthread_mutex_lock(&dispatcher->dispatchMutex);
+        dispatcher->sources.remove(idle->source);
+        pthread_mutex_unlock(&dispatcher->dispatchMutex);
+        g_source_unref(idle->source);
+
+        idle->j();
+    }
+    pthread_mutex_unlock(&idle->state->runMutex);
+    return FALSE;
+}
+
+void SignalDispatcher::free_job(gpointer data)
+{
+    IdleJob *idle = (IdleJob *)data;
+    release(idle->state);
+    delete idle;
+}
+
+/**
+ * Drop a reference to the state shared with the idle sources
+ */
+void SignalDispatcher::release(IdleState *state)
+{
+    if(g_atomic_int_dec_and_test(&state->refs)) {
+        pthread_mutex_destroy(&state->runMutex);
+        delete state;
+    }
+}
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIGNALDISPATCHER_H
+#define SIGNALDISPATCHER_H
+
+#include <list>
+#include <pthread.h>
+#include <glib.h>
+#include <boost/function.hpp>
+
+/**
+ * Runs application callbacks away from the thread that asks for them.
+ *
+ * Jobs are run one at a time, in the order they were posted, on a thread
+ * of the dispatcher's own that is started with the first job. When a
+ * GMainContext is set they are run from that context instead, as idle
+ * sources, e.g. on the application's main loop. Sources not yet run when
+ * the dispatcher shuts down are destroyed, and a job that is running holds
+ * up the shutdown, so no job runs on a destroyed dispatcher's owner.
+ *
+ * Posting takes a short lock and never waits for a job to run, so it can
+ * be done from the streaming thread.
+ */
+class SignalDispatcher
+{
+    public:
+        typedef boost::function<void ()> job;
+
+        SignalDispatcher();
+        ~SignalDispatcher();
+
+        void setContext(GMainContext *context);
+        void post(const job &j);
+        void shutdown();
+
+    private:
+        // Shared with the idle sources, which may outlive the dispatcher
+        struct IdleState {
+            pthread_mutex_t runMutex;   // Held while a job runs, recursive
+            bool alive;                 // Jobs may run, cleared by shutdown
+            gint refs;
+        };
+        struct IdleJob {
+            IdleState *state;
+            SignalDispatcher *dispatcher;
+            GSource *source;
+            job j;
+        };
+
+        static void *dispatch_thread(void *dispatcher);
+        static gboolean dispatch_idle(gpointer data);
+        static void free_job(gpointer data);
+        static void release(IdleState *state);
+        void run();
+
+        pthread_mutex_t dispatchMutex;
+        pthread_cond_t jobCond;
+        std::list<job> jobs;
+        GMainContext *context;  // NULL to use the dispatch thread
+        IdleState *idleState;
+        std::list<GSource *> sources;   // Attached and not run, a reference each
+        pthread_t thread;
+        bool started;           // thread is running
+        bool stopping;
+};
+
+#endif
@@ -0,0 +1,242 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+#include <cstring>
+
+#include "SilenceCompressor.h"
+
+static inline double sampleValue(short s) { return s / 32768.0; }
+static inline double sampleValue(float s) { return s; }
+
+SilenceCompressor::SilenceCompressor(int rate, int channels, bool isFloat):
+    rate(rate),
+    channels(channels),
+    isFloat(isFloat),
+    enabled(true),
+    envelope(0.0),
+    silent(false),
+    pauseFrames(0),
+    delayHead(0),
+    delayFrames(0),
+    outFrames(0),
+    dropped(0),
+    droppedTotal(0)
+{
+    bytesPerFrame = channels * (isFloat ? sizeof(float) : sizeof(short));
+    attack = 1.0 - exp(-1000.0 / (SILENCE_ATTACK_MS * rate));
+    release = 1.0 - exp(-1000.0 / (SILENCE_RELEASE_MS * rate));
+    lookaheadFrames = SILENCE_LOOKAHEAD_MS * rate / 1000;
+    delay.resize((lookaheadFrames + 1) * bytesPerFrame);
+
+    setThreshold(SILENCE_THRESHOLD_DB);
+    setMaxPause(SILENCE_MAX_PAUSE_MS);
+}
+
+/**
+ * Turn dropping of silence on or off
+ *
+ * @param enable true to shorten pauses
+ */
+void SilenceCompressor::setEnabled(bool enable)
+{
+    enabled = enable;
+}
+
+/**
+ * Set the level below which audio counts as silence
+ *
+ * @param dB level relative to full scale
+ */
+void SilenceCompressor::setThreshold(double dB)
+{
+    closeLevel = pow(10.0, dB / 10.0);
+    openLevel = pow(10.0, (dB + SILENCE_HYSTERESIS_DB) / 10.0);
+}
+
+/**
+ * Set the length pauses are shortened to
+ *
+ * @param ms pause length in milliseconds
+ */
+void SilenceCompressor::setMaxPause(int ms)
+{
+    maxPauseFrames = (int)((long long)ms * rate / 1000);
+}
+
+/**
+ * Account for one frame leaving the lookahead
+ */
+void SilenceCompressor::emit(bool keep)
+{
+    if(keep) {
+        outFrames++;
+        return;
+    }
+
+    dropped++;
+    droppedTotal++;
+    if(breakpoints.empty() || breakpoints.back().outFrame != outFrames) {
+        breakpoint bp = { outFrames, dropped };
+        breakpoints.push_back(bp);
+    } else {
+        breakpoints.back().dropped = dropped;
+    }
+}
+
+template <typename T>
+int SilenceCompressor::run(const T *in, T *out, int frames)
+{
+    int capacity = lookaheadFrames + 1;
+    int written = 0;
+
+    for(int i = 0; i < frames; i++) {
+        const T *frame = in + i * channels;
+
+        double power = 0.0;
+        for(int c = 0; c < channels; c++) {
+            double v = sampleValue(frame[c]);
+            power += v * v;
+        }
+        power /= channels;
+        envelope += (power > envelope ? attack : release) * (power - envelope);
+
+        if(silent && envelope > openLevel) {
+            silent = false;
+        } else if(!silent && envelope < closeLevel) {
+            silent = true;
+            pauseFrames = 0;
+        }
+
+        memcpy(&delay[((delayHead + delayFrames) % capacity) * bytesPerFrame], frame, bytesPerFrame);
+        delayFrames++;
+        if(delayFrames <= lookaheadFrames) continue;
+
+        // The oldest frame is decided on the state lookaheadFrames later
+        bool keep = !enabled || !silent || pauseFrames++ < maxPauseFrames;
+        if(keep) memcpy(out + written++ * channels, &delay[delayHead * bytesPerFrame], bytesPerFrame);
+        emit(keep);
+        delayHead = (delayHead + 1) % capacity;
+        delayFrames--;
+    }
+
+    return written;
+}
+
+template <typename T>
+int SilenceCompressor::drain(T *out)
+{
+    int capacity = lookaheadFrames + 1;
+    int written = 0;
+
+    while(delayFrames > 0) {
+        bool keep = !enabled || !silent || pauseFrames++ < maxPauseFrames;
+        if(keep) memcpy(out + written++ * channels, &delay[delayHead * bytesPerFrame], bytesPerFrame);
+        emit(keep);
+        delayHead = (delayHead + 1) % capacity;
+        delayFrames--;
+    }
+
+    return written;
+}
+
+/**
+ * Compress a block of audio
+ *
+ * @param in input frames
+ * @param out room for at least as many frames as the input
+ * @param frames number of input frames
+ * @return number of frames written to out
+ */
+int SilenceCompressor::process(const void *in, void *out, int frames)
+{
+    if(isFloat) return run((const float *)in, (float *)out, frames);
+    return run((const short *)in, (short *)out, frames);
+}
+
+/**
+ * Output the frames held back for lookahead, at the end of the stream
+ *
+ * @param out room for at least pending() frames
+ * @return number of frames written to out
+ */
+int SilenceCompressor::flush(void *out)
+{
+    if(isFloat) return drain((float *)out);
+    return drain((short *)out);
+}
+
+/**
+ * @return number of frames held back for lookahead
+ */
+int SilenceCompressor::pending()
+{
+    return delayFrames;
+}
+
+/**
+ * Forget all state, for a new segment. totalDroppedFrames() is kept.
+ */
+void SilenceCompressor::clear()
+{
+    envelope = 0.0;
+    silent = false;
+    pauseFrames = 0;
+    delayHead = 0;
+    delayFrames = 0;
+    outFrames = 0;
+    dropped = 0;
+    breakpoints.clear();
+}
+
+/**
+ * Map an output position to the input position it was taken from
+ *
+ * @param outFrame frames since the last clear() in the output
+ * @return frames since the last clear() in the input
+ */
+long long SilenceCompressor::toSource(long long outFrame)
+{
+    // Find the last run dropped at or before outFrame
+    size_t lo = 0, hi = breakpoints.size();
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(breakpoints[mid].outFrame <= outFrame) lo = mid + 1;
+        else hi = mid;
+    }
+    if(lo == 0) return outFrame;
+    return outFrame + breakpoints[lo - 1].dropped;
+}
+
+/**
+ * @return number of frames dropped since the last clear()
+ */
+long long SilenceCompressor::droppedFrames()
+{
+    return dropped;
+}
+
+/**
+ * @return number of frames dropped since construction
+ */
+long long SilenceCompressor::totalDroppedFrames()
+{
+    return droppedTotal;
+}
@@ -0,0 +1,112 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SILENCECOMPRESSOR_H
+#define SILENCECOMPRESSOR_H
+
+#include <vector>
+#include <stddef.h>
+
+#define SILENCE_THRESHOLD_DB -40.0  // Level below which audio counts as silence
+#define SILENCE_HYSTERESIS_DB 6.0   // Level must rise this much above the threshold to end a pause
+#define SILENCE_MAX_PAUSE_MS 300    // Pauses are shortened to this length
+#define SILENCE_LOOKAHEAD_MS 5      // Delay so that speech onsets are never cut
+#define SILENCE_ATTACK_MS 1
+#define SILENCE_RELEASE_MS 10
+
+/**
+ * Shortens pauses in speech.
+ *
+ * The level is followed with a fast attack, slow release envelope on the
+ * mean square of each frame. A pause starts when the envelope falls below
+ * the threshold and ends when it rises SILENCE_HYSTERESIS_DB above it.
+ * The first maxPause of every pause is kept, the rest is dropped frame by
+ * frame. Decisions are made SILENCE_LOOKAHEAD_MS ahead of the output so
+ * the start of the next word is always kept.
+ *
+ * When disabled nothing more is dropped, but the lookahead delay and the
+ * recorded drops stay so that the output timeline continues.
+ *
+ * Every drop is recorded so that output positions can be mapped back to
+ * input positions with toSource().
+ *
+ * Samples are interleaved 16 bit integers or 32 bit floats, counts are in
+ * frames.
+ */
+class SilenceCompressor
+{
+    public:
+        SilenceCompressor(int rate, int channels, bool isFloat);
+
+        void setEnabled(bool enable);
+        void setThreshold(double dB);
+        void setMaxPause(int ms);
+
+        int process(const void *in, void *out, int frames);
+        int flush(void *out);
+        int pending();
+        void clear();
+
+        long long toSource(long long outFrame);
+        long long droppedFrames();
+        long long totalDroppedFrames();
+
+    private:
+        template <typename T> int run(const T *in, T *out, int frames);
+        template <typename T> int drain(T *out);
+        void emit(bool keep);
+
+        int rate;
+        int channels;
+        int bytesPerFrame;
+        bool isFloat;
+        bool enabled;
+
+        double closeLevel;      // Mean square that starts a pause
+        double openLevel;       // Mean square that ends a pause
+        double attack;
+        double release;
+        int maxPauseFrames;
+        int lookaheadFrames;
+
+        double envelope;
+        bool silent;
+        long long pauseFrames;  // Length of the current pause so far
+
+        std::vector<char> delay; // Lookahead frames, oldest first
+        size_t delayHead;
+        int delayFrames;
+
+        long long outFrames;    // Frames output since clear()
+        long long dropped;      // Frames dropped since clear()
+        long long droppedTotal; // Frames dropped since construction
+
+        /**
+         * A run of dropped frames, located between output frame outFrame-1
+         * and outFrame. dropped is the total including this run.
+         */
+        struct breakpoint {
+            long long outFrame;
+            long long dropped;
+        };
+        std::vector<breakpoint> breakpoints;
+};
+
+#endif
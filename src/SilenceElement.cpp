@@ -0,0 +1,390 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <log4cxx/logger.h>
+
+#include "SilenceElement.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr silenceElementLog(log4cxx::Logger::getLogger("kolibre.player.silenceelement"));
+
+enum {
+    PROP_0,
+    PROP_ENABLED,
+    PROP_THRESHOLD,
+    PROP_MAX_PAUSE,
+    PROP_SAVED
+};
+
+#define SILENCE_CAPS \
+    "audio/x-raw-int, " \
+    "width = (int) 16, " \
+    "depth = (int) 16, " \
+    "signed = (boolean) true, " \
+    "endianness = (int) BYTE_ORDER, " \
+    "rate = (int) [ 8000, 96000 ], " \
+    "channels = (int) [ 1, 2 ]; " \
+    "audio/x-raw-float, " \
+    "width = (int) 32, " \
+    "endianness = (int) BYTE_ORDER, " \
+    "rate = (int) [ 8000, 96000 ], " \
+    "channels = (int) [ 1, 2 ]"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+        GST_PAD_SINK,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS (SILENCE_CAPS));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+        GST_PAD_SRC,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS (SILENCE_CAPS));
+
+GST_BOILERPLATE (GstKolibreSilence, gst_kolibre_silence, GstElement, GST_TYPE_ELEMENT);
+
+static void gst_kolibre_silence_finalize (GObject *object);
+static void gst_kolibre_silence_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_kolibre_silence_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static GstStateChangeReturn gst_kolibre_silence_change_state (GstElement *element, GstStateChange transition);
+static gboolean gst_kolibre_silence_setcaps (GstPad *pad, GstCaps *caps);
+static GstFlowReturn gst_kolibre_silence_chain (GstPad *pad, GstBuffer *buffer);
+static gboolean gst_kolibre_silence_sink_event (GstPad *pad, GstEvent *event);
+
+static void gst_kolibre_silence_base_init (gpointer g_class)
+{
+    GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&src_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&sink_template));
+    gst_element_class_set_details_simple (element_class, "Pause compressor",
+            "Filter/Effect/Audio", "Shortens pauses in speech", "Kolibre");
+}
+
+static void gst_kolibre_silence_class_init (GstKolibreSilenceClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+    gobject_class->set_property = gst_kolibre_silence_set_property;
+    gobject_class->get_property = gst_kolibre_silence_get_property;
+    gobject_class->finalize = gst_kolibre_silence_finalize;
+
+    g_object_class_install_property (gobject_class, PROP_ENABLED,
+            g_param_spec_boolean ("enabled", "Enabled", "Shorten pauses",
+                FALSE, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_THRESHOLD,
+            g_param_spec_double ("threshold", "Threshold", "Level in dB below which audio counts as silence",
+                -90.0, 0.0, SILENCE_THRESHOLD_DB, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_MAX_PAUSE,
+            g_param_spec_uint ("max-pause", "Max pause", "Milliseconds pauses are shortened to",
+                0, 10000, SILENCE_MAX_PAUSE_MS, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_SAVED,
+            g_param_spec_uint64 ("saved", "Saved", "Nanoseconds of silence dropped",
+                0, G_MAXUINT64, 0, (GParamFlags) G_PARAM_READABLE));
+
+    element_class->change_state = gst_kolibre_silence_change_state;
+}
+
+static void gst_kolibre_silence_init (GstKolibreSilence *self, GstKolibreSilenceClass *klass)
+{
+    self->sinkpad = gst_pad_new_from_static_template (&sink_template, "sink");
+    gst_pad_set_chain_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_kolibre_silence_chain));
+    gst_pad_set_event_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_kolibre_silence_sink_event));
+    gst_pad_set_setcaps_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_kolibre_silence_setcaps));
+    gst_pad_set_getcaps_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_pad_proxy_getcaps));
+    gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
+
+    self->srcpad = gst_pad_new_from_static_template (&src_template, "src");
+    gst_pad_set_getcaps_function (self->srcpad, GST_DEBUG_FUNCPTR (gst_pad_proxy_getcaps));
+    gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
+
+    self->compressor = NULL;
+    self->rate = 0;
+    self->bytesPerFrame = 0;
+    self->savedBefore = 0;
+    self->enabled = FALSE;
+    self->threshold = SILENCE_THRESHOLD_DB;
+    self->maxPause = SILENCE_MAX_PAUSE_MS;
+    self->changed = TRUE;
+    self->segmentStart = GST_CLOCK_TIME_NONE;
+    self->outFrames = 0;
+}
+
+static void gst_kolibre_silence_finalize (GObject *object)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (object);
+
+    delete self->compressor;
+    self->compressor = NULL;
+
+    G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/**
+ * Nanoseconds of silence dropped, called with the object lock held
+ */
+static guint64 gst_kolibre_silence_saved (GstKolibreSilence *self)
+{
+    if (self->compressor == NULL) return self->savedBefore;
+    return self->savedBefore + gst_util_uint64_scale_int (self->compressor->totalDroppedFrames (), GST_SECOND, self->rate);
+}
+
+static void gst_kolibre_silence_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (object);
+
+    GST_OBJECT_LOCK (self);
+    switch (prop_id) {
+        case PROP_ENABLED:
+            self->enabled = g_value_get_boolean (value);
+            break;
+        case PROP_THRESHOLD:
+            self->threshold = g_value_get_double (value);
+            break;
+        case PROP_MAX_PAUSE:
+            self->maxPause = g_value_get_uint (value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    self->changed = TRUE;
+    GST_OBJECT_UNLOCK (self);
+}
+
+static void gst_kolibre_silence_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (object);
+
+    GST_OBJECT_LOCK (self);
+    switch (prop_id) {
+        case PROP_ENABLED:
+            g_value_set_boolean (value, self->enabled);
+            break;
+        case PROP_THRESHOLD:
+            g_value_set_double (value, self->threshold);
+            break;
+        case PROP_MAX_PAUSE:
+            g_value_set_uint (value, self->maxPause);
+            break;
+        case PROP_SAVED:
+            g_value_set_uint64 (value, gst_kolibre_silence_saved (self));
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * Forget the mapping of the current segment
+ */
+static void gst_kolibre_silence_reset (GstKolibreSilence *self)
+{
+    GST_OBJECT_LOCK (self);
+    if (self->compressor) self->compressor->clear ();
+    self->segmentStart = GST_CLOCK_TIME_NONE;
+    self->outFrames = 0;
+    GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean gst_kolibre_silence_setcaps (GstPad *pad, GstCaps *caps)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (gst_pad_get_parent (pad));
+    GstStructure *structure = gst_caps_get_structure (caps, 0);
+    gboolean isFloat = gst_structure_has_name (structure, "audio/x-raw-float");
+    gint rate, channels;
+
+    if (!gst_structure_get_int (structure, "rate", &rate) ||
+            !gst_structure_get_int (structure, "channels", &channels) ||
+            !gst_pad_set_caps (self->srcpad, caps)) {
+        gst_object_unref (self);
+        return FALSE;
+    }
+
+    GST_OBJECT_LOCK (self);
+    self->savedBefore = gst_kolibre_silence_saved (self);
+    delete self->compressor;
+    self->compressor = new SilenceCompressor (rate, channels, isFloat);
+    self->rate = rate;
+    self->bytesPerFrame = channels * (isFloat ? sizeof(float) : sizeof(short));
+    self->segmentStart = GST_CLOCK_TIME_NONE;
+    self->outFrames = 0;
+    self->changed = TRUE;
+    GST_OBJECT_UNLOCK (self);
+
+    gst_object_unref (self);
+    return TRUE;
+}
+
+/**
+ * Push frames written by the compressor, restamped on the output timeline
+ */
+static GstFlowReturn gst_kolibre_silence_push (GstKolibreSilence *self, GstBuffer *buffer, int frames)
+{
+    if (frames == 0) {
+        gst_buffer_unref (buffer);
+        return GST_FLOW_OK;
+    }
+
+    GST_BUFFER_SIZE (buffer) = frames * self->bytesPerFrame;
+    if (GST_CLOCK_TIME_IS_VALID (self->segmentStart)) {
+        GstClockTime start = gst_util_uint64_scale_int (self->outFrames, GST_SECOND, self->rate);
+        GstClockTime end = gst_util_uint64_scale_int (self->outFrames + frames, GST_SECOND, self->rate);
+        GST_BUFFER_TIMESTAMP (buffer) = self->segmentStart + start;
+        GST_BUFFER_DURATION (buffer) = end - start;
+    }
+    self->outFrames += frames;
+
+    return gst_pad_push (self->srcpad, buffer);
+}
+
+static GstFlowReturn gst_kolibre_silence_chain (GstPad *pad, GstBuffer *buffer)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (GST_PAD_PARENT (pad));
+
+    if (self->compressor == NULL) {
+        gst_buffer_unref (buffer);
+        return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    int frames = GST_BUFFER_SIZE (buffer) / self->bytesPerFrame;
+
+    GST_OBJECT_LOCK (self);
+    if (self->changed) {
+        self->compressor->setEnabled (self->enabled);
+        self->compressor->setThreshold (self->threshold);
+        self->compressor->setMaxPause (self->maxPause);
+        self->changed = FALSE;
+    }
+    if (!GST_CLOCK_TIME_IS_VALID (self->segmentStart))
+        self->segmentStart = GST_BUFFER_TIMESTAMP (buffer);
+
+    // Nothing to do until pauses are shortened, keep the buffer as it is
+    if (!self->enabled && self->compressor->droppedFrames () == 0 && self->compressor->pending () == 0) {
+        GST_OBJECT_UNLOCK (self);
+        self->outFrames += frames;
+        return gst_pad_push (self->srcpad, buffer);
+    }
+    GST_OBJECT_UNLOCK (self);
+
+    GstBuffer *out;
+    GstFlowReturn ret = gst_pad_alloc_buffer_and_set_caps (self->srcpad, GST_BUFFER_OFFSET_NONE,
+            frames * self->bytesPerFrame, GST_PAD_CAPS (self->srcpad), &out);
+    if (ret != GST_FLOW_OK) {
+        gst_buffer_unref (buffer);
+        return ret;
+    }
+
+    GST_OBJECT_LOCK (self);
+    frames = self->compressor->process (GST_BUFFER_DATA (buffer), GST_BUFFER_DATA (out), frames);
+    GST_OBJECT_UNLOCK (self);
+    gst_buffer_unref (buffer);
+
+    return gst_kolibre_silence_push (self, out, frames);
+}
+
+static gboolean gst_kolibre_silence_sink_event (GstPad *pad, GstEvent *event)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (gst_pad_get_parent (pad));
+
+    switch (GST_EVENT_TYPE (event)) {
+        case GST_EVENT_FLUSH_STOP:
+            gst_kolibre_silence_reset (self);
+            break;
+        case GST_EVENT_NEWSEGMENT:
+            {
+                gboolean update;
+                gst_event_parse_new_segment (event, &update, NULL, NULL, NULL, NULL, NULL);
+                if (!update) gst_kolibre_silence_reset (self);
+                break;
+            }
+        case GST_EVENT_EOS:
+            if (self->compressor && self->compressor->pending () > 0) {
+                GstBuffer *out;
+                if (gst_pad_alloc_buffer_and_set_caps (self->srcpad, GST_BUFFER_OFFSET_NONE,
+                            self->compressor->pending () * self->bytesPerFrame, GST_PAD_CAPS (self->srcpad), &out) == GST_FLOW_OK) {
+                    GST_OBJECT_LOCK (self);
+                    int frames = self->compressor->flush (GST_BUFFER_DATA (out));
+                    GST_OBJECT_UNLOCK (self);
+                    gst_kolibre_silence_push (self, out, frames);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+
+    gboolean ret = gst_pad_push_event (self->srcpad, event);
+    gst_object_unref (self);
+    return ret;
+}
+
+static GstStateChangeReturn gst_kolibre_silence_change_state (GstElement *element, GstStateChange transition)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (element);
+
+    GstStateChangeReturn ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+    if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+        gst_kolibre_silence_reset (self);
+
+    return ret;
+}
+
+/**
+ * Map a timestamp downstream of a kolibresilence element back to the
+ * timestamp it had upstream
+ *
+ * @param element kolibresilence element
+ * @param time downstream timestamp
+ * @return upstream timestamp
+ */
+GstClockTime gst_kolibre_silence_to_source (GstElement *element, GstClockTime time)
+{
+    GstKolibreSilence *self = GST_KOLIBRE_SILENCE (element);
+
+    GST_OBJECT_LOCK (self);
+    if (self->compressor != NULL && GST_CLOCK_TIME_IS_VALID (self->segmentStart) &&
+            GST_CLOCK_TIME_IS_VALID (time) && time > self->segmentStart) {
+        guint64 frames = gst_util_uint64_scale_int (time - self->segmentStart, self->rate, GST_SECOND);
+        GstClockTime rest = time - self->segmentStart - gst_util_uint64_scale_int (frames, GST_SECOND, self->rate);
+        frames = self->compressor->toSource (frames);
+        time = self->segmentStart + gst_util_uint64_scale_int (frames, GST_SECOND, self->rate) + rest;
+    }
+    GST_OBJECT_UNLOCK (self);
+
+    return time;
+}
+
+/**
+ * Make the kolibresilence element available to gst_element_factory_make
+ *
+ * @return true on success
+ */
+bool silence_element_register()
+{
+    if (!gst_element_register (NULL, "kolibresilence", GST_RANK_NONE, GST_TYPE_KOLIBRE_SILENCE)) {
+        LOG4CXX_ERROR(silenceElementLog, "Failed to register kolibresilence element");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#ifndef SILENCEELEMENT_H
+#define SILENCEELEMENT_H
+
+#include <gst/gst.h>
+
+#include "SilenceCompressor.h"
+
+#define GST_TYPE_KOLIBRE_SILENCE (gst_kolibre_silence_get_type())
+#define GST_KOLIBRE_SILENCE(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_KOLIBRE_SILENCE, GstKolibreSilence))
+
+/**
+ * The "kolibresilence" element shortens pauses in speech.
+ *
+ * Output timestamps run on continuously from the start of the segment, so
+ * downstream positions are ahead of the source by the silence dropped so
+ * far. gst_kolibre_silence_to_source maps them back. Seeks and queries
+ * pass through unchanged, a new segment starts a new mapping.
+ */
+typedef struct {
+    GstElement element;
+
+    GstPad *sinkpad;
+    GstPad *srcpad;
+
+    SilenceCompressor *compressor;  // Mutated in the streaming thread with the object lock held
+    gint rate;
+    gint bytesPerFrame;
+    guint64 savedBefore;            // Frames dropped by earlier compressors, at their rates in ns
+
+    // Properties, protected by the object lock
+    gboolean enabled;
+    gdouble threshold;
+    guint maxPause;
+    gboolean changed;
+
+    GstClockTime segmentStart;      // Timestamp of the first buffer in the segment
+    guint64 outFrames;              // Frames pushed since segmentStart
+} GstKolibreSilence;
+
+typedef struct {
+    GstElementClass parent_class;
+} GstKolibreSilenceClass;
+
+GType gst_kolibre_silence_get_type(void);
+
+GstClockTime gst_kolibre_silence_to_source(GstElement *element, GstClockTime time);
+
+bool silence_element_register();
+
+#endif
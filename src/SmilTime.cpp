@@ -0,0 +1,187 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <climits>
+
+#include "SmilTime.h"
+
+#define MAX_INTEGER_DIGITS 12       // Keeps hours * 3600000 within 64 bits
+#define MAX_FRACTION_DIGITS 9
+
+static const unsigned long long powersOfTen[MAX_FRACTION_DIGITS + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL,
+    1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL
+};
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Read at least one digit at p, return false if there is none or too many
+static inline bool readInteger(const char *&p, const char *e, unsigned long long &value)
+{
+    const char *first = p;
+    value = 0;
+    while(p < e && *p >= '0' && *p <= '9') {
+        if(p - first == MAX_INTEGER_DIGITS) return false;
+        value = value * 10 + (*p++ - '0');
+    }
+    return p > first;
+}
+
+SmilTimeCode::SmilTimeCode(const char *SMILBegin, const char *SMILEnd)
+{
+    start = 0;
+    end = 0;
+    valid = true;
+
+    //Set the begin time
+    if(SMILBegin != NULL && *SMILBegin != '\0' && !parse(SMILBegin, start))
+        valid = false;
+
+    //Set the end of time
+    if(SMILEnd != NULL && *SMILEnd != '\0' && !parse(SMILEnd, end))
+        valid = false;
+}
+
+/**
+ * Convert a SMIL 2 clock value to milliseconds. Accepts full clock values
+ * (hh:mm:ss.fraction), partial clock values (mm:ss.fraction) and timecount
+ * values with an optional h, min, s or ms metric, seconds if none. An
+ * "npt=" prefix and surrounding white space are skipped, and the
+ * hh:mm:ss:ms form of older DAISY books is accepted. The leading field
+ * may exceed 59. Fractions of a millisecond are truncated.
+ *
+ * The decimal point is always '.' whatever the locale, and nothing is
+ * allocated.
+ *
+ * @param str clock value, need not be terminated
+ * @param len length of the clock value
+ * @param ms receives the time in ms, 0 if the value is not valid
+ * @return true if the value is a clock value
+ */
+bool SmilTimeCode::parse(const char *str, size_t len, unsigned long &ms)
+{
+    const char *p = str;
+    const char *e = str + len;
+    ms = 0;
+
+    while(p < e && isSpace(*p)) p++;
+    while(e > p && isSpace(e[-1])) e--;
+    if(e - p >= 4 && memcmp(p, "npt=", 4) == 0) p += 4;
+
+    // Up to four fields separated by ':'
+    unsigned long long fields[4];
+    int count = 0;
+    for(;;) {
+        if(!readInteger(p, e, fields[count++])) return false;
+        if(p == e || *p != ':' || count == 4) break;
+        p++;
+    }
+
+    unsigned long long fraction = 0;
+    int fractionDigits = 0;
+    if(p < e && *p == '.') {
+        const char *first = ++p;
+        while(p < e && *p >= '0' && *p <= '9') {
+            if(fractionDigits < MAX_FRACTION_DIGITS) {
+                fraction = fraction * 10 + (*p - '0');
+                fractionDigits++;
+            }
+            p++;
+        }
+        if(p == first) return false;
+    }
+
+    // Unit of the last field
+    unsigned long long unit = 1000;
+    if(count == 1) {
+        size_t left = e - p;
+        if(left == 0) unit = 1000;
+        else if(left == 1 && *p == 'h') unit = 3600000;
+        else if(left == 3 && memcmp(p, "min", 3) == 0) unit = 60000;
+        else if(left == 1 && *p == 's') unit = 1000;
+        else if(left == 2 && memcmp(p, "ms", 2) == 0) unit = 1;
+        else return false;
+        p = e;
+    }
+    if(p != e) return false;
+
+    unsigned long long total;
+    switch(count) {
+        case 1:
+            total = fields[0] * unit;
+            break;
+        case 2:     // mm:ss
+            if(fields[1] > 59) return false;
+            total = fields[0] * 60000 + fields[1] * 1000;
+            break;
+        case 3:     // hh:mm:ss
+            if(fields[1] > 59 || fields[2] > 59) return false;
+            total = fields[0] * 3600000 + fields[1] * 60000 + fields[2] * 1000;
+            break;
+        default:    // hh:mm:ss:ms
+            if(fields[1] > 59 || fields[2] > 59 || fields[3] > 999 || fractionDigits > 0) return false;
+            total = fields[0] * 3600000 + fields[1] * 60000 + fields[2] * 1000 + fields[3];
+            break;
+    }
+    total += fraction * unit / powersOfTen[fractionDigits];
+
+    if(total > ULONG_MAX) return false;
+    ms = (unsigned long)total;
+    return true;
+}
+
+/**
+ * Convert a terminated SMIL 2 clock value to milliseconds, see above
+ *
+ * @param str clock value
+ * @param ms receives the time in ms, 0 if the value is not valid
+ * @return true if the value is a clock value
+ */
+bool SmilTimeCode::parse(const char *str, unsigned long &ms)
+{
+    return parse(str, strlen(str), ms);
+}
+
+/**
+ * Convert many clock values, e.g. the clipBegin and clipEnd attributes of
+ * a whole book
+ *
+ * @param strs terminated clock values, entries may be NULL
+ * @param count number of values
+ * @param ms receives count times in ms, -1 for values that are missing,
+ * empty or not valid
+ * @return the number of valid values
+ */
+size_t SmilTimeCode::parse(const char *const *strs, size_t count, long long *ms)
+{
+    size_t parsed = 0;
+    for(size_t i = 0; i < count; i++) {
+        unsigned long value;
+        if(strs[i] != NULL && parse(strs[i], value)) {
+            ms[i] = value;
+            parsed++;
+        }
+        else ms[i] = -1;
+    }
+    return parsed;
+}
@@ -0,0 +1,146 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "TimeMap.h"
+
+using namespace std;
+
+TimeMap::TimeMap()
+{
+    pthread_mutex_init(&mapMutex, NULL);
+    reset(1.0);
+}
+
+TimeMap::~TimeMap()
+{
+    pthread_mutex_destroy(&mapMutex);
+}
+
+/**
+ * Start over for a new segment
+ *
+ * @param tempo tempo the segment starts with
+ */
+void TimeMap::reset(double tempo)
+{
+    breakpoint first = { 0, 0, tempo };
+    pthread_mutex_lock(&mapMutex);
+    breakpoints.clear();
+    breakpoints.push_back(first);
+    pthread_mutex_unlock(&mapMutex);
+}
+
+/**
+ * Record a tempo change
+ *
+ * @param output output time the new tempo applies from, not before the
+ * last change
+ * @param tempo the new tempo
+ */
+void TimeMap::setTempo(GstClockTime output, double tempo)
+{
+    GstClockTime source = toSource(output);
+
+    pthread_mutex_lock(&mapMutex);
+    breakpoint &last = breakpoints.back();
+    if(output <= last.output) {
+        // Nothing was played at the tempo of the last change
+        last.tempo = tempo;
+    } else {
+        breakpoint b = { output, source, tempo };
+        breakpoints.push_back(b);
+        if(breakpoints.size() > TIME_MAP_BREAKPOINTS)
+            breakpoints.erase(breakpoints.begin());
+    }
+    pthread_mutex_unlock(&mapMutex);
+}
+
+/**
+ * @return the tempo of the last change
+ */
+double TimeMap::tempo()
+{
+    pthread_mutex_lock(&mapMutex);
+    double tempo = breakpoints.back().tempo;
+    pthread_mutex_unlock(&mapMutex);
+    return tempo;
+}
+
+/**
+ * @return number of breakpoints
+ */
+size_t TimeMap::size()
+{
+    pthread_mutex_lock(&mapMutex);
+    size_t n = breakpoints.size();
+    pthread_mutex_unlock(&mapMutex);
+    return n;
+}
+
+bool TimeMap::beforeOutput(GstClockTime output, const breakpoint &b)
+{
+    return output < b.output;
+}
+
+bool TimeMap::beforeSource(GstClockTime source, const breakpoint &b)
+{
+    return source < b.source;
+}
+
+/**
+ * Convert output time to source time
+ *
+ * @param output time after the time-stretcher (ns)
+ * @return position in the file (ns)
+ */
+GstClockTime TimeMap::toSource(GstClockTime output)
+{
+    if(!GST_CLOCK_TIME_IS_VALID(output)) return GST_CLOCK_TIME_NONE;
+
+    pthread_mutex_lock(&mapMutex);
+    vector<breakpoint>::iterator it = upper_bound(breakpoints.begin(), breakpoints.end(), output, beforeOutput);
+    if(it != breakpoints.begin()) --it;
+    GstClockTimeDiff since = GST_CLOCK_DIFF(it->output, output);
+    GstClockTime source = it->source + (GstClockTimeDiff)(since * it->tempo);
+    pthread_mutex_unlock(&mapMutex);
+
+    return source;
+}
+
+/**
+ * Convert source time to output time
+ *
+ * @param source position in the file (ns)
+ * @return time after the time-stretcher (ns)
+ */
+GstClockTime TimeMap::toOutput(GstClockTime source)
+{
+    if(!GST_CLOCK_TIME_IS_VALID(source)) return GST_CLOCK_TIME_NONE;
+
+    pthread_mutex_lock(&mapMutex);
+    vector<breakpoint>::iterator it = upper_bound(breakpoints.begin(), breakpoints.end(), source, beforeSource);
+    if(it != breakpoints.begin()) --it;
+    GstClockTimeDiff since = GST_CLOCK_DIFF(it->source, source);
+    GstClockTime output = it->output + (GstClockTimeDiff)(since / it->tempo);
+    pthread_mutex_unlock(&mapMutex);
+
+    return output;
+}
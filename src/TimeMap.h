@@ -0,0 +1,73 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIMEMAP_H
+#define TIMEMAP_H
+
+#include <vector>
+#include <pthread.h>
+#include <glib.h>
+#include <gst/gst.h>
+
+// Tempo changes remembered per segment, older ones are dropped
+#define TIME_MAP_BREAKPOINTS 256
+
+/**
+ * Converts between output time, the timestamps after the time-stretcher,
+ * and source time, the position in the file.
+ *
+ * A new segment starts its output at source / tempo, so output 0 is
+ * source 0 until the tempo is changed. Each change while playing is
+ * recorded as a breakpoint: the output time it took effect at, the source
+ * time reached by then and the new tempo. A time is converted by finding
+ * the last breakpoint before it with a binary search and moving on from
+ * it at its tempo.
+ *
+ * Seeks are not converted here: the stretcher converts them with the
+ * tempo in use and starts a new segment, which resets the map.
+ */
+class TimeMap
+{
+    public:
+        TimeMap();
+        ~TimeMap();
+
+        void reset(double tempo);
+        void setTempo(GstClockTime output, double tempo);
+        double tempo();
+        size_t size();
+
+        GstClockTime toSource(GstClockTime output);
+        GstClockTime toOutput(GstClockTime source);
+
+    private:
+        struct breakpoint {
+            GstClockTime output;        // Output time the tempo took effect at
+            GstClockTime source;        // Source time at that point
+            double tempo;               // Source time per output time from here
+        };
+
+        static bool beforeOutput(GstClockTime output, const breakpoint &b);
+        static bool beforeSource(GstClockTime source, const breakpoint &b);
+
+        pthread_mutex_t mapMutex;
+        std::vector<breakpoint> breakpoints;   // Ascending in output and source
+};
+
+#endif
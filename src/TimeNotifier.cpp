@@ -0,0 +1,111 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "TimeNotifier.h"
+
+using namespace std;
+
+TimeNotifier::TimeNotifier():
+    interval(TIME_INTERVAL_MS),
+    notified(false),
+    lastms(0),
+    laststart(0),
+    laststop(0)
+{
+    pthread_mutex_init(&notifierMutex, NULL);
+}
+
+TimeNotifier::~TimeNotifier()
+{
+    pthread_mutex_destroy(&notifierMutex);
+}
+
+/**
+ * Set the media time between notifications
+ *
+ * @param ms interval in milliseconds, 0 to notify at thresholds only
+ */
+void TimeNotifier::setInterval(long ms)
+{
+    pthread_mutex_lock(&notifierMutex);
+    interval = ms > 0 ? ms : 0;
+    pthread_mutex_unlock(&notifierMutex);
+}
+
+/**
+ * Set positions that are always notified when playback passes them
+ *
+ * @param ms media positions in milliseconds, in any order
+ */
+void TimeNotifier::setThresholds(const vector<long long> &ms)
+{
+    pthread_mutex_lock(&notifierMutex);
+    thresholds = ms;
+    sort(thresholds.begin(), thresholds.end());
+    pthread_mutex_unlock(&notifierMutex);
+}
+
+/**
+ * Make the next position due, when a new file is opened
+ */
+void TimeNotifier::reset()
+{
+    pthread_mutex_lock(&notifierMutex);
+    notified = false;
+    pthread_mutex_unlock(&notifierMutex);
+}
+
+/**
+ * @return number of thresholds at or before ms
+ */
+size_t TimeNotifier::thresholdIndex(long long ms)
+{
+    return upper_bound(thresholds.begin(), thresholds.end(), ms) - thresholds.begin();
+}
+
+/**
+ * Check whether a position should be notified. If so it is remembered as
+ * the last one sent.
+ *
+ * @param ms current position (ms)
+ * @param segmentstart start of the playing segment (ms)
+ * @param segmentstop stop of the playing segment (ms)
+ * @return true if onPlayerTime should be sent
+ */
+bool TimeNotifier::due(long long ms, long long segmentstart, long long segmentstop)
+{
+    pthread_mutex_lock(&notifierMutex);
+    bool send = !notified ||
+        ms < lastms ||
+        segmentstart != laststart || segmentstop != laststop ||
+        (interval > 0 && ms / interval != lastms / interval) ||
+        thresholdIndex(ms) != thresholdIndex(lastms);
+
+    if(send) {
+        notified = true;
+        lastms = ms;
+        laststart = segmentstart;
+        laststop = segmentstop;
+    }
+    pthread_mutex_unlock(&notifierMutex);
+
+    return send;
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TIMENOTIFIER_H
+#define TIMENOTIFIER_H
+
+#include <vector>
+#include <pthread.h>
+
+#define TIME_INTERVAL_MS 100        // Default media time between onPlayerTime notifications
+
+/**
+ * Decides when the player thread sends onPlayerTime.
+ *
+ * The player thread looks at the position every loop, about every 10 ms,
+ * but a notification is only due when the position enters a new interval
+ * of media time, crosses one of the thresholds, jumps backwards or the
+ * segment changes. Several reasons in one loop give one notification.
+ * With an interval of 0 only thresholds and segment changes notify.
+ *
+ * Thresholds are media positions (ms), e.g. the clip boundaries of a SMIL
+ * file, so that a slot hears about them without being called in between.
+ */
+class TimeNotifier
+{
+    public:
+        TimeNotifier();
+        ~TimeNotifier();
+
+        void setInterval(long ms);
+        void setThresholds(const std::vector<long long> &ms);
+        void reset();
+
+        bool due(long long ms, long long segmentstart, long long segmentstop);
+
+    private:
+        size_t thresholdIndex(long long ms);
+
+        pthread_mutex_t notifierMutex;
+        long interval;
+        std::vector<long long> thresholds;  // Sorted
+
+        bool notified;                      // Something was sent since reset
+        long long lastms;
+        long long laststart;
+        long long laststop;
+};
+
+#endif
@@ -0,0 +1,557 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "Wsola.h"
+
+// Step of the coarse correlation search (frames)
+#define COARSE_STEP 4
+// Right shift of the 16 bit SSE2 products, keeps the 32 bit sums from
+// overflowing for up to MAX_CORRELATION_SAMPLES samples
+#define CORR_SHIFT 6
+#define MAX_CORRELATION_SAMPLES 2048
+
+using namespace std;
+
+/*
+ * Cross correlation of ref and cand, and energy of cand
+ */
+static inline void correlate(const short *ref, const short *cand, int n, double &cross, double &norm)
+{
+    long long c = 0, e = 0;
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128i vc = _mm_setzero_si128();
+    __m128i ve = _mm_setzero_si128();
+    for(; i + 8 <= n; i += 8) {
+        // Halve the samples so that madd can't overflow
+        __m128i a = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(ref + i)), 1);
+        __m128i b = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(cand + i)), 1);
+        vc = _mm_add_epi32(vc, _mm_srai_epi32(_mm_madd_epi16(a, b), CORR_SHIFT));
+        ve = _mm_add_epi32(ve, _mm_srai_epi32(_mm_madd_epi16(b, b), CORR_SHIFT));
+    }
+    int sum[4];
+    _mm_storeu_si128((__m128i *)sum, vc);
+    c = (long long)sum[0] + sum[1] + sum[2] + sum[3];
+    _mm_storeu_si128((__m128i *)sum, ve);
+    e = (long long)sum[0] + sum[1] + sum[2] + sum[3];
+    for(; i < n; i++) {
+        c += ((ref[i] >> 1) * (cand[i] >> 1)) >> CORR_SHIFT;
+        e += ((cand[i] >> 1) * (cand[i] >> 1)) >> CORR_SHIFT;
+    }
+#elif defined(__ARM_NEON__)
+    int64x2_t vc = vdupq_n_s64(0);
+    int64x2_t ve = vdupq_n_s64(0);
+    for(; i + 4 <= n; i += 4) {
+        int16x4_t a = vld1_s16(ref + i);
+        int16x4_t b = vld1_s16(cand + i);
+        vc = vpadalq_s32(vc, vmull_s16(a, b));
+        ve = vpadalq_s32(ve, vmull_s16(b, b));
+    }
+    c = vgetq_lane_s64(vc, 0) + vgetq_lane_s64(vc, 1);
+    e = vgetq_lane_s64(ve, 0) + vgetq_lane_s64(ve, 1);
+    for(; i < n; i++) {
+        c += ref[i] * cand[i];
+        e += cand[i] * cand[i];
+    }
+#else
+    for(; i < n; i++) {
+        c += ref[i] * cand[i];
+        e += cand[i] * cand[i];
+    }
+#endif
+
+    cross = (double)c;
+    norm = (double)e;
+}
+
+static inline void correlate(const float *ref, const float *cand, int n, double &cross, double &norm)
+{
+    float c = 0.0f, e = 0.0f;
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128 vc = _mm_setzero_ps();
+    __m128 ve = _mm_setzero_ps();
+    for(; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(ref + i);
+        __m128 b = _mm_loadu_ps(cand + i);
+        vc = _mm_add_ps(vc, _mm_mul_ps(a, b));
+        ve = _mm_add_ps(ve, _mm_mul_ps(b, b));
+    }
+    float sum[4];
+    _mm_storeu_ps(sum, vc);
+    c = sum[0] + sum[1] + sum[2] + sum[3];
+    _mm_storeu_ps(sum, ve);
+    e = sum[0] + sum[1] + sum[2] + sum[3];
+#elif defined(__ARM_NEON__)
+    float32x4_t vc = vdupq_n_f32(0.0f);
+    float32x4_t ve = vdupq_n_f32(0.0f);
+    for(; i + 4 <= n; i += 4) {
+        float32x4_t a = vld1q_f32(ref + i);
+        float32x4_t b = vld1q_f32(cand + i);
+        vc = vmlaq_f32(vc, a, b);
+        ve = vmlaq_f32(ve, b, b);
+    }
+    c = vgetq_lane_f32(vc, 0) + vgetq_lane_f32(vc, 1) + vgetq_lane_f32(vc, 2) + vgetq_lane_f32(vc, 3);
+    e = vgetq_lane_f32(ve, 0) + vgetq_lane_f32(ve, 1) + vgetq_lane_f32(ve, 2) + vgetq_lane_f32(ve, 3);
+#endif
+    for(; i < n; i++) {
+        c += ref[i] * cand[i];
+        e += cand[i] * cand[i];
+    }
+
+    cross = c;
+    norm = e;
+}
+
+/*
+ * Mean square of n samples
+ */
+static inline double meanSquare(const short *samples, int n)
+{
+    long long e = 0;
+    for(int i = 0; i < n; i++)
+        e += samples[i] * samples[i];
+    return (double)e / n;
+}
+
+static inline double meanSquare(const float *samples, int n)
+{
+    float e = 0.0f;
+    for(int i = 0; i < n; i++)
+        e += samples[i] * samples[i];
+    return e / n;
+}
+
+static inline double fullScale(short) { return 32768.0; }
+static inline double fullScale(float) { return 1.0; }
+
+/*
+ * Linear crossfade from prev to next over n samples of the given channel count
+ */
+static inline void crossfade(short *out, const short *prev, const short *next, int frames, int channels)
+{
+    for(int f = 0; f < frames; f++) {
+        int in = f, outw = frames - f;
+        for(int c = 0; c < channels; c++, out++, prev++, next++)
+            *out = (short)((*prev * outw + *next * in) / frames);
+    }
+}
+
+static inline void crossfade(float *out, const float *prev, const float *next, int frames, int channels)
+{
+    float step = 1.0f / frames;
+    for(int f = 0; f < frames; f++) {
+        float in = f * step;
+        for(int c = 0; c < channels; c++, out++, prev++, next++)
+            *out = *prev + (*next - *prev) * in;
+    }
+}
+
+template <typename T>
+void Wsola<T>::fifo::append(const T *samples, int n)
+{
+    memcpy(extend(n), samples, n * channels * sizeof(T));
+}
+
+template <typename T>
+T *Wsola<T>::fifo::extend(int n)
+{
+    // Drop consumed samples once they make up half of the buffer
+    if(head > 0 && head >= data.size() / 2) {
+        data.erase(data.begin(), data.begin() + head);
+        head = 0;
+    }
+    size_t size = data.size();
+    data.resize(size + n * channels);
+    return &data[size];
+}
+
+template <typename T>
+void Wsola<T>::fifo::consume(int n)
+{
+    head += n * channels;
+    if(head >= data.size()) clear();
+}
+
+template <typename T>
+void Wsola<T>::fifo::truncate(int n)
+{
+    if(n < frames()) data.resize(head + n * channels);
+}
+
+template <typename T>
+Wsola<T>::Wsola(int r, int ch):
+    rate(r),
+    channels(ch),
+    tempo(1.0),
+    pitch(1.0),
+    silenceAware(true),
+    targetTempo(1.0),
+    targetPitch(1.0),
+    tempoStep(0.0),
+    pitchStep(0.0)
+{
+    input.channels = stretched.channels = output.channels = channels;
+    configure();
+    clear();
+}
+
+/**
+ * Set the speed, 2.0 plays twice as fast. While samples are being
+ * processed the tempo is ramped to the new value.
+ *
+ * @param value tempo
+ */
+template <typename T>
+void Wsola<T>::setTempo(double value)
+{
+    targetTempo = value;
+    if(!haveOverlap) tempo = value;
+    tempoStep = (targetTempo - tempo) / rampFrames;
+}
+
+/**
+ * Set the pitch, 2.0 is one octave up. While samples are being processed
+ * the pitch is ramped to the new value.
+ *
+ * @param value pitch
+ */
+template <typename T>
+void Wsola<T>::setPitch(double value)
+{
+    targetPitch = value;
+    if(!haveOverlap) pitch = value;
+    pitchStep = (targetPitch - pitch) / rampFrames;
+}
+
+/**
+ * Shorten silent pieces more than speech
+ *
+ * @param enable true to enable
+ */
+template <typename T>
+void Wsola<T>::setSilenceAware(bool enable)
+{
+    silenceAware = enable;
+    if(!enable) inputAhead = 0.0;
+}
+
+/**
+ * Add samples to process
+ *
+ * @param samples interleaved samples
+ * @param frames number of frames
+ */
+template <typename T>
+void Wsola<T>::putSamples(const void *samples, int frames)
+{
+    input.append((const T *)samples, frames);
+    process();
+    resample();
+}
+
+/**
+ * Get processed samples
+ *
+ * @param samples buffer for interleaved samples
+ * @param maxFrames size of the buffer in frames
+ * @return number of frames copied
+ */
+template <typename T>
+int Wsola<T>::receiveSamples(void *samples, int maxFrames)
+{
+    int n = min(maxFrames, output.frames());
+    if(n <= 0) return 0;
+    memcpy(samples, output.ptr(), n * channels * sizeof(T));
+    output.consume(n);
+    return n;
+}
+
+/**
+ * @return number of processed frames ready to be received
+ */
+template <typename T>
+int Wsola<T>::availableFrames()
+{
+    return output.frames();
+}
+
+/**
+ * Process the input that is left, at end of stream
+ */
+template <typename T>
+void Wsola<T>::flush()
+{
+    int pending = input.frames() - (int)skipFraction;
+    if(pending < 0) pending = 0;
+    int target = output.frames() + (int)(stretched.frames() / pitch) + (int)(pending / tempo);
+
+    // Pad with silence so the last piece gets processed
+    int pad = seekFrames + sequenceFrames;
+    memset(input.extend(pad), 0, pad * channels * sizeof(T));
+    process();
+    resample();
+
+    output.truncate(target);
+    input.clear();
+    stretched.clear();
+    haveOverlap = false;
+    skipFraction = inputAhead = resamplePos = 0.0;
+}
+
+/**
+ * Drop all samples, after a flush or seek
+ */
+template <typename T>
+void Wsola<T>::clear()
+{
+    input.clear();
+    stretched.clear();
+    output.clear();
+    haveOverlap = false;
+    skipFraction = 0.0;
+    inputAhead = 0.0;
+    resamplePos = 0.0;
+
+    // Nothing to ramp from
+    tempo = targetTempo;
+    pitch = targetPitch;
+}
+
+/**
+ * Compute the piece lengths from the sample rate
+ */
+template <typename T>
+void Wsola<T>::configure()
+{
+    sequenceFrames = rate * WSOLA_SEQUENCE_MS / 1000;
+    overlapFrames = rate * WSOLA_OVERLAP_MS / 1000;
+    seekFrames = rate * WSOLA_SEEKWINDOW_MS / 1000;
+    rampFrames = rate * WSOLA_RAMP_MS / 1000;
+    if(rampFrames < 1) rampFrames = 1;
+
+    if(overlapFrames * channels > MAX_CORRELATION_SAMPLES)
+        overlapFrames = MAX_CORRELATION_SAMPLES / channels;
+    if(overlapFrames < 1) overlapFrames = 1;
+    if(sequenceFrames < 2 * overlapFrames + 1) sequenceFrames = 2 * overlapFrames + 1;
+
+    double level = fullScale(T()) * pow(10.0, WSOLA_SILENCE_DB / 20.0);
+    silenceLevel = level * level;
+
+    overlap.resize(overlapFrames * channels);
+}
+
+/**
+ * Move tempo and pitch towards the values last set
+ *
+ * @param frames output frames produced since the last step
+ */
+template <typename T>
+void Wsola<T>::ramp(int frames)
+{
+    if(tempo != targetTempo) {
+        tempo += tempoStep * frames;
+        if((tempoStep > 0) == (tempo > targetTempo)) tempo = targetTempo;
+    }
+    if(pitch != targetPitch) {
+        pitch += pitchStep * frames;
+        if((pitchStep > 0) == (pitch > targetPitch)) pitch = targetPitch;
+    }
+}
+
+/**
+ * Cut pieces from the input and overlap-add them to stretched
+ */
+template <typename T>
+void Wsola<T>::process()
+{
+    int needed = seekFrames + sequenceFrames;
+    int middle = sequenceFrames - 2 * overlapFrames;
+
+    for(;;) {
+        // Skip the input consumed by the previous piece
+        int drop = (int)skipFraction;
+        if(drop > 0) {
+            if(input.frames() < drop) {
+                skipFraction -= input.frames();
+                input.clear();
+                return;
+            }
+            input.consume(drop);
+            skipFraction -= drop;
+        }
+
+        if(input.frames() < needed) return;
+
+        ramp(sequenceFrames - overlapFrames);
+
+        // At neutral settings consecutive pieces line up and the
+        // crossfades reproduce the input
+        bool neutral = tempo == 1.0 && pitch == 1.0 && inputAhead == 0.0;
+
+        const T *in = input.ptr();
+        bool silent = !neutral && silenceAware && isSilent(in);
+        int offset = (haveOverlap && !neutral && !silent) ? seekBestOverlap(in) : 0;
+        const T *piece = in + offset * channels;
+
+        T *out = stretched.extend(sequenceFrames - overlapFrames);
+        if(haveOverlap)
+            crossfade(out, &overlap[0], piece, overlapFrames, channels);
+        else
+            memcpy(out, piece, overlapFrames * channels * sizeof(T));
+        memcpy(out + overlapFrames * channels, piece + overlapFrames * channels, middle * channels * sizeof(T));
+
+        // The end of this piece is crossfaded with the next one
+        memcpy(&overlap[0], piece + (sequenceFrames - overlapFrames) * channels, overlapFrames * channels * sizeof(T));
+        haveOverlap = true;
+
+        skipFraction += nextSkip(silent);
+    }
+}
+
+/**
+ * Resample stretched into output to change the pitch
+ */
+template <typename T>
+void Wsola<T>::resample()
+{
+    if(pitch == 1.0) {
+        output.append(stretched.ptr(), stretched.frames());
+        stretched.clear();
+        resamplePos = 0.0;
+        return;
+    }
+
+    int frames = stretched.frames();
+    if(frames < 2) return;
+
+    int n = (int)ceil((frames - 1 - resamplePos) / pitch);
+    if(n <= 0) return;
+
+    const T *src = stretched.ptr();
+    T *out = output.extend(n);
+    int produced = 0;
+    for(; produced < n && resamplePos < frames - 1; produced++, resamplePos += pitch) {
+        int i = (int)resamplePos;
+        double f = resamplePos - i;
+        const T *a = src + i * channels;
+        const T *b = a + channels;
+        for(int c = 0; c < channels; c++)
+            *out++ = (T)(a[c] + (b[c] - a[c]) * f);
+    }
+    output.truncate(output.frames() - (n - produced));
+
+    // Keep the frame the next interpolation starts from
+    int used = (int)resamplePos;
+    stretched.consume(used);
+    resamplePos -= used;
+}
+
+/**
+ * Find the offset within the seek window where the input matches the
+ * tail of the previous piece best, first in steps of COARSE_STEP frames
+ * and then around the best coarse match
+ *
+ * @param candidates input at the start of the seek window
+ * @return offset in frames
+ */
+template <typename T>
+int Wsola<T>::seekBestOverlap(const T *candidates)
+{
+    const T *ref = &overlap[0];
+    int n = overlapFrames * channels;
+    double bestScore = -1e30;
+    int best = 0;
+
+    for(int k = 0; k < seekFrames; k += COARSE_STEP) {
+        double cross, norm;
+        correlate(ref, candidates + k * channels, n, cross, norm);
+        double score = cross / sqrt(norm + 1.0);
+        if(score > bestScore) {
+            bestScore = score;
+            best = k;
+        }
+    }
+
+    int coarse = best;
+    int first = max(0, coarse - COARSE_STEP + 1);
+    int last = min(seekFrames - 1, coarse + COARSE_STEP - 1);
+    for(int k = first; k <= last; k++) {
+        if(k == coarse) continue;
+        double cross, norm;
+        correlate(ref, candidates + k * channels, n, cross, norm);
+        double score = cross / sqrt(norm + 1.0);
+        if(score > bestScore) {
+            bestScore = score;
+            best = k;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @param samples start of a piece
+ * @return true if the piece is below WSOLA_SILENCE_DB
+ */
+template <typename T>
+bool Wsola<T>::isSilent(const T *samples)
+{
+    return meanSquare(samples, sequenceFrames * channels) < silenceLevel;
+}
+
+/**
+ * Input frames to advance after a piece. Silence is skipped faster,
+ * up to WSOLA_MAX_AHEAD_MS ahead of the nominal tempo, and speech
+ * slower until the lead is used up.
+ *
+ * @param silent true if the piece was silent
+ * @return frames to skip
+ */
+template <typename T>
+double Wsola<T>::nextSkip(bool silent)
+{
+    double nominal = (sequenceFrames - overlapFrames) * tempo / pitch;
+    double maxAhead = (double)rate * WSOLA_MAX_AHEAD_MS / 1000.0;
+    double skip = nominal;
+
+    if(silent && inputAhead < maxAhead)
+        skip = min(nominal * WSOLA_SILENCE_BOOST, nominal + maxAhead - inputAhead);
+    else if(!silent && inputAhead > 0.0)
+        skip = nominal - min(inputAhead, nominal * 0.25);
+
+    inputAhead += skip - nominal;
+    return skip;
+}
+
+template class Wsola<short>;
+template class Wsola<float>;
@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WSOLA_H
+#define WSOLA_H
+
+#include <vector>
+#include <stddef.h>
+
+// Tuned for narrated speech
+#define WSOLA_SEQUENCE_MS 40    // Length of the pieces copied from the input
+#define WSOLA_OVERLAP_MS 8      // Crossfade between two pieces
+#define WSOLA_SEEKWINDOW_MS 15  // Range searched for the best matching piece
+#define WSOLA_SILENCE_DB -45.0  // Pieces below this level count as silence
+#define WSOLA_SILENCE_BOOST 1.5 // Extra tempo applied to silent pieces
+#define WSOLA_MAX_AHEAD_MS 100  // How far silence may run ahead of the nominal tempo
+#define WSOLA_RAMP_MS 50        // Time a new tempo or pitch is reached in
+
+/**
+ * Interface of the time-stretcher, independent of the sample format.
+ * Samples are interleaved, counts are in frames.
+ */
+class WsolaBase
+{
+    public:
+        virtual ~WsolaBase() {}
+
+        virtual void setTempo(double tempo) = 0;
+        virtual void setPitch(double pitch) = 0;
+        virtual void setSilenceAware(bool enable) = 0;
+
+        virtual void putSamples(const void *samples, int frames) = 0;
+        virtual int receiveSamples(void *samples, int maxFrames) = 0;
+        virtual int availableFrames() = 0;
+
+        virtual void flush() = 0;
+        virtual void clear() = 0;
+};
+
+/**
+ * WSOLA (waveform similarity overlap-add) time-stretcher for speech.
+ *
+ * The input is cut in pieces of WSOLA_SEQUENCE_MS which are crossfaded
+ * over WSOLA_OVERLAP_MS. Each piece is taken from the position within
+ * WSOLA_SEEKWINDOW_MS that best matches the end of the previous piece,
+ * found with a coarse to fine cross-correlation search. Silent pieces
+ * skip the search and are shortened more, speech is shortened less so
+ * that the average tempo stays as requested.
+ *
+ * Pitch is changed by stretching with tempo/pitch and resampling the
+ * result by pitch.
+ *
+ * Tempo and pitch can be changed while running, they move to the new
+ * values piece by piece over WSOLA_RAMP_MS. At tempo and pitch 1.0 the
+ * input is copied through unchanged, without searching or shortening
+ * silence, so it costs little to keep the stretcher in the chain.
+ *
+ * Wsola<short> works in fixed point, Wsola<float> in floating point.
+ */
+template <typename T>
+class Wsola: public WsolaBase
+{
+    public:
+        Wsola(int rate, int channels);
+
+        void setTempo(double tempo);
+        void setPitch(double pitch);
+        void setSilenceAware(bool enable);
+
+        void putSamples(const void *samples, int frames);
+        int receiveSamples(void *samples, int maxFrames);
+        int availableFrames();
+
+        void flush();
+        void clear();
+
+    private:
+        /**
+         * Interleaved sample FIFO that compacts lazily
+         */
+        struct fifo {
+            std::vector<T> data;
+            size_t head;
+            int channels;
+
+            fifo(): head(0), channels(1) {}
+            int frames() const { return (data.size() - head) / channels; }
+            T *ptr() { return &data[head]; }
+            void append(const T *samples, int n);
+            T *extend(int n);
+            void consume(int n);
+            void truncate(int n);
+            void clear() { data.clear(); head = 0; }
+        };
+
+        void configure();
+        void ramp(int frames);
+        void process();
+        void resample();
+        int seekBestOverlap(const T *candidates);
+        bool isSilent(const T *samples);
+        double nextSkip(bool silent);
+
+        int rate;
+        int channels;
+        double tempo;
+        double pitch;
+        bool silenceAware;
+
+        // Ramp towards the values last set
+        double targetTempo;
+        double targetPitch;
+        double tempoStep;       // Change per output frame
+        double pitchStep;
+        int rampFrames;
+
+        int sequenceFrames;
+        int overlapFrames;
+        int seekFrames;
+        double silenceLevel;    // Mean square below which a piece is silent
+
+        fifo input;
+        fifo stretched;         // WSOLA output, before resampling
+        fifo output;
+        std::vector<T> overlap; // Tail of the previous piece
+        bool haveOverlap;
+
+        double skipFraction;    // Fractional frames to skip from the input
+        double inputAhead;      // Input frames consumed beyond the nominal tempo
+        double resamplePos;     // Read position in stretched for the resampler
+};
+
+#endif
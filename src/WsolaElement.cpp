@@ -0,0 +1,437 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <log4cxx/logger.h>
+
+#include "WsolaElement.h"
+
+// create a logger which will become a child to logger kolibre.player
+log4cxx::LoggerPtr wsolaElementLog(log4cxx::Logger::getLogger("kolibre.player.wsolaelement"));
+
+enum {
+    PROP_0,
+    PROP_TEMPO,
+    PROP_PITCH,
+    PROP_SILENCE_AWARE
+};
+
+#define WSOLA_CAPS \
+    "audio/x-raw-int, " \
+    "width = (int) 16, " \
+    "depth = (int) 16, " \
+    "signed = (boolean) true, " \
+    "endianness = (int) BYTE_ORDER, " \
+    "rate = (int) [ 8000, 96000 ], " \
+    "channels = (int) [ 1, 2 ]; " \
+    "audio/x-raw-float, " \
+    "width = (int) 32, " \
+    "endianness = (int) BYTE_ORDER, " \
+    "rate = (int) [ 8000, 96000 ], " \
+    "channels = (int) [ 1, 2 ]"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+        GST_PAD_SINK,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS (WSOLA_CAPS));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+        GST_PAD_SRC,
+        GST_PAD_ALWAYS,
+        GST_STATIC_CAPS (WSOLA_CAPS));
+
+GST_BOILERPLATE (GstKolibreWsola, gst_kolibre_wsola, GstElement, GST_TYPE_ELEMENT);
+
+static void gst_kolibre_wsola_finalize (GObject *object);
+static void gst_kolibre_wsola_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
+static void gst_kolibre_wsola_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
+static GstStateChangeReturn gst_kolibre_wsola_change_state (GstElement *element, GstStateChange transition);
+static gboolean gst_kolibre_wsola_setcaps (GstPad *pad, GstCaps *caps);
+static GstFlowReturn gst_kolibre_wsola_chain (GstPad *pad, GstBuffer *buffer);
+static gboolean gst_kolibre_wsola_sink_event (GstPad *pad, GstEvent *event);
+static gboolean gst_kolibre_wsola_src_event (GstPad *pad, GstEvent *event);
+static gboolean gst_kolibre_wsola_src_query (GstPad *pad, GstQuery *query);
+
+static void gst_kolibre_wsola_base_init (gpointer g_class)
+{
+    GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&src_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&sink_template));
+    gst_element_class_set_details_simple (element_class, "Speech time-stretcher",
+            "Filter/Effect/Audio", "Changes tempo and pitch of speech using WSOLA", "Kolibre");
+}
+
+static void gst_kolibre_wsola_class_init (GstKolibreWsolaClass *klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+    GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+    gobject_class->set_property = gst_kolibre_wsola_set_property;
+    gobject_class->get_property = gst_kolibre_wsola_get_property;
+    gobject_class->finalize = gst_kolibre_wsola_finalize;
+
+    g_object_class_install_property (gobject_class, PROP_TEMPO,
+            g_param_spec_double ("tempo", "Tempo", "Playback speed, 2.0 is twice as fast",
+                0.1, 10.0, 1.0, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_PITCH,
+            g_param_spec_double ("pitch", "Pitch", "Pitch factor, 2.0 is one octave up",
+                0.1, 10.0, 1.0, (GParamFlags) G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_SILENCE_AWARE,
+            g_param_spec_boolean ("silence-aware", "Silence aware", "Shorten pauses more than speech",
+                TRUE, (GParamFlags) G_PARAM_READWRITE));
+
+    element_class->change_state = gst_kolibre_wsola_change_state;
+}
+
+static void gst_kolibre_wsola_init (GstKolibreWsola *self, GstKolibreWsolaClass *klass)
+{
+    self->sinkpad = gst_pad_new_from_static_template (&sink_template, "sink");
+    gst_pad_set_chain_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_kolibre_wsola_chain));
+    gst_pad_set_event_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_kolibre_wsola_sink_event));
+    gst_pad_set_setcaps_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_kolibre_wsola_setcaps));
+    gst_pad_set_getcaps_function (self->sinkpad, GST_DEBUG_FUNCPTR (gst_pad_proxy_getcaps));
+    gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
+
+    self->srcpad = gst_pad_new_from_static_template (&src_template, "src");
+    gst_pad_set_event_function (self->srcpad, GST_DEBUG_FUNCPTR (gst_kolibre_wsola_src_event));
+    gst_pad_set_query_function (self->srcpad, GST_DEBUG_FUNCPTR (gst_kolibre_wsola_src_query));
+    gst_pad_set_getcaps_function (self->srcpad, GST_DEBUG_FUNCPTR (gst_pad_proxy_getcaps));
+    gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
+
+    self->stretcher = NULL;
+    self->rate = 0;
+    self->channels = 0;
+    self->bytesPerFrame = 0;
+    self->params.tempo = 1.0;
+    self->params.pitch = 1.0;
+    self->params.silenceAware = TRUE;
+    self->paramSeq = 0;
+    self->appliedSeq = -1;
+    self->segmentTempo = 1.0;
+    self->nextTimestamp = GST_CLOCK_TIME_NONE;
+}
+
+static void gst_kolibre_wsola_finalize (GObject *object)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (object);
+
+    delete self->stretcher;
+    self->stretcher = NULL;
+
+    G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void gst_kolibre_wsola_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (object);
+
+    GST_OBJECT_LOCK (self);
+    g_atomic_int_inc (&self->paramSeq);
+    switch (prop_id) {
+        case PROP_TEMPO:
+            self->params.tempo = g_value_get_double (value);
+            break;
+        case PROP_PITCH:
+            self->params.pitch = g_value_get_double (value);
+            break;
+        case PROP_SILENCE_AWARE:
+            self->params.silenceAware = g_value_get_boolean (value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    g_atomic_int_inc (&self->paramSeq);
+    GST_OBJECT_UNLOCK (self);
+}
+
+static void gst_kolibre_wsola_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (object);
+
+    GST_OBJECT_LOCK (self);
+    switch (prop_id) {
+        case PROP_TEMPO:
+            g_value_set_double (value, self->params.tempo);
+            break;
+        case PROP_PITCH:
+            g_value_set_double (value, self->params.pitch);
+            break;
+        case PROP_SILENCE_AWARE:
+            g_value_set_boolean (value, self->params.silenceAware);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+            break;
+    }
+    GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * Read a consistent copy of the properties without locking
+ *
+ * @param params the copy
+ * @return the sequence number the copy is from
+ */
+static gint gst_kolibre_wsola_get_params (GstKolibreWsola *self, GstKolibreWsolaParams *params)
+{
+    for (;;) {
+        gint before = g_atomic_int_get (&self->paramSeq);
+        if (before & 1) continue;
+        *params = self->params;
+        if (g_atomic_int_get (&self->paramSeq) == before) return before;
+    }
+}
+
+/**
+ * Get the current tempo
+ */
+static gdouble gst_kolibre_wsola_get_tempo (GstKolibreWsola *self)
+{
+    GstKolibreWsolaParams params;
+    gst_kolibre_wsola_get_params (self, &params);
+    return params.tempo;
+}
+
+/**
+ * Set up a stretcher for the negotiated sample format
+ */
+static gboolean gst_kolibre_wsola_setcaps (GstPad *pad, GstCaps *caps)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (gst_pad_get_parent (pad));
+    GstStructure *structure = gst_caps_get_structure (caps, 0);
+    gboolean isFloat = gst_structure_has_name (structure, "audio/x-raw-float");
+    gint rate, channels;
+
+    if (!gst_structure_get_int (structure, "rate", &rate) ||
+            !gst_structure_get_int (structure, "channels", &channels) ||
+            !gst_pad_set_caps (self->srcpad, caps)) {
+        gst_object_unref (self);
+        return FALSE;
+    }
+
+    delete self->stretcher;
+    if (isFloat)
+        self->stretcher = new Wsola<float>(rate, channels);
+    else
+        self->stretcher = new Wsola<short>(rate, channels);
+
+    self->rate = rate;
+    self->channels = channels;
+    self->bytesPerFrame = channels * (isFloat ? sizeof(float) : sizeof(short));
+    self->appliedSeq = -1;
+
+    LOG4CXX_DEBUG(wsolaElementLog, "Stretching " << (isFloat ? "float" : "16 bit") << " audio, " << rate << " Hz, " << channels << " channels");
+
+    gst_object_unref (self);
+    return TRUE;
+}
+
+/**
+ * Push all processed samples downstream
+ */
+static GstFlowReturn gst_kolibre_wsola_push (GstKolibreWsola *self)
+{
+    int frames = self->stretcher->availableFrames();
+    if (frames <= 0) return GST_FLOW_OK;
+
+    GstBuffer *buffer;
+    GstFlowReturn ret = gst_pad_alloc_buffer_and_set_caps (self->srcpad, GST_BUFFER_OFFSET_NONE,
+            frames * self->bytesPerFrame, GST_PAD_CAPS (self->srcpad), &buffer);
+    if (ret != GST_FLOW_OK) return ret;
+
+    frames = self->stretcher->receiveSamples (GST_BUFFER_DATA (buffer), frames);
+    GST_BUFFER_SIZE (buffer) = frames * self->bytesPerFrame;
+
+    GstClockTime duration = gst_util_uint64_scale_int (frames, GST_SECOND, self->rate);
+    GST_BUFFER_TIMESTAMP (buffer) = self->nextTimestamp;
+    GST_BUFFER_DURATION (buffer) = duration;
+    if (GST_CLOCK_TIME_IS_VALID (self->nextTimestamp))
+        self->nextTimestamp += duration;
+
+    return gst_pad_push (self->srcpad, buffer);
+}
+
+static GstFlowReturn gst_kolibre_wsola_chain (GstPad *pad, GstBuffer *buffer)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (GST_PAD_PARENT (pad));
+
+    if (self->stretcher == NULL) {
+        gst_buffer_unref (buffer);
+        return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    // New settings are ramped to by the stretcher, the output continues
+    if (g_atomic_int_get (&self->paramSeq) != self->appliedSeq) {
+        GstKolibreWsolaParams params;
+        self->appliedSeq = gst_kolibre_wsola_get_params (self, &params);
+        self->stretcher->setTempo (params.tempo);
+        self->stretcher->setPitch (params.pitch);
+        self->stretcher->setSilenceAware (params.silenceAware);
+    }
+
+    // Output timestamps continue from the first buffer of the segment
+    if (!GST_CLOCK_TIME_IS_VALID (self->nextTimestamp) && GST_CLOCK_TIME_IS_VALID (GST_BUFFER_TIMESTAMP (buffer)))
+        self->nextTimestamp = (GstClockTime) (GST_BUFFER_TIMESTAMP (buffer) / self->segmentTempo);
+
+    self->stretcher->putSamples (GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer) / self->bytesPerFrame);
+    gst_buffer_unref (buffer);
+
+    return gst_kolibre_wsola_push (self);
+}
+
+static gboolean gst_kolibre_wsola_sink_event (GstPad *pad, GstEvent *event)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (gst_pad_get_parent (pad));
+
+    switch (GST_EVENT_TYPE (event)) {
+        case GST_EVENT_FLUSH_STOP:
+            if (self->stretcher) self->stretcher->clear ();
+            self->nextTimestamp = GST_CLOCK_TIME_NONE;
+            break;
+        case GST_EVENT_EOS:
+            if (self->stretcher) {
+                self->stretcher->flush ();
+                gst_kolibre_wsola_push (self);
+            }
+            break;
+        case GST_EVENT_NEWSEGMENT:
+            {
+                gboolean update;
+                gdouble rate, arate;
+                GstFormat format;
+                gint64 start, stop, time;
+
+                gst_event_parse_new_segment_full (event, &update, &rate, &arate, &format, &start, &stop, &time);
+                if (format == GST_FORMAT_TIME) {
+                    // Downstream sees the stretched timeline
+                    gdouble tempo = gst_kolibre_wsola_get_tempo (self);
+                    self->segmentTempo = tempo;
+                    start = (gint64) (start / tempo);
+                    if (stop != -1) stop = (gint64) (stop / tempo);
+                    time = (gint64) (time / tempo);
+
+                    gst_event_unref (event);
+                    event = gst_event_new_new_segment_full (update, rate, arate, format, start, stop, time);
+                }
+                if (!update && self->stretcher) self->stretcher->clear ();
+                self->nextTimestamp = GST_CLOCK_TIME_NONE;
+                break;
+            }
+        default:
+            break;
+    }
+
+    gboolean ret = gst_pad_push_event (self->srcpad, event);
+    gst_object_unref (self);
+    return ret;
+}
+
+static gboolean gst_kolibre_wsola_src_event (GstPad *pad, GstEvent *event)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (gst_pad_get_parent (pad));
+    gboolean ret;
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEEK) {
+        gdouble rate;
+        GstFormat format;
+        GstSeekFlags flags;
+        GstSeekType curType, stopType;
+        gint64 cur, stop;
+
+        gst_event_parse_seek (event, &rate, &format, &flags, &curType, &cur, &stopType, &stop);
+        if (format == GST_FORMAT_TIME) {
+            // Seek positions are in stretched time, convert to input time
+            gdouble tempo = gst_kolibre_wsola_get_tempo (self);
+            if (curType != GST_SEEK_TYPE_NONE && cur != -1) cur = (gint64) (cur * tempo);
+            if (stopType != GST_SEEK_TYPE_NONE && stop != -1) stop = (gint64) (stop * tempo);
+
+            gst_event_unref (event);
+            event = gst_event_new_seek (rate, format, flags, curType, cur, stopType, stop);
+        }
+        ret = gst_pad_push_event (self->sinkpad, event);
+    } else {
+        ret = gst_pad_event_default (pad, event);
+    }
+
+    gst_object_unref (self);
+    return ret;
+}
+
+static gboolean gst_kolibre_wsola_src_query (GstPad *pad, GstQuery *query)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (gst_pad_get_parent (pad));
+    gboolean ret;
+    GstFormat format;
+    gint64 value;
+
+    switch (GST_QUERY_TYPE (query)) {
+        case GST_QUERY_POSITION:
+            ret = gst_pad_peer_query (self->sinkpad, query);
+            if (ret) {
+                gst_query_parse_position (query, &format, &value);
+                if (format == GST_FORMAT_TIME && value != -1)
+                    gst_query_set_position (query, format, (gint64) (value / gst_kolibre_wsola_get_tempo (self)));
+            }
+            break;
+        case GST_QUERY_DURATION:
+            ret = gst_pad_peer_query (self->sinkpad, query);
+            if (ret) {
+                gst_query_parse_duration (query, &format, &value);
+                if (format == GST_FORMAT_TIME && value != -1)
+                    gst_query_set_duration (query, format, (gint64) (value / gst_kolibre_wsola_get_tempo (self)));
+            }
+            break;
+        default:
+            ret = gst_pad_query_default (pad, query);
+            break;
+    }
+
+    gst_object_unref (self);
+    return ret;
+}
+
+static GstStateChangeReturn gst_kolibre_wsola_change_state (GstElement *element, GstStateChange transition)
+{
+    GstKolibreWsola *self = GST_KOLIBRE_WSOLA (element);
+
+    GstStateChangeReturn ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+    if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+        if (self->stretcher) self->stretcher->clear ();
+        self->nextTimestamp = GST_CLOCK_TIME_NONE;
+    }
+
+    return ret;
+}
+
+/**
+ * Make the kolibrewsola element available to gst_element_factory_make
+ *
+ * @return true on success
+ */
+bool wsola_element_register()
+{
+    if (!gst_element_register (NULL, "kolibrewsola", GST_RANK_NONE, GST_TYPE_KOLIBRE_WSOLA)) {
+        LOG4CXX_ERROR(wsolaElementLog, "Failed to register kolibrewsola element");
+        return false;
+    }
+    return true;
+}
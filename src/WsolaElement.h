@@ -0,0 +1,81 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef WSOLAELEMENT_H
+#define WSOLAELEMENT_H
+
+#include <gst/gst.h>
+
+#include "Wsola.h"
+
+#define GST_TYPE_KOLIBRE_WSOLA (gst_kolibre_wsola_get_type())
+#define GST_KOLIBRE_WSOLA(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_KOLIBRE_WSOLA, GstKolibreWsola))
+
+/**
+ * The "kolibrewsola" element, a drop in replacement for the soundtouch
+ * "pitch" element with the same tempo and pitch properties and the same
+ * time conversions: buffers, segments and position/duration queries
+ * downstream of it are in stretched time (input time / tempo) and seeks
+ * from downstream are converted back.
+ *
+ * Tempo and pitch may be set while playing. They are published in a
+ * parameter block the streaming thread reads without locking, and the
+ * stretcher ramps to them, so a change needs no flush or seek.
+ */
+
+/**
+ * Properties as published to the streaming thread
+ */
+typedef struct {
+    gdouble tempo;
+    gdouble pitch;
+    gboolean silenceAware;
+} GstKolibreWsolaParams;
+
+typedef struct {
+    GstElement element;
+
+    GstPad *sinkpad;
+    GstPad *srcpad;
+
+    WsolaBase *stretcher;
+    gint rate;
+    gint channels;
+    gint bytesPerFrame;
+
+    // Properties, written under the object lock and read lock-free,
+    // paramSeq is odd while params is being written
+    GstKolibreWsolaParams params;
+    gint paramSeq;
+    gint appliedSeq;            // paramSeq last given to the stretcher, streaming thread only
+
+    gdouble segmentTempo;       // Tempo the current segment was scaled with
+    GstClockTime nextTimestamp; // Timestamp of the next output buffer
+} GstKolibreWsola;
+
+typedef struct {
+    GstElementClass parent_class;
+} GstKolibreWsolaClass;
+
+GType gst_kolibre_wsola_get_type(void);
+
+bool wsola_element_register();
+
+#endif
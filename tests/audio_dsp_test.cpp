@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstdio>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include "AudioDsp.h"
+
+#define RATE 22050
+
+using namespace std;
+
+vector<short> sine(double hz, int frames, double level)
+{
+    vector<short> samples(frames);
+    for(int i = 0; i < frames; i++)
+        samples[i] = (short)(level * 32767.0 * sin(2.0 * M_PI * hz * i / RATE));
+    return samples;
+}
+
+// Level of the last half of the samples, in dB relative to level
+double gainDb(const vector<short> &samples, double level)
+{
+    double sum = 0;
+    size_t start = samples.size() / 2;
+    for(size_t i = start; i < samples.size(); i++) sum += (double)samples[i] * samples[i];
+    double rms = sqrt(sum / (samples.size() - start)) / 32767.0;
+    return 20.0 * log10(rms / (level / sqrt(2.0)));
+}
+
+int main(int argc, char *argv[])
+{
+    int ramp = DSP_RAMP_MS * RATE / 1000;
+
+    // Neutral settings leave the samples untouched
+    {
+        AudioDsp dsp(RATE, 1, false);
+        vector<short> in = sine(440, RATE, 0.5);
+        vector<short> out = in;
+        assert(dsp.isNeutral());
+        dsp.process(&out[0], out.size());
+        for(size_t i = 0; i < in.size(); i++) assert(out[i] == in[i]);
+    }
+
+    // Gain ramps smoothly to its target
+    {
+        AudioDsp dsp(RATE, 1, false);
+        vector<short> in(RATE, 10000);
+        vector<short> out = in;
+        dsp.setGain(2.0);
+        dsp.process(&out[0], out.size());
+        for(int i = 1; i < ramp; i++) assert(out[i] >= out[i - 1] && out[i] - out[i - 1] <= 10000 / ramp + 1);
+        assert(out[ramp] == 20000 && out[RATE - 1] == 20000);
+
+        // Clipped, not wrapped
+        out = in;
+        dsp.setGain(4.0, false);
+        dsp.process(&out[0], out.size());
+        assert(out[0] == 32767);
+    }
+
+    // The bass shelf boosts low frequencies and leaves the middle alone
+    {
+        AudioDsp dsp(RATE, 1, false);
+        dsp.setShelves(6.0, 0.0, false);
+        vector<short> low = sine(60, RATE, 0.25), mid = sine(1000, RATE, 0.25);
+        dsp.process(&low[0], low.size());
+        dsp.reset();
+        dsp.process(&mid[0], mid.size());
+        printf("bass +6 dB: 60 Hz %.2f dB, 1 kHz %.2f dB\n", gainDb(low, 0.25), gainDb(mid, 0.25));
+        assert(fabs(gainDb(low, 0.25) - 6.0) < 0.5);
+        assert(fabs(gainDb(mid, 0.25)) < 1.0);
+    }
+
+    // The treble shelf cuts high frequencies, in float stereo
+    {
+        AudioDsp dsp(RATE, 2, true);
+        dsp.setShelves(0.0, -6.0, false);
+        vector<short> high = sine(8000, RATE, 0.25);
+        vector<float> buffer(RATE * 2);
+        for(int i = 0; i < RATE; i++) buffer[i * 2] = buffer[i * 2 + 1] = high[i] / 32768.0f;
+        dsp.process(&buffer[0], RATE);
+        for(int i = 0; i < RATE; i++) {
+            assert(buffer[i * 2] == buffer[i * 2 + 1]);
+            high[i] = (short)(buffer[i * 2] * 32768.0f);
+        }
+        printf("treble -6 dB: 8 kHz %.2f dB\n", gainDb(high, 0.25));
+        assert(fabs(gainDb(high, 0.25) + 6.0) < 0.5);
+    }
+
+    // Turning the shelves up while playing doesn't click
+    {
+        AudioDsp dsp(RATE, 1, false);
+        vector<short> in = sine(200, RATE, 0.25);
+        dsp.process(&in[0], RATE / 2);
+        dsp.setShelves(9.0, 9.0);
+        dsp.process(&in[RATE / 2], RATE / 2);
+        int jump = 0;
+        for(int i = 1; i < RATE; i++)
+            if(abs(in[i] - in[i - 1]) > jump) jump = abs(in[i] - in[i - 1]);
+        printf("largest step while ramping: %d\n", jump);
+        // Once boosted the sine steps by up to about 960, ringing would go well beyond
+        assert(jump < 1100);
+    }
+
+    // Fade in from silence
+    {
+        AudioDsp dsp(RATE, 1, false);
+        vector<short> out(RATE, 10000);
+        dsp.fadeIn(50);
+        assert(!dsp.isNeutral());
+        dsp.process(&out[0], out.size());
+        int fade = 50 * RATE / 1000;
+        assert(out[0] == 0);
+        assert(abs(out[fade / 2] - 5000) < 10);
+        assert(out[fade] == 10000);
+        assert(dsp.isNeutral());
+    }
+
+    return 0;
+}
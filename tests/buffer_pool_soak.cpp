@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Soak test for the buffer pool. Simulates hours of playback through the
+ * time-stretcher into a fake sink as fast as possible, changing the tempo
+ * every few hundred milliseconds so buffer sizes keep varying. For every
+ * simulated half hour the allocation rate and the heap in use are
+ * printed, the heap should level out after the first interval.
+ *
+ * Run with --no-pool to compare against the default allocator.
+ *
+ * usage: bufferpoolsoak [--no-pool] [HOURS]   (default 8 hours)
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <gst/gst.h>
+
+#include "BufferPool.h"
+#include "WsolaElement.h"
+
+#define RATE 22050
+#define SAMPLES_PER_BUFFER 1024
+#define REPORT_INTERVAL (30 * 60 * GST_SECOND)
+
+static volatile gint64 streamTime = 0;
+static volatile gint buffers = 0;
+
+static gboolean cb_buffer(GstPad *pad, GstBuffer *buffer, gpointer data)
+{
+    if(GST_BUFFER_TIMESTAMP_IS_VALID(buffer)) streamTime = GST_BUFFER_TIMESTAMP(buffer);
+    g_atomic_int_inc(&buffers);
+    return TRUE;
+}
+
+// Bytes allocated from the heap and not yet freed
+static size_t heapInUse()
+{
+    struct mallinfo info = mallinfo();
+    return (size_t)(unsigned int)info.uordblks + (size_t)(unsigned int)info.hblkhd;
+}
+
+int main(int argc, char *argv[])
+{
+    gst_init(&argc, &argv);
+    wsola_element_register();
+
+    bool usePool = true;
+    double hours = 8.0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--no-pool") == 0) usePool = false;
+        else hours = atof(argv[i]);
+    }
+
+    // HOURS of source audio, the stretcher timestamps its output in playback time
+    long long numBuffers = (long long)(hours * 3600 * RATE / SAMPLES_PER_BUFFER);
+    char description[512];
+    snprintf(description, sizeof(description),
+            "audiotestsrc wave=pink-noise samplesperbuffer=%d num-buffers=%lld ! "
+            "audio/x-raw-int,rate=%d,channels=1,width=16 ! audioconvert ! "
+            "kolibrewsola name=stretch ! audioconvert ! fakesink name=sink sync=false",
+            SAMPLES_PER_BUFFER, numBuffers, RATE);
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description, &error);
+    if(pipeline == NULL) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    GstElement *stretch = gst_bin_get_by_name(GST_BIN(pipeline), "stretch");
+    GstElement *sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+    GstPad *pad = gst_element_get_static_pad(sink, "sink");
+    gst_pad_add_buffer_probe(pad, G_CALLBACK(cb_buffer), NULL);
+
+    BufferPool pool;
+    if(usePool) pool.attach(pad);
+
+    size_t heapStart = heapInUse();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    printf("%8s %12s %12s %12s %14s %12s\n", "hours", "allocs/s", "heap allocs", "pool kB", "heap growth kB", "buffers");
+    GstBus *bus = gst_element_get_bus(pipeline);
+    srand(1);
+    gint64 nextReport = REPORT_INTERVAL;
+    gint64 lastTime = 0;
+    BufferPool::stats last = pool.getStats();
+    gint lastBuffers = 0;
+    bool ok = false;
+
+    while(true) {
+        GstMessage *msg = gst_bus_timed_pop_filtered(bus, 200 * GST_MSECOND,
+                (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+        bool done = false;
+        if(msg != NULL) {
+            ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+            gst_message_unref(msg);
+            done = true;
+        }
+
+        // Tempos a listener might pick, 0.8 to 2.5
+        g_object_set(G_OBJECT(stretch), "tempo", 0.8 + (rand() % 18) / 10.0, NULL);
+
+        gint64 now = streamTime;
+        if(now < nextReport && !done) continue;
+
+        BufferPool::stats s = pool.getStats();
+        gint count = g_atomic_int_get(&buffers);
+        double seconds = (double)(now - lastTime) / GST_SECOND;
+        // Without the pool every buffer reaching the sink was one heap allocation
+        unsigned long long allocs = usePool ? s.fallbacks - last.fallbacks : count - lastBuffers;
+        printf("%8.2f %12.2f %12llu %12lu %14ld %12d\n",
+                (double)now / (3600 * GST_SECOND),
+                seconds > 0 ? allocs / seconds : 0.0,
+                allocs,
+                (unsigned long)(s.arenaBytes / 1024),
+                ((long)heapInUse() - (long)heapStart) / 1024,
+                count - lastBuffers);
+        fflush(stdout);
+
+        last = s;
+        lastBuffers = count;
+        lastTime = now;
+        while(nextReport <= now) nextReport += REPORT_INTERVAL;
+        if(done) break;
+    }
+
+    gst_object_unref(bus);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pad);
+    gst_object_unref(sink);
+    gst_object_unref(stretch);
+    gst_object_unref(pipeline);
+
+    BufferPool::stats s = pool.getStats();
+    printf("%llu pool requests, %llu reused, %llu from the heap\n", s.requests, s.reuses, s.fallbacks);
+    return ok ? 0 : 1;
+}
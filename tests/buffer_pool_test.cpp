@@ -0,0 +1,93 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <vector>
+#include "BufferPool.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    // Blocks are reused from the free list of their size class
+    {
+        BufferPool pool;
+        void *a = pool.acquire(1000);
+        assert(a != NULL && ((size_t)a & 15) == 0);
+        memset(a, 0x55, 1000);
+        BufferPool::release(a);
+
+        void *b = pool.acquire(900);
+        assert(b == a);
+        BufferPool::stats s = pool.getStats();
+        assert(s.requests == 2 && s.reuses == 1 && s.fallbacks == 0);
+        assert(s.arenaBytes == POOL_ARENA_BYTES);
+        assert(s.inUseBytes == 1024);
+        BufferPool::release(b);
+        assert(pool.getStats().inUseBytes == 0);
+    }
+
+    // Irregular sizes, as from time-stretching, stop growing the arenas once warmed up
+    {
+        BufferPool pool;
+        srand(1);
+        vector<void *> live;
+        size_t warmedUp = 0;
+        for(int i = 0; i < 200000; i++) {
+            live.push_back(pool.acquire(500 + rand() % 16000));
+            if(live.size() > 20) {
+                size_t victim = rand() % live.size();
+                BufferPool::release(live[victim]);
+                live[victim] = live.back();
+                live.pop_back();
+            }
+            if(i == 10000) warmedUp = pool.getStats().arenaBytes;
+        }
+        BufferPool::stats s = pool.getStats();
+        printf("%llu requests, %llu reused, %llu from the heap, %lu bytes in arenas\n",
+                s.requests, s.reuses, s.fallbacks, (unsigned long)s.arenaBytes);
+        assert(s.arenaBytes == warmedUp);
+        assert(s.fallbacks == 0);
+        for(size_t i = 0; i < live.size(); i++) BufferPool::release(live[i]);
+        assert(pool.getStats().inUseBytes == 0);
+    }
+
+    // Past the maximum, and above the largest class, memory comes from the heap
+    {
+        BufferPool pool;
+        pool.setMaxBytes(POOL_ARENA_BYTES);
+        vector<void *> live;
+        for(int i = 0; i < 100; i++) live.push_back(pool.acquire(8192));
+        void *big = pool.acquire(1024 * 1024);
+        memset(big, 0, 1024 * 1024);
+
+        BufferPool::stats s = pool.getStats();
+        assert(s.arenaBytes == POOL_ARENA_BYTES);
+        assert(s.fallbacks == 100 - POOL_ARENA_BYTES / (8192 + 32) + 1);
+
+        BufferPool::release(big);
+        for(size_t i = 0; i < live.size(); i++) BufferPool::release(live[i]);
+        assert(pool.getStats().inUseBytes == 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares the CPU time of the postprocessing chain before and after it
+ * was planned around a single sample format. Before, the stretcher and
+ * silence compression ran in whatever audioconvert picked and a second
+ * audioconvert sat in front of level and amplify. Now the chain runs in
+ * the decoder's format and converts once, at the end, to the sink format.
+ *
+ * Both are run for a sink that only takes 16 bit integers and one that
+ * also takes float. The time spent decoding (measured with nothing but
+ * decodebin) is subtracted.
+ *
+ * usage: chainbenchmark FILE...
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+
+#include "SilenceElement.h"
+#include "WsolaElement.h"
+
+#define FORMAT_INT16 "audio/x-raw-int, width = (int) 16, depth = (int) 16, signed = (boolean) true"
+#define FORMAT_FLOAT32 "audio/x-raw-float, width = (int) 32"
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+// Run the file through the chain, return CPU seconds or -1 on failure
+static double run(const char *filename, const char *chain, double *audioSeconds)
+{
+    char description[2048];
+    snprintf(description, sizeof(description),
+            "filesrc location=\"%s\" ! decodebin ! %s", filename, chain);
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description, &error);
+    if(pipeline == NULL) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    double start = cpuSeconds();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+            (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    bool ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    double used = cpuSeconds() - start;
+
+    GstFormat format = GST_FORMAT_TIME;
+    gint64 duration = 0;
+    gst_element_query_duration(pipeline, &format, &duration);
+    *audioSeconds = (double)duration / GST_SECOND;
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    return ok ? used : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    gst_init(&argc, &argv);
+    silence_element_register();
+    wsola_element_register();
+
+    const char *sinks[] = { FORMAT_INT16, FORMAT_INT16 "; " FORMAT_FLOAT32 };
+    const char *sinkNames[] = { "int16", "int16/float" };
+
+    printf("%-40s %-12s %16s %16s\n", "file", "sink", "before ms / s", "after ms / s");
+    for(int f = 1; f < argc; f++) {
+        double seconds = 0;
+        double baseline = run(argv[f], "fakesink sync=false", &seconds);
+        if(baseline < 0 || seconds <= 0) {
+            fprintf(stderr, "failed to decode %s\n", argv[f]);
+            return 1;
+        }
+
+        // What setupPipeline picks for the file, vorbis decodes to float
+        size_t len = strlen(argv[f]);
+        const char *processing = len > 4 && strcmp(argv[f] + len - 4, ".ogg") == 0 ? FORMAT_FLOAT32 : FORMAT_INT16;
+
+        for(unsigned int s = 0; s < sizeof(sinks) / sizeof(sinks[0]); s++) {
+            char before[1024], after[1024];
+            snprintf(before, sizeof(before),
+                    "audioconvert ! kolibrewsola tempo=1.5 ! kolibresilence ! audioconvert ! "
+                    "level ! audioamplify amplification=0.8 ! %s ! fakesink sync=false", sinks[s]);
+            snprintf(after, sizeof(after),
+                    "audioconvert ! %s ! kolibrewsola tempo=1.5 ! kolibresilence ! "
+                    "level ! audioamplify amplification=0.8 ! audioconvert ! %s ! fakesink sync=false",
+                    processing, sinks[s]);
+
+            double ignored;
+            double usedBefore = run(argv[f], before, &ignored);
+            double usedAfter = run(argv[f], after, &ignored);
+            if(usedBefore < 0 || usedAfter < 0) {
+                printf("%-40s %-12s %16s %16s\n", argv[f], sinkNames[s], "n/a", "n/a");
+                continue;
+            }
+            printf("%-40s %-12s %16.3f %16.3f\n", argv[f], sinkNames[s],
+                    (usedBefore - baseline) * 1000.0 / seconds,
+                    (usedAfter - baseline) * 1000.0 / seconds);
+        }
+    }
+
+    return 0;
+}
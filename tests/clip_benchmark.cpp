@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Measures loading a synthetic book into the clip index and looking up
+ * the clip playing at random positions, against a linear scan of the
+ * clips as applications did before. The book has FILES files of 500
+ * clips of 1.2 to 4 seconds each.
+ *
+ * usage: clipbenchmark [FILES]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+#include "ClipIndex.h"
+
+#define CLIPS_PER_FILE 500
+
+struct Clip
+{
+    std::string url;
+    long long begin, end;
+};
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static long scan(const std::vector<Clip> &clips, const std::string &url, long long ms)
+{
+    for(size_t i = 0; i < clips.size(); i++)
+        if(clips[i].url == url && clips[i].begin <= ms && ms < clips[i].end) return i;
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    long files = argc > 1 ? atol(argv[1]) : 200;
+    if(files <= 0) files = 200;
+    long count = files * CLIPS_PER_FILE;
+
+    std::vector<Clip> clips(count);
+    std::vector<std::string> urls(count), begins(count), ends(count);
+    char buf[64];
+    srand(1);
+    for(long f = 0, i = 0; f < files; f++) {
+        long long ms = 0;
+        snprintf(buf, sizeof(buf), "/media/book/%03ld_chapter.mp3", f);
+        std::string url = buf;
+        for(long c = 0; c < CLIPS_PER_FILE; c++, i++) {
+            long long length = 1200 + rand() % 2800;
+            clips[i].url = urls[i] = url;
+            clips[i].begin = ms;
+            clips[i].end = ms + length;
+            snprintf(buf, sizeof(buf), "npt=%lld.%03llds", ms / 1000, ms % 1000);
+            begins[i] = buf;
+            snprintf(buf, sizeof(buf), "npt=%lld.%03llds", (ms + length) / 1000, (ms + length) % 1000);
+            ends[i] = buf;
+            ms += length;
+        }
+    }
+    std::vector<const char *> u(count), b(count), e(count);
+    for(long i = 0; i < count; i++) {
+        u[i] = urls[i].c_str();
+        b[i] = begins[i].c_str();
+        e[i] = ends[i].c_str();
+    }
+
+    ClipIndex index;
+    double start = now();
+    size_t valid = index.set(&u[0], &b[0], &e[0], count);
+    double load = now() - start;
+    if(valid != (size_t)count) {
+        fprintf(stderr, "%ld clips not valid\n", count - (long)valid);
+        return 1;
+    }
+
+    // Random positions within random clips
+    const long lookups = 1000000;
+    std::vector<long> targets(lookups);
+    std::vector<long long> positions(lookups);
+    for(long i = 0; i < lookups; i++) {
+        targets[i] = rand() % count;
+        positions[i] = clips[targets[i]].begin + rand() % (clips[targets[i]].end - clips[targets[i]].begin);
+    }
+
+    start = now();
+    for(long i = 0; i < lookups; i++)
+        if(index.find(urls[targets[i]], positions[i]) != targets[i]) {
+            fprintf(stderr, "clip %ld not found at %lld\n", targets[i], positions[i]);
+            return 1;
+        }
+    double indexed = now() - start;
+
+    // The scan is slow, time fewer lookups
+    const long scans = 2000;
+    start = now();
+    for(long i = 0; i < scans; i++)
+        if(scan(clips, urls[targets[i]], positions[i]) != targets[i]) return 1;
+    double scanned = now() - start;
+
+    printf("%ld clips in %ld files, loaded in %.1f ms\n", count, files, load * 1000);
+    printf("%-8s %14s %12s\n", "lookup", "lookups / s", "ns / lookup");
+    printf("%-8s %14.0f %12.1f\n", "index", lookups / indexed, indexed * 1e9 / lookups);
+    printf("%-8s %14.0f %12.1f\n", "scan", scans / scanned, scanned * 1e9 / scans);
+    return 0;
+}
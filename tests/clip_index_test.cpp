@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cassert>
+#include <string>
+#include "ClipIndex.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    // Two files, the second listed in two runs and not in time order
+    const char *urls[] = { "a.mp3", "a.mp3", "a.mp3", "b.mp3", "b.mp3", "a.mp3", "b.mp3" };
+    const char *begins[] = { "npt=0.000s", "npt=1.500s", "npt=3.000s", "0:00:10", "0:00:00", "npt=5.000s", "00:20" };
+    const char *ends[] = { "npt=1.500s", "npt=3.000s", "npt=4.000s", "0:00:20", "0:00:10", NULL, "bad" };
+
+    ClipIndex index;
+    assert(index.size() == 0);
+    assert(index.find("a.mp3", 0) == -1);
+    assert(index.set(urls, begins, ends, 7) == 6);
+    assert(index.size() == 7);
+
+    // Position to clip
+    assert(index.find("a.mp3", 0) == 0);
+    assert(index.find("a.mp3", 1499) == 0);
+    assert(index.find("a.mp3", 1500) == 1);
+    assert(index.find("a.mp3", 3999) == 2);
+    assert(index.find("a.mp3", 4000) == -1);    // Gap between clips
+    assert(index.find("a.mp3", 5000) == 5);
+    assert(index.find("a.mp3", 3600000) == 5);  // Runs to the end of the file
+    assert(index.find("b.mp3", 0) == 4);
+    assert(index.find("b.mp3", 15000) == 3);
+    assert(index.find("b.mp3", 25000) == 6);    // Invalid end taken as missing
+    assert(index.find("c.mp3", 0) == -1);
+    assert(index.find("a.mp3", -1) == -1);
+
+    // Book order
+    assert(index.next(0) == 1);
+    assert(index.next(6) == -1);
+    assert(index.next(-1) == -1);
+    assert(index.previous(0) == -1);
+    assert(index.previous(3) == 2);
+    assert(index.previous(7) == -1);
+
+    string url;
+    long long beginms, endms;
+    assert(index.get(3, url, beginms, endms));
+    assert(url == "b.mp3" && beginms == 10000 && endms == 20000);
+    assert(index.get(5, url, beginms, endms));
+    assert(url == "a.mp3" && beginms == 5000 && endms == CLIP_TO_END);
+    assert(!index.get(7, url, beginms, endms));
+
+    // Every position of a larger book finds its clip
+    {
+        const int clipsPerFile = 500, fileCount = 20;
+        static char urlBuf[fileCount * clipsPerFile][16];
+        static char beginBuf[fileCount * clipsPerFile][24];
+        static char endBuf[fileCount * clipsPerFile][24];
+        const char *u[fileCount * clipsPerFile], *b[fileCount * clipsPerFile], *e[fileCount * clipsPerFile];
+        for(int i = 0; i < fileCount * clipsPerFile; i++) {
+            int c = i % clipsPerFile;
+            snprintf(urlBuf[i], sizeof(urlBuf[i]), "f%02d.mp3", i / clipsPerFile);
+            snprintf(beginBuf[i], sizeof(beginBuf[i]), "npt=%d.%03ds", c * 1234 / 1000, c * 1234 % 1000);
+            snprintf(endBuf[i], sizeof(endBuf[i]), "npt=%d.%03ds", (c + 1) * 1234 / 1000, (c + 1) * 1234 % 1000);
+            u[i] = urlBuf[i];
+            b[i] = beginBuf[i];
+            e[i] = endBuf[i];
+        }
+        assert(index.set(u, b, e, fileCount * clipsPerFile) == (size_t)(fileCount * clipsPerFile));
+        for(int i = 0; i < fileCount * clipsPerFile; i += 7) {
+            int c = i % clipsPerFile;
+            assert(index.find(urlBuf[i], c * 1234) == i);
+            assert(index.find(urlBuf[i], c * 1234 + 1233) == i);
+        }
+        assert(index.find("f00.mp3", clipsPerFile * 1234) == -1);
+
+        index.reset();
+        assert(index.size() == 0);
+        assert(index.find("f00.mp3", 0) == -1);
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
@@ -33,6 +33,7 @@ class PlayerControl
         char **var_argv;
         bool atEOS;
         bool error;
+        bool playing;
         string source;
         PlayerControl();
         void play();
@@ -46,6 +47,7 @@ PlayerControl::PlayerControl():
     player(Player::Instance()),
     atEOS(false),
     error(false),
+    playing(false),
     source()
 {
     player->doOnPlayerMessage( boost::bind(&PlayerControl::playerMessageSlot, this, _1) );
@@ -76,8 +78,10 @@ bool PlayerControl::playerStateSlot( playerState state )
     switch (state)
     {
         case INACTIVE:
-        case BUFFERING:
         case PLAYING:
+            playing = true;
+            return true;
+        case BUFFERING:
         case PAUSING:
         case STOPPED:
         case EXITING:
@@ -91,6 +95,11 @@ void PlayerControl::play()
 {
     player->open( source );
     player->resume();
+
+    // The player thread must take the pipeline, silence element included, to PLAYING
+    for (int i = 0; i < 10 && !playing; i++) sleep(1);
+    assert( playing == true );
+
     while (!atEOS) sleep(1);
 
     // Assert that test run til end and no errors occurred!
@@ -0,0 +1,15 @@
+#!/bin/sh
+
+toppkgdir=${srcdir:-.}/..
+
+# test flac codec
+flac_file=$toppkgdir/tests/testdata/flac/dtb_10s.flac
+./codectest $flac_file $gst_params
+result=$?
+
+if [ $result -ne 0 ]
+then
+    echo TEST FAILED! Returned $result
+fi
+
+exit $result
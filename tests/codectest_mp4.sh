@@ -0,0 +1,21 @@
+#!/bin/sh
+
+toppkgdir=${srcdir:-.}/..
+
+# test mp4 codec, the file is created by 'make extra-testdata'
+mp4_file=$toppkgdir/tests/testdata/mp4/dtb_10s.m4a
+if [ ! -f $mp4_file ]
+then
+    echo SKIPPED, $mp4_file not found
+    exit 77
+fi
+
+./codectest $mp4_file $gst_params
+result=$?
+
+if [ $result -ne 0 ]
+then
+    echo TEST FAILED! Returned $result
+fi
+
+exit $result
@@ -0,0 +1,21 @@
+#!/bin/sh
+
+toppkgdir=${srcdir:-.}/..
+
+# test opus codec, the file is created by 'make extra-testdata'
+opus_file=$toppkgdir/tests/testdata/opus/dtb_10s.opus
+if [ ! -f $opus_file ]
+then
+    echo SKIPPED, $opus_file not found
+    exit 77
+fi
+
+./codectest $opus_file $gst_params
+result=$?
+
+if [ $result -ne 0 ]
+then
+    echo TEST FAILED! Returned $result
+fi
+
+exit $result
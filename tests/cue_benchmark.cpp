@@ -0,0 +1,131 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Measures how closely OnPlayerCue follows what is heard. A file is
+ * played with a cue every few milliseconds, at normal and at a raised
+ * tempo. For each cue the audible position is compared with the cue when
+ * the slot is called, and the cue jitter histogram of the player shows
+ * how late the slots were called after the cues became audible.
+ *
+ * usage: cuebenchmark FILE [SPACINGMS]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <pthread.h>
+#include <Player.h>
+
+#include "setup_logging.h"
+
+static pthread_mutex_t resultMutex = PTHREAD_MUTEX_INITIALIZER;
+static Player *player;
+static bool atEOS;
+static long cues;
+static long long errorTotal, errorMax;
+
+bool messageSlot(Player::playerMessage message)
+{
+    if(message == Player::PLAYER_ATEOS || message == Player::PLAYER_ERROR) {
+        pthread_mutex_lock(&resultMutex);
+        atEOS = true;
+        pthread_mutex_unlock(&resultMutex);
+    }
+    return false;
+}
+
+bool cueSlot(long long ms)
+{
+    long long error = player->getAudiblePos() - ms;
+    if(error < 0) error = -error;
+
+    pthread_mutex_lock(&resultMutex);
+    cues++;
+    errorTotal += error;
+    if(error > errorMax) errorMax = error;
+    pthread_mutex_unlock(&resultMutex);
+    return true;
+}
+
+// Play the file through, return false on failure
+bool run(const char *filename, long spacing, double tempo)
+{
+    pthread_mutex_lock(&resultMutex);
+    atEOS = false;
+    cues = 0;
+    errorTotal = errorMax = 0;
+    pthread_mutex_unlock(&resultMutex);
+    player->resetMetrics();
+
+    player->open(filename);
+    player->setTempo(tempo);
+
+    // Every spacing ms for an hour, more than any test file
+    std::vector<long long> points;
+    for(long long ms = spacing; ms < 3600000; ms += spacing) points.push_back(ms);
+    player->setCues(points);
+
+    player->resume();
+    for(;;) {
+        sleep(1);
+        pthread_mutex_lock(&resultMutex);
+        bool done = atEOS;
+        pthread_mutex_unlock(&resultMutex);
+        if(done) break;
+    }
+    player->stop();
+
+    Player::histogramData jitter = player->getMetrics().cueJitter;
+    if(cues == 0 || jitter.count == 0) return false;
+
+    printf("%5.2f %8ld %10.1f %8lld %10llu %8llu\n", tempo, cues,
+            (double)errorTotal / cues, errorMax,
+            jitter.total / jitter.count / 1000, jitter.max / 1000);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    setup_logging();
+
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s FILE [SPACINGMS]\n", argv[0]);
+        return 1;
+    }
+    long spacing = argc > 2 ? atol(argv[2]) : 20;
+    if(spacing <= 0) spacing = 20;
+
+    player = Player::Instance();
+    player->enable(&argc, &argv);
+    player->doOnPlayerMessage(messageSlot);
+    player->doOnPlayerCue(cueSlot);
+
+    printf("%5s %8s %10s %8s %10s %8s\n", "tempo", "cues", "avg error", "max", "avg late", "max");
+    printf("%5s %8s %10s %8s %10s %8s\n", "", "", "ms", "ms", "ms", "ms");
+    const double tempos[] = { 1.0, 1.5 };
+    for(unsigned int t = 0; t < sizeof(tempos) / sizeof(tempos[0]); t++)
+        if(!run(argv[1], spacing, tempos[t])) {
+            fprintf(stderr, "no cues sent at tempo %.2f\n", tempos[t]);
+            return 1;
+        }
+
+    delete player;
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include "CueList.h"
+
+using namespace std;
+
+// Play from start to stop in 10 ms loops like the player thread, return the cues taken
+vector<long long> play(CueList &list, long long start, long long stop)
+{
+    vector<long long> taken;
+    for(long long ms = start; ms < stop; ms += 10) {
+        long long cue = list.pending(ms);
+        if(cue >= 0 && cue <= ms) list.take(ms, taken);
+    }
+    return taken;
+}
+
+int main(int argc, char *argv[])
+{
+    // Every cue once and in order, also when set unsorted
+    {
+        CueList list;
+        vector<long long> cues;
+        for(long long ms = 4995; ms >= 0; ms -= 5) cues.push_back(ms);
+        cues.push_back(100);
+        list.set(cues);
+        assert(list.size() == 1000);
+
+        vector<long long> taken = play(list, 0, 6000);
+        printf("%d cues taken\n", (int)taken.size());
+        assert(taken.size() == 1000);
+        for(size_t i = 0; i < taken.size(); i++) assert(taken[i] == (long long)i * 5);
+        assert(list.pending(6000) == -1);
+    }
+
+    // Cues between two loops are all taken
+    {
+        CueList list;
+        vector<long long> cues;
+        cues.push_back(1001);
+        cues.push_back(1002);
+        cues.push_back(1009);
+        list.set(cues);
+        assert(list.pending(1000) == 1001);
+        vector<long long> taken;
+        list.take(1010, taken);
+        assert(taken.size() == 3);
+    }
+
+    // Seeks: skipped cues are not sent, cues before a seek back are sent again
+    {
+        CueList list;
+        vector<long long> cues;
+        for(long long ms = 0; ms < 10000; ms += 1000) cues.push_back(ms);
+        list.set(cues);
+
+        assert(play(list, 0, 2500).size() == 3);        // 0, 1000, 2000
+        assert(list.pending(6500) == 7000);             // Seek forward
+        assert(play(list, 6500, 7500).size() == 1);
+        assert(list.pending(1500) == 2000);             // Seek back
+        assert(play(list, 1500, 2500).size() == 1);
+
+        // A position estimate slightly behind the cue sent is no seek
+        assert(list.pending(1990) == 3000);
+
+        // A new file starts over from its position
+        list.reset();
+        assert(list.pending(0) == 0);
+    }
+
+    return 0;
+}
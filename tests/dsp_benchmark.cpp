@@ -0,0 +1,125 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares the CPU time of the ways volume, bass and treble have been
+ * done: audioamplify alone as when the equalizer was disabled,
+ * equalizer-10bands followed by audioamplify, and the fused kolibredsp
+ * element with flat and with boosted shelves. A minute of pink noise is generated for each run, the time spent
+ * generating it (measured with identity in place of the chain) is
+ * subtracted.
+ *
+ * usage: dspbenchmark [SECONDS]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+
+#include "DspElement.h"
+
+#define FORMAT_INT16 "audio/x-raw-int, width = (int) 16, depth = (int) 16, signed = (boolean) true"
+#define FORMAT_FLOAT32 "audio/x-raw-float, width = (int) 32"
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+// Run generated audio through the chain, return CPU seconds or -1 on failure
+static double run(const char *format, const char *chain, int seconds)
+{
+    char description[2048];
+    snprintf(description, sizeof(description),
+            "audiotestsrc wave=pink-noise samplesperbuffer=1024 num-buffers=%d ! "
+            "%s, rate = (int) 44100, channels = (int) 2 ! %s ! fakesink sync=false",
+            seconds * 44100 / 1024, format, chain);
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description, &error);
+    if(pipeline == NULL) {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    double start = cpuSeconds();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+            (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    bool ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    double used = cpuSeconds() - start;
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    return ok ? used : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    gst_init(&argc, &argv);
+    dsp_element_register();
+
+    int seconds = argc > 1 ? atoi(argv[1]) : 60;
+    if(seconds <= 0) seconds = 60;
+
+    const char *formats[] = { FORMAT_INT16, FORMAT_FLOAT32 };
+    const char *formatNames[] = { "int16", "float32" };
+
+    // Settings as PlayerImpl::setEqualizer makes them for bass 0.3, treble 0.2
+    // with the old band mapping and with the shelves
+    const char *names[] = { "disabled", "eq10+amplify", "dsp flat", "dsp shelves" };
+    const char *chains[] = {
+        "audioamplify amplification=2.5",
+        "equalizer-10bands band0=0.6 band1=0.525 band2=0.45 band3=0.375 band4=0.3332 "
+        "band5=0.3664 band6=0.3996 band7=0.4328 band8=0.466 band9=0.4992 ! audioamplify amplification=2.5",
+        "kolibredsp amplification=2.5",
+        "kolibredsp bass=5.4 treble=3.6 amplification=2.5",
+    };
+
+    printf("%-8s %-14s %16s\n", "format", "chain", "ms cpu / s audio");
+    for(unsigned int f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        double baseline = run(formats[f], "identity", seconds);
+        if(baseline < 0) {
+            fprintf(stderr, "failed to run %s\n", formatNames[f]);
+            return 1;
+        }
+        for(unsigned int c = 0; c < sizeof(chains) / sizeof(chains[0]); c++) {
+            double used = run(formats[f], chains[c], seconds);
+            if(used < 0) {
+                printf("%-8s %-14s %16s\n", formatNames[f], names[c], "n/a");
+                continue;
+            }
+            printf("%-8s %-14s %16.3f\n", formatNames[f], names[c], (used - baseline) * 1000.0 / seconds);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "FormatSniffer.h"
+
+#include "setup_logging.h"
+
+using namespace std;
+
+typedef vector<unsigned char> bytes;
+
+// MPEG-1 layer 3, 128 kbit/s, 44100 Hz frames, 417 bytes each
+bytes mp3Frames(int count)
+{
+    bytes data;
+    for(int f = 0; f < count; f++) {
+        const unsigned char header[] = { 0xFF, 0xFB, 0x90, 0x64 };
+        data.insert(data.end(), header, header + 4);
+        data.resize(data.size() + 413, 0x55);
+    }
+    return data;
+}
+
+// ADTS frames of 200 bytes
+bytes adtsFrames(int count)
+{
+    bytes data;
+    for(int f = 0; f < count; f++) {
+        const unsigned char header[] = { 0xFF, 0xF1, 0x50, 0x80, 0x19, 0x1F, 0xFC };
+        data.insert(data.end(), header, header + 7);
+        data.resize(data.size() + 193, 0x21);
+    }
+    return data;
+}
+
+bytes id3Tag(size_t length)
+{
+    unsigned char header[] = { 'I', 'D', '3', 3, 0, 0,
+        (unsigned char)((length >> 21) & 0x7F), (unsigned char)((length >> 14) & 0x7F),
+        (unsigned char)((length >> 7) & 0x7F), (unsigned char)(length & 0x7F) };
+    bytes data(header, header + 10);
+    data.resize(10 + length, 0);
+    return data;
+}
+
+bytes fromString(const char *s, size_t length)
+{
+    return bytes(s, s + length);
+}
+
+FormatSniffer::format sniff(const bytes &data)
+{
+    size_t skip;
+    return FormatSniffer::sniff(&data[0], data.size(), &skip);
+}
+
+string writeTemp(const bytes &data)
+{
+    char name[] = "/tmp/formatsniffertestXXXXXX";
+    int fd = mkstemp(name);
+    assert(fd >= 0);
+    assert(write(fd, &data[0], data.size()) == (ssize_t)data.size());
+    close(fd);
+    return name;
+}
+
+int main(int argc, char *argv[])
+{
+    setup_logging();
+
+    // Raw MPEG and ADTS frames
+    assert(sniff(mp3Frames(3)) == FormatSniffer::FORMAT_MP3);
+    assert(sniff(adtsFrames(3)) == FormatSniffer::FORMAT_AAC);
+
+    // A frame sync after junk only counts when the next frame follows
+    {
+        bytes data(100, 0);
+        bytes frames = mp3Frames(2);
+        data.insert(data.end(), frames.begin(), frames.end());
+        assert(sniff(data) == FormatSniffer::FORMAT_MP3);
+
+        bytes lone(100, 0);
+        lone.insert(lone.end(), frames.begin(), frames.begin() + 4);
+        lone.resize(2000, 0);
+        assert(sniff(lone) == FormatSniffer::FORMAT_UNKNOWN);
+    }
+
+    // Frames after an ID3v2 tag
+    {
+        bytes data = id3Tag(300);
+        bytes frames = mp3Frames(3);
+        data.insert(data.end(), frames.begin(), frames.end());
+        assert(sniff(data) == FormatSniffer::FORMAT_MP3);
+    }
+
+    // A tag larger than the buffer asks for another read
+    {
+        bytes data = id3Tag(10000);
+        size_t skip = 0;
+        assert(FormatSniffer::sniff(&data[0], SNIFF_BYTES, &skip) == FormatSniffer::FORMAT_UNKNOWN);
+        assert(skip == 10010);
+    }
+
+    // Containers
+    {
+        bytes vorbis = fromString("OggS\0\2\0\0\0\0\0\0\0\0\1\2\3\4\0\0\0\0\0\0\0\0\1\x1e\001vorbis", 35);
+        assert(sniff(vorbis) == FormatSniffer::FORMAT_OGG_VORBIS);
+        bytes opus = fromString("OggS\0\2\0\0\0\0\0\0\0\0\1\2\3\4\0\0\0\0\0\0\0\0\1\x13OpusHead", 36);
+        assert(sniff(opus) == FormatSniffer::FORMAT_OGG_OPUS);
+        bytes other = fromString("OggS\0\2\0\0\0\0\0\0\0\0\1\2\3\4\0\0\0\0\0\0\0\0\1\x08Speex   ", 36);
+        assert(sniff(other) == FormatSniffer::FORMAT_OGG_OTHER);
+        assert(sniff(fromString("RIFF\x24\0\0\0WAVEfmt ", 16)) == FormatSniffer::FORMAT_WAV);
+        assert(sniff(fromString("RIFF\x24\0\0\0AVI LIST", 16)) == FormatSniffer::FORMAT_UNKNOWN);
+        assert(sniff(fromString("fLaC\0\0\0\x22", 8)) == FormatSniffer::FORMAT_FLAC);
+        assert(sniff(fromString("\0\0\0\x20" "ftypM4B \0\0\0\0", 16)) == FormatSniffer::FORMAT_MP4);
+        assert(sniff(bytes(4096, 0)) == FormatSniffer::FORMAT_UNKNOWN);
+    }
+
+    // Extensions, ignoring case, queries and fragments
+    assert(FormatSniffer::fromExtension("http://host/book/part1.MP3?session=1.ogg") == FormatSniffer::FORMAT_MP3);
+    assert(FormatSniffer::fromExtension("http://host/a.b/part1#t=10") == FormatSniffer::FORMAT_UNKNOWN);
+    assert(FormatSniffer::fromExtension("/books/chapter.m4b") == FormatSniffer::FORMAT_MP4);
+    assert(FormatSniffer::fromExtension("/books/chapter.opus") == FormatSniffer::FORMAT_OGG_OPUS);
+
+    // Content wins over a misleading name, and the result is cached
+    {
+        FormatSniffer sniffer;
+        string name = writeTemp(mp3Frames(5));
+        assert(sniffer.detect(name) == FormatSniffer::FORMAT_MP3);
+
+        // The cache answers without reading the file again
+        unlink(name.c_str());
+        assert(sniffer.detect(name) == FormatSniffer::FORMAT_MP3);
+        sniffer.forget(name);
+        assert(sniffer.detect(name) == FormatSniffer::FORMAT_UNKNOWN);
+
+        // Files that can not be sniffed fall back to the extension
+        assert(sniffer.detect("/nonexistent/file.wav") == FormatSniffer::FORMAT_WAV);
+
+        // Remote files are not read, but typefind results are kept
+        assert(sniffer.detect("http://localhost:1/book/part1") == FormatSniffer::FORMAT_UNKNOWN);
+        sniffer.remember("http://localhost:1/book/part1", FormatSniffer::FORMAT_AAC);
+        assert(sniffer.detect("http://localhost:1/book/part1") == FormatSniffer::FORMAT_AAC);
+    }
+
+    // ID3 tag larger than the first read
+    {
+        FormatSniffer sniffer;
+        bytes data = id3Tag(SNIFF_BYTES * 2);
+        bytes frames = mp3Frames(3);
+        data.insert(data.end(), frames.begin(), frames.end());
+        string name = writeTemp(data);
+        assert(sniffer.detect(name) == FormatSniffer::FORMAT_MP3);
+        unlink(name.c_str());
+    }
+
+    // The test data, when run from make check
+    const char *srcdir = getenv("srcdir");
+    if(srcdir != NULL) {
+        FormatSniffer sniffer;
+        assert(sniffer.detect(string(srcdir) + "/testdata/wav/dtb_10s.wav") == FormatSniffer::FORMAT_WAV);
+        assert(sniffer.detect(string(srcdir) + "/testdata/ogg/dtb_10s.ogg") == FormatSniffer::FORMAT_OGG_VORBIS);
+        assert(sniffer.detect(string(srcdir) + "/testdata/mp3/dtb_10s.mp3") == FormatSniffer::FORMAT_MP3);
+        assert(sniffer.detect(string(srcdir) + "/testdata/flac/dtb_10s.flac") == FormatSniffer::FORMAT_FLAC);
+    }
+
+    return 0;
+}
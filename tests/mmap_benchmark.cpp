@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares CPU time, peak resident memory and page faults of filesrc and
+ * the kolibremmapsrc element while playing a wav file. Each run is done
+ * in a child process of its own so the resource usage is not mixed up.
+ *
+ * By default files are decoded as fast as possible, with -r they are
+ * played in real time to a fakesink.
+ *
+ * usage: mmapbenchmark [-r] FILE...
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <gst/gst.h>
+
+#include "MmapSrcElement.h"
+
+// Play the file with the given source element, exit code 0 on success
+static int play(const char *filename, const char *source, bool realtime)
+{
+    char description[1024];
+    snprintf(description, sizeof(description),
+            "%s location=\"%s\" ! wavparse ! audioconvert ! volume volume=0.5 ! fakesink sync=%s",
+            source, filename, realtime ? "true" : "false");
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description, &error);
+    if(pipeline == NULL) {
+        fprintf(stderr, "%s: %s\n", source, error->message);
+        g_error_free(error);
+        return 1;
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+            (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    bool ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    return ok ? 0 : 1;
+}
+
+// Run play() in a child process, return false on failure
+static bool run(const char *filename, const char *source, bool realtime, struct rusage *usage)
+{
+    pid_t pid = fork();
+    if(pid < 0) return false;
+    if(pid == 0) {
+        gst_init(NULL, NULL);
+        mmapsrc_element_register();
+        _exit(play(filename, source, realtime));
+    }
+
+    int status;
+    if(wait4(pid, &status, 0, usage) != pid) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    bool realtime = false;
+    int first = 1;
+    if(argc > 1 && strcmp(argv[1], "-r") == 0) {
+        realtime = true;
+        first = 2;
+    }
+
+    const char *sources[] = { "filesrc", "kolibremmapsrc" };
+
+    printf("%-40s %-16s %10s %12s %12s %12s\n", "file", "element", "cpu ms", "max rss kB", "minor flt", "major flt");
+    for(int f = first; f < argc; f++) {
+        for(unsigned int s = 0; s < sizeof(sources) / sizeof(sources[0]); s++) {
+            struct rusage usage;
+            if(!run(argv[f], sources[s], realtime, &usage)) {
+                printf("%-40s %-16s %10s\n", argv[f], sources[s], "failed");
+                continue;
+            }
+            double cpu = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+                (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+            printf("%-40s %-16s %10.1f %12ld %12ld %12ld\n", argv[f], sources[s], cpu,
+                    usage.ru_maxrss, usage.ru_minflt, usage.ru_majflt);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstdio>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <unistd.h>
+#include "PauseIndex.h"
+
+#include "setup_logging.h"
+
+#define RATE 16000
+
+using namespace std;
+
+// Speech like bursts of tone with pauses of the given lengths in between
+vector<unsigned char> buildIndex(const int *pausesMs, int count, double gain)
+{
+    PauseIndex::Builder builder(RATE);
+    vector<short> samples;
+    for(int p = 0; p <= count; p++) {
+        for(int i = 0; i < RATE; i++)
+            samples.push_back((short)(gain * 16000.0 * sin(2.0 * M_PI * 180.0 * i / RATE)));
+        if(p < count)
+            for(int i = 0; i < pausesMs[p] * RATE / 1000; i++)
+                samples.push_back((short)((rand() % 21) - 10)); // Room noise
+    }
+    builder.addSamples(&samples[0], samples.size() / 2);
+    builder.addSamples(&samples[samples.size() / 2], samples.size() - samples.size() / 2);
+    return builder.finish();
+}
+
+int main(int argc, char *argv[])
+{
+    setup_logging();
+
+    const int pausesMs[] = { 600, 100, 1500 };
+
+    // The 100 ms gap is too short to be a pause, at any recording level
+    for(double gain = 1.0; gain > 0.05; gain /= 4.0) {
+        vector<unsigned char> energy = buildIndex(pausesMs, 3, gain);
+        vector<Player::pauseData> pauses = PauseIndex::findPauses(energy);
+        assert(pauses.size() == 2);
+        assert(labs(pauses[0].start - 1000) <= PAUSEINDEX_WINDOW_MS);
+        assert(labs(pauses[0].stop - 1600) <= PAUSEINDEX_WINDOW_MS);
+        assert(labs(pauses[1].start - 3700) <= PAUSEINDEX_WINDOW_MS);
+        assert(labs(pauses[1].stop - 5200) <= PAUSEINDEX_WINDOW_MS);
+    }
+
+    // Silence only has no pauses
+    assert(PauseIndex::findPauses(vector<unsigned char>(100, 0)).empty());
+
+    char dir[] = "/tmp/pauseindextestXXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    string cachedir = string(dir) + "/cache";
+
+    {
+        PauseIndex index;
+        index.setCacheDir(cachedir);
+        vector<Player::pauseData> pauses;
+
+        // Unknown files are queued once
+        assert(!index.getPauses("book.mp3", pauses));
+        assert(!index.getPauses("book.mp3", pauses));
+        string url;
+        assert(index.waitJob(url));
+        assert(url == "book.mp3");
+
+        index.store(url, buildIndex(pausesMs, 3, 1.0));
+        assert(index.getPauses("book.mp3", pauses));
+        assert(pauses.size() == 2);
+
+        // Seeks close to a pause land just before the next phrase
+        assert(index.snap("book.mp3", 1500, 500) == 1600 - PAUSEINDEX_SNAP_LEAD_MS);
+        assert(index.snap("book.mp3", 5000, 500) == 5200 - PAUSEINDEX_SNAP_LEAD_MS);
+        assert(index.snap("book.mp3", 2500, 500) == 2500);
+        assert(index.snap("other.mp3", 2500, 500) == 2500);
+
+        // Files that fail are not retried
+        index.request("broken.mp3");
+        assert(index.waitJob(url));
+        index.failed(url);
+        assert(!index.getPauses("broken.mp3", pauses));
+
+        index.shutdown();
+        assert(!index.waitJob(url));
+    }
+
+    // A new index finds the file in the disk cache
+    {
+        PauseIndex index;
+        index.setCacheDir(cachedir);
+        vector<Player::pauseData> pauses;
+        assert(index.getPauses("book.mp3", pauses));
+        assert(pauses.size() == 2);
+    }
+
+    system((string("rm -rf ") + dir).c_str());
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cassert>
+#include <unistd.h>
+#include "PlayerMetrics.h"
+
+#include "setup_logging.h"
+
+int main(int argc, char *argv[])
+{
+    setup_logging();
+
+    PlayerMetrics metrics;
+
+    // Counters
+    metrics.count(PlayerMetrics::BUFFERS_PROCESSED);
+    metrics.count(PlayerMetrics::BUFFERS_PROCESSED, 2);
+    metrics.count(PlayerMetrics::QOS_EVENTS);
+    metrics.count(PlayerMetrics::TIME_NOTIFICATIONS, 4);
+
+    Player::metricsData data = metrics.snapshot();
+    assert(data.buffersProcessed == 3);
+    assert(data.qosEvents == 1);
+    assert(data.buffersSkipped == 0);
+    assert(data.timeNotifications == 4);
+
+    // Histograms, 0 us goes to the first bucket, 3 us to the third (2 <= 3 < 4)
+    metrics.record(PlayerMetrics::DATAMUTEX_WAIT, 0);
+    metrics.record(PlayerMetrics::DATAMUTEX_WAIT, 3 * GST_USECOND);
+    metrics.record(PlayerMetrics::DATAMUTEX_WAIT, 3600 * GST_SECOND);
+
+    data = metrics.snapshot();
+    assert(data.dataMutexWait.count == 3);
+    assert(data.dataMutexWait.buckets[0] == 1);
+    assert(data.dataMutexWait.buckets[2] == 1);
+    assert(data.dataMutexWait.buckets[PLAYER_HISTOGRAM_BUCKETS - 1] == 1);
+    assert(data.dataMutexWait.max == 3600ULL * 1000000ULL);
+
+    // Timers only record when started
+    metrics.stop(PlayerMetrics::SEEK_LATENCY);
+    assert(metrics.snapshot().seekLatency.count == 0);
+    metrics.start(PlayerMetrics::SEEK_LATENCY);
+    usleep(1000);
+    metrics.stop(PlayerMetrics::SEEK_LATENCY);
+    metrics.stop(PlayerMetrics::SEEK_LATENCY);
+    data = metrics.snapshot();
+    assert(data.seekLatency.count == 1);
+    assert(data.seekLatency.total >= 1000);
+
+    // Scoped timers record when they go out of scope
+    {
+        PlayerMetricsTimer timer(metrics, PlayerMetrics::PROBE_TIME);
+        assert(metrics.snapshot().probeTime.count == 0);
+    }
+    assert(metrics.snapshot().probeTime.count == 1);
+
+    metrics.dump();
+
+    metrics.reset();
+    data = metrics.snapshot();
+    assert(data.buffersProcessed == 0);
+    assert(data.dataMutexWait.count == 0);
+
+    return 0;
+}
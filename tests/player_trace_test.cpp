@@ -0,0 +1,87 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include "PlayerTrace.h"
+
+#include "setup_logging.h"
+
+using namespace std;
+
+PlayerTrace trace;
+
+void *streaming_thread(void *)
+{
+    // Overflow the ring, only the newest events should be dumped
+    for(int i = 0; i < TRACE_RING_SIZE + 100; i++)
+        trace.counter("streaming", "position", i);
+    return NULL;
+}
+
+int count(const string &haystack, const string &needle)
+{
+    int n = 0;
+    for(size_t pos = haystack.find(needle); pos != string::npos; pos = haystack.find(needle, pos + 1))
+        n++;
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    setup_logging();
+
+    // Nothing is recorded while disabled
+    trace.instant("api", "ignored");
+
+    trace.setEnabled(true);
+    {
+        PlayerTraceSpan span(trace, "api", "open");
+        trace.instant("api", "seek", 1234);
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, streaming_thread, NULL);
+    pthread_join(thread, NULL);
+
+    const char *filename = "player_trace_test.json";
+    assert(trace.dump(filename));
+
+    ifstream in(filename);
+    stringstream buf;
+    buf << in.rdbuf();
+    string json = buf.str();
+
+    assert(json.find("\"traceEvents\"") != string::npos);
+    assert(json.find("ignored") == string::npos);
+    assert(count(json, "\"name\":\"open\"") == 2);
+    assert(json.find("\"value\":1234") != string::npos);
+    assert(count(json, "\"name\":\"thread_name\"") == 2);
+    assert(count(json, "\"name\":\"position\"") == TRACE_RING_SIZE);
+    assert(json.find("\"position\":99}") == string::npos);
+    assert(json.find("\"position\":100}") != string::npos);
+
+    remove(filename);
+    return 0;
+}
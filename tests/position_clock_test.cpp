@@ -0,0 +1,111 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <pthread.h>
+#include <gst/gst.h>
+#include "PositionClock.h"
+
+#define MS GST_MSECOND
+#define BASE (10 * GST_SECOND)
+
+PositionClock positions;
+gint written = 0;
+
+// Streaming thread, 20 ms buffers at tempo 1.5 from file position 3 s
+void *streaming_thread(void *)
+{
+    for(int i = 0; i < 20000; i++) {
+        positions.add(i * 20 * MS, 20 * MS, 3 * GST_SECOND + i * 30 * MS, 1.5);
+        g_atomic_int_set(&written, i + 1);
+        g_usleep(20);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    gst_init(&argc, &argv);
+    GstClock *clock = gst_system_clock_obtain();
+
+    // Nothing playing
+    assert(positions.positionAt(BASE) == 0);
+
+    // Buffers queued ahead of the clock, 20 ms each from file position 5 s
+    positions.start(clock, BASE, 0);
+    for(int i = 0; i < 10; i++)
+        positions.add(i * 20 * MS, 20 * MS, 5 * GST_SECOND + i * 20 * MS, 1.0);
+
+    // Before the first buffer is heard it is the next to be heard
+    assert(positions.positionAt(BASE - 5 * MS) == 5 * GST_SECOND);
+
+    // Positions move between buffers, not in buffer sized steps
+    assert(positions.positionAt(BASE + 7 * MS) == 5 * GST_SECOND + 7 * MS);
+    assert(positions.positionAt(BASE + 33 * MS) == 5 * GST_SECOND + 33 * MS);
+
+    // Past the last buffer the position stops at its end, it was not played yet
+    assert(positions.positionAt(BASE + 500 * MS) == 5 * GST_SECOND + 200 * MS);
+
+    // Latency delays what is heard
+    positions.start(clock, BASE, 50 * MS);
+    assert(positions.positionAt(BASE + 83 * MS) == 5 * GST_SECOND + 33 * MS);
+
+    // Tempo scales the movement within a buffer, a gap in the file
+    // (dropped silence) shows as a jump at the buffer start
+    positions.flush();
+    positions.start(clock, BASE, 0);
+    positions.add(0, 20 * MS, GST_SECOND, 2.0);
+    positions.add(20 * MS, 20 * MS, 2 * GST_SECOND, 2.0);
+    assert(positions.positionAt(BASE + 10 * MS) == GST_SECOND + 20 * MS);
+    assert(positions.positionAt(BASE + 30 * MS) == 2 * GST_SECOND + 20 * MS);
+
+    // Later positions are extrapolated from the newest buffer at its tempo
+    assert(positions.clockTimeAt(3 * GST_SECOND) == BASE + 20 * MS + 500 * MS);
+
+    // The position is held while paused and after a flush until new
+    // buffers arrive
+    positions.stop();
+    positions.add(0, 20 * MS, 7 * GST_SECOND, 1.0);
+    assert(positions.position() == 7 * GST_SECOND);
+    assert(!GST_CLOCK_TIME_IS_VALID(positions.clockTimeAt(8 * GST_SECOND)));
+    positions.flush();
+    assert(positions.position() == 7 * GST_SECOND);
+
+    // Readers never see a half written anchor
+    positions.stop();
+    positions.start(clock, 0, 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, streaming_thread, NULL);
+    int reads = 0;
+    for(int n = 0; n < 20000; n = g_atomic_int_get(&written)) {
+        if(n < 20) continue;
+        // A time within one of the last buffers written, which maps to 3 s + 1.5 t
+        GstClockTime now = (n - 20 + rand() % 19) * 20 * MS + (rand() % 20) * MS;
+        assert(positions.positionAt(now) == 3 * GST_SECOND + (gint64)(now * 1.5));
+        reads++;
+    }
+    pthread_join(thread, NULL);
+    printf("%d reads while writing\n", reads);
+
+    positions.stop();
+    gst_object_unref(clock);
+    return 0;
+}
@@ -18,6 +18,8 @@ along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <Player.h>
 
 #include "setup_logging.h"
@@ -151,6 +153,16 @@ bool PlayerControl::enable( int argc, char **argv )
     player->enable(&var_argc, &var_argv);
 }
 
+// Peak resident memory of this process in kB, -1 if unknown
+long peakRss()
+{
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+        if (line.compare(0, 6, "VmHWM:") == 0) return atol(line.c_str() + 6);
+    return -1;
+}
+
 int main(int argc, char *argv[])
 {
     setup_logging();
@@ -159,5 +171,18 @@ int main(int argc, char *argv[])
 
     playerControl.enable(argc, argv);
 
+    // --rss-budget=KB plays in the low-memory profile and checks the peak memory use
+    long budget = 0;
+    for (int i = 1; i < playerControl.var_argc; i++)
+        if (strncmp(playerControl.var_argv[i], "--rss-budget=", 13) == 0)
+            budget = atol(playerControl.var_argv[i] + 13);
+    if (budget > 0) playerControl.player->setLowMemory(true);
+
     playerControl.play();
+
+    if (budget > 0) {
+        long peak = peakRss();
+        cout << "\nPeak RSS " << peak << " kB, budget " << budget << " kB" << endl;
+        assert(peak < 0 || peak <= budget);
+    }
 }
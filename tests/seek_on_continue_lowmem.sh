@@ -0,0 +1,15 @@
+#!/bin/sh
+
+# play the seek_on_continue segments in the low-memory profile and check
+# that the peak resident memory stays within the budget, in kB
+rss_budget=${RSS_BUDGET:-49152}
+
+./seek_on_continue --rss-budget=$rss_budget $gst_params
+result=$?
+
+if [ $result -ne 0 ]
+then
+    echo TEST FAILED! Returned $result
+fi
+
+exit $result
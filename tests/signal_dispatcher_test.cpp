@@ -0,0 +1,127 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include <unistd.h>
+#include <pthread.h>
+#include <boost/bind.hpp>
+#include "SignalDispatcher.h"
+
+#include "setup_logging.h"
+
+using namespace std;
+
+pthread_mutex_t ranMutex = PTHREAD_MUTEX_INITIALIZER;
+vector<int> ran;
+vector<pthread_t> threads;
+
+// A slow application callback
+void callback(int n)
+{
+    usleep(20000);
+    pthread_mutex_lock(&ranMutex);
+    ran.push_back(n);
+    threads.push_back(pthread_self());
+    pthread_mutex_unlock(&ranMutex);
+}
+
+size_t count()
+{
+    pthread_mutex_lock(&ranMutex);
+    size_t n = ran.size();
+    pthread_mutex_unlock(&ranMutex);
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    setup_logging();
+
+    // Posting doesn't wait for the callbacks, they run in order on another thread
+    {
+        SignalDispatcher dispatcher;
+        GTimer *timer = g_timer_new();
+        for(int i = 0; i < 5; i++)
+            dispatcher.post(boost::bind(callback, i));
+        double posting = g_timer_elapsed(timer, NULL);
+        g_timer_destroy(timer);
+        printf("posting 5 callbacks took %.3f ms\n", posting * 1000);
+        assert(posting < 0.02);
+
+        for(int i = 0; i < 100 && count() < 5; i++) usleep(10000);
+        assert(count() == 5);
+        for(int i = 0; i < 5; i++) {
+            assert(ran[i] == i);
+            assert(!pthread_equal(threads[i], pthread_self()));
+        }
+    }
+
+    // With a context the callbacks run where the context is iterated
+    {
+        ran.clear();
+        threads.clear();
+        SignalDispatcher dispatcher;
+        GMainContext *context = g_main_context_new();
+        dispatcher.setContext(context);
+        dispatcher.post(boost::bind(callback, 7));
+        assert(count() == 0);
+        while(g_main_context_iteration(context, FALSE));
+        assert(count() == 1 && ran[0] == 7);
+        assert(pthread_equal(threads[0], pthread_self()));
+        g_main_context_unref(context);
+    }
+
+    // Nothing runs after shutdown
+    {
+        ran.clear();
+        SignalDispatcher dispatcher;
+        dispatcher.shutdown();
+        dispatcher.post(boost::bind(callback, 1));
+        usleep(50000);
+        assert(count() == 0);
+    }
+
+    // Nor from a context, also when the dispatcher is gone before the context runs
+    {
+        ran.clear();
+        GMainContext *context = g_main_context_new();
+        SignalDispatcher *dispatcher = new SignalDispatcher();
+        dispatcher->setContext(context);
+        dispatcher->post(boost::bind(callback, 2));
+        dispatcher->post(boost::bind(callback, 3));
+        dispatcher->shutdown();
+        dispatcher->post(boost::bind(callback, 4));
+        while(g_main_context_iteration(context, FALSE));
+        assert(count() == 0);
+
+        dispatcher->setContext(NULL);
+        delete dispatcher;
+        dispatcher = new SignalDispatcher();
+        dispatcher->setContext(context);
+        dispatcher->post(boost::bind(callback, 5));
+        delete dispatcher;
+        while(g_main_context_iteration(context, FALSE));
+        assert(count() == 0);
+        g_main_context_unref(context);
+    }
+
+    return 0;
+}
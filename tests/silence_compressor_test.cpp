@@ -0,0 +1,137 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstdio>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include "SilenceCompressor.h"
+
+#define RATE 22050
+
+using namespace std;
+
+// One second of tone, a pause of pauseMs, one second of tone
+vector<short> makeInput(int pauseMs, double noise)
+{
+    int pause = pauseMs * RATE / 1000;
+    vector<short> samples(2 * RATE + pause);
+    for(size_t i = 0; i < samples.size(); i++) {
+        bool tone = i < RATE || i >= (size_t)(RATE + pause);
+        double v = tone ? 0.5 * sin(2.0 * M_PI * 220.0 * i / RATE) : noise * ((rand() % 2001) - 1000) / 1000.0;
+        samples[i] = (short)(v * 32767.0);
+    }
+    return samples;
+}
+
+vector<short> run(SilenceCompressor &compressor, const vector<short> &in)
+{
+    vector<short> out(in.size() + compressor.pending() + RATE);
+    int written = 0;
+    for(size_t pos = 0; pos < in.size(); pos += 1000) {
+        int n = in.size() - pos < 1000 ? in.size() - pos : 1000;
+        written += compressor.process(&in[pos], &out[written], n);
+    }
+    written += compressor.flush(&out[written]);
+    out.resize(written);
+    return out;
+}
+
+// First frame after start that is louder than level
+int firstLoud(const vector<short> &samples, int start)
+{
+    for(size_t i = start; i < samples.size(); i++)
+        if(abs(samples[i]) > 1000) return i;
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    int maxPause = SILENCE_MAX_PAUSE_MS * RATE / 1000;
+    int ms = RATE / 1000;
+
+    // A long pause is shortened to the maximum pause length
+    {
+        SilenceCompressor compressor(RATE, 1, false);
+        vector<short> in = makeInput(2000, 0.0);
+        vector<short> out = run(compressor, in);
+
+        int dropped = in.size() - out.size();
+        printf("dropped %d frames\n", dropped);
+        // The envelope takes a while to fall below the threshold after the tone
+        assert(dropped <= 2 * RATE - maxPause && dropped > 2 * RATE - maxPause - 100 * ms);
+        assert(compressor.droppedFrames() == dropped);
+
+        // Speech after the pause starts intact and maps back to the input
+        int onset = firstLoud(out, RATE + 10 * ms);
+        int source = compressor.toSource(onset);
+        printf("onset %d maps to %d, expected %d\n", onset, source, firstLoud(in, RATE + 10 * ms));
+        assert(source == firstLoud(in, RATE + 10 * ms));
+        for(int i = 0; i < 100; i++) assert(out[onset + i] == in[source + i]);
+
+        // Positions before the pause are unchanged
+        assert(compressor.toSource(RATE / 2) == RATE / 2);
+
+        // A new segment starts a new mapping
+        compressor.clear();
+        assert(compressor.droppedFrames() == 0);
+        assert(compressor.totalDroppedFrames() == dropped);
+        assert(compressor.toSource(RATE * 2) == RATE * 2);
+    }
+
+    // Nothing is dropped when disabled
+    {
+        SilenceCompressor compressor(RATE, 1, false);
+        compressor.setEnabled(false);
+        vector<short> in = makeInput(2000, 0.0);
+        vector<short> out = run(compressor, in);
+        assert(out.size() == in.size());
+    }
+
+    // Pauses shorter than the maximum are left alone
+    {
+        SilenceCompressor compressor(RATE, 1, false);
+        vector<short> in = makeInput(SILENCE_MAX_PAUSE_MS - 50, 0.0);
+        vector<short> out = run(compressor, in);
+        assert(out.size() == in.size());
+    }
+
+    // Noise above the threshold is not a pause
+    {
+        SilenceCompressor compressor(RATE, 1, false);
+        vector<short> in = makeInput(2000, 0.05);
+        vector<short> out = run(compressor, in);
+        assert(out.size() == in.size());
+    }
+
+    // Float stereo
+    {
+        SilenceCompressor compressor(RATE, 2, true);
+        vector<short> mono = makeInput(1000, 0.0);
+        vector<float> in(mono.size() * 2), out(mono.size() * 2);
+        for(size_t i = 0; i < mono.size(); i++) in[i * 2] = in[i * 2 + 1] = mono[i] / 32768.0f;
+        int written = compressor.process(&in[0], &out[0], mono.size());
+        written += compressor.flush(&out[written * 2]);
+        int dropped = mono.size() - written;
+        assert(dropped <= RATE - maxPause && dropped > RATE - maxPause - 100 * ms);
+    }
+
+    return 0;
+}
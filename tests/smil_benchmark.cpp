@@ -0,0 +1,141 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Measures how many SMIL clock values are converted per second, with the
+ * batch parser and with the strdup/atof conversion SmilTimeCode used
+ * before. The values are synthetic clip begin and end attributes in the
+ * forms found in DAISY 2.02 and 3 books.
+ *
+ * usage: smilbenchmark [VALUES]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <clocale>
+#include <vector>
+#include <string>
+#include <sys/time.h>
+
+#include "SmilTime.h"
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// The conversion SmilTimeCode did before, for comparison
+static unsigned long legacyParse(const char *strSMIL)
+{
+    if(strstr(strSMIL, "npt=") != NULL) strSMIL += 4;
+    char *timecode = strdup(strSMIL);
+    int startMetric = 0;
+
+    if(localeconv()->decimal_point[0] != '.') {
+        for(unsigned i = 0; i < strlen(timecode); i++)
+            if(timecode[i] == '.')
+                timecode[i] = localeconv()->decimal_point[0];
+    }
+
+    char *pos;
+    if((pos = strstr(timecode, "ms")) != NULL) { *pos = '\0'; startMetric = 0; }
+    else if((pos = strstr(timecode, "s")) != NULL) { *pos = '\0'; startMetric = 1; }
+    else if((pos = strstr(timecode, "min")) != NULL) { *pos = '\0'; startMetric = 2; }
+    else if((pos = strstr(timecode, "h")) != NULL) { *pos = '\0'; startMetric = 3; }
+    else {
+        int cnt = 0;
+        for(unsigned int i = 0; i < strlen(timecode); i++)
+            if(timecode[i] == ':') cnt++;
+        startMetric = cnt >= 2 ? 3 : cnt == 1 ? 2 : 1;
+    }
+
+    pos = timecode;
+    char *vptr = timecode;
+    int finished = 0;
+    double fields[4] = { 0, 0, 0, 0 };
+    while(startMetric >= 0 && !finished) {
+        if(*pos == ':' || *pos == '\0') {
+            if(*pos == '\0') finished = 1;
+            *pos = '\0';
+            fields[startMetric--] = atof(vptr);
+            pos++;
+            vptr = pos;
+        }
+        pos++;
+    }
+
+    fields[0] += fields[3] * 60 * 60 * 1000;
+    fields[0] += fields[2] * 60 * 1000;
+    fields[0] += fields[1] * 1000;
+    free(timecode);
+    return (unsigned long)fields[0];
+}
+
+int main(int argc, char *argv[])
+{
+    long count = argc > 1 ? atol(argv[1]) : 1000000;
+    if(count <= 0) count = 1000000;
+
+    std::vector<std::string> strings;
+    strings.reserve(count);
+    char buf[64];
+    for(long i = 0; i < count; i++) {
+        long ms = (i * 2713) % 36000000;
+        switch(i % 4) {
+            case 0: snprintf(buf, sizeof(buf), "npt=%ld.%03lds", ms / 1000, ms % 1000); break;
+            case 1: snprintf(buf, sizeof(buf), "%ld:%02ld:%02ld.%03ld", ms / 3600000, ms / 60000 % 60, ms / 1000 % 60, ms % 1000); break;
+            case 2: snprintf(buf, sizeof(buf), "%02ld:%02ld.%03ld", ms / 60000 % 60, ms / 1000 % 60, ms % 1000); break;
+            default: snprintf(buf, sizeof(buf), "%ldms", ms); break;
+        }
+        strings.push_back(buf);
+    }
+    std::vector<const char *> values(count);
+    for(long i = 0; i < count; i++) values[i] = strings[i].c_str();
+    std::vector<long long> ms(count);
+
+    double start = now();
+    size_t parsed = SmilTimeCode::parse(&values[0], count, &ms[0]);
+    double batch = now() - start;
+    if(parsed != (size_t)count) {
+        fprintf(stderr, "%ld values not parsed\n", count - (long)parsed);
+        return 1;
+    }
+
+    unsigned long long sum = 0;
+    start = now();
+    for(long i = 0; i < count; i++) sum += legacyParse(values[i]);
+    double legacy = now() - start;
+
+    // Both must agree, apart from the rounding of atof
+    unsigned long long batchSum = 0;
+    for(long i = 0; i < count; i++) batchSum += ms[i];
+    long long difference = (long long)(batchSum - sum);
+    if(difference < -count || difference > count) {
+        fprintf(stderr, "results differ by %lld ms\n", difference);
+        return 1;
+    }
+
+    printf("%-8s %14s %12s\n", "parser", "values / s", "ns / value");
+    printf("%-8s %14.0f %12.1f\n", "batch", count / batch, batch * 1e9 / count);
+    printf("%-8s %14.0f %12.1f\n", "legacy", count / legacy, legacy * 1e9 / count);
+    return 0;
+}
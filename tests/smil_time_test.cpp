@@ -0,0 +1,102 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cassert>
+#include <clocale>
+#include <cstring>
+#include "SmilTime.h"
+
+// Parse str, return the time or -1 if it is not valid
+long long parse(const char *str)
+{
+    unsigned long ms;
+    if(!SmilTimeCode::parse(str, ms)) return -1;
+    return ms;
+}
+
+int main(int argc, char *argv[])
+{
+    // Full clock values
+    assert(parse("02:30:03") == 9003000);
+    assert(parse("50:00:10.25") == 180010250);
+    assert(parse("0:00:00.001") == 1);
+    assert(parse("100:59:59.999") == 363599999);
+
+    // Partial clock values
+    assert(parse("02:33") == 153000);
+    assert(parse("00:10.5") == 10500);
+    assert(parse("90:00") == 5400000);
+
+    // Timecount values
+    assert(parse("3.2h") == 11520000);
+    assert(parse("45min") == 2700000);
+    assert(parse("30s") == 30000);
+    assert(parse("5ms") == 5);
+    assert(parse("12.467") == 12467);
+    assert(parse("0") == 0);
+    assert(parse("1.5min") == 90000);
+    assert(parse("12.7ms") == 12);
+    assert(parse("0.0000001h") == 0);
+    assert(parse("1.12345678901s") == 1123);
+
+    // DAISY forms
+    assert(parse("npt=12.345s") == 12345);
+    assert(parse("npt=0:01:02.5") == 62500);
+    assert(parse(" npt=4.5s\n") == 4500);
+    assert(parse("1:02:03:456") == 3723456);
+
+    // Not clock values
+    const char *invalid[] = { "", "npt=", "s", ".5s", "5.s", "5 s", "5sec", "5m", "1:60",
+        "1:00:60", "1:2:3:1000", "1:2:3:4.5", "1:2:3:4:5", "1::2", "1:2s", "-5s", "5,5s",
+        "1234567890123s", "12abc" };
+    for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        printf("'%s' %lld\n", invalid[i], parse(invalid[i]));
+        assert(parse(invalid[i]) == -1);
+    }
+
+    // Only len characters are read
+    unsigned long ms;
+    assert(SmilTimeCode::parse("12.5s junk", 5, ms) && ms == 12500);
+    assert(SmilTimeCode::parse("1:00:00", 4, ms) && ms == 60000);
+
+    // The decimal point does not follow the locale
+    if(setlocale(LC_NUMERIC, "sv_SE.UTF-8") || setlocale(LC_NUMERIC, "de_DE.UTF-8"))
+        assert(parse("1.5s") == 1500);
+    setlocale(LC_NUMERIC, "C");
+
+    // Batch
+    const char *values[] = { "npt=0.000s", "npt=3.120s", NULL, "", "0:00:04.5", "bad" };
+    long long out[6];
+    assert(SmilTimeCode::parse(values, 6, out) == 3);
+    assert(out[0] == 0 && out[1] == 3120 && out[2] == -1 && out[3] == -1 && out[4] == 4500 && out[5] == -1);
+
+    // Begin and end of a clip, missing values are 0
+    {
+        SmilTimeCode clip("npt=1.5s", "npt=2:03.25");
+        assert(clip.isValid() && clip.getStart() == 1500 && clip.getEnd() == 123250);
+        SmilTimeCode open("", "10s");
+        assert(open.isValid() && open.getStart() == 0 && open.getEnd() == 10000);
+        SmilTimeCode bad("1:2:3:4:5", "10s");
+        assert(!bad.isValid() && bad.getStart() == 0 && bad.getEnd() == 10000);
+    }
+
+    printf("All tests passed\n");
+    return 0;
+}
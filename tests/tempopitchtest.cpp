@@ -91,104 +91,78 @@ void PlayerControl::play()
     assert(!atEOS);
 
     player->setPitch(1.2);
-    player->pause();
-    player->resume();
     assert(player->getPitch() == 1.2);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setPitch(1.5);
-    player->pause();
-    player->resume();
     assert(player->getPitch() == 1.5);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setPitch(20.0);
-    player->pause();
-    player->resume();
     assert(player->getPitch() == PLAYER_MAX_PITCH);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setPitch(1.0);
-    player->pause();
-    player->resume();
     assert(player->getPitch() == 1.0);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(1.1);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.1);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(1.2);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.2);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(1.3);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.3);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(1.4);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.4);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(1.5);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.5);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(220.0);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==PLAYER_MAX_TEMPO);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(1.0);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.0);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(0.5);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==0.5);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
     player->setTempo(0.7);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==0.7);
     sleep(1);
     assert(player->isPlaying());
@@ -196,8 +170,6 @@ void PlayerControl::play()
 
     player->setTempo(1.0);
     player->setPitch(1.0);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.0);
     sleep(1);
     assert(player->isPlaying());
@@ -205,8 +177,6 @@ void PlayerControl::play()
 
     player->setTempo(1.5);
     player->setPitch(1.5);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.5);
     assert(player->getPitch()==1.5);
     sleep(1);
@@ -215,8 +185,6 @@ void PlayerControl::play()
 
     player->setTempo(1.2);
     player->setPitch(1.2);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.2);
     assert(player->getPitch()==1.2);
     sleep(1);
@@ -225,8 +193,6 @@ void PlayerControl::play()
 
     player->setTempo(1.6);
     player->setPitch(1.6);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.6);
     assert(player->getPitch()==1.6);
     sleep(1);
@@ -235,8 +201,6 @@ void PlayerControl::play()
 
     player->setTempo(0.6);
     player->setPitch(0.6);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==0.6);
     assert(player->getPitch()==0.6);
     sleep(1);
@@ -245,8 +209,6 @@ void PlayerControl::play()
 
     player->setTempo(1.0);
     player->setPitch(1.0);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.0);
     assert(player->getPitch()==1.0);
     sleep(1);
@@ -255,8 +217,6 @@ void PlayerControl::play()
 
     player->setTempo(0.5);
     player->setPitch(1.5);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==0.5);
     assert(player->getPitch()==1.5);
     sleep(1);
@@ -265,8 +225,6 @@ void PlayerControl::play()
 
     player->setTempo(1.5);
     player->setPitch(0.5);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.5);
     assert(player->getPitch()==0.5);
     sleep(1);
@@ -275,14 +233,32 @@ void PlayerControl::play()
 
     player->setTempo(1.0);
     player->setPitch(1.0);
-    player->pause();
-    player->resume();
     assert(player->getTempo()==1.0);
     assert(player->getPitch()==1.0);
     sleep(1);
     assert(player->isPlaying());
     assert(!atEOS);
 
+    // 100 changes while playing, without a seek, and the position keeps
+    // moving forward through them
+    player->resetMetrics();
+    long long audible = player->getAudiblePos();
+    for (int i = 0; i < 100; i++) {
+        player->setTempo(0.6 + (i * 7 % 13) * 0.1);
+        if (i % 10 == 0) player->setPitch(0.8 + (i % 3) * 0.2);
+        usleep(50000);
+        assert(player->isPlaying());
+        assert(!atEOS);
+        if (i % 10 == 9) {
+            long long now = player->getAudiblePos();
+            assert(now > audible);
+            audible = now;
+        }
+    }
+    Player::metricsData metrics = player->getMetrics();
+    assert(metrics.seekLatency.count == 0);
+    assert(metrics.buffersProcessed > 0);
+
     player->stop();
     delete player;
 }
@@ -0,0 +1,89 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cassert>
+#include "TimeMap.h"
+
+#define MS GST_MSECOND
+
+int main(int argc, char *argv[])
+{
+    // Without changes source time is output time at the segment tempo
+    {
+        TimeMap map;
+        map.reset(1.5);
+        assert(map.toSource(2000 * MS) == 3000 * MS);
+        assert(map.toOutput(3000 * MS) == 2000 * MS);
+    }
+
+    // Changes in the middle of the segment
+    {
+        TimeMap map;
+        map.reset(1.0);
+        map.setTempo(10000 * MS, 2.0);      // source 10 s
+        map.setTempo(15000 * MS, 0.5);      // source 20 s
+        assert(map.size() == 3);
+
+        assert(map.toSource(5000 * MS) == 5000 * MS);
+        assert(map.toSource(12000 * MS) == 14000 * MS);
+        assert(map.toSource(17000 * MS) == 21000 * MS);
+        assert(map.toOutput(14000 * MS) == 12000 * MS);
+        assert(map.toOutput(21000 * MS) == 17000 * MS);
+        assert(map.tempo() == 0.5);
+
+        // A second change at the same point replaces the first
+        map.setTempo(15000 * MS, 1.0);
+        assert(map.size() == 3);
+        assert(map.toSource(17000 * MS) == 22000 * MS);
+
+        // Round trips across all breakpoints
+        for(GstClockTime t = 0; t < 30000 * MS; t += 7 * MS)
+            assert(map.toOutput(map.toSource(t)) == t);
+    }
+
+    // A new segment forgets the changes
+    {
+        TimeMap map;
+        map.setTempo(1000 * MS, 2.0);
+        map.reset(2.0);
+        assert(map.size() == 1);
+        assert(map.toSource(1000 * MS) == 2000 * MS);
+    }
+
+    // Many changes keep the newest ones and stay continuous
+    {
+        TimeMap map;
+        map.reset(1.0);
+        GstClockTime source = 0;
+        for(int i = 1; i <= 1000; i++) {
+            double tempo = i % 2 ? 1.5 : 0.75;
+            map.setTempo(i * 100 * MS, tempo);
+            GstClockTime reached = map.toSource(i * 100 * MS);
+            assert(reached >= source);
+            source = reached;
+        }
+        printf("%d breakpoints, source %lld ms\n", (int)map.size(), (long long)(source / MS));
+        assert(map.size() == TIME_MAP_BREAKPOINTS);
+        // Up to the last change: 100 ms at 1.0, then 500 at 1.5 and 499 at 0.75
+        assert(source == (100 + 500 * 150 + 499 * 75) * MS);
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdio>
+#include <cassert>
+#include <vector>
+#include "TimeNotifier.h"
+
+using namespace std;
+
+// Play from start to stop in 10 ms loops, count the notifications
+int play(TimeNotifier &notifier, long long start, long long stop)
+{
+    int sent = 0;
+    for(long long ms = start; ms < stop; ms += 10)
+        if(notifier.due(ms, 0, 60000)) sent++;
+    return sent;
+}
+
+int main(int argc, char *argv[])
+{
+    // One notification per interval instead of one per loop
+    {
+        TimeNotifier notifier;
+        int sent = play(notifier, 0, 10000);
+        printf("%d notifications in 10 s\n", sent);
+        assert(sent == 10000 / TIME_INTERVAL_MS);
+
+        notifier.setInterval(1000);
+        assert(play(notifier, 10000, 20000) == 10);
+    }
+
+    // Thresholds only, several crossed in one loop give one notification
+    {
+        TimeNotifier notifier;
+        notifier.setInterval(0);
+        vector<long long> thresholds;
+        thresholds.push_back(2500);
+        thresholds.push_back(1200);
+        thresholds.push_back(1203);
+        notifier.setThresholds(thresholds);
+
+        assert(notifier.due(0, 0, 60000));      // First position
+        assert(!notifier.due(1000, 0, 60000));
+        assert(notifier.due(1210, 0, 60000));   // Passed 1200 and 1203
+        assert(!notifier.due(1220, 0, 60000));
+        assert(!notifier.due(2490, 0, 60000));
+        assert(notifier.due(2500, 0, 60000));
+        assert(!notifier.due(9000, 0, 60000));
+    }
+
+    // Seeks backwards and new segments are always notified
+    {
+        TimeNotifier notifier;
+        assert(notifier.due(5000, 0, 60000));
+        assert(!notifier.due(5010, 0, 60000));
+        assert(notifier.due(4000, 0, 60000));
+        assert(notifier.due(4010, 4000, 8000));
+
+        // A new file starts over
+        notifier.reset();
+        assert(notifier.due(4020, 4000, 8000));
+    }
+
+    return 0;
+}
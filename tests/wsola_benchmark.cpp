@@ -0,0 +1,119 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Compares the CPU time of the soundtouch pitch element and the built-in
+ * kolibrewsola element. Each file is decoded as fast as possible with
+ * the stretcher in the pipeline, the time spent decoding (measured with
+ * identity in its place) is subtracted.
+ *
+ * usage: wsolabenchmark FILE...
+ */
+
+#include <cstdio>
+#include <string>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+
+#include "WsolaElement.h"
+
+static double cpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+// Run the file through the stretcher, return CPU seconds or -1 on failure
+static double run(const char *filename, const char *stretcher, double tempo, double *audioSeconds)
+{
+    char description[1024];
+    if(std::string(stretcher) == "identity")
+        snprintf(description, sizeof(description),
+                "filesrc location=\"%s\" ! decodebin ! audioconvert ! identity ! fakesink sync=false", filename);
+    else
+        snprintf(description, sizeof(description),
+                "filesrc location=\"%s\" ! decodebin ! audioconvert ! %s tempo=%f ! fakesink sync=false", filename, stretcher, tempo);
+
+    GError *error = NULL;
+    GstElement *pipeline = gst_parse_launch(description, &error);
+    if(pipeline == NULL) {
+        fprintf(stderr, "%s: %s\n", stretcher, error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    double start = cpuSeconds();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    GstBus *bus = gst_element_get_bus(pipeline);
+    GstMessage *msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+            (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    bool ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+    gst_message_unref(msg);
+    gst_object_unref(bus);
+
+    double used = cpuSeconds() - start;
+
+    GstFormat format = GST_FORMAT_TIME;
+    gint64 duration = 0;
+    gst_element_query_duration(pipeline, &format, &duration);
+    *audioSeconds = (double)duration / GST_SECOND;
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+
+    return ok ? used : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    gst_init(&argc, &argv);
+    wsola_element_register();
+
+    const char *stretchers[] = { "pitch", "kolibrewsola" };
+    const double tempos[] = { 1.2, 1.5, 2.0 };
+
+    printf("%-40s %-14s %6s %16s\n", "file", "element", "tempo", "ms cpu / s audio");
+    for(int f = 1; f < argc; f++) {
+        double seconds = 0;
+        double baseline = run(argv[f], "identity", 1.0, &seconds);
+        if(baseline < 0 || seconds <= 0) {
+            fprintf(stderr, "failed to decode %s\n", argv[f]);
+            return 1;
+        }
+
+        for(unsigned int s = 0; s < sizeof(stretchers) / sizeof(stretchers[0]); s++) {
+            for(unsigned int t = 0; t < sizeof(tempos) / sizeof(tempos[0]); t++) {
+                double ignored;
+                double used = run(argv[f], stretchers[s], tempos[t], &ignored);
+                if(used < 0) {
+                    printf("%-40s %-14s %6.2f %16s\n", argv[f], stretchers[s], tempos[t], "n/a");
+                    continue;
+                }
+                printf("%-40s %-14s %6.2f %16.3f\n", argv[f], stretchers[s], tempos[t],
+                        (used - baseline) * 1000.0 / seconds);
+            }
+        }
+    }
+
+    return 0;
+}
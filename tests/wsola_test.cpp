@@ -0,0 +1,197 @@
+/*
+Copyright (C) 2012 Kolibre
+
+This file is part of kolibre-player.
+
+Kolibre-player is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 2.1 of the License, or
+(at your option) any later version.
+
+Kolibre-player is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with kolibre-player. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <cstdio>
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include "Wsola.h"
+
+#define RATE 22050
+#define SECONDS 6
+#define FREQ 220.0
+
+using namespace std;
+
+// Tone on the first channel, with a silent gap in the middle when gap is set
+template <typename T>
+vector<T> makeInput(int channels, bool gap, double scale)
+{
+    vector<T> samples(RATE * SECONDS * channels);
+    for(int i = 0; i < RATE * SECONDS; i++) {
+        double v = 0.5 * sin(2.0 * M_PI * FREQ * i / RATE);
+        if(gap && i > RATE * 2 && i < RATE * 4) v = 0.0;
+        for(int c = 0; c < channels; c++)
+            samples[i * channels + c] = (T)(v * scale);
+    }
+    return samples;
+}
+
+// Feed the input in chunks like a decoder would and collect the output
+template <typename T>
+vector<T> run(const vector<T> &in, int channels, double tempo, double pitch, bool silenceAware)
+{
+    Wsola<T> wsola(RATE, channels);
+    wsola.setTempo(tempo);
+    wsola.setPitch(pitch);
+    wsola.setSilenceAware(silenceAware);
+
+    vector<T> out;
+    vector<T> chunk(1024 * channels);
+    int frames = in.size() / channels;
+    for(int pos = 0; pos < frames; pos += 1024) {
+        int n = frames - pos < 1024 ? frames - pos : 1024;
+        wsola.putSamples(&in[pos * channels], n);
+        int got;
+        while((got = wsola.receiveSamples(&chunk[0], 1024)) > 0)
+            out.insert(out.end(), chunk.begin(), chunk.begin() + got * channels);
+    }
+    wsola.flush();
+    int got;
+    while((got = wsola.receiveSamples(&chunk[0], 1024)) > 0)
+        out.insert(out.end(), chunk.begin(), chunk.begin() + got * channels);
+    return out;
+}
+
+// Frequency of the first channel from its zero crossings, skipping the edges
+template <typename T>
+double frequency(const vector<T> &samples, int channels)
+{
+    int frames = samples.size() / channels;
+    int first = frames / 10, last = frames / 3;
+    int crossings = 0;
+    for(int i = first + 1; i < last; i++)
+        if((samples[(i - 1) * channels] < 0) != (samples[i * channels] < 0)) crossings++;
+    return crossings / 2.0 / ((double)(last - first) / RATE);
+}
+
+bool near(double value, double expected, double tolerance)
+{
+    printf("got %.2f, expected %.2f\n", value, expected);
+    return fabs(value - expected) <= expected * tolerance;
+}
+
+template <typename T>
+void check(int channels, double tempo, double pitch, bool gap, double scale)
+{
+    vector<T> in = makeInput<T>(channels, gap, scale);
+    vector<T> out = run<T>(in, channels, tempo, pitch, true);
+
+    double inFrames = in.size() / channels;
+    double outFrames = out.size() / channels;
+
+    // Length follows the tempo, silence only moves time around
+    assert(near(outFrames, inFrames / tempo, 0.02));
+    // Pitch follows the pitch setting only
+    assert(near(frequency(out, channels), FREQ * pitch, 0.03));
+}
+
+// Tempo 1.0 and pitch 1.0 give back the input
+template <typename T>
+void checkNeutral(int channels, double scale)
+{
+    vector<T> in = makeInput<T>(channels, true, scale);
+    vector<T> out = run<T>(in, channels, 1.0, 1.0, true);
+
+    double maxError = 0.0;
+    for(size_t i = 0; i < out.size() && i < in.size(); i++)
+        maxError = max(maxError, fabs((double)out[i] - (double)in[i]) / scale);
+    printf("neutral: %d of %d frames, max error %g\n", (int)(out.size() / channels), (int)(in.size() / channels), maxError);
+    assert(near(out.size(), in.size(), 0.01));
+    assert(maxError < 0.001);
+}
+
+// Change the tempo 100 times while playing, the output has to stay continuous
+template <typename T>
+void checkLiveChanges(int channels, double scale)
+{
+    vector<T> in = makeInput<T>(channels, false, scale);
+    Wsola<T> wsola(RATE, channels);
+
+    // The tone three times over, with a change every third chunk
+    vector<T> out;
+    vector<T> chunk(1024 * channels);
+    int frames = in.size() / channels;
+    int changes = 0, chunks = 0, previous = 0;
+    double expected = 0.0, tempo = 1.0;
+    for(int pos = 0; pos < 3 * frames; chunks++) {
+        if(chunks % 3 == 1 && changes < 100) {
+            // Between 0.6 and 1.8 and through neutral
+            tempo = 0.6 + (changes * 7 % 13) * 0.1;
+            wsola.setTempo(tempo);
+            changes++;
+        }
+        // The input is processed about a chunk after it is put
+        expected += previous / tempo;
+        int n = min(1024, frames - pos % frames);
+        previous = n;
+        wsola.putSamples(&in[pos % frames * channels], n);
+        pos += n;
+        int got;
+        while((got = wsola.receiveSamples(&chunk[0], 1024)) > 0)
+            out.insert(out.end(), chunk.begin(), chunk.begin() + got * channels);
+    }
+    expected += previous / tempo;
+    wsola.flush();
+    int got;
+    while((got = wsola.receiveSamples(&chunk[0], 1024)) > 0)
+        out.insert(out.end(), chunk.begin(), chunk.begin() + got * channels);
+    assert(changes == 100);
+
+    // Level in 10 ms windows, a gap or a dropout shows as silence
+    int window = RATE / 100;
+    int outFrames = out.size() / channels;
+    double minRms = 1.0, maxStep = 0.0;
+    for(int w = 0; w + window <= outFrames; w += window) {
+        double sum = 0.0;
+        for(int i = w; i < w + window; i++) {
+            double v = out[i * channels] / scale;
+            sum += v * v;
+            if(i > 0) maxStep = max(maxStep, fabs(v - out[(i - 1) * channels] / scale));
+        }
+        minRms = min(minRms, sqrt(sum / window));
+    }
+    printf("live changes: %d frames, expected about %.0f, min rms %.3f, max step %.3f\n", outFrames, expected, minRms, maxStep);
+
+    // The tone is 0.35 rms and moves at most 0.03 between two samples
+    assert(minRms > 0.2);
+    assert(maxStep < 0.1);
+    // Length follows the tempo, give or take what the ramps and the
+    // buffered input move between two settings
+    assert(near(outFrames, expected, 0.05));
+}
+
+int main(int argc, char *argv[])
+{
+    check<short>(1, 1.5, 1.0, false, 32767.0);
+    check<short>(2, 2.0, 1.0, false, 32767.0);
+    check<short>(1, 1.2, 1.0, true, 32767.0);
+    check<short>(1, 1.0, 1.25, false, 32767.0);
+    check<float>(1, 1.5, 1.0, false, 1.0);
+    check<float>(2, 0.75, 1.0, true, 1.0);
+    check<float>(1, 2.0, 0.8, false, 1.0);
+
+    checkNeutral<short>(2, 32767.0);
+    checkNeutral<float>(1, 1.0);
+    checkLiveChanges<short>(1, 32767.0);
+    checkLiveChanges<float>(2, 1.0);
+
+    return 0;
+}